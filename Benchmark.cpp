@@ -0,0 +1,847 @@
+#include "Benchmark.h"
+#include "ImuBuffer.h"
+#include "LivoxDevice.h"
+#include "MotionDeskew.h"
+#include "PacketCodec.h"
+#include "PointDecoder.h"
+#include "SpatialFilter.h"
+#include "SyntheticPacketSource.h"
+#include "VoxelGrid.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstring>
+#include <deque>
+#include <iomanip>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <utility>
+
+namespace
+{
+	using Clock = std::chrono::steady_clock;
+
+	// Input set: this many synthetic packets per point format.
+	constexpr size_t kPackets = 1024;
+
+	// Kernel timings are the best of kRepetitions runs of at least kMinRunTime.
+	constexpr size_t kRepetitions = 5;
+	constexpr auto kMinRunTime = std::chrono::milliseconds(20);
+
+	// Buffer-filling runs repeat until this much time has been measured.
+	constexpr auto kMinDrainTime = std::chrono::milliseconds(100);
+
+	constexpr std::array<size_t, 4> kConsumeBatches = { 256, 4096, 16384, 65536 };
+	constexpr size_t kFillBatch = 4096;
+
+	// Buffer limit for the consume and limit-change runs, and the two lower
+	// limits: one applied in place, one small enough to force a reallocation.
+	constexpr size_t kDeviceLimit = size_t(1) << 20;
+	constexpr size_t kInPlaceLimit = kDeviceLimit / 2;
+	constexpr size_t kReallocLimit = kDeviceLimit / 16;
+	constexpr size_t kLimitIterations = 10;
+
+	// Contention runs: a producer thread pushes packets of this many points
+	// while the benchmark thread drains kFillBatch at a time until it has
+	// drained kContentionPoints.
+	constexpr size_t kContentionPacket = 96;
+	constexpr size_t kContentionPoints = size_t(1) << 22;
+
+	// De-skew runs treat the decoded points as one frame of this length, with
+	// an IMU sample every kImuPeriodNs.
+	constexpr uint64_t kDeskewFrameNs = 100000000;
+	constexpr uint64_t kImuPeriodNs = 5000000;
+
+	constexpr float kVoxelLeaf = 0.1f;
+
+	// Decoder equivalence: random packets of every length in kVerifyCounts,
+	// kVerifyRounds times each, from a fixed seed. The lengths cover every
+	// scalar tail (1-7 records) after zero, one and twelve AVX2 blocks.
+	constexpr std::array<size_t, 24> kVerifyCounts = {
+		0, 1, 2, 3, 4, 5, 6, 7,
+		8, 9, 10, 11, 12, 13, 14, 15,
+		96, 97, 98, 99, 100, 101, 102, 103
+	};
+	constexpr size_t kVerifyRounds = 64;
+	constexpr uint32_t kVerifySeed = 0x4C495658;
+	// Output slack past the last point; it must come back untouched.
+	constexpr size_t kVerifySlack = 8;
+
+	// Spatial-filter runs crop to a box of this half-width, flattened to a
+	// quarter of it vertically, and a range gate out to the same distance.
+	constexpr float kSpatialCrop = 10.0f;
+
+	uint64_t
+	elapsedNs(Clock::time_point start, Clock::time_point end)
+	{
+		return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count());
+	}
+
+	// Collects the first kPackets packets a source produces.
+	class PacketCapture : public PacketSink
+	{
+	public:
+		PacketCapture()
+			: captured_(0)
+		{
+			packets_.reserve(kPackets);
+		}
+
+		void onPacket(uint32_t, const LivoxLidarEthernetPacket* packet) override
+		{
+			if (packets_.size() >= kPackets)
+			{
+				return;
+			}
+			const auto* bytes = reinterpret_cast<const uint8_t*>(packet);
+			packets_.emplace_back(bytes, bytes + PacketSource::packetSize(packet));
+			captured_.store(packets_.size());
+		}
+
+		void onImuPacket(uint32_t, const LivoxLidarEthernetPacket*) override {}
+		void onLidarInfo(uint32_t, const std::string&, const std::string&) override {}
+		void onInfoMessage(const std::string&) override {}
+		void onStatus(const std::string&) override {}
+
+		bool complete() const
+		{
+			return captured_.load() >= kPackets;
+		}
+
+		// Only valid once the source has been stopped.
+		const std::vector<std::vector<uint8_t>>& packets() const
+		{
+			return packets_;
+		}
+
+	private:
+		std::vector<std::vector<uint8_t>> packets_;
+		std::atomic<size_t> captured_;
+	};
+
+	// Lets the benchmark thread push packets into a LivoxDevice synchronously.
+	class ManualPacketSource : public PacketSource
+	{
+	public:
+		bool start(PacketSink& sink) override
+		{
+			sink_ = &sink;
+			return true;
+		}
+
+		void stop() override
+		{
+			sink_ = nullptr;
+		}
+
+		void requestDataType(uint32_t, LivoxLidarPointDataType) override {}
+
+		std::string description() const override
+		{
+			return "Benchmark";
+		}
+
+		void push(const std::vector<std::vector<uint8_t>>& packets)
+		{
+			for (const std::vector<uint8_t>& packet : packets)
+			{
+				sink_->onPacket(SyntheticPacketSource::kHandle, reinterpret_cast<const LivoxLidarEthernetPacket*>(packet.data()));
+			}
+		}
+
+	private:
+		PacketSink* sink_ = nullptr;
+	};
+
+	std::vector<std::vector<uint8_t>>
+	capturePackets(LivoxLidarPointDataType data_type)
+	{
+		SyntheticPacketSource::Config config;
+		config.rate_scale = 0.0;
+		SyntheticPacketSource source(config);
+		source.requestDataType(SyntheticPacketSource::kHandle, data_type);
+
+		PacketCapture capture;
+		source.start(capture);
+		while (!capture.complete())
+		{
+			std::this_thread::yield();
+		}
+		source.stop();
+		return capture.packets();
+	}
+
+	size_t
+	pointCount(const std::vector<std::vector<uint8_t>>& packets)
+	{
+		size_t points = 0;
+		for (const std::vector<uint8_t>& packet : packets)
+		{
+			points += reinterpret_cast<const LivoxLidarEthernetPacket*>(packet.data())->dot_num;
+		}
+		return points;
+	}
+
+	// Best-of-kRepetitions timing of fn, which processes points_per_call points.
+	template <typename Fn>
+	Benchmark::Result
+	measure(const char* name, size_t batch, size_t points_per_call, Fn&& fn)
+	{
+		Benchmark::Result best;
+		best.name = name;
+		best.batch = batch;
+		double best_per_op = std::numeric_limits<double>::max();
+		for (size_t rep = 0; rep < kRepetitions; ++rep)
+		{
+			uint64_t iterations = 0;
+			const Clock::time_point start = Clock::now();
+			Clock::time_point end = start;
+			do
+			{
+				fn();
+				++iterations;
+				end = Clock::now();
+			} while (end - start < kMinRunTime);
+
+			const uint64_t total_ns = elapsedNs(start, end);
+			const double per_op = static_cast<double>(total_ns) / static_cast<double>(iterations);
+			if (per_op < best_per_op)
+			{
+				best_per_op = per_op;
+				best.iterations = iterations;
+				best.points = iterations * points_per_call;
+				best.total_ns = total_ns;
+			}
+		}
+		return best;
+	}
+
+	template <typename Raw, typename Decode>
+	Benchmark::Result
+	measureDecode(const char* name, const std::vector<std::vector<uint8_t>>& packets, PointBlock& block, Decode decode, const PointTransform* transform = nullptr)
+	{
+		const size_t points = pointCount(packets);
+		block.resize(points);
+		const PointColumns columns = block.columns();
+		return measure(name, 0, points, [&]()
+		{
+			size_t offset = 0;
+			for (const std::vector<uint8_t>& bytes : packets)
+			{
+				const auto* packet = reinterpret_cast<const LivoxLidarEthernetPacket*>(bytes.data());
+				decode(reinterpret_cast<const Raw*>(packet->data), packet->dot_num, columns.offset(offset), transform);
+				offset += packet->dot_num;
+			}
+		});
+	}
+
+	void
+	randomRecords(std::mt19937& rng, LivoxLidarCartesianHighRawPoint* records, size_t count)
+	{
+		std::uniform_int_distribution<int32_t> coordinate(std::numeric_limits<int32_t>::min(), std::numeric_limits<int32_t>::max());
+		std::uniform_int_distribution<int> byte(0, 255);
+		for (size_t i = 0; i < count; ++i)
+		{
+			records[i].x = coordinate(rng);
+			records[i].y = coordinate(rng);
+			records[i].z = coordinate(rng);
+			records[i].reflectivity = static_cast<uint8_t>(byte(rng));
+			records[i].tag = static_cast<uint8_t>(byte(rng));
+		}
+	}
+
+	void
+	randomRecords(std::mt19937& rng, LivoxLidarCartesianLowRawPoint* records, size_t count)
+	{
+		std::uniform_int_distribution<int> coordinate(std::numeric_limits<int16_t>::min(), std::numeric_limits<int16_t>::max());
+		std::uniform_int_distribution<int> byte(0, 255);
+		for (size_t i = 0; i < count; ++i)
+		{
+			records[i].x = static_cast<int16_t>(coordinate(rng));
+			records[i].y = static_cast<int16_t>(coordinate(rng));
+			records[i].z = static_cast<int16_t>(coordinate(rng));
+			records[i].reflectivity = static_cast<uint8_t>(byte(rng));
+			records[i].tag = static_cast<uint8_t>(byte(rng));
+		}
+	}
+
+	// Points whose x, y, z, intensity or tag differ in any bit.
+	uint64_t
+	countMismatches(const PointColumns& expected, const PointColumns& actual, size_t count)
+	{
+		uint64_t mismatches = 0;
+		for (size_t i = 0; i < count; ++i)
+		{
+			if (std::memcmp(&expected.x[i], &actual.x[i], sizeof(float)) != 0
+				|| std::memcmp(&expected.y[i], &actual.y[i], sizeof(float)) != 0
+				|| std::memcmp(&expected.z[i], &actual.z[i], sizeof(float)) != 0
+				|| std::memcmp(&expected.intensity[i], &actual.intensity[i], sizeof(float)) != 0
+				|| std::memcmp(&expected.tag[i], &actual.tag[i], sizeof(float)) != 0)
+			{
+				++mismatches;
+			}
+		}
+		return mismatches;
+	}
+
+	// Decodes the same random packets with the active kernel and the scalar
+	// one. Each packet gets its own allocation so a read past its last record
+	// shows up in sanitizer builds; the output slack past the last point is
+	// compared too, so a stray write counts as a mismatch.
+	template <typename Raw, typename Decode>
+	Benchmark::Result
+	verifyDecode(const char* name, Decode active, Decode scalar, const PointTransform* transform)
+	{
+		Benchmark::Result result;
+		result.name = name;
+		const size_t columns = *std::max_element(kVerifyCounts.begin(), kVerifyCounts.end()) + kVerifySlack;
+		PointBlock expected_block;
+		PointBlock actual_block;
+		expected_block.resize(columns);
+		actual_block.resize(columns);
+		const PointColumns expected = expected_block.columns();
+		const PointColumns actual = actual_block.columns();
+
+		std::mt19937 rng(kVerifySeed);
+		const Clock::time_point start = Clock::now();
+		for (size_t round = 0; round < kVerifyRounds; ++round)
+		{
+			for (size_t count : kVerifyCounts)
+			{
+				std::vector<Raw> records(count);
+				randomRecords(rng, records.data(), count);
+				for (const PointColumns* output : { &expected, &actual })
+				{
+					std::fill(output->x, output->x + columns, -1.0f);
+					std::fill(output->y, output->y + columns, -1.0f);
+					std::fill(output->z, output->z + columns, -1.0f);
+					std::fill(output->intensity, output->intensity + columns, -1.0f);
+					std::fill(output->tag, output->tag + columns, -1.0f);
+				}
+				scalar(records.data(), count, expected, transform);
+				active(records.data(), count, actual, transform);
+				result.mismatches += countMismatches(expected, actual, count + kVerifySlack);
+				++result.iterations;
+				result.points += count;
+			}
+		}
+		result.total_ns = elapsedNs(start, Clock::now());
+		return result;
+	}
+
+	// The mounting extrinsic of the *_extrinsic rows: tilted on every axis.
+	PointTransform
+	tiltedMount()
+	{
+		return PointTransform::fromEuler(0.1, -0.2, 1.5, 2.0, -30.0, 45.0);
+	}
+
+	size_t
+	byteCount(const std::vector<std::vector<uint8_t>>& packets)
+	{
+		size_t bytes = 0;
+		for (const std::vector<uint8_t>& packet : packets)
+		{
+			bytes += packet.size();
+		}
+		return bytes;
+	}
+
+	// Encodes, then decodes, every packet with PacketCodec. Both runs report
+	// the raw packet bytes they covered and the overall compression ratio.
+	void
+	measureCodec(const char* encode_name, const char* decode_name, const std::vector<std::vector<uint8_t>>& packets, std::vector<Benchmark::Result>& results)
+	{
+		const size_t points = pointCount(packets);
+		const size_t bytes = byteCount(packets);
+		std::vector<std::vector<uint8_t>> encoded(packets.size());
+		for (size_t i = 0; i < packets.size(); ++i)
+		{
+			encoded[i].resize(PacketCodec::maxEncodedSize(packets[i].size()));
+		}
+		std::vector<size_t> encoded_sizes(packets.size());
+
+		Benchmark::Result encode = measure(encode_name, 0, points, [&]()
+		{
+			for (size_t i = 0; i < packets.size(); ++i)
+			{
+				encoded_sizes[i] = PacketCodec::encode(reinterpret_cast<const LivoxLidarEthernetPacket*>(packets[i].data()), packets[i].size(), encoded[i].data());
+			}
+		});
+
+		size_t encoded_bytes = 0;
+		for (size_t size : encoded_sizes)
+		{
+			encoded_bytes += size;
+		}
+		size_t largest = 0;
+		for (const std::vector<uint8_t>& raw : packets)
+		{
+			largest = std::max(largest, raw.size());
+		}
+		std::vector<uint8_t> packet(largest);
+		Benchmark::Result decode = measure(decode_name, 0, points, [&]()
+		{
+			for (size_t i = 0; i < packets.size(); ++i)
+			{
+				PacketCodec::decode(encoded[i].data(), encoded_sizes[i], packet.data(), packet.size());
+			}
+		});
+
+		const double ratio = encoded_bytes == 0 ? 0.0 : static_cast<double>(bytes) / static_cast<double>(encoded_bytes);
+		for (Benchmark::Result* result : { &encode, &decode })
+		{
+			result->bytes = result->iterations * bytes;
+			result->compression_ratio = ratio;
+			results.push_back(*result);
+		}
+	}
+
+	// Spreads the decoded points over one frame and feeds an IMU turning at
+	// about 90 degrees a second. deskew_prepare times the per-frame gyro
+	// integration; the reproject rows correct the points in place.
+	void
+	measureDeskew(PointBlock& block, std::vector<Benchmark::Result>& results)
+	{
+		const size_t points = block.size();
+		const PointColumns columns = block.columns();
+		for (size_t i = 0; i < points; ++i)
+		{
+			columns.timestamp[i] = kDeskewFrameNs * i / points;
+		}
+
+		ImuBuffer imu;
+		std::vector<uint8_t> bytes(offsetof(LivoxLidarEthernetPacket, data) + sizeof(LivoxLidarImuRawPoint));
+		auto* packet = reinterpret_cast<LivoxLidarEthernetPacket*>(bytes.data());
+		packet->time_interval = 0;
+		packet->dot_num = 1;
+		packet->data_type = kLivoxLidarImuData;
+		for (uint64_t timestamp = 0; timestamp <= kDeskewFrameNs; timestamp += kImuPeriodNs)
+		{
+			LivoxLidarImuRawPoint sample = {};
+			sample.gyro_x = 0.2f;
+			sample.gyro_y = -0.1f;
+			sample.gyro_z = 1.5f + 1e-8f * static_cast<float>(timestamp);
+			sample.acc_z = 1.0f;
+			std::memcpy(packet->timestamp, &timestamp, sizeof(timestamp));
+			std::memcpy(packet->data, &sample, sizeof(sample));
+			imu.push(packet, 0);
+		}
+
+		MotionDeskew deskew(imu);
+		results.push_back(measure("deskew_prepare", 0, points, [&]()
+		{
+			deskew.prepare(0, kDeskewFrameNs);
+		}));
+		results.push_back(measure("deskew_reproject", 0, points, [&]()
+		{
+			deskew.reproject(columns, points);
+		}));
+		results.push_back(measure("deskew_reproject_scalar", 0, points, [&]()
+		{
+			deskew.reprojectScalar(columns, points);
+		}));
+	}
+
+	// The filters work in place, so each run first restores the input with
+	// this; the copy is included in the time.
+	void
+	copyPoints(const PointColumns& source, const PointColumns& target, size_t points)
+	{
+		std::memcpy(target.x, source.x, points * sizeof(float));
+		std::memcpy(target.y, source.y, points * sizeof(float));
+		std::memcpy(target.z, source.z, points * sizeof(float));
+		std::memcpy(target.intensity, source.intensity, points * sizeof(float));
+		std::memcpy(target.tag, source.tag, points * sizeof(float));
+		std::memcpy(target.timestamp, source.timestamp, points * sizeof(uint64_t));
+	}
+
+	// Downsamples the decoded points as one frame.
+	void
+	measureVoxel(PointBlock& block, std::vector<Benchmark::Result>& results)
+	{
+		const size_t points = block.size();
+		const PointColumns source = block.columns();
+		PointBlock frame;
+		frame.resize(points);
+		const PointColumns target = frame.columns();
+		VoxelGrid voxels;
+		voxels.setLeafSize(kVoxelLeaf);
+		results.push_back(measure("voxel_filter", 0, points, [&]()
+		{
+			copyPoints(source, target, points);
+			voxels.filter(target, points);
+		}));
+	}
+
+	// All three tests on, with a sector that wraps through 180 degrees.
+	void
+	measureSpatial(PointBlock& block, std::vector<Benchmark::Result>& results)
+	{
+		const size_t points = block.size();
+		const PointColumns source = block.columns();
+		PointBlock frame;
+		frame.resize(points);
+		const PointColumns target = frame.columns();
+		std::vector<uint32_t> indices(points);
+
+		SpatialFilter::Settings settings;
+		settings.crop = true;
+		settings.crop_min[0] = settings.crop_min[1] = -kSpatialCrop;
+		settings.crop_min[2] = -kSpatialCrop / 4.0f;
+		settings.crop_max[0] = settings.crop_max[1] = kSpatialCrop;
+		settings.crop_max[2] = kSpatialCrop / 4.0f;
+		settings.range = true;
+		settings.min_range = 0.5f;
+		settings.max_range = kSpatialCrop;
+		settings.sector = true;
+		settings.azimuth[0] = 90.0f;
+		settings.azimuth[1] = -90.0f;
+		settings.elevation[0] = -30.0f;
+		settings.elevation[1] = 45.0f;
+		SpatialFilter filter;
+		filter.configure(settings);
+
+		results.push_back(measure("spatial_filter", 0, points, [&]()
+		{
+			copyPoints(source, target, points);
+			filter.apply(target, points, indices.data());
+		}));
+		results.push_back(measure("spatial_filter_scalar", 0, points, [&]()
+		{
+			copyPoints(source, target, points);
+			filter.applyScalar(target, points, indices.data());
+		}));
+	}
+
+	// A device with its own manual source; nothing here touches the SDK.
+	struct BenchDevice
+	{
+		LivoxDevice device;
+		ManualPacketSource* source = nullptr;
+
+		explicit BenchDevice(LivoxDevice::BufferStorage storage)
+		{
+			auto manual = std::make_unique<ManualPacketSource>();
+			source = manual.get();
+			device.setBufferStorage(storage);
+			device.setBufferLimit(kDeviceLimit);
+			device.start(std::move(manual));
+		}
+
+		void fill(const std::vector<std::vector<uint8_t>>& packets, size_t points)
+		{
+			device.clear();
+			while (device.bufferedSamples() + pointCount(packets) <= points)
+			{
+				source->push(packets);
+			}
+		}
+	};
+
+	// Drains a refilled buffer batch by batch, timing only the drain. The
+	// convert step runs on each drained batch and is included in the time.
+	template <typename Convert>
+	Benchmark::Result
+	measureDrain(const char* name, size_t batch, BenchDevice& bench, const std::vector<std::vector<uint8_t>>& packets, const PointColumns& destination, Convert convert)
+	{
+		Benchmark::Result result;
+		result.name = name;
+		result.batch = batch;
+		while (std::chrono::nanoseconds(result.total_ns) < kMinDrainTime)
+		{
+			bench.fill(packets, kDeviceLimit);
+			const Clock::time_point start = Clock::now();
+			for (size_t drained = bench.device.consume(destination, batch); drained > 0; drained = bench.device.consume(destination, batch))
+			{
+				convert(drained);
+				++result.iterations;
+				result.points += drained;
+			}
+			result.total_ns += elapsedNs(start, Clock::now());
+		}
+		return result;
+	}
+
+	// The buffer the point ring replaced: a deque of one element per point
+	// behind a single mutex shared by the producer and the consumer.
+	class MutexDequeBuffer
+	{
+	public:
+		explicit MutexDequeBuffer(size_t limit)
+			: limit_(limit)
+		{
+		}
+
+		void push(const PointColumns& source, size_t count, const PacketStamp& stamp)
+		{
+			const std::lock_guard<std::mutex> lock(mutex_);
+			for (size_t i = 0; i < count; ++i)
+			{
+				points_.push_back({ source.x[i], source.y[i], source.z[i], source.intensity[i], source.tag[i], stamp.timestamp });
+			}
+			while (points_.size() > limit_)
+			{
+				points_.pop_front();
+			}
+		}
+
+		size_t pop(const PointColumns& destination, size_t max_points)
+		{
+			const std::lock_guard<std::mutex> lock(mutex_);
+			const size_t count = std::min(max_points, points_.size());
+			for (size_t i = 0; i < count; ++i)
+			{
+				const Sample& sample = points_.front();
+				destination.x[i] = sample.x;
+				destination.y[i] = sample.y;
+				destination.z[i] = sample.z;
+				destination.intensity[i] = sample.intensity;
+				destination.tag[i] = sample.tag;
+				destination.timestamp[i] = sample.timestamp;
+				points_.pop_front();
+			}
+			return count;
+		}
+
+	private:
+		struct Sample
+		{
+			float x;
+			float y;
+			float z;
+			float intensity;
+			float tag;
+			uint64_t timestamp;
+		};
+
+		std::mutex mutex_;
+		std::deque<Sample> points_;
+		size_t limit_;
+	};
+
+	// Producer and consumer at full speed on one buffer. The drain row times
+	// the consumer from its first to its last drain; the push row sums the
+	// time the producer spent inside push(), lock waits included.
+	template <typename Buffer>
+	void
+	measureContention(const char* drain_name, const char* push_name, Buffer& buffer, const PointColumns& source, size_t source_points, const PointColumns& destination, std::vector<Benchmark::Result>& results)
+	{
+		Benchmark::Result push;
+		push.name = push_name;
+		push.batch = kContentionPacket;
+		std::atomic<bool> done(false);
+		std::thread producer([&]()
+		{
+			PacketStamp stamp;
+			stamp.time_interval = 5000;
+			stamp.dot_num = static_cast<uint16_t>(kContentionPacket);
+			size_t offset = 0;
+			while (!done.load(std::memory_order_relaxed))
+			{
+				const Clock::time_point start = Clock::now();
+				buffer.push(source.offset(offset), kContentionPacket, stamp);
+				push.total_ns += elapsedNs(start, Clock::now());
+				++push.iterations;
+				push.points += kContentionPacket;
+				stamp.timestamp += 500000;
+				offset = offset + 2 * kContentionPacket <= source_points ? offset + kContentionPacket : 0;
+			}
+		});
+
+		Benchmark::Result drain;
+		drain.name = drain_name;
+		drain.batch = kFillBatch;
+		const Clock::time_point start = Clock::now();
+		while (drain.points < kContentionPoints)
+		{
+			const size_t drained = buffer.pop(destination, kFillBatch);
+			if (drained == 0)
+			{
+				std::this_thread::yield();
+				continue;
+			}
+			++drain.iterations;
+			drain.points += drained;
+		}
+		drain.total_ns = elapsedNs(start, Clock::now());
+		done.store(true);
+		producer.join();
+		results.push_back(drain);
+		results.push_back(push);
+	}
+
+	Benchmark::Result
+	measureLimitChange(const char* name, size_t lower_limit, BenchDevice& bench, const std::vector<std::vector<uint8_t>>& packets)
+	{
+		Benchmark::Result result;
+		result.name = name;
+		for (size_t i = 0; i < kLimitIterations; ++i)
+		{
+			bench.device.setBufferLimit(kDeviceLimit);
+			bench.fill(packets, kDeviceLimit);
+			const size_t buffered = bench.device.bufferedSamples();
+			const Clock::time_point start = Clock::now();
+			bench.device.setBufferLimit(lower_limit);
+			result.total_ns += elapsedNs(start, Clock::now());
+			++result.iterations;
+			result.points += buffered;
+		}
+		bench.device.setBufferLimit(kDeviceLimit);
+		return result;
+	}
+}
+
+double
+Benchmark::Result::nsPerOp() const
+{
+	return iterations == 0 ? 0.0 : static_cast<double>(total_ns) / static_cast<double>(iterations);
+}
+
+double
+Benchmark::Result::nsPerPoint() const
+{
+	return points == 0 ? 0.0 : static_cast<double>(total_ns) / static_cast<double>(points);
+}
+
+double
+Benchmark::Result::megabytesPerSecond() const
+{
+	return total_ns == 0 ? 0.0 : static_cast<double>(bytes) * 1e3 / static_cast<double>(total_ns);
+}
+
+std::vector<Benchmark::Result>
+Benchmark::verifyDecoders()
+{
+	const PointTransform mount = tiltedMount();
+	std::vector<Result> results;
+	results.push_back(verifyDecode<LivoxLidarCartesianHighRawPoint>("verify_decode_high", &PointDecoder::decodeHigh, &PointDecoder::decodeHighScalar, nullptr));
+	results.push_back(verifyDecode<LivoxLidarCartesianLowRawPoint>("verify_decode_low", &PointDecoder::decodeLow, &PointDecoder::decodeLowScalar, nullptr));
+	results.push_back(verifyDecode<LivoxLidarCartesianHighRawPoint>("verify_decode_high_extrinsic", &PointDecoder::decodeHigh, &PointDecoder::decodeHighScalar, &mount));
+	results.push_back(verifyDecode<LivoxLidarCartesianLowRawPoint>("verify_decode_low_extrinsic", &PointDecoder::decodeLow, &PointDecoder::decodeLowScalar, &mount));
+	return results;
+}
+
+std::vector<Benchmark::Result>
+Benchmark::run()
+{
+	const std::vector<std::vector<uint8_t>> high = capturePackets(kLivoxLidarCartesianCoordinateHighData);
+	const std::vector<std::vector<uint8_t>> low = capturePackets(kLivoxLidarCartesianCoordinateLowData);
+	std::vector<Result> results = verifyDecoders();
+
+	PointBlock block;
+	results.push_back(measureDecode<LivoxLidarCartesianHighRawPoint>("decode_high", high, block, &PointDecoder::decodeHigh));
+	results.push_back(measureDecode<LivoxLidarCartesianHighRawPoint>("decode_high_scalar", high, block, &PointDecoder::decodeHighScalar));
+	results.push_back(measureDecode<LivoxLidarCartesianLowRawPoint>("decode_low", low, block, &PointDecoder::decodeLow));
+	results.push_back(measureDecode<LivoxLidarCartesianLowRawPoint>("decode_low_scalar", low, block, &PointDecoder::decodeLowScalar));
+
+	// A tilted mount: the extrinsic is folded into the unit scale, so these
+	// should cost little more than the plain decode rows.
+	const PointTransform mount = tiltedMount();
+	results.push_back(measureDecode<LivoxLidarCartesianHighRawPoint>("decode_high_extrinsic", high, block, &PointDecoder::decodeHigh, &mount));
+	results.push_back(measureDecode<LivoxLidarCartesianLowRawPoint>("decode_low_extrinsic", low, block, &PointDecoder::decodeLow, &mount));
+
+	const PointColumns decoded = block.columns();
+	PointBlock spherical;
+	spherical.resize(block.size());
+	const PointColumns angles = spherical.columns();
+	results.push_back(measure("to_spherical", 0, block.size(), [&]()
+	{
+		PointDecoder::toSpherical(decoded, block.size(), angles.x, angles.y, angles.z);
+	}));
+	measureDeskew(block, results);
+	measureVoxel(block, results);
+	measureSpatial(block, results);
+
+	struct StorageCase
+	{
+		LivoxDevice::BufferStorage storage;
+		const char* ingest;
+		const char* consume;
+		const char* fill_cartesian;
+		const char* fill_spherical;
+	};
+	const std::array<StorageCase, 2> storages = { {
+		{ LivoxDevice::BufferStorage::Decoded, "ingest_decoded", "consume_decoded", "fill_cartesian_decoded", "fill_spherical_decoded" },
+		{ LivoxDevice::BufferStorage::RawPackets, "ingest_raw", "consume_raw", "fill_cartesian_raw", "fill_spherical_raw" }
+	} };
+
+	PointBlock output;
+	output.resize(*std::max_element(kConsumeBatches.begin(), kConsumeBatches.end()));
+	const PointColumns channels = output.columns();
+	PointBlock scratch;
+	scratch.resize(output.size());
+	const PointColumns scratch_columns = scratch.columns();
+
+	for (const StorageCase& storage : storages)
+	{
+		BenchDevice bench(storage.storage);
+		results.push_back(measure(storage.ingest, 0, pointCount(high), [&]()
+		{
+			bench.source->push(high);
+		}));
+
+		// The Cartesian output path drains straight into the channels; the
+		// spherical one drains into scratch and converts.
+		PointColumns cartesian;
+		cartesian.x = channels.x;
+		cartesian.y = channels.y;
+		cartesian.z = channels.z;
+		cartesian.intensity = channels.intensity;
+		cartesian.received = channels.received;
+		for (size_t batch : kConsumeBatches)
+		{
+			results.push_back(measureDrain(storage.consume, batch, bench, high, cartesian, [](size_t) {}));
+		}
+		results.push_back(measureDrain(storage.fill_cartesian, kFillBatch, bench, high, cartesian, [](size_t) {}));
+
+		PointColumns to_scratch = scratch_columns;
+		to_scratch.intensity = channels.intensity;
+		to_scratch.tag = nullptr;
+		to_scratch.timestamp = nullptr;
+		results.push_back(measureDrain(storage.fill_spherical, kFillBatch, bench, high, to_scratch, [&](size_t drained)
+		{
+			PointDecoder::toSpherical(scratch_columns, drained, channels.x, channels.y, channels.z);
+		}));
+	}
+
+	// The lock-free ring against the mutex-guarded deque it replaced, both
+	// capped at kDeviceLimit points.
+	PointColumns drained = channels;
+	drained.timestamp = scratch_columns.timestamp;
+	drained.received = nullptr;
+	// Packets are pushed timed by their stamps, as unfiltered ones are.
+	PointColumns packet_points = decoded;
+	packet_points.timestamp = nullptr;
+	PointRing ring(kDeviceLimit);
+	measureContention("contention_ring", "contention_ring_push", ring, packet_points, block.size(), drained, results);
+	MutexDequeBuffer deque(kDeviceLimit);
+	measureContention("contention_deque", "contention_deque_push", deque, packet_points, block.size(), drained, results);
+
+	BenchDevice bench(LivoxDevice::BufferStorage::Decoded);
+	results.push_back(measureLimitChange("shrink_limit_in_place", kInPlaceLimit, bench, high));
+	results.push_back(measureLimitChange("shrink_limit_realloc", kReallocLimit, bench, high));
+
+	measureCodec("codec_encode_high", "codec_decode_high", high, results);
+	measureCodec("codec_encode_low", "codec_decode_low", low, results);
+	return results;
+}
+
+void
+Benchmark::write(std::ostream& stream, const std::vector<Result>& results)
+{
+	stream << "benchmark,batch,iterations,points,total_ns,ns_per_op,ns_per_point,mb_per_s,compression_ratio,mismatches\n";
+	stream << std::fixed << std::setprecision(3);
+	for (const Result& result : results)
+	{
+		stream << result.name << ',' << result.batch << ',' << result.iterations << ',' << result.points << ','
+			<< result.total_ns << ',' << result.nsPerOp() << ',' << result.nsPerPoint() << ','
+			<< result.megabytesPerSecond() << ',' << result.compression_ratio << ',' << result.mismatches << '\n';
+	}
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// Fixed-input microbenchmarks of the ingest and output kernels: packet
+// decode, the full packet handler, consume() at several batch sizes, the
+// Cartesian and spherical output paths, the point ring against the
+// mutex-guarded deque under producer/consumer contention, buffer-limit
+// changes, IMU motion de-skew, voxel downsampling, the spatial filter and
+// the recording codec.
+// Inputs come from the synthetic packet source, so runs are comparable
+// across commits and machines. Runs on the calling thread and touches no
+// live device.
+class Benchmark
+{
+public:
+	struct Result
+	{
+		std::string name;
+		size_t batch = 0;        // points per call, or 0 when not batched
+		uint64_t iterations = 0; // timed calls
+		uint64_t points = 0;     // points processed by those calls
+		uint64_t total_ns = 0;
+		uint64_t bytes = 0;              // packet bytes processed, codec runs only
+		double compression_ratio = 0.0; // packet bytes per encoded byte, codec runs only
+		uint64_t mismatches = 0;         // points decoded differently by the two kernels, verify runs only
+
+		double nsPerOp() const;
+		double nsPerPoint() const;
+		double megabytesPerSecond() const;
+	};
+
+	// Starts with the verifyDecoders() rows.
+	static std::vector<Result> run();
+
+	// Decodes fixed-seed random High and Low packets of 0-15 and 96-103
+	// records with the active kernel and the scalar one, with and without a
+	// transform, and counts the points that differ in any bit. Each row's
+	// iterations and points are the packets and points compared.
+	static std::vector<Result> verifyDecoders();
+
+	// Writes a "benchmark,batch,iterations,points,total_ns,ns_per_op,ns_per_point,
+	// mb_per_s,compression_ratio,mismatches" CSV, one row per result.
+	static void write(std::ostream& stream, const std::vector<Result>& results);
+};
@@ -0,0 +1,89 @@
+#include "DrainController.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+	// Time constant of the arrival-rate average. Long enough to ride over
+	// packet bursts, short enough to follow a scan-rate change within a second.
+	constexpr double kRateTimeConstant = 0.5;
+
+	// The backlog error is closed over roughly this long, so one slow cook does
+	// not cause a burst of output on the next.
+	constexpr double kCorrectionTime = 0.25;
+
+	// Gaps longer than this (paused timeline, device restart) restart the
+	// estimate instead of folding a huge interval into it.
+	constexpr double kMaxInterval = 1.0;
+}
+
+DrainController::DrainController()
+{
+	reset();
+}
+
+void
+DrainController::reset()
+{
+	primed_ = false;
+	last_time_ = Clock::time_point();
+	last_total_ = 0;
+	rate_ = 0.0;
+	age_ = 0.0;
+	target_points_ = 0.0;
+	planned_ = 0;
+}
+
+size_t
+DrainController::plan(Clock::time_point now, uint64_t total_points, size_t buffered, double target_seconds, size_t max_points)
+{
+	const double interval = std::chrono::duration<double>(now - last_time_).count();
+	if (!primed_ || total_points < last_total_ || interval <= 0.0 || interval > kMaxInterval)
+	{
+		primed_ = true;
+		last_time_ = now;
+		last_total_ = total_points;
+		planned_ = 0;
+		return planned_;
+	}
+
+	const double arrived = static_cast<double>(total_points - last_total_);
+	const double alpha = 1.0 - std::exp(-interval / kRateTimeConstant);
+	rate_ += alpha * (arrived / interval - rate_);
+	last_time_ = now;
+	last_total_ = total_points;
+
+	const double backlog = static_cast<double>(buffered);
+	age_ = rate_ > 0.0 ? backlog / rate_ : 0.0;
+	target_points_ = rate_ * std::max(target_seconds, 0.0);
+
+	const double correction = (backlog - target_points_) * std::min(interval / kCorrectionTime, 1.0);
+	const double wanted = std::max(rate_ * interval + correction, 0.0);
+	planned_ = std::min({ static_cast<size_t>(std::lround(wanted)), buffered, max_points });
+	return planned_;
+}
+
+double
+DrainController::arrivalRate() const
+{
+	return rate_;
+}
+
+double
+DrainController::bufferAge() const
+{
+	return age_;
+}
+
+double
+DrainController::targetPoints() const
+{
+	return target_points_;
+}
+
+size_t
+DrainController::plannedPoints() const
+{
+	return planned_;
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+// Cook-thread controller that sizes each drain so the buffered backlog stays
+// near a target age. The arrival rate is a time-weighted moving average of the
+// ingest counter; each cook drains what arrived since the previous cook plus a
+// fraction of the distance between the backlog and the target backlog.
+class DrainController
+{
+public:
+	using Clock = std::chrono::steady_clock;
+
+	DrainController();
+
+	// Forgets the rate estimate, e.g. after the device restarts.
+	void reset();
+
+	// Plans the next drain from the ingest total and the current backlog.
+	// The result is clamped to [0, min(buffered, max_points)].
+	size_t plan(Clock::time_point now, uint64_t total_points, size_t buffered, double target_seconds, size_t max_points);
+
+	double arrivalRate() const;
+	double bufferAge() const;
+	double targetPoints() const;
+	size_t plannedPoints() const;
+
+private:
+	bool primed_;
+	Clock::time_point last_time_;
+	uint64_t last_total_;
+	double rate_;
+	double age_;
+	double target_points_;
+	size_t planned_;
+};
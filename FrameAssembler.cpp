@@ -0,0 +1,215 @@
+#include "FrameAssembler.h"
+#include "MotionDeskew.h"
+#include "VoxelGrid.h"
+
+#include <algorithm>
+#include <cstring>
+
+FrameAssembler::FrameAssembler()
+	: duration_ns_(kDefaultDurationNs)
+	, capacity_(0)
+	, deskew_(nullptr)
+	, voxels_(nullptr)
+	, back_(0)
+	, open_(false)
+	, frame_index_(0)
+	, sequence_(0)
+	, middle_(1)
+	, front_(2)
+	, published_(0)
+	, overflow_(0)
+{
+}
+
+void
+FrameAssembler::configure(uint64_t duration_ns, size_t capacity)
+{
+	duration_ns_ = std::max<uint64_t>(duration_ns, 1);
+	capacity_ = capacity;
+	for (Frame& frame : frames_)
+	{
+		// Start from an empty block so a smaller capacity gives memory back.
+		frame.points = PointBlock();
+		frame.points.resize(capacity);
+	}
+	reset();
+}
+
+void
+FrameAssembler::reset()
+{
+	for (Frame& frame : frames_)
+	{
+		frame.count = 0;
+		frame.start_time = 0;
+		frame.end_time = 0;
+		frame.sequence = 0;
+	}
+	back_ = 0;
+	middle_.store(1);
+	front_ = 2;
+	open_ = false;
+}
+
+uint64_t
+FrameAssembler::duration() const
+{
+	return duration_ns_;
+}
+
+size_t
+FrameAssembler::capacity() const
+{
+	return capacity_;
+}
+
+void
+FrameAssembler::setDeskew(MotionDeskew* deskew)
+{
+	deskew_ = deskew;
+}
+
+void
+FrameAssembler::setVoxelGrid(VoxelGrid* voxels)
+{
+	voxels_ = voxels;
+}
+
+void
+FrameAssembler::append(const PointColumns& points, size_t count, const PacketStamp& stamp)
+{
+	// Points within a packet are time-ordered, so a packet splits into at most
+	// a few runs that each belong to one frame.
+	size_t run_begin = 0;
+	for (size_t i = 0; i < count; ++i)
+	{
+		const uint64_t frame_index = stamp.batchTime(points, i) / duration_ns_;
+		if (open_ && frame_index == frame_index_)
+		{
+			continue;
+		}
+
+		appendRun(points, run_begin, i, stamp);
+		run_begin = i;
+		if (open_)
+		{
+			publish();
+		}
+		beginFrame(frame_index);
+	}
+	appendRun(points, run_begin, count, stamp);
+}
+
+const FrameAssembler::Frame&
+FrameAssembler::acquire()
+{
+	if ((middle_.load(std::memory_order_relaxed) & kFreshBit) != 0)
+	{
+		front_ = middle_.exchange(front_, std::memory_order_acq_rel) & kIndexMask;
+	}
+	return frames_[front_];
+}
+
+const FrameAssembler::Frame&
+FrameAssembler::current() const
+{
+	return frames_[front_];
+}
+
+size_t
+FrameAssembler::copyCurrent(const PointColumns& destination, size_t max_points)
+{
+	Frame& frame = frames_[front_];
+	const size_t count = std::min(frame.count, max_points);
+	const PointColumns source = frame.points.columns();
+	const auto copyColumn = [count](auto* target, const auto* column)
+	{
+		if (target != nullptr && count > 0)
+		{
+			std::memcpy(target, column, count * sizeof(*column));
+		}
+	};
+	copyColumn(destination.x, source.x);
+	copyColumn(destination.y, source.y);
+	copyColumn(destination.z, source.z);
+	copyColumn(destination.intensity, source.intensity);
+	copyColumn(destination.tag, source.tag);
+	copyColumn(destination.timestamp, source.timestamp);
+	copyColumn(destination.received, source.received);
+	return count;
+}
+
+uint64_t
+FrameAssembler::publishedFrames() const
+{
+	return published_.load();
+}
+
+uint64_t
+FrameAssembler::overflowPoints() const
+{
+	return overflow_.load();
+}
+
+void
+FrameAssembler::appendRun(const PointColumns& points, size_t begin, size_t end, const PacketStamp& stamp)
+{
+	if (begin >= end || !open_)
+	{
+		return;
+	}
+
+	Frame& frame = frames_[back_];
+	const size_t requested = end - begin;
+	const size_t accepted = std::min(requested, capacity_ - frame.count);
+	if (accepted < requested)
+	{
+		overflow_.fetch_add(requested - accepted, std::memory_order_relaxed);
+	}
+	if (accepted == 0)
+	{
+		return;
+	}
+
+	const PointColumns source = points.offset(begin);
+	const PointColumns target = frame.points.columns().offset(frame.count);
+	std::memcpy(target.x, source.x, accepted * sizeof(float));
+	std::memcpy(target.y, source.y, accepted * sizeof(float));
+	std::memcpy(target.z, source.z, accepted * sizeof(float));
+	std::memcpy(target.intensity, source.intensity, accepted * sizeof(float));
+	std::memcpy(target.tag, source.tag, accepted * sizeof(float));
+	for (size_t i = 0; i < accepted; ++i)
+	{
+		target.timestamp[i] = stamp.batchTime(points, begin + i);
+	}
+	std::fill(target.received, target.received + accepted, stamp.received);
+	frame.count += accepted;
+}
+
+void
+FrameAssembler::beginFrame(uint64_t frame_index)
+{
+	Frame& frame = frames_[back_];
+	frame.count = 0;
+	frame.start_time = frame_index * duration_ns_;
+	frame.end_time = frame.start_time + duration_ns_;
+	frame_index_ = frame_index;
+	open_ = true;
+}
+
+void
+FrameAssembler::publish()
+{
+	Frame& frame = frames_[back_];
+	if (deskew_ != nullptr)
+	{
+		deskew_->apply(frame.points.columns(), frame.count, frame.start_time, frame.end_time);
+	}
+	if (voxels_ != nullptr)
+	{
+		frame.count = voxels_->filter(frame.points.columns(), frame.count);
+	}
+	frame.sequence = ++sequence_;
+	back_ = middle_.exchange(back_ | kFreshBit, std::memory_order_acq_rel) & kIndexMask;
+	published_.fetch_add(1, std::memory_order_relaxed);
+}
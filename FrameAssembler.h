@@ -0,0 +1,100 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+#include "PointRing.h"
+
+class MotionDeskew;
+class VoxelGrid;
+
+// Groups decoded points into fixed-duration frames aligned to the packet
+// clock (frame k covers [k * duration, (k + 1) * duration) ns) and hands
+// completed frames to the cook thread through a lock-free triple buffer.
+//
+// The SDK thread owns the back frame, the cook thread owns the front frame and
+// the middle slot is swapped atomically, so the cook thread can read the
+// newest complete frame for as long as it likes without blocking ingest.
+class FrameAssembler
+{
+public:
+	struct Frame
+	{
+		PointBlock points;
+		size_t count = 0;
+		uint64_t start_time = 0;
+		uint64_t end_time = 0;
+		uint64_t sequence = 0;
+	};
+
+	static constexpr uint64_t kDefaultDurationNs = 100000000;
+
+	FrameAssembler();
+
+	// Sets the frame duration and the per-frame point capacity and drops all
+	// frames. Not thread-safe: the producer must be quiescent.
+	void configure(uint64_t duration_ns, size_t capacity);
+
+	// Drops the open and all published frames without reallocating. Not
+	// thread-safe: the producer must be quiescent.
+	void reset();
+
+	uint64_t duration() const;
+	size_t capacity() const;
+
+	// Producer-side stage run on every completed frame before it is
+	// published; nullptr disables it. Not thread-safe: the producer must be
+	// quiescent.
+	void setDeskew(MotionDeskew* deskew);
+
+	// Producer-side downsampling of every completed frame, run after the
+	// de-skew so the published frame holds only the reduced points; nullptr
+	// disables it. Not thread-safe: the producer must be quiescent.
+	void setVoxelGrid(VoxelGrid* voxels);
+
+	// Producer: appends the points of one packet, timed by their timestamp
+	// column if set and by stamp otherwise, publishing the current frame
+	// whenever a point falls past its end. Points beyond the frame capacity are
+	// counted as overflow and dropped.
+	void append(const PointColumns& points, size_t count, const PacketStamp& stamp);
+
+	// Consumer: swaps in the newest complete frame if one was published since
+	// the last call and returns the front frame (empty until the first frame
+	// completes). The reference stays valid until the next acquire/configure.
+	const Frame& acquire();
+	const Frame& current() const;
+
+	// Consumer: copies up to max_points of the front frame into the non-null
+	// destination columns. The frame is left in place for the next cook.
+	size_t copyCurrent(const PointColumns& destination, size_t max_points);
+
+	uint64_t publishedFrames() const;
+	uint64_t overflowPoints() const;
+
+private:
+	static constexpr int kFreshBit = 4;
+	static constexpr int kIndexMask = 3;
+
+	void appendRun(const PointColumns& points, size_t begin, size_t end, const PacketStamp& stamp);
+	void beginFrame(uint64_t frame_index);
+	void publish();
+
+	Frame frames_[3];
+	uint64_t duration_ns_;
+	size_t capacity_;
+	MotionDeskew* deskew_;
+	VoxelGrid* voxels_;
+
+	// Producer state.
+	int back_;
+	bool open_;
+	uint64_t frame_index_;
+	uint64_t sequence_;
+
+	alignas(SpscRingIndex::kCacheLine) std::atomic<int> middle_;
+	alignas(SpscRingIndex::kCacheLine) int front_;
+
+	std::atomic<uint64_t> published_;
+	std::atomic<uint64_t> overflow_;
+};
@@ -0,0 +1,181 @@
+#include "ImuBuffer.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace
+{
+	// The Mid-360 sends 200 samples a second, one per packet, so the ring
+	// rides out about five seconds without a cook.
+	constexpr size_t kRingSamples = 1024;
+
+	// Points can wait in the buffers for a while before they are output, so
+	// the history reaches further back than the ring.
+	constexpr size_t kHistorySamples = 2048;
+
+	void
+	writeSample(const ImuColumns& destination, size_t index, const ImuSample& from, const ImuSample& to, float weight)
+	{
+		for (int axis = 0; axis < 3; ++axis)
+		{
+			if (destination.gyro[axis] != nullptr)
+			{
+				destination.gyro[axis][index] = from.gyro[axis] + (to.gyro[axis] - from.gyro[axis]) * weight;
+			}
+			if (destination.accel[axis] != nullptr)
+			{
+				destination.accel[axis][index] = from.accel[axis] + (to.accel[axis] - from.accel[axis]) * weight;
+			}
+		}
+	}
+}
+
+ImuBuffer::ImuBuffer()
+	: ring_(kRingSamples)
+	, ingest_ring_(kRingSamples)
+	, total_samples_(0)
+	, evicted_samples_(0)
+{
+	history_.reserve(2 * kHistorySamples);
+	arrivals_.resize(kRingSamples);
+}
+
+size_t
+ImuBuffer::push(const LivoxLidarEthernetPacket* packet, uint64_t received)
+{
+	const size_t count = packet->dot_num;
+	uint64_t timestamp = 0;
+	std::memcpy(&timestamp, packet->timestamp, sizeof(timestamp));
+
+	// Packets carry a single sample in practice; several are spread over the
+	// packet's time_interval like points are.
+	ImuSample samples[8];
+	size_t pushed = 0;
+	while (pushed < count)
+	{
+		const size_t batch = std::min(count - pushed, sizeof(samples) / sizeof(samples[0]));
+		for (size_t i = 0; i < batch; ++i)
+		{
+			LivoxLidarImuRawPoint raw;
+			std::memcpy(&raw, packet->data + (pushed + i) * sizeof(raw), sizeof(raw));
+			ImuSample& sample = samples[i];
+			sample.timestamp = timestamp + (static_cast<uint64_t>(pushed + i) * packet->time_interval * 100) / count;
+			sample.received = received;
+			sample.gyro[0] = raw.gyro_x;
+			sample.gyro[1] = raw.gyro_y;
+			sample.gyro[2] = raw.gyro_z;
+			sample.accel[0] = raw.acc_x;
+			sample.accel[1] = raw.acc_y;
+			sample.accel[2] = raw.acc_z;
+		}
+		evicted_samples_.fetch_add(ring_.push(samples, batch), std::memory_order_relaxed);
+		ingest_ring_.push(samples, batch);
+		pushed += batch;
+	}
+	total_samples_.fetch_add(count, std::memory_order_relaxed);
+	return count;
+}
+
+size_t
+ImuBuffer::popIngest(ImuSample* samples, size_t max_samples)
+{
+	return ingest_ring_.pop(samples, max_samples);
+}
+
+void
+ImuBuffer::update()
+{
+	const size_t count = ring_.pop(arrivals_.data(), arrivals_.size());
+	for (size_t i = 0; i < count; ++i)
+	{
+		if (!history_.empty() && arrivals_[i].timestamp < history_.back().timestamp)
+		{
+			history_.clear();
+		}
+		history_.push_back(arrivals_[i]);
+	}
+	if (history_.size() >= 2 * kHistorySamples)
+	{
+		history_.erase(history_.begin(), history_.end() - kHistorySamples);
+	}
+}
+
+void
+ImuBuffer::clear()
+{
+	ring_.clear();
+	history_.clear();
+}
+
+bool
+ImuBuffer::latest(ImuSample& sample) const
+{
+	if (history_.empty())
+	{
+		return false;
+	}
+	sample = history_.back();
+	return true;
+}
+
+void
+ImuBuffer::sample(const uint64_t* timestamps, size_t count, const ImuColumns& destination) const
+{
+	if (history_.empty() || timestamps == nullptr)
+	{
+		const ImuSample zero;
+		for (size_t i = 0; i < count; ++i)
+		{
+			writeSample(destination, i, zero, zero, 0.0f);
+		}
+		return;
+	}
+
+	// Points arrive in time order within a sensor, so the search walks
+	// forward and only starts over when the timestamps go backwards.
+	const auto later = [](uint64_t timestamp, const ImuSample& sample) { return timestamp < sample.timestamp; };
+	size_t upper = 0;
+	for (size_t i = 0; i < count; ++i)
+	{
+		const uint64_t timestamp = timestamps[i];
+		if (i == 0 || timestamp < timestamps[i - 1])
+		{
+			upper = static_cast<size_t>(std::upper_bound(history_.begin(), history_.end(), timestamp, later) - history_.begin());
+		}
+		else
+		{
+			while (upper < history_.size() && history_[upper].timestamp <= timestamp)
+			{
+				++upper;
+			}
+		}
+
+		if (upper == 0)
+		{
+			writeSample(destination, i, history_.front(), history_.front(), 0.0f);
+		}
+		else if (upper == history_.size())
+		{
+			writeSample(destination, i, history_.back(), history_.back(), 0.0f);
+		}
+		else
+		{
+			const ImuSample& from = history_[upper - 1];
+			const ImuSample& to = history_[upper];
+			const float weight = static_cast<float>(static_cast<double>(timestamp - from.timestamp) / static_cast<double>(to.timestamp - from.timestamp));
+			writeSample(destination, i, from, to, weight);
+		}
+	}
+}
+
+uint64_t
+ImuBuffer::totalSamples() const
+{
+	return total_samples_.load(std::memory_order_relaxed);
+}
+
+uint64_t
+ImuBuffer::evictedSamples() const
+{
+	return evicted_samples_.load(std::memory_order_relaxed);
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "livox_lidar_api.h"
+#include "SpscRing.h"
+
+// One IMU reading as sent by the lidar: angular rate in rad/s and
+// acceleration in g, in the lidar's own frame.
+struct ImuSample
+{
+	uint64_t timestamp = 0; // lidar clock, ns
+	uint64_t received = 0;  // host steady_clock time the packet arrived, ns
+	float gyro[3] = {};
+	float accel[3] = {};
+};
+
+// Destination columns for per-point IMU values; null columns are skipped.
+struct ImuColumns
+{
+	float* gyro[3] = {};
+	float* accel[3] = {};
+
+	ImuColumns offset(size_t count) const
+	{
+		ImuColumns shifted;
+		for (int axis = 0; axis < 3; ++axis)
+		{
+			shifted.gyro[axis] = gyro[axis] != nullptr ? gyro[axis] + count : nullptr;
+			shifted.accel[axis] = accel[axis] != nullptr ? accel[axis] + count : nullptr;
+		}
+		return shifted;
+	}
+};
+
+// IMU stream of one lidar. It is kept apart from the point buffers so a
+// reading never waits on their ingest lock: the source thread pushes into a
+// fixed-size lock-free ring that is never reallocated, and the cook thread
+// moves what arrived into a history of the last few seconds, which points are
+// then looked up in by timestamp. A second ring carries the same samples to
+// the lidar's point source thread for motion de-skew.
+class ImuBuffer
+{
+public:
+	ImuBuffer();
+
+	// Source thread: appends the samples of a kLivoxLidarImuData packet.
+	// Returns how many it held.
+	size_t push(const LivoxLidarEthernetPacket* packet, uint64_t received);
+
+	// Point source thread: takes up to max_samples of the samples that arrived
+	// since the last call. When nobody calls it the oldest are overwritten.
+	size_t popIngest(ImuSample* samples, size_t max_samples);
+
+	// Cook thread: moves newly arrived samples into the history. A device
+	// timestamp running backwards (a restarted lidar or a looped replay)
+	// starts the history over.
+	void update();
+	void clear();
+
+	// Cook thread: newest sample in the history; false if there is none.
+	bool latest(ImuSample& sample) const;
+
+	// Cook thread: IMU values at each timestamp, interpolated linearly between
+	// the samples around it and held at the ends of the history. Writes
+	// zeros while the history is empty.
+	void sample(const uint64_t* timestamps, size_t count, const ImuColumns& destination) const;
+
+	uint64_t totalSamples() const;
+	// Samples the ring dropped because the cook thread fell behind.
+	uint64_t evictedSamples() const;
+
+private:
+	SpscRing<ImuSample> ring_;
+	SpscRing<ImuSample> ingest_ring_;
+	std::atomic<uint64_t> total_samples_;
+	std::atomic<uint64_t> evicted_samples_;
+
+	// Cook thread. The history is trimmed in batches rather than per sample.
+	std::vector<ImuSample> history_;
+	std::vector<ImuSample> arrivals_;
+};
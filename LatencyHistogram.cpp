@@ -0,0 +1,146 @@
+#include "LatencyHistogram.h"
+
+#include <algorithm>
+#include <limits>
+
+namespace
+{
+	int
+	highestBit(uint64_t value)
+	{
+		int bit = 0;
+		while (value >>= 1)
+		{
+			++bit;
+		}
+		return bit;
+	}
+}
+
+LatencyHistogram::LatencyHistogram(int max_value_bits)
+	: counts_(bucketCount(max_value_bits), 0)
+{
+	reset();
+}
+
+void
+LatencyHistogram::reset()
+{
+	std::fill(counts_.begin(), counts_.end(), 0);
+	total_ = 0;
+	min_ = std::numeric_limits<uint64_t>::max();
+	max_ = 0;
+	sum_ = 0.0;
+}
+
+void
+LatencyHistogram::record(uint64_t value, uint64_t count)
+{
+	if (count == 0)
+	{
+		return;
+	}
+	counts_[bucketIndex(value, counts_.size())] += count;
+	total_ += count;
+	min_ = std::min(min_, value);
+	max_ = std::max(max_, value);
+	sum_ += static_cast<double>(value) * static_cast<double>(count);
+}
+
+void
+LatencyHistogram::merge(const LatencyHistogram& other)
+{
+	const size_t shared = std::min(counts_.size(), other.counts_.size());
+	for (size_t i = 0; i < shared; ++i)
+	{
+		counts_[i] += other.counts_[i];
+	}
+	for (size_t i = shared; i < other.counts_.size(); ++i)
+	{
+		counts_.back() += other.counts_[i];
+	}
+	total_ += other.total_;
+	min_ = std::min(min_, other.min_);
+	max_ = std::max(max_, other.max_);
+	sum_ += other.sum_;
+}
+
+uint64_t
+LatencyHistogram::count() const
+{
+	return total_;
+}
+
+uint64_t
+LatencyHistogram::min() const
+{
+	return total_ == 0 ? 0 : min_;
+}
+
+uint64_t
+LatencyHistogram::max() const
+{
+	return max_;
+}
+
+double
+LatencyHistogram::mean() const
+{
+	return total_ == 0 ? 0.0 : sum_ / static_cast<double>(total_);
+}
+
+uint64_t
+LatencyHistogram::percentile(double fraction) const
+{
+	if (total_ == 0)
+	{
+		return 0;
+	}
+
+	const double clamped = std::min(std::max(fraction, 0.0), 1.0);
+	const uint64_t rank = std::max<uint64_t>(1, static_cast<uint64_t>(clamped * static_cast<double>(total_) + 0.5));
+	uint64_t seen = 0;
+	for (size_t i = 0; i < counts_.size(); ++i)
+	{
+		seen += counts_[i];
+		if (seen >= rank)
+		{
+			// Report the bucket's upper edge so percentiles never read low.
+			return std::min(std::max(bucketValue(i + 1) - 1, min_), max_);
+		}
+	}
+	return max_;
+}
+
+void
+LatencyHistogram::write(std::ostream& stream) const
+{
+	stream << "value,count,cumulative_fraction\n";
+	uint64_t seen = 0;
+	for (size_t i = 0; i < counts_.size(); ++i)
+	{
+		if (counts_[i] == 0)
+		{
+			continue;
+		}
+		seen += counts_[i];
+		stream << bucketValue(i) << ',' << counts_[i] << ',' << static_cast<double>(seen) / static_cast<double>(total_) << '\n';
+	}
+}
+
+size_t
+LatencyHistogram::bucketIndex(uint64_t value, size_t bucket_count)
+{
+	// Bucket 0 holds 0 .. 2 * kSubBuckets - 1 exactly; each further bucket
+	// covers the next power of two with kSubBuckets steps.
+	const int shift = std::max(highestBit(value) - kSubBucketBits, 0);
+	const size_t index = static_cast<size_t>(shift) * kSubBuckets + static_cast<size_t>(value >> shift);
+	return std::min(index, bucket_count - 1);
+}
+
+uint64_t
+LatencyHistogram::bucketValue(size_t index)
+{
+	const size_t shift = index < 2 * kSubBuckets ? 0 : index / kSubBuckets - 1;
+	return static_cast<uint64_t>(index - shift * kSubBuckets) << shift;
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <vector>
+
+// Fixed-memory log-linear histogram in the style of HdrHistogram. Values are
+// grouped by power of two and each power of two is split into kSubBuckets
+// linear buckets, so every recorded value is kept to within about 3% over the
+// whole range with no allocation while recording.
+class LatencyHistogram
+{
+public:
+	static constexpr int kSubBucketBits = 5;
+	static constexpr size_t kSubBuckets = size_t(1) << kSubBucketBits;
+
+	// Values up to 2^max_value_bits - 1 are tracked; larger ones are clamped
+	// into the top bucket.
+	explicit LatencyHistogram(int max_value_bits = 40);
+
+	// Bucket layout, shared with writers that keep their own (e.g. atomic)
+	// counts and fold them into a histogram later.
+	static constexpr size_t bucketCount(int max_value_bits)
+	{
+		return static_cast<size_t>((max_value_bits - kSubBucketBits > 1 ? max_value_bits - kSubBucketBits : 1) + 1) * kSubBuckets;
+	}
+	static size_t bucketIndex(uint64_t value, size_t bucket_count);
+	// Smallest value that falls in the bucket.
+	static uint64_t bucketValue(size_t index);
+
+	void reset();
+	void record(uint64_t value, uint64_t count = 1);
+	void merge(const LatencyHistogram& other);
+
+	uint64_t count() const;
+	uint64_t min() const;
+	uint64_t max() const;
+	double mean() const;
+
+	// Value at or below which the given fraction (0..1) of the recorded values
+	// fall, rounded up to the edge of its bucket.
+	uint64_t percentile(double fraction) const;
+
+	// Writes one "value,count,cumulative_fraction" row per non-empty bucket.
+	void write(std::ostream& stream) const;
+
+private:
+	std::vector<uint64_t> counts_;
+	uint64_t total_;
+	uint64_t min_;
+	uint64_t max_;
+	double sum_;
+};
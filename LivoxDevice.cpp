@@ -1,28 +1,167 @@
 #include "LivoxDevice.h"
+#include "PointDecoder.h"
 
 #include <algorithm>
 #include <atomic>
 #include <cmath>
 #include <cstring>
-#include <filesystem>
-#include <sstream>
-#include <system_error>
+#include <utility>
 
 namespace
 {
-	constexpr float kMilliToMeters = 0.001f;
-	constexpr float kCentiToMeters = 0.01f;
+	constexpr size_t kDefaultBufferLimit = 200000;
+
+	// A lower limit is applied by advancing the read index; the allocation is
+	// only given back once it is this many times larger than needed.
+	constexpr size_t kShrinkSlack = 8;
+
+	// Stream-mode voxel windows. A window also closes at kVoxelWindowPoints,
+	// which bounds its memory.
+	constexpr uint64_t kDefaultVoxelWindowNs = 5000000;
+	constexpr size_t kVoxelWindowPoints = 65536;
+	// How long past its length the cook lets a window wait for the packet
+	// that closes it, covering network jitter and slowed-down replays.
+	constexpr uint64_t kVoxelWindowGraceNs = 10000000;
+
+	bool
+	needsRealloc(size_t capacity, size_t limit)
+	{
+		return limit > capacity || capacity / kShrinkSlack >= SpscRingIndex::roundCapacity(limit);
+	}
+
+	// Splits budget across count backlogs in proportion to their sizes; the
+	// rounding remainder goes to the first backlogs with points left over.
+	void
+	shareBudget(const size_t* backlogs, size_t count, size_t budget, size_t* shares)
+	{
+		size_t total = 0;
+		for (size_t i = 0; i < count; ++i)
+		{
+			total += backlogs[i];
+		}
+		if (total <= budget)
+		{
+			std::copy(backlogs, backlogs + count, shares);
+			return;
+		}
+
+		size_t assigned = 0;
+		for (size_t i = 0; i < count; ++i)
+		{
+			shares[i] = static_cast<size_t>(static_cast<uint64_t>(budget) * backlogs[i] / total);
+			assigned += shares[i];
+		}
+		for (size_t i = 0; i < count && assigned < budget; ++i)
+		{
+			if (shares[i] < backlogs[i])
+			{
+				++shares[i];
+				++assigned;
+			}
+		}
+	}
+
+	void
+	fillSensorColumn(const PointColumns& destination, size_t count, size_t index)
+	{
+		if (destination.sensor != nullptr)
+		{
+			std::fill(destination.sensor, destination.sensor + count, static_cast<float>(index));
+		}
+	}
 }
 
+struct LivoxDevice::Sensor
+{
+	Sensor(uint32_t sensor_handle, size_t sensor_slot)
+		: handle(sensor_handle)
+		, slot(sensor_slot)
+		, buffer(1)
+		, packets(1)
+		, deskew(imu)
+		, data_type(kLivoxLidarCartesianCoordinateHighData)
+		, total_points(0)
+		, skipped_points(0)
+		, window_opened(0)
+		, buffered_points(0)
+		, evicted_points(0)
+	{
+	}
+
+	const uint32_t handle;
+	// Index in sensors_, and the sensor's profiler lane.
+	const size_t slot;
+
+	// Contended only while the cook thread resizes or switches this sensor's
+	// buffers; the source thread never waits on it and drops the packet instead.
+	std::mutex ingest_mutex;
+	PointRing buffer;
+	PacketSlab packets;
+	PointBlock staging;
+	FrameAssembler frames;
+	// Set by the cook thread under ingest_mutex; decode reads it under the same lock.
+	PointTransform transform;
+	bool transformed = false;
+
+	// Lock-free on its own; IMU packets never take ingest_mutex.
+	ImuBuffer imu;
+	// Run by frames on the source thread; configured under ingest_mutex.
+	MotionDeskew deskew;
+
+	// Voxel filter of frames, or in Stream mode of the window of packets
+	// gathered under ingest_mutex before they are buffered.
+	VoxelGrid voxels;
+	PointBlock window;
+	size_t window_count = 0;
+	PacketStamp window_stamp;
+
+	// Configured under ingest_mutex. In Raw Packets storage the records of the
+	// points that pass are gathered through kept_dots into filtered_records.
+	SpatialFilter filter;
+	std::vector<uint32_t> kept_dots;
+	std::vector<uint8_t> filtered_records;
+
+	// Written by the sensor's source thread.
+	std::atomic<LivoxLidarPointDataType> data_type;
+	std::atomic<uint64_t> total_points;
+	std::atomic<uint64_t> skipped_points;
+	// Receive time of the window's first packet, 0 while it is empty; lets the
+	// cook spot a stale window without the lock.
+	std::atomic<uint64_t> window_opened;
+	// Stream mode: points pushed into the buffer or slab, after the filter
+	// and voxel merging; the adaptive drain's arrival rate.
+	std::atomic<uint64_t> buffered_points;
+	// Stream mode: points the buffer or slab evicted before a cook took them,
+	// as reported by push() and by Buffer Limit changes on the cook thread.
+	std::atomic<uint64_t> evicted_points;
+
+	// Cook-thread rate tracking.
+	uint64_t rate_points = 0;
+	double points_per_second = 0.0;
+
+	// Guarded by state_mutex_.
+	std::string serial;
+	std::string ip;
+};
+
+static_assert(LivoxDevice::kMaxSensors <= Profiler::kSensorLanes, "one profiler lane per sensor slot");
+
 LivoxDevice::LivoxDevice()
-	: buffer_limit_(200000)
+	: sensor_count_(0)
+	, buffer_limit_(kDefaultBufferLimit)
+	, storage_(BufferStorage::Decoded)
+	, frame_duration_ns_(FrameAssembler::kDefaultDurationNs)
+	, output_mode_(OutputMode::Stream)
+	, deskew_(false)
+	, voxel_size_(0.0f)
+	, voxel_window_ns_(kDefaultVoxelWindowNs)
+	, identity_version_(0)
+	, matched_identity_version_(0)
+	, drain_policy_(DrainPolicy::OldestFirst)
+	, points_unassigned_(0)
 	, running_(false)
 	, connected_(false)
-	, sdk_initialized_(false)
-	, lidar_handle_(0)
-	, total_points_(0)
 	, requested_data_type_(kLivoxLidarCartesianCoordinateHighData)
-	, current_data_type_(kLivoxLidarCartesianCoordinateHighData)
 {
 	status_text_ = "Idle";
 }
@@ -33,49 +172,57 @@ LivoxDevice::~LivoxDevice()
 }
 
 bool
-LivoxDevice::start(const std::string& config_path)
+LivoxDevice::start(std::unique_ptr<PacketSource> source)
 {
-	namespace fs = std::filesystem;
-	std::error_code ec;
-	const fs::path cfg_path(config_path);
-	if (!fs::exists(cfg_path, ec))
+	stop();
+	if (!source)
 	{
-		publishStatus("Config file not found: " + config_path);
+		publishStatus("No packet source");
 		return false;
 	}
 
-	if (!LivoxLidarSdkInit(config_path.c_str()))
+	// No source is delivering, so the slots can be released without the
+	// producers' cooperation.
 	{
-		publishStatus("LivoxLidarSdkInit failed");
-		return false;
+		const std::lock_guard<std::mutex> sensors_lock(sensors_mutex_);
+		sensor_count_.store(0);
+		for (std::unique_ptr<Sensor>& sensor : sensors_)
+		{
+			sensor.reset();
+		}
 	}
-
-	clear();
-	total_points_.store(0);
+	for (DrainCounters& counters : drain_counters_)
+	{
+		counters = DrainCounters();
+	}
+	drain_controller_.reset();
+	profiler_.reset();
+	points_unassigned_.store(0);
+	rate_window_start_ = std::chrono::steady_clock::now();
 
 	{
 		std::lock_guard<std::mutex> lock(state_mutex_);
-		config_path_ = config_path;
 		running_ = true;
-		sdk_initialized_ = true;
-		connected_ = false;
-		lidar_handle_ = 0;
-		serial_number_.clear();
-		lidar_ip_.clear();
-		status_text_ = "SDK initialized, waiting for Mid-360";
+		connected_.store(false);
+		status_text_ = "Starting " + source->description();
 	}
 
-	SetLivoxLidarPointCloudCallBack(PointCloudCallback, this);
-	SetLivoxLidarInfoCallback(InfoCallback, this);
-	SetLivoxLidarInfoChangeCallback(InfoChangeCallback, this);
-
+	// The source may call back before start() returns, so it is installed
+	// first; a failed start is unwound the same way as stop().
+	source_ = std::move(source);
+	if (!source_->start(*this))
+	{
+		source_.reset();
+		std::lock_guard<std::mutex> lock(state_mutex_);
+		running_ = false;
+		return false;
+	}
 	return true;
 }
 
 void
 LivoxDevice::stop()
 {
-	bool should_uninit = false;
 	{
 		std::lock_guard<std::mutex> lock(state_mutex_);
 		if (!running_)
@@ -83,26 +230,43 @@ LivoxDevice::stop()
 			return;
 		}
 		running_ = false;
-		connected_ = false;
-		lidar_handle_ = 0;
-		serial_number_.clear();
-		lidar_ip_.clear();
+		connected_.store(false);
+		const size_t count = sensor_count_.load(std::memory_order_acquire);
+		for (size_t i = 0; i < count; ++i)
+		{
+			sensors_[i]->serial.clear();
+			sensors_[i]->ip.clear();
+		}
 		status_text_ = "Stopped";
-		should_uninit = sdk_initialized_;
-		sdk_initialized_ = false;
 	}
 
-	if (should_uninit)
+	// Outside state_mutex_: the source's thread may be inside a sink call
+	// that needs it.
+	if (source_)
 	{
-		LivoxLidarSdkUninit();
+		source_->stop();
+		source_.reset();
 	}
 }
 
 void
 LivoxDevice::clear()
 {
-	std::lock_guard<std::mutex> lock(buffer_mutex_);
-	buffer_.clear();
+	const std::lock_guard<std::mutex> sensors_lock(sensors_mutex_);
+	discardBuffered();
+	const size_t count = sensor_count_.load(std::memory_order_acquire);
+	for (size_t i = 0; i < count; ++i)
+	{
+		const std::unique_lock<std::mutex> lock = lockIngest(*sensors_[i]);
+		if (output_mode_.load() == OutputMode::Frames)
+		{
+			sensors_[i]->frames.reset();
+		}
+		else
+		{
+			dropVoxelWindow(*sensors_[i]);
+		}
+	}
 }
 
 bool
@@ -115,8 +279,7 @@ LivoxDevice::isRunning() const
 bool
 LivoxDevice::isConnected() const
 {
-	std::lock_guard<std::mutex> lock(state_mutex_);
-	return connected_;
+	return connected_.load();
 }
 
 void
@@ -126,301 +289,1295 @@ LivoxDevice::setBufferLimit(size_t limit)
 	{
 		limit = 1;
 	}
-	std::lock_guard<std::mutex> lock(buffer_mutex_);
-	buffer_limit_ = limit;
-	while (buffer_.size() > buffer_limit_)
+	if (limit == buffer_limit_.load())
 	{
-		buffer_.pop_front();
+		return;
 	}
+
+	const std::lock_guard<std::mutex> sensors_lock(sensors_mutex_);
+	buffer_limit_.store(limit);
+	applyBufferLimit();
 }
 
 size_t
 LivoxDevice::bufferLimit() const
 {
-	std::lock_guard<std::mutex> lock(buffer_mutex_);
-	return buffer_limit_;
+	return buffer_limit_.load();
 }
 
 void
-LivoxDevice::setPointDataType(LivoxLidarPointDataType type)
+LivoxDevice::setBufferStorage(BufferStorage storage)
 {
-	uint32_t handle = 0;
+	if (storage == storage_.load())
 	{
-		std::lock_guard<std::mutex> lock(state_mutex_);
-		if (requested_data_type_ == type)
+		return;
+	}
+
+	const std::lock_guard<std::mutex> sensors_lock(sensors_mutex_);
+	discardBuffered();
+
+	// Only the active storage keeps a full-size allocation. The switch happens
+	// under every sensor's lock so no packet lands in a released buffer.
+	const size_t count = sensor_count_.load(std::memory_order_acquire);
+	std::unique_lock<std::mutex> locks[kMaxSensors];
+	for (size_t i = 0; i < count; ++i)
+	{
+		Sensor& sensor = *sensors_[i];
+		locks[i] = lockIngest(sensor);
+		dropVoxelWindow(sensor);
+		if (storage == BufferStorage::RawPackets)
 		{
-			return;
+			sensor.buffer.resize(1);
 		}
-		requested_data_type_ = type;
-		if (connected_ && lidar_handle_ != 0)
+		else
 		{
-			handle = lidar_handle_;
+			sensor.packets.resize(1);
 		}
 	}
-
-	if (handle != 0)
+	storage_.store(storage);
+	for (size_t i = 0; i < count; ++i)
 	{
-		applyPendingDataType(handle);
+		locks[i].unlock();
 	}
+	applyBufferLimit();
+	discardBuffered();
 }
 
-LivoxLidarPointDataType
-LivoxDevice::requestedDataType() const
+LivoxDevice::BufferStorage
+LivoxDevice::bufferStorage() const
 {
-	std::lock_guard<std::mutex> lock(state_mutex_);
-	return requested_data_type_;
+	return storage_.load();
 }
 
-LivoxLidarPointDataType
-LivoxDevice::activeDataType() const
+void
+LivoxDevice::setOutputMode(OutputMode mode)
 {
-	std::lock_guard<std::mutex> lock(state_mutex_);
-	return current_data_type_;
+	if (mode == output_mode_.load())
+	{
+		return;
+	}
+
+	const std::lock_guard<std::mutex> sensors_lock(sensors_mutex_);
+	discardBuffered();
+
+	// Frames and the FIFO buffers are never used together; release whichever
+	// side is going idle.
+	const size_t count = sensor_count_.load(std::memory_order_acquire);
+	std::unique_lock<std::mutex> locks[kMaxSensors];
+	for (size_t i = 0; i < count; ++i)
+	{
+		Sensor& sensor = *sensors_[i];
+		locks[i] = lockIngest(sensor);
+		dropVoxelWindow(sensor);
+		if (mode == OutputMode::Frames)
+		{
+			sensor.buffer.resize(1);
+			sensor.packets.resize(1);
+		}
+		else
+		{
+			sensor.frames.configure(sensor.frames.duration(), 0);
+		}
+	}
+	output_mode_.store(mode);
+	for (size_t i = 0; i < count; ++i)
+	{
+		locks[i].unlock();
+	}
+	applyBufferLimit();
 }
 
-size_t
-LivoxDevice::consume(PointSample* destination, size_t max_points)
+LivoxDevice::OutputMode
+LivoxDevice::outputMode() const
+{
+	return output_mode_.load();
+}
+
+void
+LivoxDevice::setFrameDuration(uint64_t duration_ns)
 {
-	if (destination == nullptr || max_points == 0)
+	if (duration_ns == 0)
 	{
-		return 0;
+		duration_ns = 1;
+	}
+	if (duration_ns == frame_duration_ns_.load())
+	{
+		return;
 	}
 
-	std::lock_guard<std::mutex> lock(buffer_mutex_);
-	const size_t available = std::min(max_points, buffer_.size());
-	for (size_t i = 0; i < available; ++i)
+	const std::lock_guard<std::mutex> sensors_lock(sensors_mutex_);
+	frame_duration_ns_.store(duration_ns);
+	const size_t count = sensor_count_.load(std::memory_order_acquire);
+	for (size_t i = 0; i < count; ++i)
 	{
-		destination[i] = buffer_.front();
-		buffer_.pop_front();
+		Sensor& sensor = *sensors_[i];
+		const std::unique_lock<std::mutex> lock = lockIngest(sensor);
+		sensor.frames.configure(duration_ns, sensor.frames.capacity());
 	}
-	return available;
 }
 
-size_t
-LivoxDevice::bufferedSamples() const
+uint64_t
+LivoxDevice::frameDuration() const
 {
-	std::lock_guard<std::mutex> lock(buffer_mutex_);
-	return buffer_.size();
+	return frame_duration_ns_.load();
 }
 
-std::string
-LivoxDevice::statusText() const
+void
+LivoxDevice::setDrainPolicy(DrainPolicy policy)
 {
-	std::lock_guard<std::mutex> lock(state_mutex_);
-	return status_text_;
+	drain_policy_ = policy;
 }
 
-std::string
-LivoxDevice::infoMessage() const
+LivoxDevice::DrainPolicy
+LivoxDevice::drainPolicy() const
 {
-	std::lock_guard<std::mutex> lock(state_mutex_);
-	return info_text_;
+	return drain_policy_;
 }
 
-std::string
-LivoxDevice::lidarSerial() const
+void
+LivoxDevice::setMotionDeskew(bool enabled)
 {
-	std::lock_guard<std::mutex> lock(state_mutex_);
-	return serial_number_;
+	if (enabled == deskew_.load())
+	{
+		return;
+	}
+
+	const std::lock_guard<std::mutex> sensors_lock(sensors_mutex_);
+	deskew_.store(enabled);
+	const size_t count = sensor_count_.load(std::memory_order_acquire);
+	for (size_t i = 0; i < count; ++i)
+	{
+		Sensor& sensor = *sensors_[i];
+		const std::unique_lock<std::mutex> lock = lockIngest(sensor);
+		sensor.frames.setDeskew(enabled ? &sensor.deskew : nullptr);
+	}
 }
 
-std::string
-LivoxDevice::lidarIp() const
+bool
+LivoxDevice::motionDeskew() const
 {
-	std::lock_guard<std::mutex> lock(state_mutex_);
-	return lidar_ip_;
+	return deskew_.load();
 }
 
 uint64_t
-LivoxDevice::totalPoints() const
+LivoxDevice::deskewedFrames() const
 {
-	return total_points_.load();
+	uint64_t frames = 0;
+	const size_t count = sensor_count_.load(std::memory_order_acquire);
+	for (size_t i = 0; i < count; ++i)
+	{
+		frames += sensors_[i]->deskew.deskewedFrames();
+	}
+	return frames;
 }
 
-void
-LivoxDevice::PointCloudCallback(uint32_t, const uint8_t, LivoxLidarEthernetPacket* data, void* client_data)
+uint64_t
+LivoxDevice::deskewSkippedFrames() const
 {
-	if (client_data == nullptr || data == nullptr)
+	uint64_t frames = 0;
+	const size_t count = sensor_count_.load(std::memory_order_acquire);
+	for (size_t i = 0; i < count; ++i)
 	{
-		return;
+		frames += sensors_[i]->deskew.skippedFrames();
 	}
-	auto* self = static_cast<LivoxDevice*>(client_data);
-	self->handlePointCloud(data);
+	return frames;
 }
 
 void
-LivoxDevice::InfoCallback(uint32_t, const uint8_t, const char* info, void* client_data)
+LivoxDevice::setVoxelSize(float meters)
 {
-	if (client_data == nullptr || info == nullptr)
+	meters = std::max(meters, 0.0f);
+	if (meters == voxel_size_.load())
 	{
 		return;
 	}
-	auto* self = static_cast<LivoxDevice*>(client_data);
-	self->handleInfoMessage(info);
+
+	const std::lock_guard<std::mutex> sensors_lock(sensors_mutex_);
+	voxel_size_.store(meters);
+	const size_t count = sensor_count_.load(std::memory_order_acquire);
+	for (size_t i = 0; i < count; ++i)
+	{
+		Sensor& sensor = *sensors_[i];
+		const std::unique_lock<std::mutex> lock = lockIngest(sensor);
+		// A pending window goes out with the old leaf rather than being lost.
+		flushVoxelWindow(sensor);
+		sensor.voxels.setLeafSize(meters);
+		sensor.frames.setVoxelGrid(meters > 0.0f ? &sensor.voxels : nullptr);
+	}
+}
+
+float
+LivoxDevice::voxelSize() const
+{
+	return voxel_size_.load();
 }
 
 void
-LivoxDevice::InfoChangeCallback(uint32_t handle, const LivoxLidarInfo* info, void* client_data)
+LivoxDevice::setVoxelWindow(uint64_t nanoseconds)
+{
+	// Read by the source thread as each packet arrives; the open window
+	// simply closes by the new length.
+	voxel_window_ns_.store(nanoseconds);
+}
+
+uint64_t
+LivoxDevice::voxelWindow() const
 {
-	if (client_data == nullptr || info == nullptr)
+	return voxel_window_ns_.load();
+}
+
+uint64_t
+LivoxDevice::voxelRemovedPoints() const
+{
+	uint64_t points = 0;
+	const size_t count = sensor_count_.load(std::memory_order_acquire);
+	for (size_t i = 0; i < count; ++i)
 	{
-		return;
+		points += sensors_[i]->voxels.removedPoints();
 	}
-	auto* self = static_cast<LivoxDevice*>(client_data);
-	self->handleInfoChange(handle, info);
+	return points;
 }
 
 void
-LivoxDevice::WorkModeCallback(livox_status status, uint32_t handle, LivoxLidarAsyncControlResponse* response, void* client_data)
+LivoxDevice::setSpatialFilter(const SpatialFilter::Settings& settings)
 {
-	if (client_data == nullptr)
+	if (settings == filter_settings_)
 	{
 		return;
 	}
-	auto* self = static_cast<LivoxDevice*>(client_data);
-	std::ostringstream oss;
-	if (status == kLivoxLidarStatusSuccess && response != nullptr && response->ret_code == 0)
+
+	const std::lock_guard<std::mutex> sensors_lock(sensors_mutex_);
+	filter_settings_ = settings;
+	const size_t count = sensor_count_.load(std::memory_order_acquire);
+	for (size_t i = 0; i < count; ++i)
 	{
-		oss << "Work mode set OK for handle " << handle;
+		Sensor& sensor = *sensors_[i];
+		const std::unique_lock<std::mutex> lock = lockIngest(sensor);
+		sensor.filter.configure(settings);
+		const size_t buffered = sensor.packets.size();
+		sensor.packets.setTimed(sensor.filter.enabled());
+		sensor.evicted_points.fetch_add(buffered - sensor.packets.size());
 	}
-	else
+}
+
+SpatialFilter::Settings
+LivoxDevice::spatialFilter() const
+{
+	return filter_settings_;
+}
+
+uint64_t
+LivoxDevice::rejectedPoints() const
+{
+	uint64_t points = 0;
+	const size_t count = sensor_count_.load(std::memory_order_acquire);
+	for (size_t i = 0; i < count; ++i)
 	{
-		oss << "Work mode failed (" << status << ")";
-		if (response != nullptr)
-		{
-			oss << " ret=" << static_cast<int>(response->ret_code);
-		}
+		points += sensors_[i]->filter.rejectedPoints();
 	}
-	self->publishStatus(oss.str());
+	return points;
 }
 
 void
-LivoxDevice::DataTypeCallback(livox_status status, uint32_t handle, LivoxLidarAsyncControlResponse* response, void* client_data)
+LivoxDevice::setExtrinsics(const std::vector<SensorExtrinsic>& extrinsics)
 {
-	if (client_data == nullptr)
+	const uint64_t version = identity_version_.load();
+	if (version == matched_identity_version_ && extrinsics == extrinsics_)
 	{
 		return;
 	}
-	auto* self = static_cast<LivoxDevice*>(client_data);
-	std::ostringstream oss;
-	if (status == kLivoxLidarStatusSuccess && response != nullptr && response->ret_code == 0)
+	extrinsics_ = extrinsics;
+	matched_identity_version_ = version;
+
+	const std::lock_guard<std::mutex> sensors_lock(sensors_mutex_);
+	const size_t count = sensor_count_.load(std::memory_order_acquire);
+	for (size_t i = 0; i < count; ++i)
 	{
-		oss << "Data type updated for handle " << handle;
+		Sensor& sensor = *sensors_[i];
+		std::string serial;
+		std::string ip;
+		{
+			std::lock_guard<std::mutex> lock(state_mutex_);
+			serial = sensor.serial;
+			ip = sensor.ip;
+		}
+
+		// An identity transform takes the plain decode path.
+		const PointTransform* found = SensorExtrinsics::find(extrinsics_, serial, ip);
+		const bool transformed = found != nullptr && !found->isIdentity();
+		const PointTransform transform = transformed ? *found : PointTransform();
+		if (transformed == sensor.transformed && transform == sensor.transform)
+		{
+			continue;
+		}
+
+		const std::unique_lock<std::mutex> lock = lockIngest(sensor);
+		sensor.transform = transform;
+		sensor.transformed = transformed;
+		sensor.packets.setTransform(transformed ? &sensor.transform : nullptr);
+		sensor.deskew.setTransform(transformed ? &sensor.transform : nullptr);
 	}
-	else
+}
+
+void
+LivoxDevice::setPointDataType(LivoxLidarPointDataType type)
+{
+	{
+		std::lock_guard<std::mutex> lock(state_mutex_);
+		if (requested_data_type_ == type)
+		{
+			return;
+		}
+		requested_data_type_ = type;
+	}
+
+	if (connected_.load())
 	{
-		oss << "Data type update failed (" << status << ")";
-		if (response != nullptr)
+		const size_t count = sensor_count_.load(std::memory_order_acquire);
+		for (size_t i = 0; i < count; ++i)
 		{
-			oss << " ret=" << static_cast<int>(response->ret_code);
+			applyPendingDataType(sensors_[i]->handle);
 		}
 	}
-	self->publishStatus(oss.str());
 }
 
-void
-LivoxDevice::handlePointCloud(LivoxLidarEthernetPacket* packet)
+LivoxLidarPointDataType
+LivoxDevice::requestedDataType() const
 {
-	if (packet == nullptr)
+	std::lock_guard<std::mutex> lock(state_mutex_);
+	return requested_data_type_;
+}
+
+LivoxLidarPointDataType
+LivoxDevice::activeDataType() const
+{
+	// Every sensor is asked for the same type; the first one to report stands
+	// in for all of them.
+	if (sensor_count_.load(std::memory_order_acquire) == 0)
 	{
-		return;
+		return requestedDataType();
 	}
+	return sensors_[0]->data_type.load(std::memory_order_relaxed);
+}
 
-	const LivoxLidarPointDataType data_type = static_cast<LivoxLidarPointDataType>(packet->data_type);
-	if (data_type != kLivoxLidarCartesianCoordinateHighData && data_type != kLivoxLidarCartesianCoordinateLowData)
+size_t
+LivoxDevice::consume(const PointColumns& destination, size_t max_points)
+{
+	if (max_points == 0)
 	{
-		return;
+		return 0;
 	}
 
-	uint64_t timestamp = 0;
-	std::memcpy(&timestamp, packet->timestamp, sizeof(uint64_t));
+	LIVOX_PROFILE_SCOPE(profiler_, Profiler::Stage::Consume);
+	flushStaleVoxelWindows();
+	const size_t count = sensor_count_.load(std::memory_order_acquire);
+	size_t backlogs[kMaxSensors] = {};
+	size_t shares[kMaxSensors] = {};
+	for (size_t i = 0; i < count; ++i)
+	{
+		backlogs[i] = sensorBuffered(*sensors_[i]);
+	}
+	shareBudget(backlogs, count, max_points, shares);
 
+	size_t consumed = 0;
+	for (size_t i = 0; i < count; ++i)
 	{
-		std::lock_guard<std::mutex> lock(state_mutex_);
-		connected_ = true;
-		current_data_type_ = data_type;
+		const PointColumns shifted = destination.offset(consumed);
+		const size_t taken = consumeSensor(*sensors_[i], shifted, shares[i]);
+		fillSensorColumn(shifted, taken, i);
+		consumed += taken;
 	}
+	return consumed;
+}
 
-	std::lock_guard<std::mutex> lock(buffer_mutex_);
-	const uint32_t dot_count = packet->dot_num;
-	if (data_type == kLivoxLidarCartesianCoordinateHighData)
+size_t
+LivoxDevice::consumeSensor(Sensor& sensor, const PointColumns& destination, size_t max_points)
+{
+	// A zero share still applies the policy: the newest-first policies drop
+	// the backlog rather than let it age.
+	const bool raw = storage_.load() == BufferStorage::RawPackets;
+	// The slab's slots are sized for the records the sensor sends; after a
+	// data type switch they are laid out again once, keeping the backlog.
+	const LivoxLidarPointDataType data_type = sensor.data_type.load(std::memory_order_relaxed);
+	if (raw && sensor.packets.dataType() != data_type)
 	{
-		const auto* points = reinterpret_cast<LivoxLidarCartesianHighRawPoint*>(packet->data);
-		for (uint32_t i = 0; i < dot_count; ++i)
-		{
-			PointSample sample;
-			sample.x = static_cast<float>(points[i].x) * kMilliToMeters;
-			sample.y = static_cast<float>(points[i].y) * kMilliToMeters;
-			sample.z = static_cast<float>(points[i].z) * kMilliToMeters;
-			sample.intensity = static_cast<float>(points[i].reflectivity);
-			sample.tag = static_cast<float>(points[i].tag);
-			sample.timestamp = timestamp;
-			buffer_.push_back(sample);
-		}
-		total_points_.fetch_add(dot_count);
+		const std::unique_lock<std::mutex> lock = lockIngest(sensor);
+		const size_t buffered = sensor.packets.size();
+		sensor.packets.setDataType(data_type);
+		sensor.evicted_points.fetch_add(buffered - std::min(buffered, sensor.packets.size()));
 	}
-	else
+	DrainCounters& counters = drain_counters_[static_cast<size_t>(drain_policy_)];
+	size_t consumed = 0;
+	switch (drain_policy_)
+	{
+	case DrainPolicy::NewestDropBacklog:
+	{
+		const size_t dropped = raw ? sensor.packets.trim(max_points) : sensor.buffer.trim(max_points);
+		counters.dropped += dropped;
+		consumed = raw ? sensor.packets.consume(destination, max_points) : sensor.buffer.pop(destination, max_points);
+		break;
+	}
+	case DrainPolicy::NewestDecimate:
 	{
-		const auto* points = reinterpret_cast<LivoxLidarCartesianLowRawPoint*>(packet->data);
-		for (uint32_t i = 0; i < dot_count; ++i)
+		size_t skipped = 0;
+		if (max_points == 0)
+		{
+			skipped = raw ? sensor.packets.trim(0) : sensor.buffer.trim(0);
+		}
+		else
 		{
-			PointSample sample;
-			sample.x = static_cast<float>(points[i].x) * kCentiToMeters;
-			sample.y = static_cast<float>(points[i].y) * kCentiToMeters;
-			sample.z = static_cast<float>(points[i].z) * kCentiToMeters;
-			sample.intensity = static_cast<float>(points[i].reflectivity);
-			sample.tag = static_cast<float>(points[i].tag);
-			sample.timestamp = timestamp;
-			buffer_.push_back(sample);
+			consumed = raw ? sensor.packets.consumeDecimated(destination, max_points, skipped) : sensor.buffer.popDecimated(destination, max_points, skipped);
 		}
-		total_points_.fetch_add(dot_count);
+		counters.skipped += skipped;
+		break;
+	}
+	case DrainPolicy::OldestFirst:
+	default:
+		consumed = raw ? sensor.packets.consume(destination, max_points) : sensor.buffer.pop(destination, max_points);
+		break;
 	}
+	return consumed;
+}
 
-	while (buffer_.size() > buffer_limit_)
+size_t
+LivoxDevice::bufferedSamples() const
+{
+	size_t buffered = 0;
+	const size_t count = sensor_count_.load(std::memory_order_acquire);
+	for (size_t i = 0; i < count; ++i)
 	{
-		buffer_.pop_front();
+		buffered += sensorBuffered(*sensors_[i]);
 	}
+	return buffered;
 }
 
-void
-LivoxDevice::handleInfoChange(uint32_t handle, const LivoxLidarInfo* info)
+size_t
+LivoxDevice::sensorBuffered(const Sensor& sensor) const
 {
+	if (storage_.load() == BufferStorage::RawPackets)
 	{
-		std::lock_guard<std::mutex> lock(state_mutex_);
-		connected_ = true;
-		lidar_handle_ = handle;
-		serial_number_ = info->sn;
-		lidar_ip_ = info->lidar_ip;
-		status_text_ = "Connected to " + serial_number_ + " (" + lidar_ip_ + ")";
+		return sensor.packets.size();
 	}
+	return sensor.buffer.size();
+}
 
-	SetLivoxLidarWorkMode(handle, kLivoxLidarNormal, WorkModeCallback, this);
-	applyPendingDataType(handle);
+size_t
+LivoxDevice::planDrain(double target_latency_ms, size_t max_points)
+{
+	// The backlog planned for includes any stale window this cook will drain.
+	flushStaleVoxelWindows();
+	return drain_controller_.plan(DrainController::Clock::now(), bufferedTotal(), bufferedSamples(), target_latency_ms / 1000.0, max_points);
 }
 
-void
-LivoxDevice::handleInfoMessage(const std::string& message)
+const DrainController&
+LivoxDevice::drainController() const
 {
-	std::lock_guard<std::mutex> lock(state_mutex_);
-	info_text_ = message;
+	return drain_controller_;
 }
 
-void
-LivoxDevice::publishStatus(const std::string& text)
+Profiler&
+LivoxDevice::profiler()
 {
-	std::lock_guard<std::mutex> lock(state_mutex_);
-	status_text_ = text;
+	return profiler_;
+}
+
+size_t
+LivoxDevice::acquireFrame()
+{
+	size_t points = 0;
+	const size_t count = sensor_count_.load(std::memory_order_acquire);
+	for (size_t i = 0; i < count; ++i)
+	{
+		points += sensors_[i]->frames.acquire().count;
+	}
+	return points;
+}
+
+size_t
+LivoxDevice::copyFrame(const PointColumns& destination, size_t max_points)
+{
+	const size_t count = sensor_count_.load(std::memory_order_acquire);
+	size_t frame_points[kMaxSensors] = {};
+	size_t shares[kMaxSensors] = {};
+	for (size_t i = 0; i < count; ++i)
+	{
+		frame_points[i] = sensors_[i]->frames.current().count;
+	}
+	shareBudget(frame_points, count, max_points, shares);
+
+	size_t copied = 0;
+	for (size_t i = 0; i < count; ++i)
+	{
+		const PointColumns shifted = destination.offset(copied);
+		const size_t taken = sensors_[i]->frames.copyCurrent(shifted, shares[i]);
+		fillSensorColumn(shifted, taken, i);
+		copied += taken;
+	}
+	return copied;
+}
+
+size_t
+LivoxDevice::framePoints() const
+{
+	size_t points = 0;
+	const size_t count = sensor_count_.load(std::memory_order_acquire);
+	for (size_t i = 0; i < count; ++i)
+	{
+		points += sensors_[i]->frames.current().count;
+	}
+	return points;
+}
+
+uint64_t
+LivoxDevice::completedFrames() const
+{
+	uint64_t frames = 0;
+	const size_t count = sensor_count_.load(std::memory_order_acquire);
+	for (size_t i = 0; i < count; ++i)
+	{
+		frames += sensors_[i]->frames.publishedFrames();
+	}
+	return frames;
+}
+
+uint64_t
+LivoxDevice::frameOverflowPoints() const
+{
+	uint64_t overflow = 0;
+	const size_t count = sensor_count_.load(std::memory_order_acquire);
+	for (size_t i = 0; i < count; ++i)
+	{
+		overflow += sensors_[i]->frames.overflowPoints();
+	}
+	return overflow;
+}
+
+bool
+LivoxDevice::startRecording(const std::string& path, bool compress)
+{
+	// Under the record lock no record() call is in flight, so the recorder can
+	// reset its queue.
+	const std::lock_guard<std::mutex> lock(record_mutex_);
+	return recorder_.start(path, compress);
+}
+
+void
+LivoxDevice::stopRecording()
+{
+	{
+		const std::lock_guard<std::mutex> lock(record_mutex_);
+		recorder_.requestStop();
+	}
+	// Drain and close outside the lock so ingest is not held up by the disk.
+	recorder_.finish();
+}
+
+const PacketRecorder&
+LivoxDevice::recorder() const
+{
+	return recorder_;
+}
+
+void
+LivoxDevice::seek(double seconds)
+{
+	if (!source_)
+	{
+		return;
+	}
+	source_->seek(seconds);
+	clear();
+}
+
+double
+LivoxDevice::playbackPosition() const
+{
+	return source_ ? source_->position() : 0.0;
+}
+
+double
+LivoxDevice::playbackDuration() const
+{
+	return source_ ? source_->duration() : 0.0;
+}
+
+std::string
+LivoxDevice::statusText() const
+{
+	std::lock_guard<std::mutex> lock(state_mutex_);
+	return status_text_;
+}
+
+std::string
+LivoxDevice::infoMessage() const
+{
+	std::lock_guard<std::mutex> lock(state_mutex_);
+	return info_text_;
+}
+
+std::string
+LivoxDevice::lidarSerial() const
+{
+	std::string serials;
+	std::lock_guard<std::mutex> lock(state_mutex_);
+	const size_t count = sensor_count_.load(std::memory_order_acquire);
+	for (size_t i = 0; i < count; ++i)
+	{
+		if (!sensors_[i]->serial.empty())
+		{
+			serials += (serials.empty() ? "" : ", ") + sensors_[i]->serial;
+		}
+	}
+	return serials;
+}
+
+std::string
+LivoxDevice::lidarIp() const
+{
+	std::string ips;
+	std::lock_guard<std::mutex> lock(state_mutex_);
+	const size_t count = sensor_count_.load(std::memory_order_acquire);
+	for (size_t i = 0; i < count; ++i)
+	{
+		if (!sensors_[i]->ip.empty())
+		{
+			ips += (ips.empty() ? "" : ", ") + sensors_[i]->ip;
+		}
+	}
+	return ips;
+}
+
+size_t
+LivoxDevice::sensorCount() const
+{
+	return sensor_count_.load(std::memory_order_acquire);
+}
+
+LivoxDevice::SensorInfo
+LivoxDevice::sensorInfo(size_t index) const
+{
+	SensorInfo info;
+	if (index >= sensor_count_.load(std::memory_order_acquire))
+	{
+		return info;
+	}
+
+	const Sensor& sensor = *sensors_[index];
+	info.handle = sensor.handle;
+	{
+		std::lock_guard<std::mutex> lock(state_mutex_);
+		info.serial = sensor.serial;
+		info.ip = sensor.ip;
+	}
+
+	info.points = sensor.total_points.load();
+	info.evicted = sensor.evicted_points.load();
+	info.skipped = sensor.skipped_points.load();
+	info.points_per_second = sensor.points_per_second;
+	info.imu_samples = sensor.imu.totalSamples();
+	info.transformed = sensor.transformed;
+	return info;
+}
+
+void
+LivoxDevice::updateSensorRates(std::chrono::steady_clock::time_point now)
+{
+	const double elapsed = std::chrono::duration<double>(now - rate_window_start_).count();
+	if (elapsed < 1.0)
+	{
+		return;
+	}
+
+	const size_t count = sensor_count_.load(std::memory_order_acquire);
+	for (size_t i = 0; i < count; ++i)
+	{
+		Sensor& sensor = *sensors_[i];
+		const uint64_t points = sensor.total_points.load();
+		sensor.points_per_second = static_cast<double>(points - sensor.rate_points) / elapsed;
+		sensor.rate_points = points;
+	}
+	rate_window_start_ = now;
+}
+
+void
+LivoxDevice::updateImu()
+{
+	const size_t count = sensor_count_.load(std::memory_order_acquire);
+	for (size_t i = 0; i < count; ++i)
+	{
+		sensors_[i]->imu.update();
+	}
+}
+
+void
+LivoxDevice::sampleImu(const PointColumns& points, size_t count, const ImuColumns& destination) const
+{
+	// consume() and copyFrame() group points by sensor, so each run of equal
+	// sensor values is looked up in one history.
+	const size_t sensors = sensor_count_.load(std::memory_order_acquire);
+	size_t begin = 0;
+	while (begin < count)
+	{
+		size_t end = count;
+		size_t index = 0;
+		if (points.sensor != nullptr)
+		{
+			end = begin + 1;
+			while (end < count && points.sensor[end] == points.sensor[begin])
+			{
+				++end;
+			}
+			index = static_cast<size_t>(points.sensor[begin]);
+		}
+
+		if (index < sensors)
+		{
+			sensors_[index]->imu.sample(points.timestamp != nullptr ? points.timestamp + begin : nullptr, end - begin, destination.offset(begin));
+		}
+		begin = end;
+	}
+}
+
+bool
+LivoxDevice::latestImu(size_t index, ImuSample& sample) const
+{
+	if (index >= sensor_count_.load(std::memory_order_acquire))
+	{
+		return false;
+	}
+	return sensors_[index]->imu.latest(sample);
+}
+
+uint64_t
+LivoxDevice::imuSamples() const
+{
+	uint64_t samples = 0;
+	const size_t count = sensor_count_.load(std::memory_order_acquire);
+	for (size_t i = 0; i < count; ++i)
+	{
+		samples += sensors_[i]->imu.totalSamples();
+	}
+	return samples;
+}
+
+uint64_t
+LivoxDevice::totalPoints() const
+{
+	uint64_t total = 0;
+	const size_t count = sensor_count_.load(std::memory_order_acquire);
+	for (size_t i = 0; i < count; ++i)
+	{
+		total += sensors_[i]->total_points.load();
+	}
+	return total;
+}
+
+uint64_t
+LivoxDevice::bufferedTotal() const
+{
+	uint64_t total = 0;
+	const size_t count = sensor_count_.load(std::memory_order_acquire);
+	for (size_t i = 0; i < count; ++i)
+	{
+		total += sensors_[i]->buffered_points.load();
+	}
+	return total;
+}
+
+uint64_t
+LivoxDevice::evictedPoints() const
+{
+	uint64_t evicted = 0;
+	const size_t count = sensor_count_.load(std::memory_order_acquire);
+	for (size_t i = 0; i < count; ++i)
+	{
+		evicted += sensorInfo(i).evicted;
+	}
+	return evicted;
+}
+
+uint64_t
+LivoxDevice::skippedPoints() const
+{
+	uint64_t skipped = points_unassigned_.load();
+	const size_t count = sensor_count_.load(std::memory_order_acquire);
+	for (size_t i = 0; i < count; ++i)
+	{
+		skipped += sensors_[i]->skipped_points.load();
+	}
+	return skipped;
+}
+
+uint64_t
+LivoxDevice::drainDroppedPoints(DrainPolicy policy) const
+{
+	return drain_counters_[static_cast<size_t>(policy)].dropped;
+}
+
+uint64_t
+LivoxDevice::drainSkippedPoints(DrainPolicy policy) const
+{
+	return drain_counters_[static_cast<size_t>(policy)].skipped;
+}
+
+void
+LivoxDevice::onPacket(uint32_t handle, const LivoxLidarEthernetPacket* packet)
+{
+	if (packet == nullptr)
+	{
+		return;
+	}
+	const uint64_t received = PacketStamp::hostNow();
+
+	const LivoxLidarPointDataType data_type = static_cast<LivoxLidarPointDataType>(packet->data_type);
+	if (data_type != kLivoxLidarCartesianCoordinateHighData && data_type != kLivoxLidarCartesianCoordinateLowData)
+	{
+		return;
+	}
+
+	const uint32_t dot_count = packet->dot_num;
+	Sensor* sensor = findSensor(handle);
+	if (sensor == nullptr)
+	{
+		sensor = addSensor(handle);
+		if (sensor == nullptr)
+		{
+			points_unassigned_.fetch_add(dot_count);
+			return;
+		}
+	}
+	// Timed from here on, in the sensor's own lane: its packets come from one
+	// thread, other lidars' from others. Registering a new lidar is not counted.
+	LIVOX_PROFILE_SENSOR_SCOPE(profiler_, Profiler::Stage::Ingest, sensor->slot);
+	if (!connected_.load(std::memory_order_relaxed))
+	{
+		connected_.store(true);
+	}
+	sensor->data_type.store(data_type, std::memory_order_relaxed);
+
+	uint64_t timestamp = 0;
+	std::memcpy(&timestamp, packet->timestamp, sizeof(uint64_t));
+
+	// The cook thread holds the sensor's ingest lock only while resizing its
+	// buffers; skip the packet rather than stall the source's receive thread.
+	std::unique_lock<std::mutex> lock(sensor->ingest_mutex, std::try_to_lock);
+	if (!lock.owns_lock())
+	{
+		sensor->skipped_points.fetch_add(dot_count);
+		return;
+	}
+
+	if (recorder_.isRecording())
+	{
+		const std::lock_guard<std::mutex> record_lock(record_mutex_);
+		recorder_.record(handle, packet, received);
+	}
+
+	PacketStamp stamp;
+	stamp.timestamp = timestamp;
+	stamp.received = received;
+	stamp.time_interval = packet->time_interval;
+	stamp.dot_num = packet->dot_num;
+
+	if (output_mode_.load() == OutputMode::Frames)
+	{
+		PointColumns staged = decodeToStaging(*sensor, packet, data_type);
+		const size_t kept = filterStaging(*sensor, staged, dot_count, stamp);
+		sensor->frames.append(staged, kept, stamp);
+	}
+	else if (storage_.load() == BufferStorage::RawPackets)
+	{
+		if (!sensor->filter.enabled())
+		{
+			sensor->evicted_points.fetch_add(sensor->packets.push(packet, data_type, stamp));
+			sensor->buffered_points.fetch_add(dot_count);
+		}
+		else
+		{
+			// The slab keeps raw records, so the survivors' records are picked
+			// out of the packet by their original positions.
+			PointColumns staged = decodeToStaging(*sensor, packet, data_type);
+			const size_t kept = filterStaging(*sensor, staged, dot_count, stamp);
+			const size_t point_size = data_type == kLivoxLidarCartesianCoordinateHighData
+				? sizeof(LivoxLidarCartesianHighRawPoint)
+				: sizeof(LivoxLidarCartesianLowRawPoint);
+			if (kept > 0)
+			{
+				sensor->filtered_records.resize(dot_count * point_size);
+				for (size_t i = 0; i < kept; ++i)
+				{
+					std::memcpy(sensor->filtered_records.data() + i * point_size, packet->data + sensor->kept_dots[i] * point_size, point_size);
+				}
+				sensor->evicted_points.fetch_add(sensor->packets.push(sensor->filtered_records.data(), kept, data_type, stamp, staged.timestamp));
+				sensor->buffered_points.fetch_add(kept);
+			}
+		}
+	}
+	else
+	{
+		PointColumns staged = decodeToStaging(*sensor, packet, data_type);
+		const size_t kept = filterStaging(*sensor, staged, dot_count, stamp);
+		// A packet with no points left is not stored at all.
+		if (kept > 0)
+		{
+			if (sensor->voxels.leafSize() > 0.0f)
+			{
+				pushVoxelWindow(*sensor, staged, kept, stamp);
+			}
+			else
+			{
+				sensor->evicted_points.fetch_add(sensor->buffer.push(staged, kept, stamp));
+				sensor->buffered_points.fetch_add(kept);
+			}
+		}
+	}
+	sensor->total_points.fetch_add(dot_count);
+	LIVOX_PROFILE_INGEST(profiler_, sensor->slot, dot_count);
+}
+
+void
+LivoxDevice::onImuPacket(uint32_t handle, const LivoxLidarEthernetPacket* packet)
+{
+	if (packet == nullptr || packet->data_type != kLivoxLidarImuData)
+	{
+		return;
+	}
+	const uint64_t received = PacketStamp::hostNow();
+
+	Sensor* sensor = findSensor(handle);
+	if (sensor == nullptr)
+	{
+		sensor = addSensor(handle);
+		if (sensor == nullptr)
+		{
+			return;
+		}
+	}
+	sensor->imu.push(packet, received);
+}
+
+LivoxDevice::Sensor*
+LivoxDevice::findSensor(uint32_t handle) const
+{
+	const size_t count = sensor_count_.load(std::memory_order_acquire);
+	for (size_t i = 0; i < count; ++i)
+	{
+		if (sensors_[i]->handle == handle)
+		{
+			return sensors_[i].get();
+		}
+	}
+	return nullptr;
+}
+
+LivoxDevice::Sensor*
+LivoxDevice::addSensor(uint32_t handle)
+{
+	const std::lock_guard<std::mutex> sensors_lock(sensors_mutex_);
+	const size_t count = sensor_count_.load(std::memory_order_relaxed);
+	for (size_t i = 0; i < count; ++i)
+	{
+		if (sensors_[i]->handle == handle)
+		{
+			return sensors_[i].get();
+		}
+	}
+	if (count == kMaxSensors)
+	{
+		return nullptr;
+	}
+
+	// Not yet visible to the cook thread, so the buffers are sized without
+	// taking the sensor's lock.
+	std::unique_ptr<Sensor> sensor(new Sensor(handle, count));
+	const size_t limit = buffer_limit_.load();
+	sensor->frames.setDeskew(deskew_.load() ? &sensor->deskew : nullptr);
+	sensor->voxels.setLeafSize(voxel_size_.load());
+	sensor->filter.configure(filter_settings_);
+	sensor->packets.setTimed(sensor->filter.enabled());
+	sensor->frames.setVoxelGrid(voxel_size_.load() > 0.0f ? &sensor->voxels : nullptr);
+	if (output_mode_.load() == OutputMode::Frames)
+	{
+		sensor->frames.configure(frame_duration_ns_.load(), limit);
+	}
+	else
+	{
+		sensor->frames.configure(frame_duration_ns_.load(), 0);
+		if (storage_.load() == BufferStorage::RawPackets)
+		{
+			sensor->packets.resize(limit);
+			sensor->packets.setLimit(limit);
+		}
+		else
+		{
+			sensor->buffer.resize(limit);
+			sensor->buffer.setLimit(limit);
+		}
+	}
+
+	sensors_[count] = std::move(sensor);
+	sensor_count_.store(count + 1, std::memory_order_release);
+	return sensors_[count].get();
+}
+
+std::unique_lock<std::mutex>
+LivoxDevice::lockIngest(Sensor& sensor)
+{
+	LIVOX_PROFILE_SCOPE(profiler_, Profiler::Stage::CookLock);
+	return std::unique_lock<std::mutex>(sensor.ingest_mutex);
+}
+
+PointColumns
+LivoxDevice::decodeToStaging(Sensor& sensor, const LivoxLidarEthernetPacket* packet, LivoxLidarPointDataType data_type)
+{
+	const size_t dot_count = packet->dot_num;
+	sensor.staging.resize(dot_count);
+	// The points keep their packet positions, so their times still come from
+	// the stamp until a filter moves them.
+	PointColumns staged = sensor.staging.columns();
+	staged.timestamp = nullptr;
+	staged.received = nullptr;
+	const PointTransform* transform = sensor.transformed ? &sensor.transform : nullptr;
+	if (data_type == kLivoxLidarCartesianCoordinateHighData)
+	{
+		PointDecoder::decodeHigh(reinterpret_cast<const LivoxLidarCartesianHighRawPoint*>(packet->data), dot_count, staged, transform);
+	}
+	else
+	{
+		PointDecoder::decodeLow(reinterpret_cast<const LivoxLidarCartesianLowRawPoint*>(packet->data), dot_count, staged, transform);
+	}
+	return staged;
+}
+
+void
+LivoxDevice::pushVoxelWindow(Sensor& sensor, const PointColumns& points, size_t count, const PacketStamp& stamp)
+{
+	// A window closes when the packet would stretch it past the window length
+	// or its capacity, or when the lidar clock runs backwards.
+	const uint64_t end = stamp.pointTime(stamp.dot_num);
+	if (sensor.window_count > 0)
+	{
+		const uint64_t start = sensor.window_stamp.timestamp;
+		if (stamp.timestamp < start || end - start > voxel_window_ns_.load(std::memory_order_relaxed) || sensor.window_count + count > kVoxelWindowPoints)
+		{
+			flushVoxelWindow(sensor);
+		}
+	}
+	if (sensor.window.size() < sensor.window_count + count)
+	{
+		sensor.window.resize(std::max(std::min(sensor.window.size() * 2, kVoxelWindowPoints), sensor.window_count + count));
+	}
+	if (sensor.window_count == 0)
+	{
+		sensor.window_stamp = stamp;
+		sensor.window_opened.store(std::max<uint64_t>(stamp.received, 1), std::memory_order_relaxed);
+	}
+
+	const PointColumns target = sensor.window.columns().offset(sensor.window_count);
+	std::memcpy(target.x, points.x, count * sizeof(float));
+	std::memcpy(target.y, points.y, count * sizeof(float));
+	std::memcpy(target.z, points.z, count * sizeof(float));
+	std::memcpy(target.intensity, points.intensity, count * sizeof(float));
+	std::memcpy(target.tag, points.tag, count * sizeof(float));
+	for (size_t i = 0; i < count; ++i)
+	{
+		target.timestamp[i] = stamp.batchTime(points, i);
+		target.received[i] = stamp.received;
+	}
+	sensor.window_count += count;
+}
+
+void
+LivoxDevice::flushVoxelWindow(Sensor& sensor)
+{
+	if (sensor.window_count == 0)
+	{
+		return;
+	}
+
+	// Each voxel keeps the time of its first point. The voxels go into the ring
+	// as one batch with those exact times, stamped with the window's oldest
+	// receive time, so latency includes the wait in the window.
+	const PointColumns columns = sensor.window.columns();
+	const size_t kept = sensor.voxels.filter(columns, sensor.window_count);
+	PacketStamp stamp;
+	stamp.received = sensor.window_stamp.received;
+	sensor.evicted_points.fetch_add(sensor.buffer.push(columns, kept, stamp));
+	sensor.buffered_points.fetch_add(kept);
+	sensor.window_count = 0;
+	sensor.window_opened.store(0, std::memory_order_relaxed);
+}
+
+void
+LivoxDevice::dropVoxelWindow(Sensor& sensor)
+{
+	sensor.window_count = 0;
+	sensor.window_opened.store(0, std::memory_order_relaxed);
+}
+
+void
+LivoxDevice::flushStaleVoxelWindows()
+{
+	// A window otherwise closes only when a later packet arrives, so a paused
+	// or stopped stream would hold its last points back indefinitely.
+	const uint64_t now = PacketStamp::hostNow();
+	const uint64_t stale = voxel_window_ns_.load() + kVoxelWindowGraceNs;
+	const size_t count = sensor_count_.load(std::memory_order_acquire);
+	for (size_t i = 0; i < count; ++i)
+	{
+		Sensor& sensor = *sensors_[i];
+		const uint64_t opened = sensor.window_opened.load(std::memory_order_relaxed);
+		if (opened == 0 || now < opened + stale)
+		{
+			continue;
+		}
+		// Checked again under the lock: the source thread may have closed the
+		// window and opened a new one meanwhile.
+		const std::unique_lock<std::mutex> lock = lockIngest(sensor);
+		const uint64_t current = sensor.window_opened.load(std::memory_order_relaxed);
+		if (current != 0 && now >= current + stale)
+		{
+			flushVoxelWindow(sensor);
+		}
+	}
+}
+
+size_t
+LivoxDevice::filterStaging(Sensor& sensor, PointColumns& staged, size_t count, const PacketStamp& stamp)
+{
+	if (!sensor.filter.enabled())
+	{
+		return count;
+	}
+
+	// The survivors no longer sit at their packet positions, so each takes
+	// the exact time of the position it came from.
+	sensor.kept_dots.resize(count);
+	const size_t kept = sensor.filter.apply(staged, count, sensor.kept_dots.data());
+	staged.timestamp = sensor.staging.columns().timestamp;
+	for (size_t i = 0; i < kept; ++i)
+	{
+		staged.timestamp[i] = stamp.pointTime(stamp.first_dot + sensor.kept_dots[i]);
+	}
+	return kept;
+}
+
+void
+LivoxDevice::onLidarInfo(uint32_t handle, const std::string& serial, const std::string& ip)
+{
+	Sensor* sensor = findSensor(handle);
+	if (sensor == nullptr)
+	{
+		sensor = addSensor(handle);
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(state_mutex_);
+		connected_.store(true);
+		if (sensor == nullptr)
+		{
+			status_text_ = "Ignoring " + serial + " (" + ip + "): more than " + std::to_string(kMaxSensors) + " lidars";
+			return;
+		}
+		sensor->serial = serial;
+		sensor->ip = ip;
+		identity_version_.fetch_add(1);
+		const size_t count = sensor_count_.load(std::memory_order_acquire);
+		if (count == 1)
+		{
+			status_text_ = "Connected to " + serial + " (" + ip + ")";
+		}
+		else
+		{
+			status_text_ = "Connected to " + std::to_string(count) + " lidars";
+		}
+	}
+
+	applyPendingDataType(handle);
+}
+
+void
+LivoxDevice::onInfoMessage(const std::string& message)
+{
+	std::lock_guard<std::mutex> lock(state_mutex_);
+	info_text_ = message;
+}
+
+void
+LivoxDevice::onStatus(const std::string& text)
+{
+	publishStatus(text);
+}
+
+void
+LivoxDevice::publishStatus(const std::string& text)
+{
+	std::lock_guard<std::mutex> lock(state_mutex_);
+	status_text_ = text;
+}
+
+void
+LivoxDevice::applyBufferLimit()
+{
+	// The limit applies to each sensor on its own.
+	const size_t limit = buffer_limit_.load();
+	const size_t count = sensor_count_.load(std::memory_order_acquire);
+	for (size_t i = 0; i < count; ++i)
+	{
+		Sensor& sensor = *sensors_[i];
+		if (output_mode_.load() == OutputMode::Frames)
+		{
+			// The limit caps the points kept per frame.
+			if (sensor.frames.capacity() != limit)
+			{
+				const std::unique_lock<std::mutex> lock = lockIngest(sensor);
+				sensor.frames.configure(sensor.frames.duration(), limit);
+			}
+		}
+		else
+		{
+			// Points a lower limit drops count as evicted. With the source held
+			// off, the change in the buffered count is exactly what it dropped.
+			const std::unique_lock<std::mutex> lock = lockIngest(sensor);
+			const size_t buffered = sensorBuffered(sensor);
+			if (storage_.load() == BufferStorage::RawPackets)
+			{
+				if (needsRealloc(sensor.packets.pointCapacity(), limit))
+				{
+					sensor.packets.resize(limit);
+				}
+				sensor.packets.setLimit(limit);
+			}
+			else
+			{
+				if (needsRealloc(sensor.buffer.capacity(), limit))
+				{
+					sensor.buffer.resize(limit);
+				}
+				sensor.buffer.setLimit(limit);
+			}
+			sensor.evicted_points.fetch_add(buffered - std::min(buffered, sensorBuffered(sensor)));
+		}
+	}
+}
+
+void
+LivoxDevice::discardBuffered()
+{
+	const size_t count = sensor_count_.load(std::memory_order_acquire);
+	for (size_t i = 0; i < count; ++i)
+	{
+		Sensor& sensor = *sensors_[i];
+		sensor.buffer.clear();
+		sensor.packets.clear();
+	}
 }
 
 void
 LivoxDevice::applyPendingDataType(uint32_t handle)
 {
-	const LivoxLidarPointDataType data_type = requestedDataType();
-	const livox_status status = SetLivoxLidarPclDataType(handle, data_type, DataTypeCallback, this);
-	if (status != kLivoxLidarStatusSuccess)
+	if (source_)
 	{
-		std::ostringstream oss;
-		oss << "Set data type failed (" << status << ")";
-		publishStatus(oss.str());
+		source_->requestDataType(handle, requestedDataType());
 	}
 }
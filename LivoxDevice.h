@@ -1,31 +1,81 @@
 #pragma once
 
+#include <array>
 #include <atomic>
+#include <chrono>
 #include <cstdint>
 #include <cstddef>
-#include <deque>
+#include <memory>
 #include <mutex>
 #include <string>
+#include <vector>
 
+#include "DrainController.h"
+#include "FrameAssembler.h"
+#include "ImuBuffer.h"
 #include "livox_lidar_api.h"
+#include "MotionDeskew.h"
+#include "PacketRecorder.h"
+#include "PacketSlab.h"
+#include "PacketSource.h"
+#include "PointRing.h"
+#include "Profiler.h"
+#include "SensorExtrinsics.h"
+#include "SpatialFilter.h"
+#include "VoxelGrid.h"
 
-class LivoxDevice
+class LivoxDevice : private PacketSink
 {
 public:
-	struct PointSample
+	// Decoded keeps converted point columns; RawPackets keeps the packet
+	// payloads and decodes only what consume() drains.
+	enum class BufferStorage
 	{
-		float x = 0.0f;
-		float y = 0.0f;
-		float z = 0.0f;
-		float intensity = 0.0f;
-		float tag = 0.0f;
-		uint64_t timestamp = 0;
+		Decoded = 0,
+		RawPackets = 1
+	};
+
+	// Stream drains points through the FIFO buffer; Frames groups them into
+	// fixed-duration frames by packet timestamp and keeps the newest complete one.
+	enum class OutputMode
+	{
+		Stream = 0,
+		Frames = 1
+	};
+
+	// Which points consume() hands out when more are buffered than requested:
+	// the oldest (FIFO), the newest with the older backlog dropped, or a uniform
+	// decimation of the whole backlog.
+	enum class DrainPolicy
+	{
+		OldestFirst = 0,
+		NewestDropBacklog = 1,
+		NewestDecimate = 2
+	};
+
+	// Lidars beyond this many handles are ignored; their points count as skipped.
+	static constexpr size_t kMaxSensors = 8;
+
+	// Diagnostics for one sensor slot. Slots are numbered in the order their
+	// handles first reported, which is also the value of the sensor column.
+	struct SensorInfo
+	{
+		uint32_t handle = 0;
+		std::string serial;
+		std::string ip;
+		uint64_t points = 0;
+		uint64_t evicted = 0;
+		uint64_t skipped = 0;
+		double points_per_second = 0.0;
+		uint64_t imu_samples = 0;
+		bool transformed = false;
 	};
 
 	LivoxDevice();
-	~LivoxDevice();
+	~LivoxDevice() override;
 
-	bool start(const std::string& config_path);
+	// Takes ownership of source and starts receiving from it.
+	bool start(std::unique_ptr<PacketSource> source);
 	void stop();
 	void clear();
 	bool isRunning() const;
@@ -34,49 +84,227 @@ public:
 	void setBufferLimit(size_t limit);
 	size_t bufferLimit() const;
 
+	void setBufferStorage(BufferStorage storage);
+	BufferStorage bufferStorage() const;
+
+	void setOutputMode(OutputMode mode);
+	OutputMode outputMode() const;
+	void setFrameDuration(uint64_t duration_ns);
+	uint64_t frameDuration() const;
+
+	void setDrainPolicy(DrainPolicy policy);
+	DrainPolicy drainPolicy() const;
+
+	// IMU motion de-skew of every completed frame, on the source thread just
+	// before the frame is published; Frames mode only.
+	void setMotionDeskew(bool enabled);
+	bool motionDeskew() const;
+	// Frames corrected, and frames published uncorrected for lack of IMU data.
+	uint64_t deskewedFrames() const;
+	uint64_t deskewSkippedFrames() const;
+
+	// Voxel-grid downsampling between decode and buffering, with a leaf of
+	// the given side in meters (0 = off). Frames mode filters every completed
+	// frame as it is published. Stream mode with Decoded storage gathers each
+	// sensor's packets into windows of voxelWindow() and buffers only their
+	// voxels; Raw Packets storage keeps packets undecoded and is not filtered.
+	void setVoxelSize(float meters);
+	float voxelSize() const;
+	// Lidar time a Stream-mode window spans, 5 ms by default. consume() and
+	// planDrain() flush a window whose closing packet is overdue.
+	void setVoxelWindow(uint64_t nanoseconds);
+	uint64_t voxelWindow() const;
+	// Points merged away by the filter.
+	uint64_t voxelRemovedPoints() const;
+
+	// Crop box, range gate and sector mask, tested on every decoded packet in
+	// the output frame (after the extrinsics) before anything is buffered or
+	// framed. While a test is on, Raw Packets storage decodes each packet on
+	// arrival and keeps only the raw records of the points that pass.
+	void setSpatialFilter(const SpatialFilter::Settings& settings);
+	SpatialFilter::Settings spatialFilter() const;
+	// Points dropped by the filter.
+	uint64_t rejectedPoints() const;
+
+	// Mounting transforms applied while decoding, matched to each lidar by
+	// serial number or IP. Cook thread; call every cook so that lidars which
+	// identify themselves later pick up their transform. Decoded points and
+	// frames keep the transform they were decoded with, but Raw Packets
+	// storage decodes when drained, so its whole backlog takes the new one.
+	void setExtrinsics(const std::vector<SensorExtrinsic>& extrinsics);
+
 	void setPointDataType(LivoxLidarPointDataType type);
 	LivoxLidarPointDataType requestedDataType() const;
 	LivoxLidarPointDataType activeDataType() const;
 
-	size_t consume(PointSample* destination, size_t max_points);
+	// Drains up to max_points according to the drain policy straight into the
+	// caller's column pointers; null columns are skipped. With several sensors
+	// max_points is shared in proportion to their backlogs, the output is
+	// grouped by sensor and the sensor column holds each point's slot.
+	size_t consume(const PointColumns& destination, size_t max_points);
 	size_t bufferedSamples() const;
 
+	// Adaptive drain: plans how many points the next consume() should take to
+	// keep the backlog near target_latency_ms given the measured arrival rate.
+	// The rate counts the points that reach the buffers, after the spatial
+	// filter and voxel merging. Call once per cook.
+	size_t planDrain(double target_latency_ms, size_t max_points);
+	const DrainController& drainController() const;
+
+	// Stage timings; the cook thread also records its own stages here.
+	Profiler& profiler();
+
+	// Frames mode: makes the newest complete frame of every sensor current and
+	// returns their combined point count. copyFrame() then reads those frames
+	// without locking and without removing them, so they can be output again
+	// if no newer ones arrive.
+	size_t acquireFrame();
+	size_t copyFrame(const PointColumns& destination, size_t max_points);
+	size_t framePoints() const;
+	uint64_t completedFrames() const;
+	// Points that did not fit a frame because it exceeded the buffer limit.
+	uint64_t frameOverflowPoints() const;
+
+	// Records every ingested packet to a PacketFile until stopRecording(),
+	// optionally compressed with PacketCodec.
+	bool startRecording(const std::string& path, bool compress);
+	void stopRecording();
+	const PacketRecorder& recorder() const;
+
+	// Playback position of a replay source, in seconds. seek() also drops
+	// what is buffered so the output jumps with it; a packet already in
+	// flight from the old position may still arrive. Cook thread only.
+	void seek(double seconds);
+	double playbackPosition() const;
+	double playbackDuration() const;
+
 	std::string statusText() const;
 	std::string infoMessage() const;
+	// Comma-separated over all sensors.
 	std::string lidarSerial() const;
 	std::string lidarIp() const;
 
+	size_t sensorCount() const;
+	SensorInfo sensorInfo(size_t index) const;
+	// Cook thread: refreshes the per-sensor point rates once a second.
+	void updateSensorRates(std::chrono::steady_clock::time_point now);
+
+	// IMU, cook thread. updateImu() moves the samples that arrived since the
+	// last call into each sensor's history; call it once per cook.
+	void updateImu();
+	// IMU values at the time of each of count points drained by consume() or
+	// copyFrame(), found through their timestamp and sensor columns.
+	void sampleImu(const PointColumns& points, size_t count, const ImuColumns& destination) const;
+	// Newest sample of the sensor in slot index; false if none arrived yet.
+	bool latestImu(size_t index, ImuSample& sample) const;
+	uint64_t imuSamples() const;
+
 	uint64_t totalPoints() const;
 
+	// Points dropped because a sensor's buffer limit was exceeded, and points
+	// skipped because they arrived while the cook thread was reallocating the
+	// buffer or from a lidar beyond kMaxSensors.
+	uint64_t evictedPoints() const;
+	uint64_t skippedPoints() const;
+
+	// Per drain policy: backlog points dropped without being output, and
+	// points stepped over by decimation.
+	uint64_t drainDroppedPoints(DrainPolicy policy) const;
+	uint64_t drainSkippedPoints(DrainPolicy policy) const;
+
 private:
-	static void PointCloudCallback(uint32_t handle, const uint8_t dev_type, LivoxLidarEthernetPacket* data, void* client_data);
-	static void InfoCallback(uint32_t handle, const uint8_t dev_type, const char* info, void* client_data);
-	static void InfoChangeCallback(uint32_t handle, const LivoxLidarInfo* info, void* client_data);
-	static void WorkModeCallback(livox_status status, uint32_t handle, LivoxLidarAsyncControlResponse* response, void* client_data);
-	static void DataTypeCallback(livox_status status, uint32_t handle, LivoxLidarAsyncControlResponse* response, void* client_data);
-
-	void handlePointCloud(LivoxLidarEthernetPacket* packet);
-	void handleInfoChange(uint32_t handle, const LivoxLidarInfo* info);
-	void handleInfoMessage(const std::string& message);
+	struct Sensor;
+
+	void onPacket(uint32_t handle, const LivoxLidarEthernetPacket* packet) override;
+	void onImuPacket(uint32_t handle, const LivoxLidarEthernetPacket* packet) override;
+	void onLidarInfo(uint32_t handle, const std::string& serial, const std::string& ip) override;
+	void onInfoMessage(const std::string& message) override;
+	void onStatus(const std::string& text) override;
+
 	void publishStatus(const std::string& text);
 	void applyPendingDataType(uint32_t handle);
 
-	mutable std::mutex buffer_mutex_;
-	std::deque<PointSample> buffer_;
-	size_t buffer_limit_;
+	// Lock-free lookup of a published sensor; nullptr if the handle is new.
+	Sensor* findSensor(uint32_t handle) const;
+	// Registers handle under sensors_mutex_ with buffers sized for the current
+	// settings; nullptr once kMaxSensors are in use.
+	Sensor* addSensor(uint32_t handle);
+
+	// The helpers below run on the cook thread with sensors_mutex_ held.
+	void applyBufferLimit();
+	void discardBuffered();
+	size_t sensorBuffered(const Sensor& sensor) const;
+	// Points that have entered the Stream-mode buffers since start.
+	uint64_t bufferedTotal() const;
+	size_t consumeSensor(Sensor& sensor, const PointColumns& destination, size_t max_points);
+	// Cook thread: takes the sensor's ingest lock, timing the wait.
+	std::unique_lock<std::mutex> lockIngest(Sensor& sensor);
+	PointColumns decodeToStaging(Sensor& sensor, const LivoxLidarEthernetPacket* packet, LivoxLidarPointDataType data_type);
+	// Stream-mode voxel window; run under the sensor's ingest lock.
+	void pushVoxelWindow(Sensor& sensor, const PointColumns& points, size_t count, const PacketStamp& stamp);
+	void flushVoxelWindow(Sensor& sensor);
+	void dropVoxelWindow(Sensor& sensor);
+	// Cook thread; takes the ingest lock of sensors with an overdue window.
+	void flushStaleVoxelWindows();
+	// Runs the sensor's spatial filter over the staged points, compacting them
+	// in place. The survivors' packet positions go to kept_dots and their exact
+	// times to the staged timestamp column, which stays null when nothing is
+	// filtered. Source thread, under the sensor's ingest lock.
+	size_t filterStaging(Sensor& sensor, PointColumns& staged, size_t count, const PacketStamp& stamp);
+
+	// One slot per lidar handle. Points flow from each source thread into its
+	// sensor's buffer (packets in RawPackets storage, frames in Frames mode)
+	// without locking, and sensors share nothing on that path. A slot is
+	// published by storing sensor_count_ and is only removed by start() once
+	// the source has stopped, so lookups need no lock.
+	std::array<std::unique_ptr<Sensor>, kMaxSensors> sensors_;
+	std::atomic<size_t> sensor_count_;
+	// Serializes registration against the cook thread's reconfiguration.
+	std::mutex sensors_mutex_;
+
+	std::atomic<size_t> buffer_limit_;
+	std::atomic<BufferStorage> storage_;
+	std::atomic<uint64_t> frame_duration_ns_;
+	std::atomic<OutputMode> output_mode_;
+	std::atomic<bool> deskew_;
+	std::atomic<float> voxel_size_;
+	std::atomic<uint64_t> voxel_window_ns_;
+	// Cook thread; read by addSensor() under sensors_mutex_.
+	SpatialFilter::Settings filter_settings_;
+
+	// Cook thread. identity_version_ is bumped whenever a lidar reports its
+	// serial and IP, so setExtrinsics() knows to match again.
+	std::vector<SensorExtrinsic> extrinsics_;
+	std::atomic<uint64_t> identity_version_;
+	uint64_t matched_identity_version_;
+
+	// The recorder's queue has a single producer; record_mutex_ serializes the
+	// sensors' threads, and is only taken while a recording is running.
+	std::mutex record_mutex_;
+	PacketRecorder recorder_;
+
+	// Cook-thread accounting, summed over sensors.
+	struct DrainCounters
+	{
+		uint64_t dropped = 0;
+		uint64_t skipped = 0;
+	};
+
+	DrainPolicy drain_policy_;
+	DrainController drain_controller_;
+	DrainCounters drain_counters_[3];
+	std::atomic<uint64_t> points_unassigned_;
+	std::chrono::steady_clock::time_point rate_window_start_;
+
+	// Only touched by start()/stop() on the cook thread.
+	std::unique_ptr<PacketSource> source_;
 
 	mutable std::mutex state_mutex_;
 	bool running_;
-	bool connected_;
-	bool sdk_initialized_;
-	std::string config_path_;
+	std::atomic<bool> connected_;
 	std::string status_text_;
 	std::string info_text_;
-	std::string serial_number_;
-	std::string lidar_ip_;
-	uint32_t lidar_handle_;
 
-	std::atomic<uint64_t> total_points_;
+	Profiler profiler_;
 	LivoxLidarPointDataType requested_data_type_;
-	LivoxLidarPointDataType current_data_type_;
 };
@@ -1,17 +1,55 @@
 #include "LivoxMid360CHOP.h"
+#include "Benchmark.h"
 #include "Parameters.h"
+#include "PcapPacketSource.h"
+#include "PointDecoder.h"
+#include "ReplayPacketSource.h"
+#include "SdkPacketSource.h"
+#include "SyntheticPacketSource.h"
 
 #include <algorithm>
 #include <array>
-#include <cmath>
+#include <cstdlib>
 #include <cstring>
+#include <fstream>
+#include <sstream>
 #include <string>
-#include <vector>
 
 namespace
 {
-	constexpr int kNumOutputChannels = 4;
-	constexpr float kRadToDeg = 57.29577951308232f;
+	constexpr int kNumOutputChannels = 5;
+	// Appended after the point channels when IMU Channels is on.
+	constexpr int kNumImuChannels = 6;
+	constexpr int32_t kNumInfoChannels = 36;
+	constexpr int32_t kNumInfoRows = 13;
+	// Extrinsics table rows: lidar serial or IP, then a row-major 4x4 matrix.
+	constexpr int32_t kExtrinsicsColumns = 17;
+	constexpr double kNanosPerMilli = 1.0e6;
+	constexpr uint64_t kNanosPerMicro = 1000;
+	constexpr double kMicrosPerMilli = 1000.0;
+	constexpr double kP99 = 0.99;
+	// How often the config file's modification time is polled for extrinsics.
+	constexpr auto kConfigCheckInterval = std::chrono::seconds(1);
+
+	// Rows whose matrix cells are not all numbers (such as a header) are skipped.
+	bool
+	parseExtrinsicRow(const OP_DATInput* table, int32_t row, SensorExtrinsic& extrinsic)
+	{
+		double matrix[16] = {};
+		for (int32_t col = 1; col < kExtrinsicsColumns; ++col)
+		{
+			const char* cell = table->getCell(row, col);
+			char* end = nullptr;
+			matrix[col - 1] = std::strtod(cell, &end);
+			if (end == cell)
+			{
+				return false;
+			}
+		}
+		extrinsic.key = table->getCell(row, 0);
+		extrinsic.transform = PointTransform::fromMatrix(matrix);
+		return !extrinsic.key.empty();
+	}
 }
 
 extern "C"
@@ -50,14 +88,23 @@ DestroyCHOPInstance(CHOP_CPlusPlusBase* instance)
 
 LivoxMid360CHOP::LivoxMid360CHOP(const OP_NodeInfo* info)
 	: node_info_(info)
+	, record_compress_(true)
 	, execute_count_(0)
 	, last_requested_samples_(4096)
+	, planned_samples_(0)
 	, sample_fill_ratio_(0.0)
+	, imu_latency_ms_(0.0)
 	, status_message_("Idle")
-	, cached_config_path_()
-	, active_config_path_()
+	, cached_source_key_()
+	, active_source_key_()
 	, last_point_mode_(PointDataMenuItems::High)
+	, last_replay_position_(-1.0)
+	, last_storage_mode_(StorageMenuItems::Decoded)
+	, last_output_mode_(OutputModeMenuItems::Stream)
 	, buffer_limit_setting_(200000)
+	, extrinsics_table_id_(0)
+	, extrinsics_table_cooks_(-1)
+	, extrinsics_table_entries_(0)
 {
 }
 
@@ -76,8 +123,20 @@ LivoxMid360CHOP::getGeneralInfo(CHOP_GeneralInfo* ginfo, const OP_Inputs*, void*
 bool
 LivoxMid360CHOP::getOutputInfo(CHOP_OutputInfo* info, const OP_Inputs* inputs, void*)
 {
-	const int samples = std::max(1, Parameters::evalPointsPerFrame(inputs));
-	info->numChannels = kNumOutputChannels;
+	int samples = std::max(1, Parameters::evalPointsPerFrame(inputs));
+	if (device_.outputMode() == LivoxDevice::OutputMode::Frames)
+	{
+		// Size the output to the newest complete frame so it is not padded.
+		const size_t frame_points = device_.acquireFrame();
+		samples = static_cast<int>(std::max<size_t>(1, std::min(frame_points, static_cast<size_t>(samples))));
+	}
+	else if (Parameters::evalAdaptiveDrain(inputs) != 0)
+	{
+		// Points Per Cook becomes the upper bound of the adaptive drain.
+		planned_samples_ = device_.planDrain(Parameters::evalTargetLatency(inputs), static_cast<size_t>(samples));
+		samples = static_cast<int>(std::max<size_t>(1, planned_samples_));
+	}
+	info->numChannels = kNumOutputChannels + (Parameters::evalImuChannels(inputs) != 0 ? kNumImuChannels : 0);
 	info->numSamples = samples;
 	info->startIndex = 0;
 	return true;
@@ -86,15 +145,22 @@ LivoxMid360CHOP::getOutputInfo(CHOP_OutputInfo* info, const OP_Inputs* inputs, v
 void
 LivoxMid360CHOP::getChannelName(int32_t index, OP_String* name, const OP_Inputs* inputs, void*)
 {
+	if (index >= kNumOutputChannels)
+	{
+		static const std::array<const char*, kNumImuChannels> labels = { "gyro_x", "gyro_y", "gyro_z", "accel_x", "accel_y", "accel_z" };
+		name->setString(labels[static_cast<size_t>(index - kNumOutputChannels)]);
+		return;
+	}
+
 	const CoordMenuItems mode = Parameters::evalCoord(inputs);
 	if (mode == CoordMenuItems::Cartesian)
 	{
-		static const std::array<const char*, kNumOutputChannels> labels = { "x", "y", "z", "intensity" };
+		static const std::array<const char*, kNumOutputChannels> labels = { "x", "y", "z", "intensity", "sensor" };
 		name->setString(labels[static_cast<size_t>(index)]);
 	}
 	else
 	{
-		static const std::array<const char*, kNumOutputChannels> labels = { "distance", "theta", "phi", "intensity" };
+		static const std::array<const char*, kNumOutputChannels> labels = { "distance", "theta", "phi", "intensity", "sensor" };
 		name->setString(labels[static_cast<size_t>(index)]);
 	}
 }
@@ -102,12 +168,20 @@ LivoxMid360CHOP::getChannelName(int32_t index, OP_String* name, const OP_Inputs*
 int32_t
 LivoxMid360CHOP::getNumInfoCHOPChans(void*)
 {
-	return 3;
+	return kNumInfoChannels + static_cast<int32_t>(device_.profiler().channelCount());
 }
 
 void
 LivoxMid360CHOP::getInfoCHOPChan(int32_t index, OP_InfoCHOPChan* chan, void*)
 {
+	if (index >= kNumInfoChannels)
+	{
+		const size_t stage_index = static_cast<size_t>(index - kNumInfoChannels);
+		chan->name->setString(device_.profiler().channelName(stage_index));
+		chan->value = static_cast<float>(device_.profiler().channelValue(stage_index));
+		return;
+	}
+
 	switch (index)
 	{
 	case 0:
@@ -119,10 +193,128 @@ LivoxMid360CHOP::getInfoCHOPChan(int32_t index, OP_InfoCHOPChan* chan, void*)
 		chan->value = static_cast<float>(device_.bufferedSamples());
 		break;
 	case 2:
-	default:
 		chan->name->setString("fill_ratio");
 		chan->value = static_cast<float>(sample_fill_ratio_);
 		break;
+	case 3:
+		chan->name->setString("evicted_points");
+		chan->value = static_cast<float>(device_.evictedPoints());
+		break;
+	case 4:
+		chan->name->setString("skipped_points");
+		chan->value = static_cast<float>(device_.skippedPoints());
+		break;
+	case 5:
+		chan->name->setString("completed_frames");
+		chan->value = static_cast<float>(device_.completedFrames());
+		break;
+	case 6:
+		chan->name->setString("frame_points");
+		chan->value = static_cast<float>(device_.framePoints());
+		break;
+	case 7:
+		chan->name->setString("frame_overflow_points");
+		chan->value = static_cast<float>(device_.frameOverflowPoints());
+		break;
+	case 8:
+		chan->name->setString("drain_dropped_points");
+		chan->value = static_cast<float>(device_.drainDroppedPoints(device_.drainPolicy()));
+		break;
+	case 9:
+		chan->name->setString("drain_skipped_points");
+		chan->value = static_cast<float>(device_.drainSkippedPoints(device_.drainPolicy()));
+		break;
+	case 10:
+		chan->name->setString("arrival_rate");
+		chan->value = static_cast<float>(device_.drainController().arrivalRate());
+		break;
+	case 11:
+		chan->name->setString("buffer_age_ms");
+		chan->value = static_cast<float>(device_.drainController().bufferAge() * 1000.0);
+		break;
+	case 12:
+		chan->name->setString("target_points");
+		chan->value = static_cast<float>(device_.drainController().targetPoints());
+		break;
+	case 13:
+		chan->name->setString("planned_points");
+		chan->value = static_cast<float>(device_.drainController().plannedPoints());
+		break;
+	case 14:
+		chan->name->setString("latency_min_ms");
+		chan->value = static_cast<float>(cook_latency_.min() / kMicrosPerMilli);
+		break;
+	case 15:
+		chan->name->setString("latency_mean_ms");
+		chan->value = static_cast<float>(cook_latency_.mean() / kMicrosPerMilli);
+		break;
+	case 16:
+		chan->name->setString("latency_p99_ms");
+		chan->value = static_cast<float>(cook_latency_.percentile(kP99) / kMicrosPerMilli);
+		break;
+	case 17:
+		chan->name->setString("latency_max_ms");
+		chan->value = static_cast<float>(cook_latency_.max() / kMicrosPerMilli);
+		break;
+	case 18:
+		chan->name->setString("recording");
+		chan->value = device_.recorder().isRecording() ? 1.0f : 0.0f;
+		break;
+	case 19:
+		chan->name->setString("recorded_packets");
+		chan->value = static_cast<float>(device_.recorder().recordedPackets());
+		break;
+	case 20:
+		chan->name->setString("recording_dropped_packets");
+		chan->value = static_cast<float>(device_.recorder().droppedPackets());
+		break;
+	case 21:
+		chan->name->setString("replay_position_s");
+		chan->value = static_cast<float>(device_.playbackPosition());
+		break;
+	case 22:
+		chan->name->setString("replay_duration_s");
+		chan->value = static_cast<float>(device_.playbackDuration());
+		break;
+	case 23:
+		chan->name->setString("sensors");
+		chan->value = static_cast<float>(device_.sensorCount());
+		break;
+	case 24:
+		chan->name->setString("imu_samples");
+		chan->value = static_cast<float>(device_.imuSamples());
+		break;
+	case 25:
+		chan->name->setString("imu_latency_ms");
+		chan->value = static_cast<float>(imu_latency_ms_);
+		break;
+	case 26:
+		chan->name->setString("deskewed_frames");
+		chan->value = static_cast<float>(device_.deskewedFrames());
+		break;
+	case 27:
+		chan->name->setString("deskew_skipped_frames");
+		chan->value = static_cast<float>(device_.deskewSkippedFrames());
+		break;
+	case 28:
+		chan->name->setString("voxel_removed_points");
+		chan->value = static_cast<float>(device_.voxelRemovedPoints());
+		break;
+	case 29:
+		chan->name->setString("rejected_points");
+		chan->value = static_cast<float>(device_.rejectedPoints());
+		break;
+	default:
+	{
+		// Newest reading of the first sensor, whatever the point output holds.
+		static const std::array<const char*, kNumImuChannels> names = { "imu_gyro_x", "imu_gyro_y", "imu_gyro_z", "imu_accel_x", "imu_accel_y", "imu_accel_z" };
+		const size_t axis = static_cast<size_t>(std::min(index - 30, kNumImuChannels - 1));
+		ImuSample sample;
+		device_.latestImu(0, sample);
+		chan->name->setString(names[axis]);
+		chan->value = axis < 3 ? sample.gyro[axis] : sample.accel[axis - 3];
+		break;
+	}
 	}
 }
 
@@ -130,7 +322,7 @@ bool
 LivoxMid360CHOP::getInfoDATSize(OP_InfoDATSize* infoSize, void*)
 {
 	infoSize->cols = 2;
-	infoSize->rows = 7;
+	infoSize->rows = kNumInfoRows + static_cast<int32_t>(device_.sensorCount());
 	infoSize->byColumn = false;
 	return true;
 }
@@ -144,13 +336,38 @@ LivoxMid360CHOP::getInfoDATEntries(int32_t index, int32_t, OP_InfoDATEntries* en
 		entries->values[1]->setString(value.c_str());
 	};
 
+	if (index >= kNumInfoRows)
+	{
+		const size_t sensor_index = static_cast<size_t>(index - kNumInfoRows);
+		const LivoxDevice::SensorInfo sensor = device_.sensorInfo(sensor_index);
+		std::ostringstream value;
+		value << (sensor.serial.empty() ? "handle " + std::to_string(sensor.handle) : sensor.serial);
+		if (!sensor.ip.empty())
+		{
+			value << " (" << sensor.ip << ")";
+		}
+		value << ": " << static_cast<uint64_t>(sensor.points_per_second) << " pts/s, "
+			<< sensor.evicted << " evicted, " << sensor.skipped << " skipped";
+		if (sensor.imu_samples > 0)
+		{
+			value << ", " << sensor.imu_samples << " IMU samples";
+		}
+		if (sensor.transformed)
+		{
+			value << ", extrinsic applied";
+		}
+		const std::string label = "Sensor " + std::to_string(sensor_index);
+		setEntry(label.c_str(), value.str());
+		return;
+	}
+
 	switch (index)
 	{
 	case 0:
 		setEntry("Status", status_message_);
 		break;
 	case 1:
-		setEntry("Config Path", cached_config_path_);
+		setEntry("Source", cached_source_key_);
 		break;
 	case 2:
 		setEntry("Serial", device_.lidarSerial());
@@ -165,18 +382,60 @@ LivoxMid360CHOP::getInfoDATEntries(int32_t index, int32_t, OP_InfoDATEntries* en
 		setEntry("Total samples", std::to_string(device_.totalPoints()));
 		break;
 	case 6:
-	default:
+		setEntry("Evicted samples", std::to_string(device_.evictedPoints()));
+		break;
+	case 7:
+		setEntry("Decode kernel", PointDecoder::kernelName(PointDecoder::activeKernel()));
+		break;
+	case 8:
+		setEntry("Latency dump", latency_dump_status_);
+		break;
+	case 9:
+		setEntry("Benchmark", benchmark_status_);
+		break;
+	case 10:
+		setEntry("Recording", device_.recorder().statusText());
+		break;
+	case 11:
 		setEntry("Info message", device_.infoMessage());
 		break;
+	case 12:
+	default:
+	{
+		std::ostringstream value;
+		if (!extrinsics_config_error_.empty())
+		{
+			value << extrinsics_config_error_ << "; ";
+		}
+		value << config_extrinsics_.size() << " from config, " << extrinsics_table_entries_ << " from table";
+		setEntry("Extrinsics", value.str());
+		break;
+	}
 	}
 }
 
 void
 LivoxMid360CHOP::execute(CHOP_Output* output, const OP_Inputs* inputs, void*)
 {
+	LIVOX_PROFILE_SCOPE(device_.profiler(), Profiler::Stage::Execute);
 	execute_count_++;
 	last_requested_samples_ = static_cast<size_t>(std::max(1, Parameters::evalPointsPerFrame(inputs)));
 
+	updateStorage(Parameters::evalStorage(inputs));
+	updateDrainPolicy(Parameters::evalDrainPolicy(inputs));
+	updateOutputMode(Parameters::evalOutputMode(inputs), Parameters::evalFrameDuration(inputs));
+	device_.setMotionDeskew(Parameters::evalDeskew(inputs) != 0);
+	const double voxel_size = Parameters::evalVoxelSize(inputs);
+	device_.setVoxelSize(static_cast<float>(voxel_size));
+	device_.setVoxelWindow(static_cast<uint64_t>(std::max(Parameters::evalVoxelWindow(inputs), 0.0) * kNanosPerMilli));
+	// Stream mode with Raw Packets storage keeps packets undecoded, so there
+	// is nothing to downsample; the window only matters in Stream mode.
+	const bool stream = Parameters::evalOutputMode(inputs) == OutputModeMenuItems::Stream;
+	const bool voxels = !stream || Parameters::evalStorage(inputs) != StorageMenuItems::Raw;
+	inputs->enablePar(VoxelSizeName, voxels);
+	inputs->enablePar(VoxelWindowName, stream && voxels && voxel_size > 0.0);
+	updateSpatialFilter(inputs);
+
 	const size_t desired_buffer = static_cast<size_t>(std::max(Parameters::evalBufferLimit(inputs), static_cast<int>(last_requested_samples_)));
 	if (desired_buffer != buffer_limit_setting_)
 	{
@@ -185,12 +444,34 @@ LivoxMid360CHOP::execute(CHOP_Output* output, const OP_Inputs* inputs, void*)
 	}
 
 	ensureState(inputs);
+	updateExtrinsics(inputs);
 	updateDataType(Parameters::evalPointData(inputs));
+	if (Parameters::evalSource(inputs) == SourceMenuItems::Replay && device_.isRunning())
+	{
+		updateReplayPosition(Parameters::evalReplayPosition(inputs));
+	}
+	latency_file_ = inputs->getParString(LatencyFileName);
+	record_file_ = inputs->getParString(RecordFileName);
+	record_compress_ = Parameters::evalRecordCompress(inputs) != 0;
+	benchmark_file_ = inputs->getParString(BenchmarkFileName);
+
+	size_t requested_samples = last_requested_samples_;
+	if (device_.outputMode() == LivoxDevice::OutputMode::Stream && Parameters::evalAdaptiveDrain(inputs) != 0)
+	{
+		requested_samples = planned_samples_;
+	}
+
+	device_.updateImu();
+	updateImuLatency();
 
 	const CoordMenuItems coord = Parameters::evalCoord(inputs);
-	fillChannels(output, coord, last_requested_samples_);
+	const bool imu_channels = Parameters::evalImuChannels(inputs) != 0 && output->numChannels >= kNumOutputChannels + kNumImuChannels;
+	fillChannels(output, coord, requested_samples, imu_channels);
 
 	status_message_ = device_.statusText();
+	const Profiler::Clock::time_point now = Profiler::Clock::now();
+	device_.profiler().update(now);
+	device_.updateSensorRates(now);
 }
 
 void
@@ -206,38 +487,112 @@ LivoxMid360CHOP::pulsePressed(const char* name, void*)
 	{
 		device_.clear();
 	}
+	else if (strcmp(name, DumpLatencyName) == 0)
+	{
+		dumpLatency();
+	}
+	else if (strcmp(name, StartRecordingName) == 0)
+	{
+		device_.startRecording(record_file_, record_compress_);
+	}
+	else if (strcmp(name, StopRecordingName) == 0)
+	{
+		device_.stopRecording();
+	}
+	else if (strcmp(name, RunBenchmarkName) == 0)
+	{
+		runBenchmark();
+	}
 }
 
 void
 LivoxMid360CHOP::ensureState(const OP_Inputs* inputs)
 {
 	const bool should_run = Parameters::evalActive(inputs) != 0;
-	const std::string config_path = inputs->getParString(ConfigPathName);
-	cached_config_path_ = config_path;
+	const std::string source_key = sourceKey(inputs);
+	cached_source_key_ = source_key;
 
 	if (!should_run && device_.isRunning())
 	{
 		device_.stop();
-		active_config_path_.clear();
+		active_source_key_.clear();
 	}
 	else if (should_run)
 	{
-		const bool needs_restart = (!device_.isRunning()) || (config_path != active_config_path_);
+		const bool needs_restart = (!device_.isRunning()) || (source_key != active_source_key_);
 		if (needs_restart)
 		{
 			if (device_.isRunning())
 			{
 				device_.stop();
 			}
-			if (device_.start(config_path))
+			if (device_.start(createSource(inputs)))
 			{
-				active_config_path_ = config_path;
+				active_source_key_ = source_key;
+				last_replay_position_ = -1.0;
 			}
 		}
 	}
 
 }
 
+std::string
+LivoxMid360CHOP::sourceKey(const OP_Inputs* inputs)
+{
+	std::ostringstream oss;
+	switch (Parameters::evalSource(inputs))
+	{
+	case SourceMenuItems::Synthetic:
+		oss << "Synthetic " << Parameters::evalSyntheticRate(inputs) << "x";
+		break;
+	case SourceMenuItems::Replay:
+		oss << "Replay " << inputs->getParString(ReplayFileName) << " " << Parameters::evalReplaySpeed(inputs) << "x" << (Parameters::evalReplayLoop(inputs) != 0 ? " loop" : "");
+		break;
+	case SourceMenuItems::Pcap:
+		oss << "Pcap " << inputs->getParString(PcapFileName) << " port " << Parameters::evalPcapPort(inputs) << " " << Parameters::evalReplaySpeed(inputs) << "x" << (Parameters::evalReplayLoop(inputs) != 0 ? " loop" : "");
+		break;
+	case SourceMenuItems::Sensor:
+	default:
+		oss << "Sensor " << inputs->getParString(ConfigPathName);
+		break;
+	}
+	return oss.str();
+}
+
+std::unique_ptr<PacketSource>
+LivoxMid360CHOP::createSource(const OP_Inputs* inputs)
+{
+	switch (Parameters::evalSource(inputs))
+	{
+	case SourceMenuItems::Synthetic:
+	{
+		SyntheticPacketSource::Config config;
+		config.rate_scale = Parameters::evalSyntheticRate(inputs);
+		return std::make_unique<SyntheticPacketSource>(config);
+	}
+	case SourceMenuItems::Replay:
+	{
+		ReplayPacketSource::Config config;
+		config.path = inputs->getParString(ReplayFileName);
+		config.speed = Parameters::evalReplaySpeed(inputs);
+		config.loop = Parameters::evalReplayLoop(inputs) != 0;
+		return std::make_unique<ReplayPacketSource>(config);
+	}
+	case SourceMenuItems::Pcap:
+	{
+		PcapPacketSource::Config config;
+		config.path = inputs->getParString(PcapFileName);
+		config.port = static_cast<uint16_t>(Parameters::evalPcapPort(inputs));
+		config.speed = Parameters::evalReplaySpeed(inputs);
+		config.loop = Parameters::evalReplayLoop(inputs) != 0;
+		return std::make_unique<PcapPacketSource>(config);
+	}
+	case SourceMenuItems::Sensor:
+	default:
+		return std::make_unique<SdkPacketSource>(inputs->getParString(ConfigPathName));
+	}
+}
+
 void
 LivoxMid360CHOP::updateDataType(PointDataMenuItems data_mode)
 {
@@ -257,55 +612,333 @@ LivoxMid360CHOP::updateDataType(PointDataMenuItems data_mode)
 	}
 }
 
-size_t
-LivoxMid360CHOP::fillChannels(CHOP_Output* output, CoordMenuItems coord_mode, size_t requested_samples)
+void
+LivoxMid360CHOP::updateReplayPosition(double seconds)
 {
-	const size_t safe_samples = std::min(requested_samples, static_cast<size_t>(output->numSamples));
-	std::vector<LivoxDevice::PointSample> samples(safe_samples);
-	const size_t populated = device_.consume(samples.data(), safe_samples);
+	if (seconds == last_replay_position_)
+	{
+		return;
+	}
 
-	for (size_t s = 0; s < safe_samples; ++s)
+	// A fresh source starts at the beginning, so only a non-zero position
+	// needs a seek.
+	const bool restarted = last_replay_position_ < 0.0;
+	last_replay_position_ = seconds;
+	if (!restarted || seconds > 0.0)
 	{
-		float c0 = 0.0f;
-		float c1 = 0.0f;
-		float c2 = 0.0f;
-		float c3 = 0.0f;
+		device_.seek(seconds);
+	}
+}
 
-		if (s < populated)
+void
+LivoxMid360CHOP::updateExtrinsics(const OP_Inputs* inputs)
+{
+	// The config JSON is re-read only when its path or modification time
+	// changes, and the time is polled at most once a second; a missing file
+	// simply contributes nothing.
+	bool changed = false;
+	const std::string config_path = inputs->getParString(ConfigPathName);
+	const std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+	if (config_path != extrinsics_config_path_ || now - extrinsics_config_checked_ >= kConfigCheckInterval)
+	{
+		extrinsics_config_checked_ = now;
+		std::error_code ec;
+		const std::filesystem::file_time_type modified = std::filesystem::last_write_time(config_path, ec);
+		if (config_path != extrinsics_config_path_ || modified != extrinsics_config_time_)
 		{
-			const auto& sample = samples[s];
-			if (coord_mode == CoordMenuItems::Cartesian)
+			extrinsics_config_path_ = config_path;
+			extrinsics_config_time_ = modified;
+			config_extrinsics_.clear();
+			extrinsics_config_error_.clear();
+			if (!ec)
 			{
-				c0 = sample.x;
-				c1 = sample.y;
-				c2 = sample.z;
-				c3 = sample.intensity;
+				SensorExtrinsics::loadConfig(config_path, config_extrinsics_, extrinsics_config_error_);
 			}
-			else
+			changed = true;
+		}
+	}
+
+	// The table is parsed again only when it is a different DAT or has cooked.
+	const OP_DATInput* table = inputs->getParDAT(ExtrinsicsName);
+	const uint32_t table_id = table != nullptr ? table->opId : 0;
+	const int64_t table_cooks = table != nullptr ? table->totalCooks : -1;
+	if (table_id != extrinsics_table_id_ || table_cooks != extrinsics_table_cooks_)
+	{
+		extrinsics_table_id_ = table_id;
+		extrinsics_table_cooks_ = table_cooks;
+		changed = true;
+	}
+
+	if (changed)
+	{
+		// Table rows come after the config entries so they override them.
+		extrinsics_ = config_extrinsics_;
+		extrinsics_table_entries_ = 0;
+		if (table != nullptr && table->isTable && table->numCols >= kExtrinsicsColumns)
+		{
+			for (int32_t row = 0; row < table->numRows; ++row)
 			{
-				const float horizontal = std::sqrt(sample.x * sample.x + sample.y * sample.y);
-				const float distance = std::sqrt(horizontal * horizontal + sample.z * sample.z);
-				const float theta = std::atan2(sample.y, sample.x) * kRadToDeg;
-				const float phi = std::atan2(sample.z, horizontal) * kRadToDeg;
-				c0 = distance;
-				c1 = theta;
-				c2 = phi;
-				c3 = sample.intensity;
+				SensorExtrinsic extrinsic;
+				if (parseExtrinsicRow(table, row, extrinsic))
+				{
+					extrinsics_.push_back(std::move(extrinsic));
+					++extrinsics_table_entries_;
+				}
 			}
 		}
+	}
+	// Called every cook regardless: lidars that identify themselves later
+	// are matched here, and an unchanged list costs a comparison.
+	device_.setExtrinsics(extrinsics_);
+}
 
-		for (int ch = 0; ch < kNumOutputChannels; ++ch)
-		{
-			float value = 0.0f;
-			if (ch == 0) value = c0;
-			else if (ch == 1) value = c1;
-			else if (ch == 2) value = c2;
-			else value = c3;
+void
+LivoxMid360CHOP::updateSpatialFilter(const OP_Inputs* inputs)
+{
+	SpatialFilter::Settings settings;
+	settings.crop = Parameters::evalCrop(inputs) != 0;
+	for (int axis = 0; axis < 3; ++axis)
+	{
+		settings.crop_min[axis] = static_cast<float>(Parameters::evalCropMin(inputs, axis));
+		settings.crop_max[axis] = static_cast<float>(Parameters::evalCropMax(inputs, axis));
+	}
+	settings.range = Parameters::evalRangeGate(inputs) != 0;
+	settings.min_range = static_cast<float>(Parameters::evalRange(inputs, 0));
+	settings.max_range = static_cast<float>(Parameters::evalRange(inputs, 1));
+	settings.sector = Parameters::evalSector(inputs) != 0;
+	for (int i = 0; i < 2; ++i)
+	{
+		settings.azimuth[i] = static_cast<float>(Parameters::evalAzimuth(inputs, i));
+		settings.elevation[i] = static_cast<float>(Parameters::evalElevation(inputs, i));
+	}
+	device_.setSpatialFilter(settings);
+}
+
+void
+LivoxMid360CHOP::updateStorage(StorageMenuItems storage_mode)
+{
+	if (storage_mode == last_storage_mode_)
+	{
+		return;
+	}
 
-			output->channels[ch][s] = value;
+	last_storage_mode_ = storage_mode;
+	if (storage_mode == StorageMenuItems::Raw)
+	{
+		device_.setBufferStorage(LivoxDevice::BufferStorage::RawPackets);
+	}
+	else
+	{
+		device_.setBufferStorage(LivoxDevice::BufferStorage::Decoded);
+	}
+}
+
+void
+LivoxMid360CHOP::updateDrainPolicy(DrainPolicyMenuItems drain_policy)
+{
+	switch (drain_policy)
+	{
+	case DrainPolicyMenuItems::Newest:
+		device_.setDrainPolicy(LivoxDevice::DrainPolicy::NewestDropBacklog);
+		break;
+	case DrainPolicyMenuItems::Decimate:
+		device_.setDrainPolicy(LivoxDevice::DrainPolicy::NewestDecimate);
+		break;
+	case DrainPolicyMenuItems::Oldest:
+	default:
+		device_.setDrainPolicy(LivoxDevice::DrainPolicy::OldestFirst);
+		break;
+	}
+}
+
+void
+LivoxMid360CHOP::updateOutputMode(OutputModeMenuItems output_mode, double frame_duration_ms)
+{
+	device_.setFrameDuration(static_cast<uint64_t>(std::max(frame_duration_ms, 1.0) * kNanosPerMilli));
+	if (output_mode == last_output_mode_)
+	{
+		return;
+	}
+
+	last_output_mode_ = output_mode;
+	if (output_mode == OutputModeMenuItems::Frames)
+	{
+		device_.setOutputMode(LivoxDevice::OutputMode::Frames);
+	}
+	else
+	{
+		device_.setOutputMode(LivoxDevice::OutputMode::Stream);
+	}
+}
+
+size_t
+LivoxMid360CHOP::drainPoints(const PointColumns& destination, size_t max_points)
+{
+	// Frames mode re-reads the frame acquired in getOutputInfo(); nothing is
+	// removed, so the same frame is output until a newer one completes.
+	if (device_.outputMode() == LivoxDevice::OutputMode::Frames)
+	{
+		return device_.copyFrame(destination, max_points);
+	}
+	return device_.consume(destination, max_points);
+}
+
+size_t
+LivoxMid360CHOP::fillChannels(CHOP_Output* output, CoordMenuItems coord_mode, size_t requested_samples, bool imu_channels)
+{
+	LIVOX_PROFILE_SCOPE(device_.profiler(), Profiler::Stage::Fill);
+	const size_t safe_samples = std::min(requested_samples, static_cast<size_t>(output->numSamples));
+	size_t populated = 0;
+
+	if (coord_mode == CoordMenuItems::Cartesian)
+	{
+		PointColumns destination;
+		destination.x = output->channels[0];
+		destination.y = output->channels[1];
+		destination.z = output->channels[2];
+		destination.intensity = output->channels[3];
+		destination.sensor = output->channels[4];
+		if (received_scratch_.size() < safe_samples)
+		{
+			received_scratch_.resize(safe_samples);
+		}
+		destination.received = received_scratch_.data();
+		if (imu_channels)
+		{
+			if (timestamp_scratch_.size() < safe_samples)
+			{
+				timestamp_scratch_.resize(safe_samples);
+			}
+			destination.timestamp = timestamp_scratch_.data();
+		}
+		populated = drainPoints(destination, safe_samples);
+		recordLatency(destination.received, populated);
+		if (imu_channels)
+		{
+			sampleImu(output, destination, populated);
 		}
 	}
+	else
+	{
+		if (spherical_scratch_.size() < safe_samples)
+		{
+			spherical_scratch_.resize(safe_samples);
+		}
+		const PointColumns scratch = spherical_scratch_.columns();
+
+		PointColumns destination;
+		destination.x = scratch.x;
+		destination.y = scratch.y;
+		destination.z = scratch.z;
+		destination.intensity = output->channels[3];
+		destination.sensor = output->channels[4];
+		destination.received = scratch.received;
+		destination.timestamp = imu_channels ? scratch.timestamp : nullptr;
+		populated = drainPoints(destination, safe_samples);
+		recordLatency(scratch.received, populated);
+		if (imu_channels)
+		{
+			sampleImu(output, destination, populated);
+		}
+
+		PointDecoder::toSpherical(scratch, populated, output->channels[0], output->channels[1], output->channels[2]);
+	}
+
+	for (int ch = 0; ch < output->numChannels; ++ch)
+	{
+		std::fill(output->channels[ch] + populated, output->channels[ch] + output->numSamples, 0.0f);
+	}
 
 	sample_fill_ratio_ = safe_samples == 0 ? 0.0 : static_cast<double>(populated) / static_cast<double>(safe_samples);
 	return populated;
 }
+
+void
+LivoxMid360CHOP::sampleImu(CHOP_Output* output, const PointColumns& points, size_t count)
+{
+	ImuColumns destination;
+	for (int axis = 0; axis < 3; ++axis)
+	{
+		destination.gyro[axis] = output->channels[kNumOutputChannels + axis];
+		destination.accel[axis] = output->channels[kNumOutputChannels + 3 + axis];
+	}
+	device_.sampleImu(points, count, destination);
+}
+
+void
+LivoxMid360CHOP::updateImuLatency()
+{
+	// Host receive time of the newest sample to this cook, for the first sensor.
+	ImuSample sample;
+	if (!device_.latestImu(0, sample))
+	{
+		imu_latency_ms_ = 0.0;
+		return;
+	}
+	const uint64_t now = PacketStamp::hostNow();
+	imu_latency_ms_ = now > sample.received ? static_cast<double>(now - sample.received) / kNanosPerMilli : 0.0;
+}
+
+void
+LivoxMid360CHOP::recordLatency(const uint64_t* received, size_t count)
+{
+	// Points of one packet share a receive time, so record runs rather than
+	// individual points.
+	cook_latency_.reset();
+	const uint64_t now = PacketStamp::hostNow();
+	for (size_t i = 0; i < count;)
+	{
+		size_t run = 1;
+		while (i + run < count && received[i + run] == received[i])
+		{
+			++run;
+		}
+		const uint64_t age = now > received[i] ? (now - received[i]) / kNanosPerMicro : 0;
+		cook_latency_.record(age, run);
+		i += run;
+	}
+	total_latency_.merge(cook_latency_);
+}
+
+void
+LivoxMid360CHOP::dumpLatency()
+{
+	std::ofstream file(latency_file_);
+	if (!file)
+	{
+		latency_dump_status_ = "Could not open " + latency_file_;
+		return;
+	}
+
+	// Values are receive-to-output ages in microseconds since the last dump.
+	total_latency_.write(file);
+	latency_dump_status_ = "Wrote " + std::to_string(total_latency_.count()) + " samples to " + latency_file_;
+	total_latency_.reset();
+}
+
+void
+LivoxMid360CHOP::runBenchmark()
+{
+	std::ofstream file(benchmark_file_);
+	if (!file)
+	{
+		benchmark_status_ = "Could not open " + benchmark_file_;
+		return;
+	}
+
+	// Runs on the cook thread with its own devices; the live stream keeps
+	// buffering meanwhile and is drained on the next cook.
+	const std::vector<Benchmark::Result> results = Benchmark::run();
+	Benchmark::write(file, results);
+	benchmark_status_ = "Wrote " + std::to_string(results.size()) + " results to " + benchmark_file_;
+
+	uint64_t mismatches = 0;
+	for (const Benchmark::Result& result : results)
+	{
+		mismatches += result.mismatches;
+	}
+	if (mismatches > 0)
+	{
+		benchmark_status_ += "; " + std::to_string(mismatches) + " points decoded differently by the " + PointDecoder::kernelName(PointDecoder::activeKernel()) + " and scalar kernels";
+	}
+}
@@ -1,10 +1,17 @@
 #pragma once
 
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
 #include <string>
+#include <vector>
 
 #include "CHOP_CPlusPlusBase.h"
 #include "Parameters.h"
+#include "LatencyHistogram.h"
 #include "LivoxDevice.h"
+#include "SensorExtrinsics.h"
 
 class LivoxMid360CHOP : public CHOP_CPlusPlusBase
 {
@@ -28,17 +35,56 @@ public:
 
 private:
 	void ensureState(const OP_Inputs* inputs);
+	static std::string sourceKey(const OP_Inputs* inputs);
+	static std::unique_ptr<PacketSource> createSource(const OP_Inputs* inputs);
 	void updateDataType(PointDataMenuItems data_mode);
-	size_t fillChannels(CHOP_Output* output, CoordMenuItems coord_mode, size_t requested_samples);
+	void updateReplayPosition(double seconds);
+	void updateExtrinsics(const OP_Inputs* inputs);
+	void updateSpatialFilter(const OP_Inputs* inputs);
+	void updateStorage(StorageMenuItems storage_mode);
+	void updateDrainPolicy(DrainPolicyMenuItems drain_policy);
+	void updateOutputMode(OutputModeMenuItems output_mode, double frame_duration_ms);
+	size_t drainPoints(const PointColumns& destination, size_t max_points);
+	size_t fillChannels(CHOP_Output* output, CoordMenuItems coord_mode, size_t requested_samples, bool imu_channels);
+	void sampleImu(CHOP_Output* output, const PointColumns& points, size_t count);
+	void updateImuLatency();
+	void recordLatency(const uint64_t* received, size_t count);
+	void dumpLatency();
+	void runBenchmark();
 
 	const OP_NodeInfo* node_info_;
 	LivoxDevice device_;
+	PointBlock spherical_scratch_;
+	std::vector<uint64_t> received_scratch_;
+	std::vector<uint64_t> timestamp_scratch_;
+	LatencyHistogram cook_latency_;
+	LatencyHistogram total_latency_;
+	std::string latency_file_;
+	std::string latency_dump_status_;
+	std::string record_file_;
+	bool record_compress_;
+	std::string benchmark_file_;
+	std::string benchmark_status_;
 	int32_t execute_count_;
 	size_t last_requested_samples_;
+	size_t planned_samples_;
 	double sample_fill_ratio_;
+	double imu_latency_ms_;
 	std::string status_message_;
-	std::string cached_config_path_;
-	std::string active_config_path_;
+	std::string cached_source_key_;
+	std::string active_source_key_;
 	PointDataMenuItems last_point_mode_;
+	double last_replay_position_;
+	StorageMenuItems last_storage_mode_;
+	OutputModeMenuItems last_output_mode_;
 	size_t buffer_limit_setting_;
+	std::string extrinsics_config_path_;
+	std::filesystem::file_time_type extrinsics_config_time_;
+	std::chrono::steady_clock::time_point extrinsics_config_checked_;
+	uint32_t extrinsics_table_id_;
+	int64_t extrinsics_table_cooks_;
+	std::vector<SensorExtrinsic> config_extrinsics_;
+	std::vector<SensorExtrinsic> extrinsics_;
+	std::string extrinsics_config_error_;
+	size_t extrinsics_table_entries_;
 };
@@ -0,0 +1,261 @@
+#include "MappedFile.h"
+
+#if defined(_WIN32)
+	#ifndef NOMINMAX
+		#define NOMINMAX
+	#endif
+	#ifndef WIN32_LEAN_AND_MEAN
+		#define WIN32_LEAN_AND_MEAN
+	#endif
+	#include <windows.h>
+#else
+	#include <cerrno>
+	#include <cstring>
+	#include <fcntl.h>
+	#include <sys/mman.h>
+	#include <sys/stat.h>
+	#include <unistd.h>
+#endif
+
+MappedFile::MappedFile()
+#if defined(_WIN32)
+	: file_(INVALID_HANDLE_VALUE)
+	, mapping_(nullptr)
+#else
+	: file_(-1)
+#endif
+	, data_(nullptr)
+	, size_(0)
+	, writable_(false)
+{
+}
+
+MappedFile::~MappedFile()
+{
+	close(size_);
+}
+
+bool
+MappedFile::openRead(const std::string& path)
+{
+	close();
+	path_ = path;
+	writable_ = false;
+#if defined(_WIN32)
+	file_ = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (file_ == INVALID_HANDLE_VALUE)
+	{
+		return fail("Could not open");
+	}
+	LARGE_INTEGER size{};
+	if (!GetFileSizeEx(file_, &size))
+	{
+		fail("Could not size");
+		close();
+		return false;
+	}
+	const size_t length = static_cast<size_t>(size.QuadPart);
+#else
+	file_ = ::open(path.c_str(), O_RDONLY);
+	if (file_ < 0)
+	{
+		return fail("Could not open");
+	}
+	struct stat info{};
+	if (::fstat(file_, &info) != 0)
+	{
+		fail("Could not size");
+		close();
+		return false;
+	}
+	const size_t length = static_cast<size_t>(info.st_size);
+#endif
+	if (!map(length))
+	{
+		close();
+		return false;
+	}
+	return true;
+}
+
+bool
+MappedFile::create(const std::string& path, size_t size)
+{
+	close();
+	path_ = path;
+	writable_ = true;
+#if defined(_WIN32)
+	file_ = CreateFileA(path.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (file_ == INVALID_HANDLE_VALUE)
+	{
+		return fail("Could not create");
+	}
+#else
+	file_ = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+	if (file_ < 0)
+	{
+		return fail("Could not create");
+	}
+#endif
+	if (!map(size))
+	{
+		close();
+		return false;
+	}
+	return true;
+}
+
+bool
+MappedFile::resize(size_t size)
+{
+	if (!writable_ || !isOpen())
+	{
+		return false;
+	}
+	unmap();
+	return map(size);
+}
+
+void
+MappedFile::close(size_t length)
+{
+	unmap();
+#if defined(_WIN32)
+	if (file_ != INVALID_HANDLE_VALUE)
+	{
+		if (writable_)
+		{
+			LARGE_INTEGER end{};
+			end.QuadPart = static_cast<LONGLONG>(length);
+			SetFilePointerEx(file_, end, nullptr, FILE_BEGIN);
+			SetEndOfFile(file_);
+		}
+		CloseHandle(file_);
+		file_ = INVALID_HANDLE_VALUE;
+	}
+#else
+	if (file_ >= 0)
+	{
+		if (writable_ && ::ftruncate(file_, static_cast<off_t>(length)) != 0)
+		{
+			error_ = "Could not trim " + path_;
+		}
+		::close(file_);
+		file_ = -1;
+	}
+#endif
+	size_ = 0;
+}
+
+bool
+MappedFile::isOpen() const
+{
+#if defined(_WIN32)
+	return file_ != INVALID_HANDLE_VALUE;
+#else
+	return file_ >= 0;
+#endif
+}
+
+bool
+MappedFile::writable() const
+{
+	return writable_;
+}
+
+uint8_t*
+MappedFile::data()
+{
+	return data_;
+}
+
+const uint8_t*
+MappedFile::data() const
+{
+	return data_;
+}
+
+size_t
+MappedFile::size() const
+{
+	return size_;
+}
+
+const std::string&
+MappedFile::error() const
+{
+	return error_;
+}
+
+bool
+MappedFile::map(size_t size)
+{
+	size_ = size;
+	if (size == 0)
+	{
+		// Nothing to map; an empty file is still a valid open file.
+		return true;
+	}
+
+#if defined(_WIN32)
+	// Creating a writable mapping larger than the file extends the file.
+	const uint64_t wide = static_cast<uint64_t>(size);
+	mapping_ = CreateFileMappingA(file_, nullptr, writable_ ? PAGE_READWRITE : PAGE_READONLY, static_cast<DWORD>(wide >> 32), static_cast<DWORD>(wide & 0xFFFFFFFFu), nullptr);
+	if (mapping_ == nullptr)
+	{
+		return fail("Could not map");
+	}
+	data_ = static_cast<uint8_t*>(MapViewOfFile(mapping_, writable_ ? FILE_MAP_WRITE : FILE_MAP_READ, 0, 0, size));
+	if (data_ == nullptr)
+	{
+		return fail("Could not map");
+	}
+#else
+	if (writable_ && ::ftruncate(file_, static_cast<off_t>(size)) != 0)
+	{
+		return fail("Could not extend");
+	}
+	void* mapped = ::mmap(nullptr, size, writable_ ? PROT_READ | PROT_WRITE : PROT_READ, MAP_SHARED, file_, 0);
+	if (mapped == MAP_FAILED)
+	{
+		return fail("Could not map");
+	}
+	data_ = static_cast<uint8_t*>(mapped);
+	if (!writable_)
+	{
+		::madvise(mapped, size, MADV_SEQUENTIAL);
+	}
+#endif
+	return true;
+}
+
+void
+MappedFile::unmap()
+{
+#if defined(_WIN32)
+	if (data_ != nullptr)
+	{
+		UnmapViewOfFile(data_);
+	}
+	if (mapping_ != nullptr)
+	{
+		CloseHandle(mapping_);
+		mapping_ = nullptr;
+	}
+#else
+	if (data_ != nullptr)
+	{
+		::munmap(data_, size_);
+	}
+#endif
+	data_ = nullptr;
+}
+
+bool
+MappedFile::fail(const std::string& what)
+{
+	unmap();
+	size_ = 0;
+	error_ = what + " " + path_;
+	return false;
+}
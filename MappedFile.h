@@ -0,0 +1,56 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Memory-mapped file. Read mode maps an existing file read-only; write mode
+// creates (truncating) a file, maps it writable and can grow it, then trims it
+// to the bytes actually written on close. Uses file mappings on Windows and
+// mmap elsewhere.
+class MappedFile
+{
+public:
+	MappedFile();
+	~MappedFile();
+
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	bool openRead(const std::string& path);
+	bool create(const std::string& path, size_t size);
+
+	// Write mode: remaps at the new size. data() may move. On failure nothing
+	// is mapped and the file stays open so the caller can close() it at the
+	// length it managed to write.
+	bool resize(size_t size);
+
+	// Unmaps and closes. In write mode the file is cut to length bytes.
+	void close(size_t length = 0);
+
+	bool isOpen() const;
+	bool writable() const;
+	uint8_t* data();
+	const uint8_t* data() const;
+	size_t size() const;
+
+	// Reason for the last failed open, create or resize.
+	const std::string& error() const;
+
+private:
+	bool map(size_t size);
+	void unmap();
+	bool fail(const std::string& what);
+
+#if defined(_WIN32)
+	void* file_;
+	void* mapping_;
+#else
+	int file_;
+#endif
+	uint8_t* data_;
+	size_t size_;
+	bool writable_;
+	std::string path_;
+	std::string error_;
+};
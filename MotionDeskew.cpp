@@ -0,0 +1,363 @@
+#include "MotionDeskew.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstring>
+
+#if defined(_M_X64) || defined(__x86_64__)
+	#define LIVOX_HAS_X86_SIMD 1
+	#include <immintrin.h>
+	#if defined(_MSC_VER)
+		#define LIVOX_TARGET_AVX2
+	#else
+		#define LIVOX_TARGET_AVX2 __attribute__((target("avx2")))
+	#endif
+#endif
+
+namespace
+{
+	constexpr double kSecondsPerNano = 1.0e-9;
+
+	// IMU samples kept for integration; at 200 Hz several frames' worth.
+	constexpr size_t kHistorySamples = 1024;
+
+	// A frame is corrected only if the IMU reaches within this of both of its
+	// ends; the gap is bridged by holding the nearest rate.
+	constexpr uint64_t kMaxImuGapNs = 20000000;
+
+	using Matrix3 = double[9];
+
+	void
+	multiply(const Matrix3 a, const Matrix3 b, Matrix3 out)
+	{
+		for (int row = 0; row < 3; ++row)
+		{
+			for (int col = 0; col < 3; ++col)
+			{
+				out[row * 3 + col] = a[row * 3] * b[col] + a[row * 3 + 1] * b[3 + col] + a[row * 3 + 2] * b[6 + col];
+			}
+		}
+	}
+
+	// Rotation matrix of the rotation vector v (Rodrigues' formula).
+	void
+	exponential(const double v[3], Matrix3 out)
+	{
+		const double theta = std::sqrt(v[0] * v[0] + v[1] * v[1] + v[2] * v[2]);
+		const double k[9] = { 0.0, -v[2], v[1], v[2], 0.0, -v[0], -v[1], v[0], 0.0 };
+		double k2[9];
+		multiply(k, k, k2);
+		const double a = theta < 1e-12 ? 1.0 : std::sin(theta) / theta;
+		const double b = theta < 1e-12 ? 0.5 : (1.0 - std::cos(theta)) / (theta * theta);
+		for (int i = 0; i < 9; ++i)
+		{
+			out[i] = (i % 4 == 0 ? 1.0 : 0.0) + a * k[i] + b * k2[i];
+		}
+	}
+
+	size_t
+	knotIndex(float offset)
+	{
+		return std::min(static_cast<size_t>(offset), MotionDeskew::kKnots - 1);
+	}
+
+	// Both kernels interpolate the twelve map terms at the point's offset and
+	// evaluate each row left to right, so the vector kernel can match exactly.
+	void
+	reprojectRunScalar(const float* knot, const float* delta, float base, const float* offsets, const PointColumns& points, size_t count)
+	{
+		for (size_t i = 0; i < count; ++i)
+		{
+			const float w = offsets[i] - base;
+			float m[12];
+			for (size_t e = 0; e < 12; ++e)
+			{
+				m[e] = knot[e] + w * delta[e];
+			}
+			const float x = points.x[i];
+			const float y = points.y[i];
+			const float z = points.z[i];
+			points.x[i] = m[0] * x + m[1] * y + m[2] * z + m[3];
+			points.y[i] = m[4] * x + m[5] * y + m[6] * z + m[7];
+			points.z[i] = m[8] * x + m[9] * y + m[10] * z + m[11];
+		}
+	}
+
+#if defined(LIVOX_HAS_X86_SIMD)
+	constexpr size_t kLanes = 8;
+
+	LIVOX_TARGET_AVX2
+	size_t
+	reprojectRunAvx2(const float* knot, const float* delta, float base, const float* offsets, const PointColumns& points, size_t count)
+	{
+		__m256 knots[12];
+		__m256 deltas[12];
+		for (size_t e = 0; e < 12; ++e)
+		{
+			knots[e] = _mm256_set1_ps(knot[e]);
+			deltas[e] = _mm256_set1_ps(delta[e]);
+		}
+		const __m256 base_offset = _mm256_set1_ps(base);
+
+		size_t i = 0;
+		for (; i + kLanes <= count; i += kLanes)
+		{
+			const __m256 w = _mm256_sub_ps(_mm256_loadu_ps(offsets + i), base_offset);
+			__m256 m[12];
+			for (size_t e = 0; e < 12; ++e)
+			{
+				m[e] = _mm256_add_ps(knots[e], _mm256_mul_ps(w, deltas[e]));
+			}
+			const __m256 x = _mm256_loadu_ps(points.x + i);
+			const __m256 y = _mm256_loadu_ps(points.y + i);
+			const __m256 z = _mm256_loadu_ps(points.z + i);
+			for (size_t row = 0; row < 3; ++row)
+			{
+				const __m256* r = m + row * 4;
+				const __m256 value = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(r[0], x), _mm256_mul_ps(r[1], y)), _mm256_mul_ps(r[2], z)), r[3]);
+				float* column = row == 0 ? points.x : (row == 1 ? points.y : points.z);
+				_mm256_storeu_ps(column + i, value);
+			}
+		}
+		return i;
+	}
+#endif
+}
+
+MotionDeskew::MotionDeskew(ImuBuffer& imu)
+	: imu_(imu)
+	, transformed_(false)
+	, knots_{}
+	, deltas_{}
+	, start_time_(0)
+	, knots_per_ns_(0.0)
+	, deskewed_frames_(0)
+	, skipped_frames_(0)
+{
+	history_.reserve(2 * kHistorySamples);
+	arrivals_.resize(kHistorySamples);
+}
+
+void
+MotionDeskew::setTransform(const PointTransform* transform)
+{
+	transformed_ = transform != nullptr;
+	transform_ = transformed_ ? *transform : PointTransform();
+}
+
+bool
+MotionDeskew::apply(const PointColumns& points, size_t count, uint64_t start_time, uint64_t end_time)
+{
+	if (!prepare(start_time, end_time))
+	{
+		skipped_frames_.fetch_add(1, std::memory_order_relaxed);
+		return false;
+	}
+	reproject(points, count);
+	deskewed_frames_.fetch_add(1, std::memory_order_relaxed);
+	return true;
+}
+
+bool
+MotionDeskew::prepare(uint64_t start_time, uint64_t end_time)
+{
+	for (;;)
+	{
+		const size_t count = imu_.popIngest(arrivals_.data(), arrivals_.size());
+		if (count == 0)
+		{
+			break;
+		}
+		for (size_t i = 0; i < count; ++i)
+		{
+			if (!history_.empty() && arrivals_[i].timestamp < history_.back().timestamp)
+			{
+				history_.clear();
+			}
+			history_.push_back(arrivals_[i]);
+		}
+	}
+	if (history_.size() >= 2 * kHistorySamples)
+	{
+		history_.erase(history_.begin(), history_.end() - kHistorySamples);
+	}
+
+	if (end_time <= start_time || history_.empty() || history_.back().timestamp + kMaxImuGapNs < end_time || history_.front().timestamp > start_time + kMaxImuGapNs)
+	{
+		return false;
+	}
+	integrate(start_time, end_time);
+	return true;
+}
+
+void
+MotionDeskew::reproject(const PointColumns& points, size_t count)
+{
+#if !defined(NDEBUG)
+	// Debug builds re-run the scalar kernel on a copy and assert the outputs
+	// match bit for bit.
+	thread_local PointBlock reference;
+	reference.resize(count);
+	PointColumns expected = reference.columns();
+	std::memcpy(expected.x, points.x, count * sizeof(float));
+	std::memcpy(expected.y, points.y, count * sizeof(float));
+	std::memcpy(expected.z, points.z, count * sizeof(float));
+	expected.timestamp = points.timestamp;
+	reprojectRuns(expected, count, false);
+#endif
+	reprojectRuns(points, count, true);
+#if !defined(NDEBUG)
+	assert(std::memcmp(expected.x, points.x, count * sizeof(float)) == 0);
+	assert(std::memcmp(expected.y, points.y, count * sizeof(float)) == 0);
+	assert(std::memcmp(expected.z, points.z, count * sizeof(float)) == 0);
+#endif
+}
+
+void
+MotionDeskew::reprojectScalar(const PointColumns& points, size_t count)
+{
+	reprojectRuns(points, count, false);
+}
+
+uint64_t
+MotionDeskew::deskewedFrames() const
+{
+	return deskewed_frames_.load(std::memory_order_relaxed);
+}
+
+uint64_t
+MotionDeskew::skippedFrames() const
+{
+	return skipped_frames_.load(std::memory_order_relaxed);
+}
+
+void
+MotionDeskew::integrate(uint64_t start_time, uint64_t end_time)
+{
+	// With R(t) the sensor-to-world attitude, knot k holds R(end)^T R(t_k),
+	// which carries a point seen at t_k into the end pose. Walking backwards,
+	// each interval multiplies in the inverse of the rotation the gyro
+	// measured over it, taken at the interval's midpoint.
+	const double interval_ns = static_cast<double>(end_time - start_time) / static_cast<double>(kKnots);
+	double rotation[9] = { 1.0, 0.0, 0.0, 0.0, 1.0, 0.0, 0.0, 0.0, 1.0 };
+	for (size_t k = kKnots + 1; k-- > 0;)
+	{
+		if (k < kKnots)
+		{
+			double rate[3];
+			gyroAt(start_time + static_cast<uint64_t>((static_cast<double>(k) + 0.5) * interval_ns), rate);
+			const double step[3] = { -rate[0] * interval_ns * kSecondsPerNano, -rate[1] * interval_ns * kSecondsPerNano, -rate[2] * interval_ns * kSecondsPerNano };
+			double increment[9];
+			double next[9];
+			exponential(step, increment);
+			multiply(rotation, increment, next);
+			std::copy(next, next + 9, rotation);
+		}
+
+		// Points decoded with a mounting transform E are corrected in the
+		// world frame: p' = E M E^-1 p, i.e. A = Re M Re^T and b = t - A t.
+		double map[9];
+		if (transformed_)
+		{
+			double rotated[9];
+			double re[9];
+			double re_t[9];
+			for (int i = 0; i < 9; ++i)
+			{
+				re[i] = transform_.rotation[i];
+				re_t[(i % 3) * 3 + i / 3] = transform_.rotation[i];
+			}
+			multiply(re, rotation, rotated);
+			multiply(rotated, re_t, map);
+		}
+		else
+		{
+			std::copy(rotation, rotation + 9, map);
+		}
+		for (int row = 0; row < 3; ++row)
+		{
+			double offset = 0.0;
+			if (transformed_)
+			{
+				offset = transform_.translation[row];
+				for (int col = 0; col < 3; ++col)
+				{
+					offset -= map[row * 3 + col] * transform_.translation[col];
+				}
+			}
+			for (int col = 0; col < 3; ++col)
+			{
+				knots_[k][row * 4 + col] = static_cast<float>(map[row * 3 + col]);
+			}
+			knots_[k][row * 4 + 3] = static_cast<float>(offset);
+		}
+	}
+
+	for (size_t k = 0; k < kKnots; ++k)
+	{
+		for (size_t e = 0; e < 12; ++e)
+		{
+			deltas_[k][e] = knots_[k + 1][e] - knots_[k][e];
+		}
+	}
+	start_time_ = start_time;
+	knots_per_ns_ = static_cast<double>(kKnots) / static_cast<double>(end_time - start_time);
+}
+
+void
+MotionDeskew::gyroAt(uint64_t timestamp, double rate[3]) const
+{
+	const auto later = [](uint64_t time, const ImuSample& sample) { return time < sample.timestamp; };
+	const size_t upper = static_cast<size_t>(std::upper_bound(history_.begin(), history_.end(), timestamp, later) - history_.begin());
+	const ImuSample& from = history_[upper == 0 ? 0 : upper - 1];
+	const ImuSample& to = history_[std::min(upper, history_.size() - 1)];
+	const double weight = to.timestamp > from.timestamp ? static_cast<double>(timestamp - from.timestamp) / static_cast<double>(to.timestamp - from.timestamp) : 0.0;
+	for (int axis = 0; axis < 3; ++axis)
+	{
+		rate[axis] = from.gyro[axis] + (to.gyro[axis] - from.gyro[axis]) * weight;
+	}
+}
+
+void
+MotionDeskew::reprojectRuns(const PointColumns& points, size_t count, bool vectorised)
+{
+	// Offsets in knot intervals; the vector only grows, so steady-state
+	// frames allocate nothing.
+	if (offsets_.size() < count)
+	{
+		offsets_.resize(count);
+	}
+	const float last_knot = static_cast<float>(kKnots);
+	for (size_t i = 0; i < count; ++i)
+	{
+		const uint64_t timestamp = points.timestamp[i];
+		const double offset = timestamp > start_time_ ? static_cast<double>(timestamp - start_time_) * knots_per_ns_ : 0.0;
+		offsets_[i] = std::min(static_cast<float>(offset), last_knot);
+	}
+
+	size_t begin = 0;
+	while (begin < count)
+	{
+		const size_t knot = knotIndex(offsets_[begin]);
+		size_t end = begin + 1;
+		while (end < count && knotIndex(offsets_[end]) == knot)
+		{
+			++end;
+		}
+
+		const PointColumns run = points.offset(begin);
+		const float base = static_cast<float>(knot);
+		size_t done = 0;
+#if defined(LIVOX_HAS_X86_SIMD)
+		if (vectorised && PointDecoder::activeKernel() == PointDecoder::Kernel::Avx2)
+		{
+			done = reprojectRunAvx2(knots_[knot], deltas_[knot], base, offsets_.data() + begin, run, end - begin);
+		}
+#else
+		(void)vectorised;
+#endif
+		reprojectRunScalar(knots_[knot], deltas_[knot], base, offsets_.data() + begin + done, run.offset(done), end - begin - done);
+		begin = end;
+	}
+}
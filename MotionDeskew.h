@@ -0,0 +1,72 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "ImuBuffer.h"
+#include "PointDecoder.h"
+#include "PointRing.h"
+
+// Removes the smear a rotating sensor leaves in an integration window. The
+// gyro is integrated backwards from the end of the frame, giving the rotation
+// from the sensor's attitude at every instant of the frame to its attitude at
+// the end, and each point is re-projected to that end pose. Only rotation is
+// corrected; the IMU axes are taken to be the lidar's, as on the Mid-360.
+//
+// The rotation is sampled at kKnots + 1 evenly spaced knots across the frame
+// and interpolated linearly between them by each point's timestamp offset.
+// Points are time-ordered, so the knot pair is loop-invariant over long runs
+// and the AVX2 kernel interpolates and rotates 8 points per iteration. Both
+// kernels produce bit-identical results.
+//
+// Everything but the counters belongs to the sensor's point source thread.
+class MotionDeskew
+{
+public:
+	static constexpr size_t kKnots = 32;
+
+	explicit MotionDeskew(ImuBuffer& imu);
+
+	// Mounting transform the points were decoded with, or nullptr for points
+	// in the sensor frame; the correction is conjugated by it.
+	void setTransform(const PointTransform* transform);
+
+	// Re-projects the x/y/z columns of a frame covering [start_time, end_time)
+	// to the pose at end_time, using the timestamp column. Leaves the frame
+	// untouched and returns false when no IMU data covers it.
+	bool apply(const PointColumns& points, size_t count, uint64_t start_time, uint64_t end_time);
+
+	// The two halves of apply(): prepare() takes in the IMU samples that
+	// arrived and builds the knots; reproject() then corrects points with the
+	// active kernel, reprojectScalar() with the scalar one.
+	bool prepare(uint64_t start_time, uint64_t end_time);
+	void reproject(const PointColumns& points, size_t count);
+	void reprojectScalar(const PointColumns& points, size_t count);
+
+	uint64_t deskewedFrames() const;
+	uint64_t skippedFrames() const;
+
+private:
+	void integrate(uint64_t start_time, uint64_t end_time);
+	void gyroAt(uint64_t timestamp, double rate[3]) const;
+	void reprojectRuns(const PointColumns& points, size_t count, bool vectorised);
+
+	ImuBuffer& imu_;
+	std::vector<ImuSample> history_;
+	std::vector<ImuSample> arrivals_;
+	PointTransform transform_;
+	bool transformed_;
+
+	// Per knot a row-major 3x4 affine map, and per interval the difference
+	// to the next knot.
+	float knots_[kKnots + 1][12];
+	float deltas_[kKnots][12];
+	uint64_t start_time_;
+	double knots_per_ns_;
+	std::vector<float> offsets_;
+
+	std::atomic<uint64_t> deskewed_frames_;
+	std::atomic<uint64_t> skipped_frames_;
+};
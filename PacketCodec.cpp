@@ -0,0 +1,383 @@
+#include "PacketCodec.h"
+#include "PacketSource.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace
+{
+	enum Method : uint8_t
+	{
+		kStored = 0,
+		kPacked = 1
+	};
+
+	// Points per bit-packed block; each block carries its own width byte.
+	constexpr size_t kBlock = 32;
+
+	// PackBits: a control byte below 128 is followed by control + 1 literal
+	// bytes; 128 and above repeat the next byte control - 126 times.
+	constexpr size_t kMaxLiteral = 128;
+	constexpr size_t kMinRun = 2;
+	constexpr size_t kMaxRun = 129;
+
+	// Reflectivity and tag are gathered and run-length coded this many points
+	// at a time.
+	constexpr size_t kChannelChunk = 256;
+
+	constexpr size_t kHeaderSize = offsetof(LivoxLidarEthernetPacket, data);
+
+	uint32_t
+	zigzag(uint32_t delta)
+	{
+		return (delta << 1) ^ static_cast<uint32_t>(static_cast<int32_t>(delta) >> 31);
+	}
+
+	uint32_t
+	unzigzag(uint32_t value)
+	{
+		return (value >> 1) ^ (0u - (value & 1u));
+	}
+
+	uint32_t
+	bitWidth(uint32_t value)
+	{
+		uint32_t width = 0;
+		while (value != 0)
+		{
+			++width;
+			value >>= 1;
+		}
+		return width;
+	}
+
+	template <typename Raw>
+	uint32_t
+	coordinate(const Raw& point, size_t axis)
+	{
+		return static_cast<uint32_t>(static_cast<int32_t>(axis == 0 ? point.x : axis == 1 ? point.y : point.z));
+	}
+
+	template <typename Raw>
+	void
+	setCoordinate(Raw& point, size_t axis, uint32_t value)
+	{
+		using Coord = decltype(point.x);
+		const Coord coord = static_cast<Coord>(static_cast<int32_t>(value));
+		(axis == 0 ? point.x : axis == 1 ? point.y : point.z) = coord;
+	}
+
+	uint8_t*
+	packBlock(const uint32_t* values, size_t count, uint8_t* out)
+	{
+		uint32_t all = 0;
+		for (size_t i = 0; i < count; ++i)
+		{
+			all |= values[i];
+		}
+		const uint32_t width = bitWidth(all);
+		*out++ = static_cast<uint8_t>(width);
+
+		uint64_t bits = 0;
+		uint32_t filled = 0;
+		for (size_t i = 0; i < count; ++i)
+		{
+			bits |= static_cast<uint64_t>(values[i]) << filled;
+			filled += width;
+			while (filled >= 8)
+			{
+				*out++ = static_cast<uint8_t>(bits);
+				bits >>= 8;
+				filled -= 8;
+			}
+		}
+		if (filled > 0)
+		{
+			*out++ = static_cast<uint8_t>(bits);
+		}
+		return out;
+	}
+
+	const uint8_t*
+	unpackBlock(const uint8_t* in, const uint8_t* end, size_t count, uint32_t* values)
+	{
+		if (in >= end || *in > 32)
+		{
+			return nullptr;
+		}
+		const uint32_t width = *in++;
+		if (static_cast<size_t>(end - in) < (count * width + 7) / 8)
+		{
+			return nullptr;
+		}
+
+		const uint64_t mask = (uint64_t(1) << width) - 1;
+		uint64_t bits = 0;
+		uint32_t filled = 0;
+		for (size_t i = 0; i < count; ++i)
+		{
+			while (filled < width)
+			{
+				bits |= static_cast<uint64_t>(*in++) << filled;
+				filled += 8;
+			}
+			values[i] = static_cast<uint32_t>(bits & mask);
+			bits >>= width;
+			filled -= width;
+		}
+		return in;
+	}
+
+	uint8_t*
+	packRuns(const uint8_t* bytes, size_t count, uint8_t* out)
+	{
+		size_t i = 0;
+		while (i < count)
+		{
+			size_t run = 1;
+			while (i + run < count && run < kMaxRun && bytes[i + run] == bytes[i])
+			{
+				++run;
+			}
+			if (run >= kMinRun)
+			{
+				*out++ = static_cast<uint8_t>(run + 126);
+				*out++ = bytes[i];
+				i += run;
+				continue;
+			}
+
+			// Literals up to the next run of at least kMinRun + 1, which is
+			// where switching to a run starts to pay.
+			size_t literal = 1;
+			while (i + literal < count && literal < kMaxLiteral)
+			{
+				const size_t j = i + literal;
+				if (j + 2 < count && bytes[j] == bytes[j + 1] && bytes[j] == bytes[j + 2])
+				{
+					break;
+				}
+				++literal;
+			}
+			*out++ = static_cast<uint8_t>(literal - 1);
+			std::memcpy(out, bytes + i, literal);
+			out += literal;
+			i += literal;
+		}
+		return out;
+	}
+
+	const uint8_t*
+	unpackRuns(const uint8_t* in, const uint8_t* end, size_t count, uint8_t* bytes)
+	{
+		size_t i = 0;
+		while (i < count)
+		{
+			if (in >= end)
+			{
+				return nullptr;
+			}
+			const uint8_t control = *in++;
+			if (control < kMaxLiteral)
+			{
+				const size_t literal = static_cast<size_t>(control) + 1;
+				if (literal > count - i || literal > static_cast<size_t>(end - in))
+				{
+					return nullptr;
+				}
+				std::memcpy(bytes + i, in, literal);
+				in += literal;
+				i += literal;
+			}
+			else
+			{
+				const size_t run = static_cast<size_t>(control) - 126;
+				if (run > count - i || in >= end)
+				{
+					return nullptr;
+				}
+				std::memset(bytes + i, *in++, run);
+				i += run;
+			}
+		}
+		return in;
+	}
+
+	template <typename Raw>
+	uint8_t*
+	encodePoints(const Raw* points, size_t count, uint8_t* out)
+	{
+		uint32_t values[kBlock];
+		for (size_t axis = 0; axis < 3; ++axis)
+		{
+			uint32_t previous = 0;
+			for (size_t begin = 0; begin < count; begin += kBlock)
+			{
+				const size_t block = std::min(kBlock, count - begin);
+				for (size_t i = 0; i < block; ++i)
+				{
+					const uint32_t value = coordinate(points[begin + i], axis);
+					values[i] = zigzag(value - previous);
+					previous = value;
+				}
+				out = packBlock(values, block, out);
+			}
+		}
+
+		uint8_t channel[kChannelChunk];
+		for (size_t begin = 0; begin < count; begin += sizeof(channel))
+		{
+			const size_t chunk = std::min(sizeof(channel), count - begin);
+			for (size_t i = 0; i < chunk; ++i)
+			{
+				channel[i] = points[begin + i].reflectivity;
+			}
+			out = packRuns(channel, chunk, out);
+		}
+		for (size_t begin = 0; begin < count; begin += sizeof(channel))
+		{
+			const size_t chunk = std::min(sizeof(channel), count - begin);
+			for (size_t i = 0; i < chunk; ++i)
+			{
+				channel[i] = points[begin + i].tag;
+			}
+			out = packRuns(channel, chunk, out);
+		}
+		return out;
+	}
+
+	template <typename Raw>
+	bool
+	decodePoints(const uint8_t* in, const uint8_t* end, size_t count, Raw* points)
+	{
+		uint32_t values[kBlock];
+		for (size_t axis = 0; axis < 3; ++axis)
+		{
+			uint32_t previous = 0;
+			for (size_t begin = 0; begin < count; begin += kBlock)
+			{
+				const size_t block = std::min(kBlock, count - begin);
+				in = unpackBlock(in, end, block, values);
+				if (in == nullptr)
+				{
+					return false;
+				}
+				for (size_t i = 0; i < block; ++i)
+				{
+					previous += unzigzag(values[i]);
+					setCoordinate(points[begin + i], axis, previous);
+				}
+			}
+		}
+
+		uint8_t channel[kChannelChunk];
+		for (size_t begin = 0; begin < count; begin += sizeof(channel))
+		{
+			const size_t chunk = std::min(sizeof(channel), count - begin);
+			in = unpackRuns(in, end, chunk, channel);
+			if (in == nullptr)
+			{
+				return false;
+			}
+			for (size_t i = 0; i < chunk; ++i)
+			{
+				points[begin + i].reflectivity = channel[i];
+			}
+		}
+		for (size_t begin = 0; begin < count; begin += sizeof(channel))
+		{
+			const size_t chunk = std::min(sizeof(channel), count - begin);
+			in = unpackRuns(in, end, chunk, channel);
+			if (in == nullptr)
+			{
+				return false;
+			}
+			for (size_t i = 0; i < chunk; ++i)
+			{
+				points[begin + i].tag = channel[i];
+			}
+		}
+		return in == end;
+	}
+}
+
+size_t
+PacketCodec::maxEncodedSize(size_t packet_size)
+{
+	// A coordinate packs to at most 32 bits plus a width byte per block, and
+	// the run-length streams grow by at most one byte in 128, so twice the
+	// packet always fits.
+	return 1 + 2 * packet_size + 64;
+}
+
+size_t
+PacketCodec::encode(const LivoxLidarEthernetPacket* packet, size_t packet_size, uint8_t* out)
+{
+	const bool packable = packet_size >= kHeaderSize && PacketSource::packetSize(packet) == packet_size;
+	if (packable)
+	{
+		uint8_t* cursor = out;
+		*cursor++ = kPacked;
+		std::memcpy(cursor, packet, kHeaderSize);
+		cursor += kHeaderSize;
+		if (packet->data_type == kLivoxLidarCartesianCoordinateHighData)
+		{
+			cursor = encodePoints(reinterpret_cast<const LivoxLidarCartesianHighRawPoint*>(packet->data), packet->dot_num, cursor);
+		}
+		else
+		{
+			cursor = encodePoints(reinterpret_cast<const LivoxLidarCartesianLowRawPoint*>(packet->data), packet->dot_num, cursor);
+		}
+		const size_t packed = static_cast<size_t>(cursor - out);
+		if (packed <= packet_size)
+		{
+			return packed;
+		}
+	}
+
+	out[0] = kStored;
+	std::memcpy(out + 1, packet, packet_size);
+	return 1 + packet_size;
+}
+
+size_t
+PacketCodec::decode(const uint8_t* data, size_t size, uint8_t* packet, size_t capacity)
+{
+	if (size == 0)
+	{
+		return 0;
+	}
+	const uint8_t* const end = data + size;
+	if (data[0] == kStored)
+	{
+		if (size - 1 > capacity)
+		{
+			return 0;
+		}
+		std::memcpy(packet, data + 1, size - 1);
+		return size - 1;
+	}
+	if (data[0] != kPacked || size < 1 + kHeaderSize || capacity < kHeaderSize)
+	{
+		return 0;
+	}
+
+	std::memcpy(packet, data + 1, kHeaderSize);
+	auto* header = reinterpret_cast<LivoxLidarEthernetPacket*>(packet);
+	const size_t packet_size = PacketSource::packetSize(header);
+	if (packet_size == 0 || packet_size > capacity)
+	{
+		return 0;
+	}
+	const uint8_t* in = data + 1 + kHeaderSize;
+	bool valid = false;
+	if (header->data_type == kLivoxLidarCartesianCoordinateHighData)
+	{
+		valid = decodePoints(in, end, header->dot_num, reinterpret_cast<LivoxLidarCartesianHighRawPoint*>(header->data));
+	}
+	else
+	{
+		valid = decodePoints(in, end, header->dot_num, reinterpret_cast<LivoxLidarCartesianLowRawPoint*>(header->data));
+	}
+	return valid ? packet_size : 0;
+}
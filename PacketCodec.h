@@ -0,0 +1,27 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "livox_lidar_api.h"
+
+// Lossless compression of single Livox point packets for recordings. The
+// packet header is kept verbatim. Each coordinate axis is delta coded from
+// point to point within the packet, zigzag mapped and bit packed in blocks of
+// 32 points at the narrowest width that holds the block. Reflectivity and tag
+// are run-length coded (PackBits). Packets that would not shrink, and any
+// non-Cartesian data, are stored as they are.
+class PacketCodec
+{
+public:
+	// Upper bound of encode() output for a packet of packet_size bytes.
+	static size_t maxEncodedSize(size_t packet_size);
+
+	// Encodes packet_size bytes of packet into out, which must hold
+	// maxEncodedSize(packet_size) bytes. Returns the bytes written.
+	static size_t encode(const LivoxLidarEthernetPacket* packet, size_t packet_size, uint8_t* out);
+
+	// Decodes into packet, which holds capacity bytes. Returns the packet
+	// size, or 0 if data is malformed or the packet does not fit.
+	static size_t decode(const uint8_t* data, size_t size, uint8_t* packet, size_t capacity);
+};
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <cstdint>
+
+// On-disk layout of a packet recording: one FileHeader, then for every packet
+// a RecordHeader followed by `size` bytes of the LivoxLidarEthernetPacket
+// exactly as the SDK delivered it, or, when the header has kFlagCompressed
+// set (version 3), of its PacketCodec encoding. Since version 2 a finished recording ends
+// with a sparse time index: `count` IndexEntry values followed by an
+// IndexFooter. Recordings that were never finished, and version 1 files, have
+// no index and are scanned instead. All fields are little-endian and unpadded.
+namespace PacketFile
+{
+	constexpr char kMagic[8] = { 'L', 'V', 'X', 'P', 'K', 'T', 'S', '\0' };
+	constexpr char kIndexMagic[8] = { 'L', 'V', 'X', 'I', 'N', 'D', 'X', '\0' };
+	constexpr uint32_t kVersion = 3;
+	constexpr uint32_t kMinVersion = 1;
+
+	// FileHeader::flags
+	constexpr uint32_t kFlagCompressed = 1;
+
+	// Recorded time between index entries.
+	constexpr uint64_t kIndexIntervalNs = 100000000;
+
+#pragma pack(push, 1)
+	struct FileHeader
+	{
+		char magic[8];
+		uint32_t version;
+		uint32_t flags; // 0 before version 3
+	};
+
+	struct RecordHeader
+	{
+		uint64_t received; // host steady-clock time in ns (PacketStamp::hostNow)
+		uint32_t size;     // packet bytes that follow
+		uint32_t handle;   // SDK lidar handle
+	};
+
+	struct IndexEntry
+	{
+		uint64_t received; // RecordHeader::received of the record at offset
+		uint64_t offset;   // file offset of that record's header
+	};
+
+	struct IndexFooter
+	{
+		uint64_t index_offset;  // file offset of the first IndexEntry; records end here
+		uint64_t count;         // number of IndexEntry values
+		uint64_t last_received; // RecordHeader::received of the last record
+		char magic[8];
+	};
+#pragma pack(pop)
+
+	static_assert(sizeof(FileHeader) == 16, "packed file header");
+	static_assert(sizeof(RecordHeader) == 16, "packed record header");
+	static_assert(sizeof(IndexEntry) == 16, "packed index entry");
+	static_assert(sizeof(IndexFooter) == 32, "packed index footer");
+}
@@ -0,0 +1,382 @@
+#include "PacketRecorder.h"
+#include "PacketCodec.h"
+#include "PacketSource.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+
+namespace
+{
+	// About ten seconds of Mid-360 High data; absorbs disk stalls.
+	constexpr size_t kQueueBytes = size_t(32) << 20;
+
+	// The file starts at kInitialFileBytes and grows by doubling, at most
+	// kMaxGrowBytes at a time.
+	constexpr size_t kInitialFileBytes = size_t(64) << 20;
+	constexpr size_t kMaxGrowBytes = size_t(1) << 30;
+
+	// Writer poll interval while the queue is empty.
+	constexpr auto kIdleWait = std::chrono::milliseconds(2);
+
+	void
+	copyIntoRing(uint8_t* ring, size_t capacity, uint64_t index, const void* bytes, size_t count)
+	{
+		const size_t slot = static_cast<size_t>(index & (capacity - 1));
+		const size_t first = std::min(count, capacity - slot);
+		std::memcpy(ring + slot, bytes, first);
+		std::memcpy(ring, static_cast<const uint8_t*>(bytes) + first, count - first);
+	}
+
+	void
+	copyFromRing(const uint8_t* ring, size_t capacity, uint64_t index, void* bytes, size_t count)
+	{
+		const size_t slot = static_cast<size_t>(index & (capacity - 1));
+		const size_t first = std::min(count, capacity - slot);
+		std::memcpy(bytes, ring + slot, first);
+		std::memcpy(static_cast<uint8_t*>(bytes) + first, ring, count - first);
+	}
+}
+
+PacketRecorder::PacketRecorder()
+	: file_length_(0)
+	, compress_(false)
+	, next_record_(0)
+	, next_index_time_(0)
+	, last_received_(0)
+	, recording_(false)
+	, finishing_(false)
+	, failed_(false)
+	, recorded_(0)
+	, dropped_(0)
+	, bytes_written_(0)
+	, packet_bytes_(0)
+	, status_("Not recording")
+{
+}
+
+PacketRecorder::~PacketRecorder()
+{
+	requestStop();
+	finish();
+}
+
+bool
+PacketRecorder::start(const std::string& path, bool compress)
+{
+	requestStop();
+	finish();
+
+	if (!file_.create(path, kInitialFileBytes))
+	{
+		setStatus(file_.error());
+		return false;
+	}
+
+	PacketFile::FileHeader header{};
+	std::memcpy(header.magic, PacketFile::kMagic, sizeof(header.magic));
+	header.version = PacketFile::kVersion;
+	header.flags = compress ? PacketFile::kFlagCompressed : 0;
+	std::memcpy(file_.data(), &header, sizeof(header));
+	file_length_ = sizeof(header);
+	path_ = path;
+	compress_ = compress;
+	index_.clear();
+	next_record_ = file_length_;
+	next_index_time_ = 0;
+	last_received_ = 0;
+
+	if (queue_.size() != kQueueBytes)
+	{
+		queue_.assign(kQueueBytes, 0);
+	}
+	queue_index_.reset(kQueueBytes);
+	recorded_.store(0);
+	dropped_.store(0);
+	bytes_written_.store(file_length_);
+	packet_bytes_.store(0);
+	finishing_.store(false);
+	failed_ = false;
+
+	writer_ = std::thread(&PacketRecorder::run, this);
+	recording_.store(true, std::memory_order_release);
+	setStatus("Recording to " + path);
+	return true;
+}
+
+void
+PacketRecorder::requestStop()
+{
+	recording_.store(false, std::memory_order_release);
+}
+
+void
+PacketRecorder::finish()
+{
+	if (!writer_.joinable())
+	{
+		return;
+	}
+	finishing_.store(true, std::memory_order_release);
+	writer_.join();
+
+	// A recording without an index still plays; seeking then scans it once.
+	const bool indexed = !failed_ && writeIndex();
+	file_.close(file_length_);
+	if (failed_)
+	{
+		return;
+	}
+	std::string detail = std::to_string(dropped_.load()) + " dropped";
+	if (compress_ && file_length_ > 0)
+	{
+		const double ratio = static_cast<double>(packet_bytes_.load()) / static_cast<double>(bytes_written_.load());
+		char text[32];
+		std::snprintf(text, sizeof(text), ", %.2f:1", ratio);
+		detail += text;
+	}
+	if (!indexed)
+	{
+		detail += ", no index";
+	}
+	setStatus("Wrote " + std::to_string(recorded_.load()) + " packets to " + path_ + " (" + detail + ")");
+}
+
+bool
+PacketRecorder::isRecording() const
+{
+	return recording_.load(std::memory_order_acquire);
+}
+
+void
+PacketRecorder::record(uint32_t handle, const LivoxLidarEthernetPacket* packet, uint64_t received)
+{
+	if (!recording_.load(std::memory_order_acquire))
+	{
+		return;
+	}
+
+	const size_t size = PacketSource::packetSize(packet);
+	if (size == 0)
+	{
+		return;
+	}
+
+	// Records are published whole, so the writer can copy any available
+	// byte range without knowing where records start.
+	const size_t bytes = sizeof(PacketFile::RecordHeader) + size;
+	if (queue_index_.capacity() - queue_index_.size() < bytes)
+	{
+		dropped_.fetch_add(1, std::memory_order_relaxed);
+		return;
+	}
+
+	PacketFile::RecordHeader header{};
+	header.received = received;
+	header.size = static_cast<uint32_t>(size);
+	header.handle = handle;
+
+	size_t evicted = 0;
+	const uint64_t write = queue_index_.beginWrite(bytes, evicted);
+	copyIntoRing(queue_.data(), queue_.size(), write, &header, sizeof(header));
+	copyIntoRing(queue_.data(), queue_.size(), write + sizeof(header), packet, size);
+	queue_index_.commitWrite(write, bytes);
+	recorded_.fetch_add(1, std::memory_order_relaxed);
+}
+
+uint64_t
+PacketRecorder::recordedPackets() const
+{
+	return recorded_.load(std::memory_order_relaxed);
+}
+
+uint64_t
+PacketRecorder::droppedPackets() const
+{
+	return dropped_.load(std::memory_order_relaxed);
+}
+
+uint64_t
+PacketRecorder::bytesWritten() const
+{
+	return bytes_written_.load(std::memory_order_relaxed);
+}
+
+uint64_t
+PacketRecorder::packetBytes() const
+{
+	return packet_bytes_.load(std::memory_order_relaxed);
+}
+
+std::string
+PacketRecorder::statusText() const
+{
+	std::lock_guard<std::mutex> lock(status_mutex_);
+	return status_;
+}
+
+void
+PacketRecorder::run()
+{
+	for (;;)
+	{
+		// Read the flag first: once it is set no more packets arrive, so an
+		// empty queue afterwards means everything has been written.
+		const bool finishing = finishing_.load(std::memory_order_acquire);
+		if (!writeQueued())
+		{
+			// The file could not grow; stop taking packets and discard the rest.
+			failed_ = true;
+			recording_.store(false, std::memory_order_release);
+			queue_index_.clear();
+			return;
+		}
+		if (finishing && queue_index_.size() == 0)
+		{
+			return;
+		}
+		std::this_thread::sleep_for(kIdleWait);
+	}
+}
+
+bool
+PacketRecorder::writeQueued()
+{
+	size_t available = 0;
+	const uint64_t read = queue_index_.beginRead(available);
+	if (available == 0)
+	{
+		return true;
+	}
+
+	if (compress_)
+	{
+		return writeEncoded(read, available);
+	}
+	if (!reserve(available))
+	{
+		return false;
+	}
+
+	const size_t capacity = queue_.size();
+	const size_t slot = static_cast<size_t>(read & (capacity - 1));
+	const size_t first = std::min(available, capacity - slot);
+	std::memcpy(file_.data() + file_length_, queue_.data() + slot, first);
+	std::memcpy(file_.data() + file_length_ + first, queue_.data(), available - first);
+	file_length_ += available;
+	bytes_written_.store(file_length_, std::memory_order_relaxed);
+	packet_bytes_.fetch_add(available, std::memory_order_relaxed);
+	queue_index_.commitRead(read, available);
+	indexWritten();
+	return true;
+}
+
+bool
+PacketRecorder::writeEncoded(uint64_t read, size_t available)
+{
+	// Only whole records are queued, so available splits into records. Each
+	// is encoded straight into the mapped file; a packet that wraps around
+	// the end of the queue is gathered into packet_scratch_ first.
+	const size_t capacity = queue_.size();
+	for (uint64_t index = read; index < read + available;)
+	{
+		PacketFile::RecordHeader header;
+		copyFromRing(queue_.data(), capacity, index, &header, sizeof(header));
+		const uint64_t packet_index = index + sizeof(header);
+		const size_t slot = static_cast<size_t>(packet_index & (capacity - 1));
+		const uint8_t* packet = queue_.data() + slot;
+		if (slot + header.size > capacity)
+		{
+			packet_scratch_.resize(header.size);
+			copyFromRing(queue_.data(), capacity, packet_index, packet_scratch_.data(), header.size);
+			packet = packet_scratch_.data();
+		}
+
+		const size_t packet_size = header.size;
+		if (!reserve(sizeof(header) + PacketCodec::maxEncodedSize(packet_size)))
+		{
+			return false;
+		}
+		uint8_t* out = file_.data() + file_length_;
+		header.size = static_cast<uint32_t>(PacketCodec::encode(reinterpret_cast<const LivoxLidarEthernetPacket*>(packet), packet_size, out + sizeof(header)));
+		std::memcpy(out, &header, sizeof(header));
+		file_length_ += sizeof(header) + header.size;
+		packet_bytes_.fetch_add(sizeof(header) + packet_size, std::memory_order_relaxed);
+		index = packet_index + packet_size;
+	}
+
+	bytes_written_.store(file_length_, std::memory_order_relaxed);
+	queue_index_.commitRead(read, available);
+	indexWritten();
+	return true;
+}
+
+bool
+PacketRecorder::reserve(size_t bytes)
+{
+	if (file_length_ + bytes <= file_.size())
+	{
+		return true;
+	}
+	const size_t grow = std::min(std::max(file_.size(), bytes), kMaxGrowBytes);
+	if (!file_.resize(std::max(file_.size() + grow, file_length_ + bytes)))
+	{
+		setStatus("Recording stopped: " + file_.error());
+		return false;
+	}
+	return true;
+}
+
+void
+PacketRecorder::indexWritten()
+{
+	// Only whole records are queued, so the file always ends on a record
+	// boundary and the headers can be walked in place.
+	while (next_record_ + sizeof(PacketFile::RecordHeader) <= file_length_)
+	{
+		PacketFile::RecordHeader header;
+		std::memcpy(&header, file_.data() + next_record_, sizeof(header));
+		if (index_.empty() || header.received >= next_index_time_)
+		{
+			index_.push_back({ header.received, next_record_ });
+			next_index_time_ = header.received + PacketFile::kIndexIntervalNs;
+		}
+		last_received_ = header.received;
+		next_record_ += sizeof(header) + header.size;
+	}
+}
+
+bool
+PacketRecorder::writeIndex()
+{
+	if (index_.empty())
+	{
+		return false;
+	}
+
+	const size_t entry_bytes = index_.size() * sizeof(PacketFile::IndexEntry);
+	const size_t length = file_length_ + entry_bytes + sizeof(PacketFile::IndexFooter);
+	if (length > file_.size() && !file_.resize(length))
+	{
+		return false;
+	}
+
+	PacketFile::IndexFooter footer{};
+	footer.index_offset = file_length_;
+	footer.count = index_.size();
+	footer.last_received = last_received_;
+	std::memcpy(footer.magic, PacketFile::kIndexMagic, sizeof(footer.magic));
+	std::memcpy(file_.data() + file_length_, index_.data(), entry_bytes);
+	std::memcpy(file_.data() + file_length_ + entry_bytes, &footer, sizeof(footer));
+	file_length_ = length;
+	bytes_written_.store(file_length_, std::memory_order_relaxed);
+	return true;
+}
+
+void
+PacketRecorder::setStatus(const std::string& text)
+{
+	std::lock_guard<std::mutex> lock(status_mutex_);
+	status_ = text;
+}
@@ -0,0 +1,93 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "livox_lidar_api.h"
+#include "MappedFile.h"
+#include "PacketFile.h"
+#include "SpscRing.h"
+
+// Records raw point packets to a PacketFile. The ingest thread copies each
+// packet and its receive time into a lock-free byte queue and never waits; a
+// writer thread drains the queue into a memory-mapped file that grows in
+// chunks. When the queue is full the packet is dropped and counted. The writer
+// also collects a sparse time index as it goes, which finish() appends to the
+// file so playback can seek without scanning. With compression on, the writer
+// encodes each packet with PacketCodec as it copies it out of the queue.
+//
+// The queue has a single producer: record() calls must not overlap each other,
+// start() or requestStop(). LivoxDevice guarantees that with its record lock,
+// which the sensors' threads share.
+class PacketRecorder
+{
+public:
+	PacketRecorder();
+	~PacketRecorder();
+
+	PacketRecorder(const PacketRecorder&) = delete;
+	PacketRecorder& operator=(const PacketRecorder&) = delete;
+
+	// Cook thread: creates the file and starts the writer. Any previous
+	// recording is finished first.
+	bool start(const std::string& path, bool compress);
+
+	// Cook thread: stops accepting packets. finish() then drains what is
+	// queued, trims the file and joins the writer.
+	void requestStop();
+	void finish();
+
+	bool isRecording() const;
+
+	// Ingest thread: queues one packet, or counts it as dropped.
+	void record(uint32_t handle, const LivoxLidarEthernetPacket* packet, uint64_t received);
+
+	uint64_t recordedPackets() const;
+	uint64_t droppedPackets() const;
+	uint64_t bytesWritten() const;
+	// Record bytes before compression.
+	uint64_t packetBytes() const;
+	std::string statusText() const;
+
+private:
+	void run();
+	bool writeQueued();
+	bool writeEncoded(uint64_t read, size_t available);
+	bool reserve(size_t bytes);
+	void indexWritten();
+	bool writeIndex();
+	void setStatus(const std::string& text);
+
+	std::vector<uint8_t> queue_;
+	SpscRingIndex queue_index_;
+
+	MappedFile file_;
+	size_t file_length_;
+	std::string path_;
+	bool compress_;
+	std::vector<uint8_t> packet_scratch_; // writer thread; wrapped packets
+
+	// Writer thread; read after join.
+	std::vector<PacketFile::IndexEntry> index_;
+	size_t next_record_;
+	uint64_t next_index_time_;
+	uint64_t last_received_;
+
+	std::atomic<bool> recording_;
+	std::atomic<bool> finishing_;
+	bool failed_; // writer thread; read after join
+	std::thread writer_;
+
+	std::atomic<uint64_t> recorded_;
+	std::atomic<uint64_t> dropped_;
+	std::atomic<uint64_t> bytes_written_;
+	std::atomic<uint64_t> packet_bytes_;
+
+	mutable std::mutex status_mutex_;
+	std::string status_;
+};
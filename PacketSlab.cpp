@@ -0,0 +1,597 @@
+#include "PacketSlab.h"
+#include "PointDecoder.h"
+
+#include <algorithm>
+#include <cstring>
+#include <new>
+
+namespace
+{
+	// Slots start on 8-byte boundaries so their stamps stay aligned.
+	constexpr size_t kSlotAlignment = alignof(PacketStamp);
+
+	// Time of record i of a push: its own when the caller passed times,
+	// otherwise its packet position's.
+	uint64_t
+	recordTime(const PacketStamp& stamp, const uint64_t* times, size_t i)
+	{
+		return times != nullptr ? times[i] : stamp.pointTime(stamp.first_dot + i);
+	}
+
+	size_t
+	payloadBytesFor(LivoxLidarPointDataType data_type)
+	{
+		return PacketSlab::kPointsPerSlot * (data_type == kLivoxLidarCartesianCoordinateHighData
+			? sizeof(LivoxLidarCartesianHighRawPoint)
+			: sizeof(LivoxLidarCartesianLowRawPoint));
+	}
+}
+
+PacketSlab::PacketSlab(size_t point_capacity, LivoxLidarPointDataType data_type)
+	: storage_(nullptr)
+	, slot_bytes_(0)
+	, payload_bytes_(0)
+	, data_type_(data_type)
+	, timed_(false)
+	, points_written_(0)
+	, cursor_packet_(0)
+	, cursor_offset_(0)
+	, cursor_point_(0)
+	, transformed_(false)
+{
+	discard_.resize(kPointsPerSlot);
+	relayout(slotsFor(point_capacity), payloadBytesFor(data_type));
+}
+
+PacketSlab::~PacketSlab()
+{
+	::operator delete(storage_, std::align_val_t(SpscRingIndex::kCacheLine));
+}
+
+void
+PacketSlab::resize(size_t point_capacity)
+{
+	const size_t capacity = SpscRingIndex::roundCapacity(slotsFor(point_capacity));
+	if (capacity != index_.capacity())
+	{
+		relayout(capacity, payload_bytes_);
+	}
+}
+
+size_t
+PacketSlab::pointCapacity() const
+{
+	return index_.capacity() * kPointsPerSlot;
+}
+
+void
+PacketSlab::setDataType(LivoxLidarPointDataType data_type)
+{
+	if (data_type == data_type_)
+	{
+		return;
+	}
+	data_type_ = data_type;
+	const size_t limit = index_.limit();
+	relayout(index_.capacity(), payloadBytesFor(data_type));
+	index_.setLimit(limit);
+}
+
+LivoxLidarPointDataType
+PacketSlab::dataType() const
+{
+	return data_type_;
+}
+
+size_t
+PacketSlab::slotBytes() const
+{
+	return slot_bytes_;
+}
+
+void
+PacketSlab::setTimed(bool timed)
+{
+	if (timed == timed_)
+	{
+		return;
+	}
+	timed_ = timed;
+	const size_t limit = index_.limit();
+	index_.clear();
+	relayout(index_.capacity(), payload_bytes_);
+	index_.setLimit(limit);
+}
+
+bool
+PacketSlab::timed() const
+{
+	return timed_;
+}
+
+void
+PacketSlab::setLimit(size_t point_limit)
+{
+	index_.setLimit(slotsFor(point_limit));
+}
+
+size_t
+PacketSlab::push(const LivoxLidarEthernetPacket* packet, LivoxLidarPointDataType data_type, const PacketStamp& stamp)
+{
+	return push(packet->data, packet->dot_num, data_type, stamp);
+}
+
+size_t
+PacketSlab::push(const uint8_t* records, size_t count, LivoxLidarPointDataType data_type, const PacketStamp& stamp, const uint64_t* times)
+{
+	const uint64_t first_point = points_written_.load(std::memory_order_relaxed);
+	return append(records, count, static_cast<uint8_t>(data_type), stamp, times, first_point);
+}
+
+size_t
+PacketSlab::consume(const PointColumns& destination, size_t max_points)
+{
+	if (max_points == 0)
+	{
+		return 0;
+	}
+
+	for (;;)
+	{
+		size_t available = 0;
+		const uint64_t read = index_.beginRead(available);
+		size_t offset = read == cursor_packet_ ? cursor_offset_ : 0;
+		size_t produced = 0;
+		size_t finished = 0;
+		uint64_t next_point = cursor_point_.load(std::memory_order_relaxed);
+
+		while (finished < available && produced < max_points)
+		{
+			// A slot the producer is overwriting can read back torn; slotPoints()
+			// keeps the decode in bounds until commitRead() rejects the pass.
+			const SlotHeader slot = header(read + finished);
+			const size_t points = slotPoints(read + finished, slot);
+			const size_t remaining = points - std::min(offset, points);
+			const size_t take = std::min(remaining, max_points - produced);
+			produced += decodeSlot(read + finished, slot, offset, take, destination.offset(produced));
+			next_point = slot.stamp.first_point + offset + take;
+			// The newest slot is never released, as a timed slab may still be
+			// adding records to it.
+			if (take < remaining || finished + 1 == available)
+			{
+				offset += take;
+				break;
+			}
+			++finished;
+			offset = 0;
+		}
+
+		if (index_.commitRead(read, finished))
+		{
+			cursor_packet_ = read + finished;
+			cursor_offset_ = offset;
+			cursor_point_.store(next_point, std::memory_order_release);
+			return produced;
+		}
+	}
+}
+
+size_t
+PacketSlab::trim(size_t keep)
+{
+	for (;;)
+	{
+		size_t available = 0;
+		const uint64_t read = index_.beginRead(available);
+		if (available == 0)
+		{
+			return 0;
+		}
+
+		const uint64_t oldest = oldestPoint(read);
+		const uint64_t end = slotEnd(read + available - 1);
+		if (end <= oldest || end - oldest <= keep)
+		{
+			return 0;
+		}
+
+		// Slot point ranges are contiguous and ascending; find the slot holding
+		// the first point to keep.
+		const uint64_t cut = end - keep;
+		uint64_t low = read;
+		uint64_t high = read + available;
+		while (low < high)
+		{
+			const uint64_t middle = low + (high - low) / 2;
+			if (slotEnd(middle) <= cut)
+			{
+				low = middle + 1;
+			}
+			else
+			{
+				high = middle;
+			}
+		}
+		low = std::min(low, read + available - 1);
+		const uint64_t first_point = header(low).stamp.first_point;
+		const size_t offset = static_cast<size_t>(cut - std::min(cut, first_point));
+
+		if (index_.commitRead(read, static_cast<size_t>(low - read)))
+		{
+			cursor_packet_ = low;
+			cursor_offset_ = offset;
+			cursor_point_.store(cut, std::memory_order_release);
+			return static_cast<size_t>(cut - oldest);
+		}
+	}
+}
+
+size_t
+PacketSlab::consumeDecimated(const PointColumns& destination, size_t max_points, size_t& skipped)
+{
+	skipped = 0;
+	if (max_points == 0)
+	{
+		return 0;
+	}
+
+	for (;;)
+	{
+		size_t available = 0;
+		const uint64_t read = index_.beginRead(available);
+		if (available == 0)
+		{
+			return 0;
+		}
+
+		const uint64_t oldest = oldestPoint(read);
+		const uint64_t end = slotEnd(read + available - 1);
+		const size_t span = end > oldest ? static_cast<size_t>(end - oldest) : 0;
+		if (span <= max_points)
+		{
+			return consume(destination, max_points);
+		}
+
+		// Decode the sampled points one at a time so the stepped-over ones are
+		// never converted.
+		uint64_t slot_index = read;
+		for (size_t i = 0; i < max_points; ++i)
+		{
+			const uint64_t point = oldest + (static_cast<uint64_t>(i) * span) / max_points;
+			while (slot_index + 1 < read + available && slotEnd(slot_index) <= point)
+			{
+				++slot_index;
+			}
+			const SlotHeader slot = header(slot_index);
+			const size_t last = std::max<size_t>(slotPoints(slot_index, slot), 1) - 1;
+			const size_t dot = static_cast<size_t>(std::min<uint64_t>(point - std::min(point, slot.stamp.first_point), last));
+			decodeSlot(slot_index, slot, dot, 1, destination.offset(i));
+		}
+
+		const uint64_t newest = read + available - 1;
+		const uint64_t newest_first = header(newest).stamp.first_point;
+		if (index_.commitRead(read, available - 1))
+		{
+			cursor_packet_ = newest;
+			cursor_offset_ = static_cast<size_t>(end - std::min(end, newest_first));
+			cursor_point_.store(end, std::memory_order_release);
+			skipped = span - max_points;
+			return max_points;
+		}
+	}
+}
+
+void
+PacketSlab::setTransform(const PointTransform* transform)
+{
+	transformed_ = transform != nullptr;
+	transform_ = transformed_ ? *transform : PointTransform();
+}
+
+size_t
+PacketSlab::size() const
+{
+	for (;;)
+	{
+		size_t available = 0;
+		const uint64_t read = index_.beginRead(available);
+		if (available == 0)
+		{
+			return 0;
+		}
+
+		const uint64_t first_point = header(read).stamp.first_point;
+		const size_t offset = read == cursor_packet_ ? cursor_offset_ : 0;
+		const uint64_t written = points_written_.load(std::memory_order_acquire);
+
+		size_t unchanged = 0;
+		if (index_.beginRead(unchanged) == read)
+		{
+			const uint64_t oldest = first_point + offset;
+			return written > oldest ? static_cast<size_t>(written - oldest) : 0;
+		}
+	}
+}
+
+void
+PacketSlab::clear()
+{
+	// The newest slot stays, emptied, like after a full consume().
+	for (;;)
+	{
+		size_t available = 0;
+		const uint64_t read = index_.beginRead(available);
+		if (available == 0)
+		{
+			return;
+		}
+
+		const uint64_t newest = read + available - 1;
+		const SlotHeader entry = header(newest);
+		const size_t points = slotPoints(newest, entry);
+		if (index_.commitRead(read, available - 1))
+		{
+			cursor_packet_ = newest;
+			cursor_offset_ = points;
+			cursor_point_.store(entry.stamp.first_point + points, std::memory_order_release);
+			return;
+		}
+	}
+}
+
+uint64_t
+PacketSlab::oldestPoint(uint64_t read) const
+{
+	const size_t offset = read == cursor_packet_ ? cursor_offset_ : 0;
+	return header(read).stamp.first_point + offset;
+}
+
+size_t
+PacketSlab::pointSize(uint8_t data_type)
+{
+	return data_type == kLivoxLidarCartesianCoordinateHighData
+		? sizeof(LivoxLidarCartesianHighRawPoint)
+		: sizeof(LivoxLidarCartesianLowRawPoint);
+}
+
+size_t
+PacketSlab::slotsFor(size_t point_capacity)
+{
+	return std::max<size_t>(1, (point_capacity + kPointsPerSlot - 1) / kPointsPerSlot);
+}
+
+void
+PacketSlab::relayout(size_t slot_capacity, size_t payload_bytes)
+{
+	slot_capacity = SpscRingIndex::roundCapacity(slot_capacity);
+	uint8_t* const previous = storage_;
+	const size_t previous_capacity = index_.capacity();
+	const size_t previous_bytes = slot_bytes_;
+	size_t available = 0;
+	const uint64_t read = index_.beginRead(available);
+	const size_t offset = read == cursor_packet_ ? cursor_offset_ : 0;
+	const uint64_t written = points_written_.load(std::memory_order_relaxed);
+
+	const size_t previous_payload = payload_bytes_;
+	const size_t offset_bytes = timed_ ? kPointsPerSlot * sizeof(uint32_t) : 0;
+	slot_bytes_ = (sizeof(SlotHeader) + payload_bytes + offset_bytes + kSlotAlignment - 1) / kSlotAlignment * kSlotAlignment;
+	payload_bytes_ = payload_bytes;
+	storage_ = static_cast<uint8_t*>(::operator new(slot_capacity * slot_bytes_, std::align_val_t(SpscRingIndex::kCacheLine)));
+	index_.reset(slot_capacity);
+	cursor_packet_ = 0;
+	cursor_offset_ = 0;
+
+	// Oldest first, so if the new layout needs more slots than it has, the
+	// oldest points are the ones evicted. Timed slots carry their records'
+	// times over exactly.
+	uint64_t times[kPointsPerSlot];
+	for (size_t i = 0; i < available; ++i)
+	{
+		const uint8_t* old = previous + static_cast<size_t>((read + i) & (previous_capacity - 1)) * previous_bytes;
+		SlotHeader old_header;
+		std::memcpy(&old_header, old, sizeof(SlotHeader));
+		size_t points = old_header.points;
+		if (timed_)
+		{
+			// A timed slot ends where the next one starts.
+			uint64_t end = written;
+			if (i + 1 < available)
+			{
+				SlotHeader next_header;
+				std::memcpy(&next_header, previous + static_cast<size_t>((read + i + 1) & (previous_capacity - 1)) * previous_bytes, sizeof(SlotHeader));
+				end = next_header.stamp.first_point;
+			}
+			points = static_cast<size_t>(std::min<uint64_t>(end - old_header.stamp.first_point, kPointsPerSlot));
+		}
+		const size_t skip = i == 0 ? std::min(offset, points) : 0;
+		PacketStamp stamp = old_header.stamp;
+		stamp.first_dot = static_cast<uint16_t>(stamp.first_dot + skip);
+		if (timed_)
+		{
+			const auto* offsets = reinterpret_cast<const uint32_t*>(old + sizeof(SlotHeader) + previous_payload);
+			for (size_t k = skip; k < points; ++k)
+			{
+				times[k - skip] = old_header.stamp.timestamp + offsets[k];
+			}
+		}
+		append(old + sizeof(SlotHeader) + skip * pointSize(old_header.data_type), points - skip, old_header.data_type, stamp, timed_ ? times : nullptr, old_header.stamp.first_point + skip);
+	}
+	::operator delete(previous, std::align_val_t(SpscRingIndex::kCacheLine));
+}
+
+size_t
+PacketSlab::append(const uint8_t* records, size_t count, uint8_t data_type, const PacketStamp& stamp, const uint64_t* times, uint64_t first_point)
+{
+	size_t evicted_points = 0;
+	// Records of the other data type are split to fit this layout's payload.
+	const size_t point_size = pointSize(data_type);
+	const size_t per_slot = std::min(kPointsPerSlot, payload_bytes_ / point_size);
+	size_t done = 0;
+	if (timed_)
+	{
+		// The consumer never releases the newest slot, so a timed slab fills
+		// it up with records of the same type whose times fit its offsets;
+		// the slot keeps the receive time of its first records.
+		size_t available = 0;
+		const uint64_t newest = index_.beginRead(available) + available - 1;
+		const SlotHeader entry = available > 0 ? header(newest) : SlotHeader();
+		const size_t held = static_cast<size_t>(first_point - entry.stamp.first_point);
+		if (available > 0 && entry.data_type == data_type && held < per_slot)
+		{
+			uint8_t* target = slot(newest);
+			auto* offsets = reinterpret_cast<uint32_t*>(target + sizeof(SlotHeader) + payload_bytes_) + held;
+			const size_t room = std::min(count, per_slot - held);
+			for (; done < room; ++done)
+			{
+				const uint64_t time = recordTime(stamp, times, done);
+				if (time < entry.stamp.timestamp || time - entry.stamp.timestamp > UINT32_MAX)
+				{
+					break;
+				}
+				offsets[done] = static_cast<uint32_t>(time - entry.stamp.timestamp);
+			}
+			std::memcpy(target + sizeof(SlotHeader) + held * point_size, records, done * point_size);
+			first_point += done;
+			points_written_.store(first_point, std::memory_order_release);
+		}
+	}
+
+	while (done < count)
+	{
+		const size_t chunk = std::min(count - done, per_slot);
+		SlotHeader entry = {};
+		entry.stamp = stamp;
+		entry.stamp.first_point = first_point;
+		entry.stamp.first_dot = static_cast<uint16_t>(stamp.first_dot + done);
+		entry.data_type = data_type;
+		entry.points = static_cast<uint8_t>(chunk);
+
+		size_t evicted = 0;
+		uint64_t evicted_end = 0;
+		const uint64_t write = index_.beginWrite(1, evicted, &evicted_end);
+		if (evicted > 0)
+		{
+			// The evicted slots are still intact: only this thread overwrites
+			// them, starting with the write below. Points the consumer already
+			// took from the front slot were delivered, not evicted.
+			const uint64_t oldest = std::max(header(evicted_end - evicted).stamp.first_point, cursor_point_.load(std::memory_order_acquire));
+			const uint64_t end = slotEnd(evicted_end - 1);
+			evicted_points += end > oldest ? static_cast<size_t>(end - oldest) : 0;
+		}
+		uint8_t* target = slot(write);
+		if (timed_)
+		{
+			// The slot's stamp time is its earliest record's, so every offset
+			// is positive.
+			entry.stamp.timestamp = recordTime(stamp, times, done);
+			for (size_t i = 1; i < chunk; ++i)
+			{
+				entry.stamp.timestamp = std::min(entry.stamp.timestamp, recordTime(stamp, times, done + i));
+			}
+			auto* offsets = reinterpret_cast<uint32_t*>(target + sizeof(SlotHeader) + payload_bytes_);
+			for (size_t i = 0; i < chunk; ++i)
+			{
+				offsets[i] = static_cast<uint32_t>(std::min<uint64_t>(recordTime(stamp, times, done + i) - entry.stamp.timestamp, UINT32_MAX));
+			}
+		}
+		std::memcpy(target, &entry, sizeof(SlotHeader));
+		std::memcpy(target + sizeof(SlotHeader), records + done * point_size, chunk * point_size);
+		index_.commitWrite(write, 1);
+
+		first_point += chunk;
+		done += chunk;
+		points_written_.store(first_point, std::memory_order_release);
+	}
+	return evicted_points;
+}
+
+uint8_t*
+PacketSlab::slot(uint64_t index) const
+{
+	return storage_ + index_.slot(index) * slot_bytes_;
+}
+
+PacketSlab::SlotHeader
+PacketSlab::header(uint64_t index) const
+{
+	SlotHeader header;
+	std::memcpy(&header, slot(index), sizeof(SlotHeader));
+	return header;
+}
+
+size_t
+PacketSlab::slotPoints(uint64_t index, const SlotHeader& entry) const
+{
+	size_t points = entry.points;
+	if (timed_)
+	{
+		// A timed slot ends where the next one starts or, while it is the
+		// newest, at the points published so far. Loading that count before
+		// the write index keeps it from running past the slots seen.
+		const uint64_t written = points_written_.load(std::memory_order_acquire);
+		size_t available = 0;
+		const uint64_t write = index_.beginRead(available) + available;
+		const uint64_t end = index + 1 < write ? header(index + 1).stamp.first_point : written;
+		points = end > entry.stamp.first_point ? static_cast<size_t>(end - entry.stamp.first_point) : 0;
+	}
+	return std::min<size_t>(points, std::min(kPointsPerSlot, payload_bytes_ / pointSize(entry.data_type)));
+}
+
+uint64_t
+PacketSlab::slotEnd(uint64_t index) const
+{
+	const SlotHeader slot = header(index);
+	return slot.stamp.first_point + slotPoints(index, slot);
+}
+
+size_t
+PacketSlab::decodeSlot(uint64_t index, const SlotHeader& slot, size_t offset, size_t count, const PointColumns& destination)
+{
+	if (count == 0)
+	{
+		return 0;
+	}
+
+	// The decoder writes every float column; route the ones the caller did not
+	// ask for into a per-slot scratch block.
+	const PointColumns scratch = discard_.columns();
+	PointColumns target = destination;
+	target.x = target.x != nullptr ? target.x : scratch.x;
+	target.y = target.y != nullptr ? target.y : scratch.y;
+	target.z = target.z != nullptr ? target.z : scratch.z;
+	target.intensity = target.intensity != nullptr ? target.intensity : scratch.intensity;
+	target.tag = target.tag != nullptr ? target.tag : scratch.tag;
+
+	const uint8_t* payload = this->slot(index) + sizeof(SlotHeader);
+	if (slot.data_type == kLivoxLidarCartesianCoordinateHighData)
+	{
+		const auto* points = reinterpret_cast<const LivoxLidarCartesianHighRawPoint*>(payload);
+		PointDecoder::decodeHigh(points + offset, count, target, transformed_ ? &transform_ : nullptr);
+	}
+	else
+	{
+		const auto* points = reinterpret_cast<const LivoxLidarCartesianLowRawPoint*>(payload);
+		PointDecoder::decodeLow(points + offset, count, target, transformed_ ? &transform_ : nullptr);
+	}
+
+	if (destination.timestamp != nullptr && timed_)
+	{
+		const auto* offsets = reinterpret_cast<const uint32_t*>(payload + payload_bytes_) + offset;
+		for (size_t i = 0; i < count; ++i)
+		{
+			destination.timestamp[i] = slot.stamp.timestamp + offsets[i];
+		}
+	}
+	else if (destination.timestamp != nullptr)
+	{
+		for (size_t i = 0; i < count; ++i)
+		{
+			destination.timestamp[i] = slot.stamp.pointTime(slot.stamp.first_dot + offset + i);
+		}
+	}
+	if (destination.received != nullptr)
+	{
+		std::fill(destination.received, destination.received + count, slot.stamp.received);
+	}
+	return count;
+}
@@ -0,0 +1,143 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+#include "livox_lidar_api.h"
+#include "PointDecoder.h"
+#include "PointRing.h"
+#include "SpscRing.h"
+
+// Lock-free slab of raw Livox Cartesian packets. The SDK thread copies packet
+// payloads verbatim into preallocated slots; points are decoded only when the
+// cook thread drains them, so points evicted before any cook reads them are
+// never converted.
+//
+// Slots are sized for the record size of one data type, so a Low slab costs
+// about 8.4 bytes per point against 14.4 for High. Packets of the other type
+// are still stored, split over as many slots as their records need, until
+// setDataType() lays the slab out for them. A timed slab also keeps a 32-bit
+// time offset per record, 4 bytes per point more, for records that no longer
+// sit at their packet positions, such as the spatial filter's survivors. As
+// those come a few per packet, a timed push first fills up the newest slot,
+// so the slots stay full and the limit holds as many points as unfiltered.
+class PacketSlab
+{
+public:
+	// A Mid-360 Cartesian packet carries at most 96 points; larger packets are
+	// split over consecutive slots.
+	static constexpr size_t kPointsPerSlot = 96;
+
+	explicit PacketSlab(size_t point_capacity, LivoxLidarPointDataType data_type = kLivoxLidarCartesianCoordinateHighData);
+	~PacketSlab();
+
+	PacketSlab(const PacketSlab&) = delete;
+	PacketSlab& operator=(const PacketSlab&) = delete;
+
+	// Reallocates the slab for at least point_capacity points keeping the
+	// newest packets. Not thread-safe: the producer must be quiescent.
+	void resize(size_t point_capacity);
+	size_t pointCapacity() const;
+
+	// Re-lays the slots out for data_type records, keeping the buffered
+	// points and the limit. Not thread-safe: the producer must be quiescent.
+	void setDataType(LivoxLidarPointDataType data_type);
+	LivoxLidarPointDataType dataType() const;
+	size_t slotBytes() const;
+
+	// Lays the slots out with or without per-record time offsets, dropping the
+	// buffered points. Not thread-safe: the producer must be quiescent.
+	void setTimed(bool timed);
+	bool timed() const;
+
+	// Consumer: caps the slab at the slots needed for point_limit points,
+	// evicting the oldest packets in O(1).
+	void setLimit(size_t point_limit);
+
+	// Producer: copies the packet payload into the slab. first_point and
+	// first_dot of stamp are filled in here. Returns the number of points
+	// evicted to make room.
+	size_t push(const LivoxLidarEthernetPacket* packet, LivoxLidarPointDataType data_type, const PacketStamp& stamp);
+	// Same for count raw point records laid out as in a packet payload. A
+	// timed slab takes each record's time from times when it is set; other
+	// slabs always use the packet timing in stamp.
+	size_t push(const uint8_t* records, size_t count, LivoxLidarPointDataType data_type, const PacketStamp& stamp, const uint64_t* times = nullptr);
+
+	// Consumer: decodes up to max_points of the oldest points into the non-null
+	// destination columns, reconstructing per-point timestamps and receive times.
+	size_t consume(const PointColumns& destination, size_t max_points);
+
+	// Consumer: drops the oldest points so that at most keep remain, without
+	// decoding them. Finds the cut by binary search over the slot headers.
+	// Returns the number of dropped points.
+	size_t trim(size_t keep);
+
+	// Consumer: drains the whole backlog, decoding only max_points of it
+	// sampled at a uniform stride (everything if it fits). skipped receives the
+	// number of points stepped over.
+	size_t consumeDecimated(const PointColumns& destination, size_t max_points, size_t& skipped);
+
+	// Consumer: transform applied by the decode in consume(); null for none.
+	void setTransform(const PointTransform* transform);
+
+	// Consumer: number of points currently buffered.
+	size_t size() const;
+
+	// Consumer: drops everything currently buffered. Like the other consumer
+	// calls, it keeps the newest slot, emptied, for a timed push to fill.
+	void clear();
+
+private:
+	// Precedes each slot's payload. The stamp describes the whole packet, so
+	// per-point times stay exact; points is the slot's own share of it, which
+	// starts at packet position stamp.first_dot. In a timed slab the records
+	// are followed by their time offsets from stamp.timestamp instead, and a
+	// slot's records run up to the next slot's first point, since the newest
+	// slot keeps taking records after its header is written.
+	struct SlotHeader
+	{
+		PacketStamp stamp;
+		uint8_t data_type;
+		uint8_t points;
+		uint8_t reserved[6];
+	};
+
+	static size_t pointSize(uint8_t data_type);
+	static size_t slotsFor(size_t point_capacity);
+
+	// Rebuilds the storage with slot_capacity slots of payload_bytes each and
+	// re-appends the buffered points, oldest first.
+	void relayout(size_t slot_capacity, size_t payload_bytes);
+	size_t append(const uint8_t* records, size_t count, uint8_t data_type, const PacketStamp& stamp, const uint64_t* times, uint64_t first_point);
+
+	uint8_t* slot(uint64_t index) const;
+	// Copies a slot header out once; callers size and decode the slot from the
+	// same copy so a racing overwrite cannot change the record size between.
+	SlotHeader header(uint64_t index) const;
+	// Points slot index holds; clamped so a slot torn by a racing eviction
+	// still decodes within its payload.
+	size_t slotPoints(uint64_t index, const SlotHeader& entry) const;
+	uint64_t slotEnd(uint64_t index) const;
+	uint64_t oldestPoint(uint64_t read) const;
+	size_t decodeSlot(uint64_t index, const SlotHeader& header, size_t offset, size_t count, const PointColumns& destination);
+
+	uint8_t* storage_;
+	size_t slot_bytes_;
+	// Record bytes per slot; a timed slot's offsets follow them.
+	size_t payload_bytes_;
+	LivoxLidarPointDataType data_type_;
+	bool timed_;
+	SpscRingIndex index_;
+	std::atomic<uint64_t> points_written_;
+
+	// Consumer-side cursor into the front packet when a cook stopped mid-packet.
+	uint64_t cursor_packet_;
+	size_t cursor_offset_;
+	// First point the consumer has not taken yet, so the producer does not
+	// count a partly drained slot's delivered points as evicted.
+	std::atomic<uint64_t> cursor_point_;
+	PointBlock discard_;
+	PointTransform transform_;
+	bool transformed_;
+};
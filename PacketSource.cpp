@@ -0,0 +1,45 @@
+#include "PacketSource.h"
+
+#include <cstddef>
+
+void
+PacketSource::seek(double)
+{
+}
+
+double
+PacketSource::position() const
+{
+	return 0.0;
+}
+
+double
+PacketSource::duration() const
+{
+	return 0.0;
+}
+
+size_t
+PacketSource::packetSize(const LivoxLidarEthernetPacket* packet)
+{
+	return packetSize(packet->data_type, packet->dot_num);
+}
+
+size_t
+PacketSource::packetSize(uint8_t data_type, size_t dot_num)
+{
+	size_t point_size = 0;
+	if (data_type == kLivoxLidarCartesianCoordinateHighData)
+	{
+		point_size = sizeof(LivoxLidarCartesianHighRawPoint);
+	}
+	else if (data_type == kLivoxLidarCartesianCoordinateLowData)
+	{
+		point_size = sizeof(LivoxLidarCartesianLowRawPoint);
+	}
+	else
+	{
+		return 0;
+	}
+	return offsetof(LivoxLidarEthernetPacket, data) + dot_num * point_size;
+}
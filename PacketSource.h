@@ -0,0 +1,57 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "livox_lidar_api.h"
+
+// Receiver of everything a packet source produces. Calls arrive on the
+// source's own thread.
+class PacketSink
+{
+public:
+	virtual ~PacketSink() = default;
+
+	virtual void onPacket(uint32_t handle, const LivoxLidarEthernetPacket* packet) = 0;
+	// kLivoxLidarImuData packets. They may arrive on a different thread from
+	// the same lidar's point packets.
+	virtual void onImuPacket(uint32_t handle, const LivoxLidarEthernetPacket* packet) = 0;
+	virtual void onLidarInfo(uint32_t handle, const std::string& serial, const std::string& ip) = 0;
+	virtual void onInfoMessage(const std::string& message) = 0;
+	virtual void onStatus(const std::string& text) = 0;
+};
+
+// Where LivoxDevice gets its point packets from: the Livox SDK, a synthetic
+// generator or a recorded file. Every source hands LivoxLidarEthernetPacket
+// buffers to the same sink, so buffering and decode behave identically
+// whichever one is active.
+class PacketSource
+{
+public:
+	virtual ~PacketSource() = default;
+
+	// Starts delivering to sink. On failure, reports why through
+	// sink.onStatus() and returns false.
+	virtual bool start(PacketSink& sink) = 0;
+
+	// Stops delivery; the sink is not called again once this returns.
+	virtual void stop() = 0;
+
+	// Asks the lidar for the given point format. Sources that replay fixed
+	// data ignore it.
+	virtual void requestDataType(uint32_t handle, LivoxLidarPointDataType type) = 0;
+
+	virtual std::string description() const = 0;
+
+	// Playback control, in seconds from the start of a recording. Live
+	// sources ignore seek() and report 0.
+	virtual void seek(double seconds);
+	virtual double position() const;
+	virtual double duration() const;
+
+	// Bytes of a Cartesian point packet including its header, or 0 for any
+	// other data type.
+	static size_t packetSize(const LivoxLidarEthernetPacket* packet);
+	static size_t packetSize(uint8_t data_type, size_t dot_num);
+};
@@ -9,6 +9,42 @@ Parameters::evalActive(const OP_Inputs* input)
 	return input->getParInt(ActiveName);
 }
 
+SourceMenuItems
+Parameters::evalSource(const OP_Inputs* input)
+{
+	return static_cast<SourceMenuItems>(input->getParInt(SourceName));
+}
+
+double
+Parameters::evalSyntheticRate(const OP_Inputs* input)
+{
+	return input->getParDouble(SyntheticRateName);
+}
+
+int
+Parameters::evalPcapPort(const OP_Inputs* input)
+{
+	return input->getParInt(PcapPortName);
+}
+
+double
+Parameters::evalReplaySpeed(const OP_Inputs* input)
+{
+	return input->getParDouble(ReplaySpeedName);
+}
+
+int
+Parameters::evalReplayLoop(const OP_Inputs* input)
+{
+	return input->getParInt(ReplayLoopName);
+}
+
+double
+Parameters::evalReplayPosition(const OP_Inputs* input)
+{
+	return input->getParDouble(ReplayPositionName);
+}
+
 int
 Parameters::evalPointsPerFrame(const OP_Inputs* input)
 {
@@ -33,6 +69,120 @@ Parameters::evalPointData(const OP_Inputs* input)
 	return static_cast<PointDataMenuItems>(input->getParInt(DataTypeName));
 }
 
+StorageMenuItems
+Parameters::evalStorage(const OP_Inputs* input)
+{
+	return static_cast<StorageMenuItems>(input->getParInt(StorageName));
+}
+
+DrainPolicyMenuItems
+Parameters::evalDrainPolicy(const OP_Inputs* input)
+{
+	return static_cast<DrainPolicyMenuItems>(input->getParInt(DrainPolicyName));
+}
+
+int
+Parameters::evalAdaptiveDrain(const OP_Inputs* input)
+{
+	return input->getParInt(AdaptiveDrainName);
+}
+
+double
+Parameters::evalTargetLatency(const OP_Inputs* input)
+{
+	return input->getParDouble(TargetLatencyName);
+}
+
+OutputModeMenuItems
+Parameters::evalOutputMode(const OP_Inputs* input)
+{
+	return static_cast<OutputModeMenuItems>(input->getParInt(OutputModeName));
+}
+
+double
+Parameters::evalFrameDuration(const OP_Inputs* input)
+{
+	return input->getParDouble(FrameDurationName);
+}
+
+int
+Parameters::evalDeskew(const OP_Inputs* input)
+{
+	return input->getParInt(DeskewName);
+}
+
+double
+Parameters::evalVoxelSize(const OP_Inputs* input)
+{
+	return input->getParDouble(VoxelSizeName);
+}
+
+double
+Parameters::evalVoxelWindow(const OP_Inputs* input)
+{
+	return input->getParDouble(VoxelWindowName);
+}
+
+int
+Parameters::evalCrop(const OP_Inputs* input)
+{
+	return input->getParInt(CropName);
+}
+
+double
+Parameters::evalCropMin(const OP_Inputs* input, int axis)
+{
+	return input->getParDouble(CropMinName, axis);
+}
+
+double
+Parameters::evalCropMax(const OP_Inputs* input, int axis)
+{
+	return input->getParDouble(CropMaxName, axis);
+}
+
+int
+Parameters::evalRangeGate(const OP_Inputs* input)
+{
+	return input->getParInt(RangeGateName);
+}
+
+double
+Parameters::evalRange(const OP_Inputs* input, int index)
+{
+	return input->getParDouble(RangeName, index);
+}
+
+int
+Parameters::evalSector(const OP_Inputs* input)
+{
+	return input->getParInt(SectorName);
+}
+
+double
+Parameters::evalAzimuth(const OP_Inputs* input, int index)
+{
+	return input->getParDouble(AzimuthName, index);
+}
+
+double
+Parameters::evalElevation(const OP_Inputs* input, int index)
+{
+	return input->getParDouble(ElevationName, index);
+}
+
+int
+Parameters::evalRecordCompress(const OP_Inputs* input)
+{
+	return input->getParInt(RecordCompressName);
+}
+
+int
+Parameters::evalImuChannels(const OP_Inputs* input)
+{
+	return input->getParInt(ImuChannelsName);
+}
+
 void
 Parameters::setup(OP_ParameterManager* manager)
 {
@@ -47,6 +197,19 @@ Parameters::setup(OP_ParameterManager* manager)
 		assert(res == OP_ParAppendResult::Success);
 	}
 
+	// Packet source menu
+	{
+		OP_StringParameter sp;
+		sp.name = SourceName;
+		sp.label = SourceLabel;
+		sp.page = PageConnectionName;
+		sp.defaultValue = "Sensor";
+		std::array<const char*, 4> names = { "Sensor", "Synthetic", "Replay", "Pcap" };
+		std::array<const char*, 4> labels = { "Mid-360 (Livox SDK)", "Synthetic Generator", "Replay Recording", "Pcap Capture" };
+		const OP_ParAppendResult res = manager->appendMenu(sp, static_cast<int>(names.size()), names.data(), labels.data());
+		assert(res == OP_ParAppendResult::Success);
+	}
+
 	// Config path
 	{
 		OP_StringParameter sp;
@@ -58,6 +221,99 @@ Parameters::setup(OP_ParameterManager* manager)
 		assert(res == OP_ParAppendResult::Success);
 	}
 
+	// Synthetic rate scale
+	{
+		OP_NumericParameter np;
+		np.name = SyntheticRateName;
+		np.label = SyntheticRateLabel;
+		np.page = PageConnectionName;
+		np.defaultValues[0] = 1.0;
+		np.minValues[0] = 0.0;
+		np.clampMins[0] = true;
+		np.minSliders[0] = 0.0;
+		np.maxSliders[0] = 10.0;
+		const OP_ParAppendResult res = manager->appendFloat(np);
+		assert(res == OP_ParAppendResult::Success);
+	}
+
+	// Replay file
+	{
+		OP_StringParameter sp;
+		sp.name = ReplayFileName;
+		sp.label = ReplayFileLabel;
+		sp.page = PageConnectionName;
+		sp.defaultValue = "livox_packets.lvxp";
+		const OP_ParAppendResult res = manager->appendFile(sp);
+		assert(res == OP_ParAppendResult::Success);
+	}
+
+	// Pcap capture file
+	{
+		OP_StringParameter sp;
+		sp.name = PcapFileName;
+		sp.label = PcapFileLabel;
+		sp.page = PageConnectionName;
+		sp.defaultValue = "mid360.pcapng";
+		const OP_ParAppendResult res = manager->appendFile(sp);
+		assert(res == OP_ParAppendResult::Success);
+	}
+
+	// Pcap point-data port; 0 accepts any UDP port
+	{
+		OP_NumericParameter np;
+		np.name = PcapPortName;
+		np.label = PcapPortLabel;
+		np.page = PageConnectionName;
+		np.defaultValues[0] = 56301;
+		np.minValues[0] = 0;
+		np.clampMins[0] = true;
+		np.maxValues[0] = 65535;
+		np.clampMaxes[0] = true;
+		const OP_ParAppendResult res = manager->appendInt(np);
+		assert(res == OP_ParAppendResult::Success);
+	}
+
+	// Replay speed
+	{
+		OP_NumericParameter np;
+		np.name = ReplaySpeedName;
+		np.label = ReplaySpeedLabel;
+		np.page = PageConnectionName;
+		np.defaultValues[0] = 1.0;
+		np.minValues[0] = 0.0;
+		np.clampMins[0] = true;
+		np.minSliders[0] = 0.0;
+		np.maxSliders[0] = 10.0;
+		const OP_ParAppendResult res = manager->appendFloat(np);
+		assert(res == OP_ParAppendResult::Success);
+	}
+
+	// Replay loop toggle
+	{
+		OP_NumericParameter np;
+		np.name = ReplayLoopName;
+		np.label = ReplayLoopLabel;
+		np.page = PageConnectionName;
+		np.defaultValues[0] = 0;
+		const OP_ParAppendResult res = manager->appendToggle(np);
+		assert(res == OP_ParAppendResult::Success);
+	}
+
+	// Replay position, seconds
+	{
+		OP_NumericParameter np;
+		np.name = ReplayPositionName;
+		np.label = ReplayPositionLabel;
+		np.page = PageConnectionName;
+		np.defaultValues[0] = 0.0;
+		np.minValues[0] = 0.0;
+		np.clampMins[0] = true;
+		np.minSliders[0] = 0.0;
+		np.maxSliders[0] = 600.0;
+		const OP_ParAppendResult res = manager->appendFloat(np);
+		assert(res == OP_ParAppendResult::Success);
+	}
+
 	// Points per frame
 	{
 		OP_NumericParameter np;
@@ -86,6 +342,250 @@ Parameters::setup(OP_ParameterManager* manager)
 		assert(res == OP_ParAppendResult::Success);
 	}
 
+	// Buffer storage menu
+	{
+		OP_StringParameter sp;
+		sp.name = StorageName;
+		sp.label = StorageLabel;
+		sp.page = PageStreamingName;
+		sp.defaultValue = "Decoded";
+		std::array<const char*, 2> names = { "Decoded", "Raw" };
+		std::array<const char*, 2> labels = { "Decoded Points", "Raw Packets (decode on cook)" };
+		const OP_ParAppendResult res = manager->appendMenu(sp, static_cast<int>(names.size()), names.data(), labels.data());
+		assert(res == OP_ParAppendResult::Success);
+	}
+
+	// Drain policy menu
+	{
+		OP_StringParameter sp;
+		sp.name = DrainPolicyName;
+		sp.label = DrainPolicyLabel;
+		sp.page = PageStreamingName;
+		sp.defaultValue = "Oldest";
+		std::array<const char*, 3> names = { "Oldest", "Newest", "Decimate" };
+		std::array<const char*, 3> labels = { "Oldest First (FIFO)", "Newest, Drop Backlog", "Newest, Decimate Backlog" };
+		const OP_ParAppendResult res = manager->appendMenu(sp, static_cast<int>(names.size()), names.data(), labels.data());
+		assert(res == OP_ParAppendResult::Success);
+	}
+
+	// Adaptive drain toggle
+	{
+		OP_NumericParameter np;
+		np.name = AdaptiveDrainName;
+		np.label = AdaptiveDrainLabel;
+		np.page = PageStreamingName;
+		np.defaultValues[0] = 0;
+		const OP_ParAppendResult res = manager->appendToggle(np);
+		assert(res == OP_ParAppendResult::Success);
+	}
+
+	// Target latency
+	{
+		OP_NumericParameter np;
+		np.name = TargetLatencyName;
+		np.label = TargetLatencyLabel;
+		np.page = PageStreamingName;
+		np.defaultValues[0] = 50.0;
+		np.minValues[0] = 0.0;
+		np.clampMins[0] = true;
+		np.minSliders[0] = 0.0;
+		np.maxSliders[0] = 500.0;
+		const OP_ParAppendResult res = manager->appendFloat(np);
+		assert(res == OP_ParAppendResult::Success);
+	}
+
+	// Output mode menu
+	{
+		OP_StringParameter sp;
+		sp.name = OutputModeName;
+		sp.label = OutputModeLabel;
+		sp.page = PageStreamingName;
+		sp.defaultValue = "Stream";
+		std::array<const char*, 2> names = { "Stream", "Frames" };
+		std::array<const char*, 2> labels = { "Stream (FIFO)", "Complete Frames" };
+		const OP_ParAppendResult res = manager->appendMenu(sp, static_cast<int>(names.size()), names.data(), labels.data());
+		assert(res == OP_ParAppendResult::Success);
+	}
+
+	// Frame duration
+	{
+		OP_NumericParameter np;
+		np.name = FrameDurationName;
+		np.label = FrameDurationLabel;
+		np.page = PageStreamingName;
+		np.defaultValues[0] = 100.0;
+		np.minValues[0] = 1.0;
+		np.clampMins[0] = true;
+		np.minSliders[0] = 10.0;
+		np.maxSliders[0] = 1000.0;
+		const OP_ParAppendResult res = manager->appendFloat(np);
+		assert(res == OP_ParAppendResult::Success);
+	}
+
+	// IMU motion de-skew of complete frames
+	{
+		OP_NumericParameter np;
+		np.name = DeskewName;
+		np.label = DeskewLabel;
+		np.page = PageStreamingName;
+		np.defaultValues[0] = 0;
+		const OP_ParAppendResult res = manager->appendToggle(np);
+		assert(res == OP_ParAppendResult::Success);
+	}
+
+	// Voxel-grid downsampling leaf size, 0 = off. Not applied to Raw Packets
+	// storage in Stream mode, which keeps packets undecoded.
+	{
+		OP_NumericParameter np;
+		np.name = VoxelSizeName;
+		np.label = VoxelSizeLabel;
+		np.page = PageStreamingName;
+		np.defaultValues[0] = 0.0;
+		np.minValues[0] = 0.0;
+		np.clampMins[0] = true;
+		np.minSliders[0] = 0.0;
+		np.maxSliders[0] = 0.5;
+		const OP_ParAppendResult res = manager->appendFloat(np);
+		assert(res == OP_ParAppendResult::Success);
+	}
+
+	// Lidar time gathered per voxel window in Stream mode
+	{
+		OP_NumericParameter np;
+		np.name = VoxelWindowName;
+		np.label = VoxelWindowLabel;
+		np.page = PageStreamingName;
+		np.defaultValues[0] = 5.0;
+		np.minValues[0] = 0.0;
+		np.clampMins[0] = true;
+		np.minSliders[0] = 0.0;
+		np.maxSliders[0] = 100.0;
+		const OP_ParAppendResult res = manager->appendFloat(np);
+		assert(res == OP_ParAppendResult::Success);
+	}
+
+	// Crop box toggle
+	{
+		OP_NumericParameter np;
+		np.name = CropName;
+		np.label = CropLabel;
+		np.page = PageFilterName;
+		np.defaultValues[0] = 0;
+		const OP_ParAppendResult res = manager->appendToggle(np);
+		assert(res == OP_ParAppendResult::Success);
+	}
+
+	// Crop box lower corner, metres in the output frame
+	{
+		OP_NumericParameter np;
+		np.name = CropMinName;
+		np.label = CropMinLabel;
+		np.page = PageFilterName;
+		for (int axis = 0; axis < 3; ++axis)
+		{
+			np.defaultValues[axis] = -5.0;
+			np.minSliders[axis] = -20.0;
+			np.maxSliders[axis] = 20.0;
+		}
+		const OP_ParAppendResult res = manager->appendXYZ(np);
+		assert(res == OP_ParAppendResult::Success);
+	}
+
+	// Crop box upper corner
+	{
+		OP_NumericParameter np;
+		np.name = CropMaxName;
+		np.label = CropMaxLabel;
+		np.page = PageFilterName;
+		for (int axis = 0; axis < 3; ++axis)
+		{
+			np.defaultValues[axis] = 5.0;
+			np.minSliders[axis] = -20.0;
+			np.maxSliders[axis] = 20.0;
+		}
+		const OP_ParAppendResult res = manager->appendXYZ(np);
+		assert(res == OP_ParAppendResult::Success);
+	}
+
+	// Range gate toggle
+	{
+		OP_NumericParameter np;
+		np.name = RangeGateName;
+		np.label = RangeGateLabel;
+		np.page = PageFilterName;
+		np.defaultValues[0] = 0;
+		const OP_ParAppendResult res = manager->appendToggle(np);
+		assert(res == OP_ParAppendResult::Success);
+	}
+
+	// Range gate min/max distance
+	{
+		OP_NumericParameter np;
+		np.name = RangeName;
+		np.label = RangeLabel;
+		np.page = PageFilterName;
+		np.defaultValues[0] = 0.1;
+		np.defaultValues[1] = 70.0;
+		for (int i = 0; i < 2; ++i)
+		{
+			np.minValues[i] = 0.0;
+			np.clampMins[i] = true;
+			np.minSliders[i] = 0.0;
+			np.maxSliders[i] = 70.0;
+		}
+		const OP_ParAppendResult res = manager->appendFloat(np, 2);
+		assert(res == OP_ParAppendResult::Success);
+	}
+
+	// Sector mask toggle
+	{
+		OP_NumericParameter np;
+		np.name = SectorName;
+		np.label = SectorLabel;
+		np.page = PageFilterName;
+		np.defaultValues[0] = 0;
+		const OP_ParAppendResult res = manager->appendToggle(np);
+		assert(res == OP_ParAppendResult::Success);
+	}
+
+	// Sector azimuth interval, counter-clockwise from the first value
+	{
+		OP_NumericParameter np;
+		np.name = AzimuthName;
+		np.label = AzimuthLabel;
+		np.page = PageFilterName;
+		np.defaultValues[0] = -180.0;
+		np.defaultValues[1] = 180.0;
+		for (int i = 0; i < 2; ++i)
+		{
+			np.minSliders[i] = -180.0;
+			np.maxSliders[i] = 180.0;
+		}
+		const OP_ParAppendResult res = manager->appendFloat(np, 2);
+		assert(res == OP_ParAppendResult::Success);
+	}
+
+	// Sector elevation interval
+	{
+		OP_NumericParameter np;
+		np.name = ElevationName;
+		np.label = ElevationLabel;
+		np.page = PageFilterName;
+		np.defaultValues[0] = -90.0;
+		np.defaultValues[1] = 90.0;
+		for (int i = 0; i < 2; ++i)
+		{
+			np.minValues[i] = -90.0;
+			np.maxValues[i] = 90.0;
+			np.clampMins[i] = true;
+			np.clampMaxes[i] = true;
+			np.minSliders[i] = -90.0;
+			np.maxSliders[i] = 90.0;
+		}
+		const OP_ParAppendResult res = manager->appendFloat(np, 2);
+		assert(res == OP_ParAppendResult::Success);
+	}
+
 	// Data type menu
 	{
 		OP_StringParameter sp;
@@ -112,6 +612,27 @@ Parameters::setup(OP_ParameterManager* manager)
 		assert(res == OP_ParAppendResult::Success);
 	}
 
+	// Per-lidar extrinsics table
+	{
+		OP_StringParameter sp;
+		sp.name = ExtrinsicsName;
+		sp.label = ExtrinsicsLabel;
+		sp.page = PageOutputName;
+		const OP_ParAppendResult res = manager->appendDAT(sp);
+		assert(res == OP_ParAppendResult::Success);
+	}
+
+	// Per-point gyro/accel channels
+	{
+		OP_NumericParameter np;
+		np.name = ImuChannelsName;
+		np.label = ImuChannelsLabel;
+		np.page = PageOutputName;
+		np.defaultValues[0] = 0;
+		const OP_ParAppendResult res = manager->appendToggle(np);
+		assert(res == OP_ParAppendResult::Success);
+	}
+
 	// Reset pulse
 	{
 		OP_NumericParameter np;
@@ -121,4 +642,88 @@ Parameters::setup(OP_ParameterManager* manager)
 		const OP_ParAppendResult res = manager->appendPulse(np);
 		assert(res == OP_ParAppendResult::Success);
 	}
+
+	// Latency histogram dump file
+	{
+		OP_StringParameter sp;
+		sp.name = LatencyFileName;
+		sp.label = LatencyFileLabel;
+		sp.page = PageDiagnosticsName;
+		sp.defaultValue = "livox_latency.csv";
+		const OP_ParAppendResult res = manager->appendFile(sp);
+		assert(res == OP_ParAppendResult::Success);
+	}
+
+	// Latency histogram dump pulse
+	{
+		OP_NumericParameter np;
+		np.name = DumpLatencyName;
+		np.label = DumpLatencyLabel;
+		np.page = PageDiagnosticsName;
+		const OP_ParAppendResult res = manager->appendPulse(np);
+		assert(res == OP_ParAppendResult::Success);
+	}
+
+	// Packet recording file
+	{
+		OP_StringParameter sp;
+		sp.name = RecordFileName;
+		sp.label = RecordFileLabel;
+		sp.page = PageDiagnosticsName;
+		sp.defaultValue = "livox_packets.lvxp";
+		const OP_ParAppendResult res = manager->appendFile(sp);
+		assert(res == OP_ParAppendResult::Success);
+	}
+
+	// Recording compression toggle
+	{
+		OP_NumericParameter np;
+		np.name = RecordCompressName;
+		np.label = RecordCompressLabel;
+		np.page = PageDiagnosticsName;
+		np.defaultValues[0] = 1;
+		const OP_ParAppendResult res = manager->appendToggle(np);
+		assert(res == OP_ParAppendResult::Success);
+	}
+
+	// Recording start pulse
+	{
+		OP_NumericParameter np;
+		np.name = StartRecordingName;
+		np.label = StartRecordingLabel;
+		np.page = PageDiagnosticsName;
+		const OP_ParAppendResult res = manager->appendPulse(np);
+		assert(res == OP_ParAppendResult::Success);
+	}
+
+	// Recording stop pulse
+	{
+		OP_NumericParameter np;
+		np.name = StopRecordingName;
+		np.label = StopRecordingLabel;
+		np.page = PageDiagnosticsName;
+		const OP_ParAppendResult res = manager->appendPulse(np);
+		assert(res == OP_ParAppendResult::Success);
+	}
+
+	// Benchmark output file
+	{
+		OP_StringParameter sp;
+		sp.name = BenchmarkFileName;
+		sp.label = BenchmarkFileLabel;
+		sp.page = PageDiagnosticsName;
+		sp.defaultValue = "livox_benchmark.csv";
+		const OP_ParAppendResult res = manager->appendFile(sp);
+		assert(res == OP_ParAppendResult::Success);
+	}
+
+	// Benchmark pulse
+	{
+		OP_NumericParameter np;
+		np.name = RunBenchmarkName;
+		np.label = RunBenchmarkLabel;
+		np.page = PageDiagnosticsName;
+		const OP_ParAppendResult res = manager->appendPulse(np);
+		assert(res == OP_ParAppendResult::Success);
+	}
 }
@@ -7,28 +7,143 @@ class OP_ParameterManager;
 constexpr static char PageConnectionName[] = "Connection";
 constexpr static char PageStreamingName[] = "Streaming";
 constexpr static char PageOutputName[] = "Output";
+constexpr static char PageFilterName[] = "Filter";
+constexpr static char PageDiagnosticsName[] = "Diagnostics";
 
 constexpr static char ActiveName[] = "Active";
 constexpr static char ActiveLabel[] = "Active";
 
+constexpr static char SourceName[] = "Source";
+constexpr static char SourceLabel[] = "Packet Source";
+
 constexpr static char ConfigPathName[] = "Configpath";
 constexpr static char ConfigPathLabel[] = "Config File";
 
+constexpr static char SyntheticRateName[] = "Syntheticrate";
+constexpr static char SyntheticRateLabel[] = "Synthetic Rate Scale";
+
+constexpr static char ReplayFileName[] = "Replayfile";
+constexpr static char ReplayFileLabel[] = "Replay File";
+
+constexpr static char PcapFileName[] = "Pcapfile";
+constexpr static char PcapFileLabel[] = "Pcap File";
+
+constexpr static char PcapPortName[] = "Pcapport";
+constexpr static char PcapPortLabel[] = "Pcap Port";
+
+constexpr static char ReplaySpeedName[] = "Replayspeed";
+constexpr static char ReplaySpeedLabel[] = "Replay Speed";
+
+constexpr static char ReplayLoopName[] = "Replayloop";
+constexpr static char ReplayLoopLabel[] = "Replay Loop";
+
+constexpr static char ReplayPositionName[] = "Replayposition";
+constexpr static char ReplayPositionLabel[] = "Replay Position";
+
 constexpr static char PointsPerFrameName[] = "Pointsperframe";
 constexpr static char PointsPerFrameLabel[] = "Points Per Cook";
 
 constexpr static char BufferLimitName[] = "Bufferlimit";
 constexpr static char BufferLimitLabel[] = "Buffer Limit";
 
+constexpr static char StorageName[] = "Bufferstorage";
+constexpr static char StorageLabel[] = "Buffer Storage";
+
+constexpr static char DrainPolicyName[] = "Drainpolicy";
+constexpr static char DrainPolicyLabel[] = "Drain Policy";
+
+constexpr static char AdaptiveDrainName[] = "Adaptivedrain";
+constexpr static char AdaptiveDrainLabel[] = "Adaptive Drain";
+
+constexpr static char TargetLatencyName[] = "Targetlatency";
+constexpr static char TargetLatencyLabel[] = "Target Latency (ms)";
+
+constexpr static char OutputModeName[] = "Outputmode";
+constexpr static char OutputModeLabel[] = "Output Mode";
+
+constexpr static char FrameDurationName[] = "Frameduration";
+constexpr static char FrameDurationLabel[] = "Frame Duration (ms)";
+
+constexpr static char DeskewName[] = "Deskew";
+constexpr static char DeskewLabel[] = "Motion De-skew";
+
+constexpr static char VoxelSizeName[] = "Voxelsize";
+constexpr static char VoxelSizeLabel[] = "Voxel Size (m)";
+
+constexpr static char VoxelWindowName[] = "Voxelwindow";
+constexpr static char VoxelWindowLabel[] = "Voxel Window (ms)";
+
+constexpr static char CropName[] = "Crop";
+constexpr static char CropLabel[] = "Crop Box";
+
+constexpr static char CropMinName[] = "Cropmin";
+constexpr static char CropMinLabel[] = "Crop Min";
+
+constexpr static char CropMaxName[] = "Cropmax";
+constexpr static char CropMaxLabel[] = "Crop Max";
+
+constexpr static char RangeGateName[] = "Rangegate";
+constexpr static char RangeGateLabel[] = "Range Gate";
+
+constexpr static char RangeName[] = "Range";
+constexpr static char RangeLabel[] = "Range (m)";
+
+constexpr static char SectorName[] = "Sector";
+constexpr static char SectorLabel[] = "Sector Mask";
+
+constexpr static char AzimuthName[] = "Azimuth";
+constexpr static char AzimuthLabel[] = "Azimuth (deg)";
+
+constexpr static char ElevationName[] = "Elevation";
+constexpr static char ElevationLabel[] = "Elevation (deg)";
+
 constexpr static char DataTypeName[] = "Datatype";
 constexpr static char DataTypeLabel[] = "Point Data Type";
 
 constexpr static char CoordName[] = "Coordmode";
 constexpr static char CoordLabel[] = "Coordinate Output";
 
+constexpr static char ExtrinsicsName[] = "Extrinsics";
+constexpr static char ExtrinsicsLabel[] = "Extrinsics Table";
+
+constexpr static char ImuChannelsName[] = "Imuchannels";
+constexpr static char ImuChannelsLabel[] = "IMU Channels";
+
 constexpr static char ResetName[] = "Resetbuffer";
 constexpr static char ResetLabel[] = "Reset Buffer";
 
+constexpr static char LatencyFileName[] = "Latencyfile";
+constexpr static char LatencyFileLabel[] = "Latency Dump File";
+
+constexpr static char DumpLatencyName[] = "Dumplatency";
+constexpr static char DumpLatencyLabel[] = "Dump Latency Histogram";
+
+constexpr static char RecordFileName[] = "Recordfile";
+constexpr static char RecordFileLabel[] = "Record File";
+
+constexpr static char RecordCompressName[] = "Recordcompress";
+constexpr static char RecordCompressLabel[] = "Compress Recording";
+
+constexpr static char StartRecordingName[] = "Startrecording";
+constexpr static char StartRecordingLabel[] = "Start Recording";
+
+constexpr static char StopRecordingName[] = "Stoprecording";
+constexpr static char StopRecordingLabel[] = "Stop Recording";
+
+constexpr static char BenchmarkFileName[] = "Benchmarkfile";
+constexpr static char BenchmarkFileLabel[] = "Benchmark File";
+
+constexpr static char RunBenchmarkName[] = "Runbenchmark";
+constexpr static char RunBenchmarkLabel[] = "Run Benchmarks";
+
+enum class SourceMenuItems
+{
+	Sensor = 0,
+	Synthetic = 1,
+	Replay = 2,
+	Pcap = 3
+};
+
 enum class CoordMenuItems
 {
 	Cartesian = 0,
@@ -41,14 +156,58 @@ enum class PointDataMenuItems
 	Low = 1
 };
 
+enum class StorageMenuItems
+{
+	Decoded = 0,
+	Raw = 1
+};
+
+enum class DrainPolicyMenuItems
+{
+	Oldest = 0,
+	Newest = 1,
+	Decimate = 2
+};
+
+enum class OutputModeMenuItems
+{
+	Stream = 0,
+	Frames = 1
+};
+
 class Parameters
 {
 public:
 	static void setup(OP_ParameterManager* manager);
 
 	static int evalActive(const OP_Inputs* input);
+	static SourceMenuItems evalSource(const OP_Inputs* input);
+	static double evalSyntheticRate(const OP_Inputs* input);
+	static int evalPcapPort(const OP_Inputs* input);
+	static double evalReplaySpeed(const OP_Inputs* input);
+	static int evalReplayLoop(const OP_Inputs* input);
+	static double evalReplayPosition(const OP_Inputs* input);
 	static int evalPointsPerFrame(const OP_Inputs* input);
 	static int evalBufferLimit(const OP_Inputs* input);
 	static CoordMenuItems evalCoord(const OP_Inputs* input);
 	static PointDataMenuItems evalPointData(const OP_Inputs* input);
+	static StorageMenuItems evalStorage(const OP_Inputs* input);
+	static DrainPolicyMenuItems evalDrainPolicy(const OP_Inputs* input);
+	static int evalAdaptiveDrain(const OP_Inputs* input);
+	static double evalTargetLatency(const OP_Inputs* input);
+	static OutputModeMenuItems evalOutputMode(const OP_Inputs* input);
+	static double evalFrameDuration(const OP_Inputs* input);
+	static int evalDeskew(const OP_Inputs* input);
+	static double evalVoxelSize(const OP_Inputs* input);
+	static double evalVoxelWindow(const OP_Inputs* input);
+	static int evalCrop(const OP_Inputs* input);
+	static double evalCropMin(const OP_Inputs* input, int axis);
+	static double evalCropMax(const OP_Inputs* input, int axis);
+	static int evalRangeGate(const OP_Inputs* input);
+	static double evalRange(const OP_Inputs* input, int index);
+	static int evalSector(const OP_Inputs* input);
+	static double evalAzimuth(const OP_Inputs* input, int index);
+	static double evalElevation(const OP_Inputs* input, int index);
+	static int evalRecordCompress(const OP_Inputs* input);
+	static int evalImuChannels(const OP_Inputs* input);
 };
@@ -0,0 +1,540 @@
+#include "PcapPacketSource.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <sstream>
+#include <unordered_set>
+#include <vector>
+
+namespace
+{
+	constexpr auto kMaxSleep = std::chrono::milliseconds(10);
+
+	constexpr uint32_t kPcapMicros = 0xa1b2c3d4;
+	constexpr uint32_t kPcapNanos = 0xa1b23c4d;
+	constexpr uint32_t kPcapngSection = 0x0a0d0d0a;
+	constexpr uint32_t kPcapngByteOrder = 0x1a2b3c4d;
+
+	constexpr uint32_t kPcapngInterface = 1;
+	constexpr uint32_t kPcapngObsoletePacket = 2;
+	constexpr uint32_t kPcapngSimplePacket = 3;
+	constexpr uint32_t kPcapngEnhancedPacket = 6;
+	constexpr uint16_t kOptionEnd = 0;
+	constexpr uint16_t kOptionTsResol = 9;
+
+	// Link-layer types (tcpdump.org/linktypes.html).
+	constexpr uint32_t kLinkNull = 0;
+	constexpr uint32_t kLinkEthernet = 1;
+	constexpr uint32_t kLinkRaw = 101;
+	constexpr uint32_t kLinkLoop = 108;
+	constexpr uint32_t kLinkLinuxSll = 113;
+	constexpr uint32_t kLinkIpv4 = 228;
+	constexpr uint32_t kLinkLinuxSll2 = 276;
+
+	constexpr uint16_t kEtherIpv4 = 0x0800;
+	constexpr uint16_t kEtherVlan = 0x8100;
+	constexpr uint16_t kEtherQinQ = 0x88a8;
+	constexpr uint8_t kIpProtocolUdp = 17;
+	constexpr uint32_t kAfInet = 2;
+
+	constexpr uint64_t kNanosPerSecond = 1000000000;
+
+	uint16_t
+	readBe16(const uint8_t* p)
+	{
+		return static_cast<uint16_t>((p[0] << 8) | p[1]);
+	}
+
+	uint16_t
+	read16(const uint8_t* p, bool swap)
+	{
+		uint16_t value;
+		std::memcpy(&value, p, sizeof(value));
+		return swap ? static_cast<uint16_t>((value >> 8) | (value << 8)) : value;
+	}
+
+	uint32_t
+	read32(const uint8_t* p, bool swap)
+	{
+		uint32_t value;
+		std::memcpy(&value, p, sizeof(value));
+		if (swap)
+		{
+			value = (value >> 24) | ((value >> 8) & 0xff00) | ((value << 8) & 0xff0000) | (value << 24);
+		}
+		return value;
+	}
+
+	// Converts a timestamp in units of 10^-exponent (or 2^-exponent) seconds.
+	uint64_t
+	toNanos(uint64_t stamp, uint8_t resolution)
+	{
+		const uint8_t exponent = resolution & 0x7f;
+		if ((resolution & 0x80) != 0)
+		{
+			return static_cast<uint64_t>(static_cast<double>(stamp) * static_cast<double>(kNanosPerSecond) / static_cast<double>(uint64_t(1) << std::min<uint8_t>(exponent, 63)));
+		}
+		uint64_t scale = 1;
+		for (uint8_t i = exponent; i < 9; ++i)
+		{
+			scale *= 10;
+		}
+		for (uint8_t i = 9; i < exponent; ++i)
+		{
+			stamp /= 10;
+		}
+		return stamp * scale;
+	}
+
+	struct Frame
+	{
+		uint64_t time_ns = 0;
+		uint32_t link_type = 0;
+		const uint8_t* data = nullptr;
+		size_t size = 0;
+	};
+
+	// Walks the frames of a mapped pcap or pcapng file in place.
+	class CaptureReader
+	{
+	public:
+		CaptureReader(const uint8_t* data, size_t size)
+			: data_(data)
+			, size_(size)
+			, ng_(false)
+			, swap_(false)
+			, resolution_(6)
+			, link_type_(0)
+			, first_(0)
+			, offset_(0)
+			, last_time_(0)
+		{
+		}
+
+		bool open()
+		{
+			if (size_ < 24)
+			{
+				return false;
+			}
+			const uint32_t magic = read32(data_, false);
+			const uint32_t swapped = read32(data_, true);
+			if (magic == kPcapngSection)
+			{
+				ng_ = true;
+				first_ = 0;
+			}
+			else if (magic == kPcapMicros || magic == kPcapNanos || swapped == kPcapMicros || swapped == kPcapNanos)
+			{
+				swap_ = swapped == kPcapMicros || swapped == kPcapNanos;
+				resolution_ = (magic == kPcapNanos || swapped == kPcapNanos) ? 9 : 6;
+				link_type_ = read32(data_ + 20, swap_) & 0xffff;
+				first_ = 24;
+			}
+			else
+			{
+				return false;
+			}
+			rewind();
+			return true;
+		}
+
+		void rewind()
+		{
+			offset_ = first_;
+			interfaces_.clear();
+		}
+
+		// False at the end of the file or at the first malformed block.
+		bool next(Frame& frame)
+		{
+			return ng_ ? nextBlock(frame) : nextRecord(frame);
+		}
+
+	private:
+		struct Interface
+		{
+			uint32_t link_type;
+			uint8_t resolution;
+		};
+
+		bool nextRecord(Frame& frame)
+		{
+			if (offset_ + 16 > size_)
+			{
+				return false;
+			}
+			const uint8_t* record = data_ + offset_;
+			const uint64_t seconds = read32(record, swap_);
+			const uint64_t fraction = read32(record + 4, swap_);
+			const size_t captured = read32(record + 8, swap_);
+			if (captured > size_ - offset_ - 16)
+			{
+				return false;
+			}
+			frame.time_ns = seconds * kNanosPerSecond + toNanos(fraction, resolution_);
+			frame.link_type = link_type_;
+			frame.data = record + 16;
+			frame.size = captured;
+			offset_ += 16 + captured;
+			return true;
+		}
+
+		bool nextBlock(Frame& frame)
+		{
+			while (offset_ + 12 <= size_)
+			{
+				const uint8_t* block = data_ + offset_;
+				if (read32(block, false) == kPcapngSection)
+				{
+					// Each section sets its own byte order and interfaces.
+					const uint32_t order = read32(block + 8, false);
+					if (order != kPcapngByteOrder && read32(block + 8, true) != kPcapngByteOrder)
+					{
+						return false;
+					}
+					swap_ = order != kPcapngByteOrder;
+					interfaces_.clear();
+				}
+				const uint32_t type = read32(block, swap_);
+				const size_t length = read32(block + 4, swap_);
+				if (length < 12 || length % 4 != 0 || length > size_ - offset_)
+				{
+					return false;
+				}
+				offset_ += length;
+				const uint8_t* body = block + 8;
+				const size_t body_size = length - 12;
+
+				if (type == kPcapngInterface && body_size >= 8)
+				{
+					interfaces_.push_back({ read16(body, swap_), interfaceResolution(body + 8, body_size - 8) });
+				}
+				else if (type == kPcapngEnhancedPacket && body_size >= 20)
+				{
+					const uint32_t id = read32(body, swap_);
+					const size_t captured = read32(body + 12, swap_);
+					if (id < interfaces_.size() && captured <= body_size - 20)
+					{
+						const uint64_t stamp = (static_cast<uint64_t>(read32(body + 4, swap_)) << 32) | read32(body + 8, swap_);
+						return emit(frame, interfaces_[id], stamp, body + 20, captured);
+					}
+				}
+				else if (type == kPcapngObsoletePacket && body_size >= 20)
+				{
+					const uint32_t id = read16(body, swap_);
+					const size_t captured = read32(body + 12, swap_);
+					if (id < interfaces_.size() && captured <= body_size - 20)
+					{
+						const uint64_t stamp = (static_cast<uint64_t>(read32(body + 4, swap_)) << 32) | read32(body + 8, swap_);
+						return emit(frame, interfaces_[id], stamp, body + 20, captured);
+					}
+				}
+				else if (type == kPcapngSimplePacket && body_size >= 4 && !interfaces_.empty())
+				{
+					// No timestamp: it plays together with the previous frame.
+					const size_t captured = std::min<size_t>(read32(body, swap_), body_size - 4);
+					frame.time_ns = last_time_;
+					frame.link_type = interfaces_.front().link_type;
+					frame.data = body + 4;
+					frame.size = captured;
+					return true;
+				}
+			}
+			return false;
+		}
+
+		bool emit(Frame& frame, const Interface& interface, uint64_t stamp, const uint8_t* data, size_t size)
+		{
+			frame.time_ns = toNanos(stamp, interface.resolution);
+			frame.link_type = interface.link_type;
+			frame.data = data;
+			frame.size = size;
+			last_time_ = frame.time_ns;
+			return true;
+		}
+
+		uint8_t interfaceResolution(const uint8_t* options, size_t size) const
+		{
+			size_t offset = 0;
+			while (offset + 4 <= size)
+			{
+				const uint16_t code = read16(options + offset, swap_);
+				const size_t length = read16(options + offset + 2, swap_);
+				if (code == kOptionEnd || offset + 4 + length > size)
+				{
+					break;
+				}
+				if (code == kOptionTsResol && length >= 1)
+				{
+					return options[offset + 4];
+				}
+				offset += 4 + ((length + 3) & ~size_t(3));
+			}
+			return 6;
+		}
+
+		const uint8_t* data_;
+		size_t size_;
+		bool ng_;
+		bool swap_;
+		uint8_t resolution_;  // pcap: 6 (us) or 9 (ns)
+		uint32_t link_type_;  // pcap
+		size_t first_;
+		size_t offset_;
+		uint64_t last_time_;
+		std::vector<Interface> interfaces_; // pcapng, current section
+	};
+
+	// Finds the UDP payload of an IPv4 frame sent to port (any port when 0).
+	// Fragments are skipped; Livox point packets fit in one datagram.
+	bool
+	udpPayload(const Frame& frame, uint16_t port, const uint8_t*& payload, size_t& size, uint32_t& source)
+	{
+		const uint8_t* p = frame.data;
+		const uint8_t* const end = frame.data + frame.size;
+		uint16_t ether_type = kEtherIpv4;
+		switch (frame.link_type)
+		{
+		case kLinkEthernet:
+			if (end - p < 14)
+			{
+				return false;
+			}
+			ether_type = readBe16(p + 12);
+			p += 14;
+			while ((ether_type == kEtherVlan || ether_type == kEtherQinQ) && end - p >= 4)
+			{
+				ether_type = readBe16(p + 2);
+				p += 4;
+			}
+			break;
+		case kLinkLinuxSll:
+			if (end - p < 16)
+			{
+				return false;
+			}
+			ether_type = readBe16(p + 14);
+			p += 16;
+			break;
+		case kLinkLinuxSll2:
+			if (end - p < 20)
+			{
+				return false;
+			}
+			ether_type = readBe16(p);
+			p += 20;
+			break;
+		case kLinkNull:
+		case kLinkLoop:
+			// The address family is in host order for NULL and network order
+			// for LOOP; accept AF_INET either way.
+			if (end - p < 4 || (read32(p, false) != kAfInet && read32(p, true) != kAfInet))
+			{
+				return false;
+			}
+			p += 4;
+			break;
+		case kLinkRaw:
+		case kLinkIpv4:
+			break;
+		default:
+			return false;
+		}
+
+		if (ether_type != kEtherIpv4 || end - p < 20 || (p[0] >> 4) != 4)
+		{
+			return false;
+		}
+		const size_t header = static_cast<size_t>(p[0] & 0x0f) * 4;
+		const size_t total = readBe16(p + 2);
+		if (header < 20 || total < header + 8 || static_cast<size_t>(end - p) < total)
+		{
+			return false;
+		}
+		if (p[9] != kIpProtocolUdp || (readBe16(p + 6) & 0x3fff) != 0)
+		{
+			return false;
+		}
+		source = static_cast<uint32_t>(p[12]) | (static_cast<uint32_t>(p[13]) << 8) | (static_cast<uint32_t>(p[14]) << 16) | (static_cast<uint32_t>(p[15]) << 24);
+
+		const uint8_t* udp = p + header;
+		const size_t udp_length = readBe16(udp + 4);
+		if ((port != 0 && readBe16(udp + 2) != port) || udp_length < 8 || udp_length > total - header)
+		{
+			return false;
+		}
+		payload = udp + 8;
+		size = udp_length - 8;
+		return true;
+	}
+
+	std::string
+	ipString(uint32_t address)
+	{
+		std::ostringstream oss;
+		oss << (address & 0xff) << '.' << ((address >> 8) & 0xff) << '.' << ((address >> 16) & 0xff) << '.' << (address >> 24);
+		return oss.str();
+	}
+}
+
+PcapPacketSource::PcapPacketSource(const Config& config)
+	: config_(config)
+	, running_(false)
+{
+}
+
+PcapPacketSource::~PcapPacketSource()
+{
+	stop();
+}
+
+bool
+PcapPacketSource::start(PacketSink& sink)
+{
+	stop();
+
+	if (!file_.openRead(config_.path))
+	{
+		sink.onStatus("Capture file not found: " + config_.path);
+		return false;
+	}
+	CaptureReader reader(file_.data(), file_.size());
+	if (!reader.open())
+	{
+		file_.close();
+		sink.onStatus("Not a pcap or pcapng capture: " + config_.path);
+		return false;
+	}
+
+	running_.store(true);
+	sink.onStatus("Playing capture " + config_.path);
+	thread_ = std::thread(&PcapPacketSource::run, this, &sink);
+	return true;
+}
+
+void
+PcapPacketSource::stop()
+{
+	running_.store(false);
+	if (thread_.joinable())
+	{
+		thread_.join();
+	}
+	file_.close();
+}
+
+void
+PcapPacketSource::requestDataType(uint32_t, LivoxLidarPointDataType)
+{
+}
+
+std::string
+PcapPacketSource::description() const
+{
+	std::ostringstream oss;
+	oss << "Capture (" << config_.path << ", port " << config_.port << ", ";
+	if (config_.speed > 0.0)
+	{
+		oss << config_.speed << "x";
+	}
+	else
+	{
+		oss << "unpaced";
+	}
+	if (config_.loop)
+	{
+		oss << ", looping";
+	}
+	oss << ")";
+	return oss.str();
+}
+
+void
+PcapPacketSource::run(PacketSink* sink)
+{
+	using Clock = std::chrono::steady_clock;
+	const bool paced = config_.speed > 0.0;
+
+	CaptureReader reader(file_.data(), file_.size());
+	reader.open();
+
+	std::unordered_set<uint32_t> announced;
+	const Clock::time_point origin = Clock::now();
+	// Capture time already played by earlier loops, ns.
+	uint64_t timeline = 0;
+	uint64_t first_time = 0;
+	uint64_t last_time = 0;
+	uint64_t previous_time = 0;
+	bool have_first = false;
+	uint64_t packets = 0;
+	uint64_t other_frames = 0;
+
+	Frame frame;
+	while (running_.load(std::memory_order_relaxed))
+	{
+		if (!reader.next(frame))
+		{
+			if (!config_.loop || packets == 0)
+			{
+				sink->onStatus("Capture finished: " + config_.path + " (" + std::to_string(packets) + " point packets, " + std::to_string(other_frames) + " other frames)");
+				return;
+			}
+			timeline += last_time - first_time + (last_time - previous_time);
+			have_first = false;
+			reader.rewind();
+			continue;
+		}
+
+		const uint8_t* payload = nullptr;
+		size_t size = 0;
+		uint32_t source = 0;
+		const LivoxLidarEthernetPacket* packet = nullptr;
+		if (udpPayload(frame, config_.port, payload, size, source) && size >= offsetof(LivoxLidarEthernetPacket, data))
+		{
+			packet = reinterpret_cast<const LivoxLidarEthernetPacket*>(payload);
+			const size_t packet_size = PacketSource::packetSize(packet);
+			if (packet_size == 0 || packet_size > size)
+			{
+				packet = nullptr;
+			}
+		}
+		if (packet == nullptr)
+		{
+			++other_frames;
+			continue;
+		}
+
+		if (!have_first)
+		{
+			have_first = true;
+			first_time = frame.time_ns;
+			previous_time = frame.time_ns;
+			last_time = frame.time_ns;
+		}
+		previous_time = last_time;
+		last_time = std::max(last_time, frame.time_ns);
+
+		if (paced)
+		{
+			const uint64_t position = timeline + (last_time - first_time);
+			const Clock::time_point due = origin + std::chrono::nanoseconds(static_cast<int64_t>(static_cast<double>(position) / config_.speed));
+			for (Clock::time_point now = Clock::now(); now < due && running_.load(std::memory_order_relaxed); now = Clock::now())
+			{
+				std::this_thread::sleep_for(std::min<Clock::duration>(due - now, kMaxSleep));
+			}
+			if (!running_.load(std::memory_order_relaxed))
+			{
+				break;
+			}
+		}
+
+		if (announced.insert(source).second)
+		{
+			sink->onLidarInfo(source, "PCAP", ipString(source));
+		}
+		sink->onPacket(source, packet);
+		++packets;
+	}
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <thread>
+
+#include "MappedFile.h"
+#include "PacketSource.h"
+
+// Plays back Livox point packets from a tcpdump/Wireshark capture (pcap or
+// pcapng) on its own thread. The capture is memory mapped; UDP datagrams to
+// the point-data port are unwrapped from their Ethernet, Linux cooked, raw IP
+// or loopback framing and handed to the sink straight from the mapping. Each
+// sending lidar becomes its own handle, derived from its IPv4 address the way
+// the Livox SDK derives handles. Pacing follows the capture timestamps scaled
+// by a speed factor, or is switched off.
+class PcapPacketSource : public PacketSource
+{
+public:
+	struct Config
+	{
+		std::string path;
+		// UDP destination port of the point data; 0 accepts any port.
+		uint16_t port = 56301;
+		// Playback speed relative to the capture; 0 or less is unpaced.
+		double speed = 1.0;
+		bool loop = false;
+	};
+
+	explicit PcapPacketSource(const Config& config);
+	~PcapPacketSource() override;
+
+	bool start(PacketSink& sink) override;
+	void stop() override;
+	void requestDataType(uint32_t handle, LivoxLidarPointDataType type) override;
+	std::string description() const override;
+
+private:
+	void run(PacketSink* sink);
+
+	Config config_;
+	MappedFile file_;
+	std::atomic<bool> running_;
+	std::thread thread_;
+};
@@ -0,0 +1,397 @@
+#include "PointDecoder.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+#if defined(_M_X64) || defined(__x86_64__)
+	#define LIVOX_HAS_X86_SIMD 1
+	#include <immintrin.h>
+	#if defined(_MSC_VER)
+		#include <intrin.h>
+		#define LIVOX_TARGET_AVX2
+	#else
+		#define LIVOX_TARGET_AVX2 __attribute__((target("avx2")))
+	#endif
+#endif
+
+namespace
+{
+	constexpr float kMilliToMeters = 0.001f;
+	constexpr float kCentiToMeters = 0.01f;
+	constexpr float kRadToDeg = 57.29577951308232f;
+	constexpr double kDegToRad = 0.017453292519943295;
+
+	// A PointTransform with the raw unit scale folded into the rotation, so one
+	// multiply-add chain per axis both converts and transforms. Rows hold the
+	// three scaled rotation terms followed by the translation.
+	struct ScaledTransform
+	{
+		ScaledTransform(const PointTransform& transform, float scale)
+		{
+			for (size_t row = 0; row < 3; ++row)
+			{
+				for (size_t col = 0; col < 3; ++col)
+				{
+					m[row * 4 + col] = transform.rotation[row * 3 + col] * scale;
+				}
+				m[row * 4 + 3] = transform.translation[row];
+			}
+		}
+
+		// Evaluated left to right so the vector kernels can match it exactly.
+		float apply(size_t row, float x, float y, float z) const
+		{
+			const float* r = m + row * 4;
+			return r[0] * x + r[1] * y + r[2] * z + r[3];
+		}
+
+		float m[12];
+	};
+
+	template <typename RawPoint>
+	void
+	decodeTransformedScalar(const RawPoint* points, size_t count, const PointColumns& destination, const ScaledTransform& transform)
+	{
+		for (size_t i = 0; i < count; ++i)
+		{
+			const float x = static_cast<float>(points[i].x);
+			const float y = static_cast<float>(points[i].y);
+			const float z = static_cast<float>(points[i].z);
+			destination.x[i] = transform.apply(0, x, y, z);
+			destination.y[i] = transform.apply(1, x, y, z);
+			destination.z[i] = transform.apply(2, x, y, z);
+			destination.intensity[i] = static_cast<float>(points[i].reflectivity);
+			destination.tag[i] = static_cast<float>(points[i].tag);
+		}
+	}
+
+#if defined(LIVOX_HAS_X86_SIMD)
+	constexpr size_t kLanes = 8;
+
+	// Converted raw x/y/z lanes go out either scaled or through the folded
+	// transform; the choice is loop-invariant.
+	struct XyzWriter
+	{
+		LIVOX_TARGET_AVX2
+		XyzWriter(float scale, const ScaledTransform* transform)
+			: scale(_mm256_set1_ps(scale))
+			, transformed(transform != nullptr)
+		{
+			for (size_t k = 0; k < 12; ++k)
+			{
+				m[k] = _mm256_set1_ps(transformed ? transform->m[k] : 0.0f);
+			}
+		}
+
+		LIVOX_TARGET_AVX2
+		__m256 row(size_t index, __m256 x, __m256 y, __m256 z) const
+		{
+			const __m256* r = m + index * 4;
+			return _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(r[0], x), _mm256_mul_ps(r[1], y)), _mm256_mul_ps(r[2], z)), r[3]);
+		}
+
+		LIVOX_TARGET_AVX2
+		void store(const PointColumns& destination, size_t i, __m256i xi, __m256i yi, __m256i zi) const
+		{
+			const __m256 x = _mm256_cvtepi32_ps(xi);
+			const __m256 y = _mm256_cvtepi32_ps(yi);
+			const __m256 z = _mm256_cvtepi32_ps(zi);
+			if (transformed)
+			{
+				_mm256_storeu_ps(destination.x + i, row(0, x, y, z));
+				_mm256_storeu_ps(destination.y + i, row(1, x, y, z));
+				_mm256_storeu_ps(destination.z + i, row(2, x, y, z));
+			}
+			else
+			{
+				_mm256_storeu_ps(destination.x + i, _mm256_mul_ps(x, scale));
+				_mm256_storeu_ps(destination.y + i, _mm256_mul_ps(y, scale));
+				_mm256_storeu_ps(destination.z + i, _mm256_mul_ps(z, scale));
+			}
+		}
+
+		__m256 scale;
+		__m256 m[12];
+		bool transformed;
+	};
+
+	bool
+	cpuSupportsAvx2()
+	{
+#if defined(_MSC_VER)
+		int regs[4] = {};
+		__cpuid(regs, 0);
+		if (regs[0] < 7)
+		{
+			return false;
+		}
+		__cpuid(regs, 1);
+		const bool osxsave = (regs[2] & (1 << 27)) != 0;
+		const bool avx = (regs[2] & (1 << 28)) != 0;
+		if (!osxsave || !avx || (_xgetbv(0) & 0x6) != 0x6)
+		{
+			return false;
+		}
+		__cpuidex(regs, 7, 0);
+		return (regs[1] & (1 << 5)) != 0;
+#else
+		return __builtin_cpu_supports("avx2") != 0;
+#endif
+	}
+
+	LIVOX_TARGET_AVX2
+	size_t
+	decodeHighAvx2(const LivoxLidarCartesianHighRawPoint* points, size_t count, const PointColumns& destination, const ScaledTransform* transform)
+	{
+		constexpr int kStride = static_cast<int>(sizeof(LivoxLidarCartesianHighRawPoint));
+		const __m256i offsets = _mm256_setr_epi32(0, kStride, 2 * kStride, 3 * kStride, 4 * kStride, 5 * kStride, 6 * kStride, 7 * kStride);
+		const XyzWriter xyz(kMilliToMeters, transform);
+		const __m256i byte_mask = _mm256_set1_epi32(0xFF);
+		const auto* base = reinterpret_cast<const char*>(points);
+
+		// The reflectivity/tag gather reads a 32-bit word at byte 12 and so runs
+		// two bytes into the following record. Stop one record early so the last
+		// record of the packet is always decoded by the scalar tail.
+		size_t i = 0;
+		for (; i + kLanes < count; i += kLanes)
+		{
+			const char* record = base + i * kStride;
+			const __m256i xi = _mm256_i32gather_epi32(reinterpret_cast<const int*>(record), offsets, 1);
+			const __m256i yi = _mm256_i32gather_epi32(reinterpret_cast<const int*>(record + 4), offsets, 1);
+			const __m256i zi = _mm256_i32gather_epi32(reinterpret_cast<const int*>(record + 8), offsets, 1);
+			const __m256i rt = _mm256_i32gather_epi32(reinterpret_cast<const int*>(record + 12), offsets, 1);
+
+			xyz.store(destination, i, xi, yi, zi);
+			_mm256_storeu_ps(destination.intensity + i, _mm256_cvtepi32_ps(_mm256_and_si256(rt, byte_mask)));
+			_mm256_storeu_ps(destination.tag + i, _mm256_cvtepi32_ps(_mm256_and_si256(_mm256_srli_epi32(rt, 8), byte_mask)));
+		}
+		return i;
+	}
+
+	LIVOX_TARGET_AVX2
+	size_t
+	decodeLowAvx2(const LivoxLidarCartesianLowRawPoint* points, size_t count, const PointColumns& destination, const ScaledTransform* transform)
+	{
+		static_assert(sizeof(LivoxLidarCartesianLowRawPoint) == 8, "Low raw point expected to be 8 bytes");
+		const __m256i split = _mm256_setr_epi32(0, 2, 4, 6, 1, 3, 5, 7);
+		const XyzWriter xyz(kCentiToMeters, transform);
+		const __m256i byte_mask = _mm256_set1_epi32(0xFF);
+		const auto* base = reinterpret_cast<const char*>(points);
+
+		// Each record is two 32-bit words: (x | y << 16) and (z | refl << 16 | tag << 24).
+		size_t i = 0;
+		for (; i + kLanes <= count; i += kLanes)
+		{
+			const char* record = base + i * sizeof(LivoxLidarCartesianLowRawPoint);
+			const __m256i lo = _mm256_permutevar8x32_epi32(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(record)), split);
+			const __m256i hi = _mm256_permutevar8x32_epi32(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(record + 32)), split);
+			const __m256i xy = _mm256_permute2x128_si256(lo, hi, 0x20);
+			const __m256i zrt = _mm256_permute2x128_si256(lo, hi, 0x31);
+
+			const __m256i xi = _mm256_srai_epi32(_mm256_slli_epi32(xy, 16), 16);
+			const __m256i yi = _mm256_srai_epi32(xy, 16);
+			const __m256i zi = _mm256_srai_epi32(_mm256_slli_epi32(zrt, 16), 16);
+
+			xyz.store(destination, i, xi, yi, zi);
+			_mm256_storeu_ps(destination.intensity + i, _mm256_cvtepi32_ps(_mm256_and_si256(_mm256_srli_epi32(zrt, 16), byte_mask)));
+			_mm256_storeu_ps(destination.tag + i, _mm256_cvtepi32_ps(_mm256_srli_epi32(zrt, 24)));
+		}
+		return i;
+	}
+#endif
+
+#if !defined(NDEBUG)
+	// Debug builds re-run the scalar kernel on every vectorised packet and
+	// assert the outputs match bit for bit.
+	template <typename RawPoint, typename ScalarFn>
+	void
+	verifyAgainstScalar(const RawPoint* points, size_t count, const PointColumns& decoded, const PointTransform* transform, ScalarFn scalar)
+	{
+		thread_local PointBlock reference;
+		reference.resize(count);
+		const PointColumns expected = reference.columns();
+		scalar(points, count, expected, transform);
+		assert(std::memcmp(expected.x, decoded.x, count * sizeof(float)) == 0);
+		assert(std::memcmp(expected.y, decoded.y, count * sizeof(float)) == 0);
+		assert(std::memcmp(expected.z, decoded.z, count * sizeof(float)) == 0);
+		assert(std::memcmp(expected.intensity, decoded.intensity, count * sizeof(float)) == 0);
+		assert(std::memcmp(expected.tag, decoded.tag, count * sizeof(float)) == 0);
+	}
+#endif
+}
+
+PointTransform
+PointTransform::fromMatrix(const double* matrix)
+{
+	PointTransform transform;
+	for (size_t row = 0; row < 3; ++row)
+	{
+		for (size_t col = 0; col < 3; ++col)
+		{
+			transform.rotation[row * 3 + col] = static_cast<float>(matrix[row * 4 + col]);
+		}
+		transform.translation[row] = static_cast<float>(matrix[row * 4 + 3]);
+	}
+	return transform;
+}
+
+PointTransform
+PointTransform::fromEuler(double x, double y, double z, double roll, double pitch, double yaw)
+{
+	const double cr = std::cos(roll * kDegToRad);
+	const double sr = std::sin(roll * kDegToRad);
+	const double cp = std::cos(pitch * kDegToRad);
+	const double sp = std::sin(pitch * kDegToRad);
+	const double cy = std::cos(yaw * kDegToRad);
+	const double sy = std::sin(yaw * kDegToRad);
+	const double matrix[12] = {
+		cy * cp, cy * sp * sr - sy * cr, cy * sp * cr + sy * sr, x,
+		sy * cp, sy * sp * sr + cy * cr, sy * sp * cr - cy * sr, y,
+		-sp, cp * sr, cp * cr, z
+	};
+	return fromMatrix(matrix);
+}
+
+bool
+PointTransform::isIdentity() const
+{
+	return *this == PointTransform();
+}
+
+bool
+PointTransform::operator==(const PointTransform& other) const
+{
+	return std::equal(rotation, rotation + 9, other.rotation) && std::equal(translation, translation + 3, other.translation);
+}
+
+bool
+PointTransform::operator!=(const PointTransform& other) const
+{
+	return !(*this == other);
+}
+
+PointDecoder::Kernel
+PointDecoder::activeKernel()
+{
+#if defined(LIVOX_HAS_X86_SIMD)
+	static const Kernel kernel = cpuSupportsAvx2() ? Kernel::Avx2 : Kernel::Scalar;
+	return kernel;
+#else
+	return Kernel::Scalar;
+#endif
+}
+
+const char*
+PointDecoder::kernelName(Kernel kernel)
+{
+	switch (kernel)
+	{
+	case Kernel::Avx2:
+		return "AVX2";
+	case Kernel::Scalar:
+	default:
+		return "Scalar";
+	}
+}
+
+void
+PointDecoder::decodeHigh(const LivoxLidarCartesianHighRawPoint* points, size_t count, const PointColumns& destination, const PointTransform* transform)
+{
+	size_t done = 0;
+#if defined(LIVOX_HAS_X86_SIMD)
+	if (activeKernel() == Kernel::Avx2)
+	{
+		if (transform != nullptr)
+		{
+			const ScaledTransform scaled(*transform, kMilliToMeters);
+			done = decodeHighAvx2(points, count, destination, &scaled);
+		}
+		else
+		{
+			done = decodeHighAvx2(points, count, destination, nullptr);
+		}
+	}
+#endif
+	decodeHighScalar(points + done, count - done, destination.offset(done), transform);
+#if !defined(NDEBUG)
+	verifyAgainstScalar(points, count, destination, transform, &PointDecoder::decodeHighScalar);
+#endif
+}
+
+void
+PointDecoder::decodeLow(const LivoxLidarCartesianLowRawPoint* points, size_t count, const PointColumns& destination, const PointTransform* transform)
+{
+	size_t done = 0;
+#if defined(LIVOX_HAS_X86_SIMD)
+	if (activeKernel() == Kernel::Avx2)
+	{
+		if (transform != nullptr)
+		{
+			const ScaledTransform scaled(*transform, kCentiToMeters);
+			done = decodeLowAvx2(points, count, destination, &scaled);
+		}
+		else
+		{
+			done = decodeLowAvx2(points, count, destination, nullptr);
+		}
+	}
+#endif
+	decodeLowScalar(points + done, count - done, destination.offset(done), transform);
+#if !defined(NDEBUG)
+	verifyAgainstScalar(points, count, destination, transform, &PointDecoder::decodeLowScalar);
+#endif
+}
+
+void
+PointDecoder::toSpherical(const PointColumns& cartesian, size_t count, float* distance, float* theta, float* phi)
+{
+	for (size_t s = 0; s < count; ++s)
+	{
+		const float x = cartesian.x[s];
+		const float y = cartesian.y[s];
+		const float z = cartesian.z[s];
+		const float horizontal = std::sqrt(x * x + y * y);
+		distance[s] = std::sqrt(horizontal * horizontal + z * z);
+		theta[s] = std::atan2(y, x) * kRadToDeg;
+		phi[s] = std::atan2(z, horizontal) * kRadToDeg;
+	}
+}
+
+void
+PointDecoder::decodeHighScalar(const LivoxLidarCartesianHighRawPoint* points, size_t count, const PointColumns& destination, const PointTransform* transform)
+{
+	if (transform != nullptr)
+	{
+		decodeTransformedScalar(points, count, destination, ScaledTransform(*transform, kMilliToMeters));
+		return;
+	}
+	for (size_t i = 0; i < count; ++i)
+	{
+		destination.x[i] = static_cast<float>(points[i].x) * kMilliToMeters;
+		destination.y[i] = static_cast<float>(points[i].y) * kMilliToMeters;
+		destination.z[i] = static_cast<float>(points[i].z) * kMilliToMeters;
+		destination.intensity[i] = static_cast<float>(points[i].reflectivity);
+		destination.tag[i] = static_cast<float>(points[i].tag);
+	}
+}
+
+void
+PointDecoder::decodeLowScalar(const LivoxLidarCartesianLowRawPoint* points, size_t count, const PointColumns& destination, const PointTransform* transform)
+{
+	if (transform != nullptr)
+	{
+		decodeTransformedScalar(points, count, destination, ScaledTransform(*transform, kCentiToMeters));
+		return;
+	}
+	for (size_t i = 0; i < count; ++i)
+	{
+		destination.x[i] = static_cast<float>(points[i].x) * kCentiToMeters;
+		destination.y[i] = static_cast<float>(points[i].y) * kCentiToMeters;
+		destination.z[i] = static_cast<float>(points[i].z) * kCentiToMeters;
+		destination.intensity[i] = static_cast<float>(points[i].reflectivity);
+		destination.tag[i] = static_cast<float>(points[i].tag);
+	}
+}
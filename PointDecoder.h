@@ -0,0 +1,53 @@
+#pragma once
+
+#include <cstddef>
+
+#include "livox_lidar_api.h"
+#include "PointRing.h"
+
+// Rigid sensor-to-world transform, p' = rotation * p + translation, with the
+// rotation row-major and the translation in metres.
+struct PointTransform
+{
+	float rotation[9] = { 1.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 1.0f };
+	float translation[3] = { 0.0f, 0.0f, 0.0f };
+
+	// Upper three rows of a row-major 4x4 matrix acting on column vectors.
+	static PointTransform fromMatrix(const double* matrix);
+	// Livox driver convention: translation in metres, then roll about x,
+	// pitch about y and yaw about z in degrees, applied as Rz * Ry * Rx.
+	static PointTransform fromEuler(double x, double y, double z, double roll, double pitch, double yaw);
+
+	bool isIdentity() const;
+	bool operator==(const PointTransform& other) const;
+	bool operator!=(const PointTransform& other) const;
+};
+
+// Converts packed Livox Cartesian records into metre/float columns. The AVX2
+// kernels gather and convert 8 records per iteration and are selected at
+// runtime when the CPU supports them; the scalar kernels handle the remainder
+// and older CPUs. Both produce bit-identical results. A transform, when given,
+// is folded into the unit scale so the rotate-translate costs no extra pass.
+class PointDecoder
+{
+public:
+	enum class Kernel
+	{
+		Scalar = 0,
+		Avx2 = 1
+	};
+
+	static Kernel activeKernel();
+	static const char* kernelName(Kernel kernel);
+
+	// Fills x/y/z/intensity/tag of destination; the timestamp column is untouched.
+	// transform may be null for points in the sensor frame.
+	static void decodeHigh(const LivoxLidarCartesianHighRawPoint* points, size_t count, const PointColumns& destination, const PointTransform* transform = nullptr);
+	static void decodeLow(const LivoxLidarCartesianLowRawPoint* points, size_t count, const PointColumns& destination, const PointTransform* transform = nullptr);
+
+	// Converts Cartesian x/y/z columns to distance (m) and theta/phi (degrees).
+	static void toSpherical(const PointColumns& cartesian, size_t count, float* distance, float* theta, float* phi);
+
+	static void decodeHighScalar(const LivoxLidarCartesianHighRawPoint* points, size_t count, const PointColumns& destination, const PointTransform* transform = nullptr);
+	static void decodeLowScalar(const LivoxLidarCartesianLowRawPoint* points, size_t count, const PointColumns& destination, const PointTransform* transform = nullptr);
+};
@@ -0,0 +1,519 @@
+#include "PointRing.h"
+
+#include <algorithm>
+#include <cstring>
+#include <new>
+
+namespace
+{
+	// A push extends the newest stamp while that holds fewer points than this,
+	// so batches thinned by the spatial filter share stamps and the stamp ring
+	// never fills before the points do.
+	constexpr size_t kGroupPoints = 32;
+
+	template <typename T>
+	T* allocateColumn(size_t capacity)
+	{
+		return static_cast<T*>(::operator new(capacity * sizeof(T), std::align_val_t(SpscRingIndex::kCacheLine)));
+	}
+
+	template <typename T>
+	void releaseColumn(T*& column)
+	{
+		if (column != nullptr)
+		{
+			::operator delete(column, std::align_val_t(SpscRingIndex::kCacheLine));
+			column = nullptr;
+		}
+	}
+
+	template <typename T>
+	void copyToRing(T* column, size_t capacity, size_t slot, const T* source, size_t count)
+	{
+		const size_t first = std::min(count, capacity - slot);
+		std::memcpy(column + slot, source, first * sizeof(T));
+		std::memcpy(column, source + first, (count - first) * sizeof(T));
+	}
+
+	template <typename T>
+	void copyFromRing(const T* column, size_t capacity, size_t slot, T* destination, size_t count)
+	{
+		if (destination == nullptr)
+		{
+			return;
+		}
+		const size_t first = std::min(count, capacity - slot);
+		std::memcpy(destination, column + slot, first * sizeof(T));
+		std::memcpy(destination + first, column, (count - first) * sizeof(T));
+	}
+
+	// Copies count items sampled evenly from the span ring items starting at
+	// first_index.
+	template <typename T>
+	void gatherFromRing(const T* column, size_t mask, uint64_t first_index, size_t span, T* destination, size_t count)
+	{
+		if (destination == nullptr)
+		{
+			return;
+		}
+		for (size_t i = 0; i < count; ++i)
+		{
+			const uint64_t index = first_index + (static_cast<uint64_t>(i) * span) / count;
+			destination[i] = column[index & mask];
+		}
+	}
+}
+
+void
+PointBlock::resize(size_t count)
+{
+	x_.resize(count);
+	y_.resize(count);
+	z_.resize(count);
+	intensity_.resize(count);
+	tag_.resize(count);
+	timestamp_.resize(count);
+	received_.resize(count);
+}
+
+size_t
+PointBlock::size() const
+{
+	return x_.size();
+}
+
+PointColumns
+PointBlock::columns()
+{
+	PointColumns columns;
+	columns.x = x_.data();
+	columns.y = y_.data();
+	columns.z = z_.data();
+	columns.intensity = intensity_.data();
+	columns.tag = tag_.data();
+	columns.timestamp = timestamp_.data();
+	columns.received = received_.data();
+	return columns;
+}
+
+PointRing::PointRing(size_t capacity)
+	: time_offsets_(nullptr)
+	, stamps_(nullptr)
+{
+	capacity = SpscRingIndex::roundCapacity(capacity);
+	allocate(storage_, capacity);
+	time_offsets_ = allocateColumn<uint32_t>(capacity);
+	index_.reset(capacity);
+
+	const size_t stamp_capacity = stampCapacityFor(capacity);
+	stamps_ = allocateColumn<PacketStamp>(stamp_capacity);
+	stamp_index_.reset(stamp_capacity);
+}
+
+PointRing::~PointRing()
+{
+	release(storage_);
+	releaseColumn(time_offsets_);
+	releaseColumn(stamps_);
+}
+
+void
+PointRing::resize(size_t capacity)
+{
+	capacity = SpscRingIndex::roundCapacity(capacity);
+	if (capacity == index_.capacity())
+	{
+		return;
+	}
+
+	// Keep the newest points at their current indices so stamps stay valid.
+	size_t available = 0;
+	uint64_t read = index_.beginRead(available);
+	const size_t kept = std::min(available, capacity);
+	read += available - kept;
+	const uint64_t write = read + kept;
+
+	PointColumns next;
+	allocate(next, capacity);
+	const size_t old_capacity = index_.capacity();
+	copyRingRange(storage_.x, old_capacity, next.x, capacity, read, kept);
+	copyRingRange(storage_.y, old_capacity, next.y, capacity, read, kept);
+	copyRingRange(storage_.z, old_capacity, next.z, capacity, read, kept);
+	copyRingRange(storage_.intensity, old_capacity, next.intensity, capacity, read, kept);
+	copyRingRange(storage_.tag, old_capacity, next.tag, capacity, read, kept);
+	uint32_t* next_offsets = allocateColumn<uint32_t>(capacity);
+	copyRingRange(time_offsets_, old_capacity, next_offsets, capacity, read, kept);
+
+	// Carry over the stamps of the kept points. If the smaller stamp ring cannot
+	// hold them all, keep the newest stamps and drop the points they no longer
+	// cover.
+	const size_t stamp_capacity = stampCapacityFor(capacity);
+	size_t stamps_available = 0;
+	uint64_t stamp_read = stamp_index_.beginRead(stamps_available);
+	const uint64_t stamp_write = stamp_read + stamps_available;
+	while (stamp_read + 1 < stamp_write && stamps_[stamp_index_.slot(stamp_read + 1)].first_point <= read)
+	{
+		++stamp_read;
+	}
+	if (stamp_write - stamp_read > stamp_capacity)
+	{
+		stamp_read = stamp_write - stamp_capacity;
+		read = std::max(read, stamps_[stamp_index_.slot(stamp_read)].first_point);
+	}
+
+	PacketStamp* next_stamps = allocateColumn<PacketStamp>(stamp_capacity);
+	copyRingRange(stamps_, stamp_index_.capacity(), next_stamps, stamp_capacity, stamp_read, static_cast<size_t>(stamp_write - stamp_read));
+
+	release(storage_);
+	releaseColumn(time_offsets_);
+	releaseColumn(stamps_);
+	storage_ = next;
+	time_offsets_ = next_offsets;
+	stamps_ = next_stamps;
+	index_.reset(capacity, read, write);
+	stamp_index_.reset(stamp_capacity, stamp_read, stamp_write);
+}
+
+size_t
+PointRing::capacity() const
+{
+	return index_.capacity();
+}
+
+size_t
+PointRing::size() const
+{
+	return index_.size();
+}
+
+size_t
+PointRing::limit() const
+{
+	return index_.limit();
+}
+
+size_t
+PointRing::setLimit(size_t limit)
+{
+	return index_.setLimit(limit);
+}
+
+size_t
+PointRing::push(const PointColumns& source, size_t count, const PacketStamp& stamp)
+{
+	const size_t limit = index_.limit();
+	if (count == 0)
+	{
+		return 0;
+	}
+
+	// A packet larger than the whole limit keeps only its newest points.
+	size_t skip = 0;
+	if (count > limit)
+	{
+		skip = count - limit;
+		count = limit;
+	}
+
+	// A new stamp's time is the earliest of the batch so every offset is
+	// positive; a batch spanning more than the offsets can hold (4.3 s) is
+	// clamped at the end.
+	uint64_t earliest = stamp.batchTime(source, skip);
+	uint64_t latest = earliest;
+	for (size_t i = 1; i < count; ++i)
+	{
+		const uint64_t time = stamp.batchTime(source, skip + i);
+		earliest = std::min(earliest, time);
+		latest = std::max(latest, time);
+	}
+
+	// The consumer never releases the newest stamp, so the producer may add
+	// points to it when it is small and the batch's times fit its offsets. The
+	// group keeps the receive time of its first batch.
+	size_t stamps_buffered = 0;
+	const uint64_t stamp_end = stamp_index_.beginRead(stamps_buffered) + stamps_buffered;
+	size_t buffered = 0;
+	const uint64_t end = index_.beginRead(buffered) + buffered;
+	const PacketStamp* group = stamps_buffered > 0 ? &stamps_[stamp_index_.slot(stamp_end - 1)] : nullptr;
+	const bool extend = group != nullptr
+		&& end - group->first_point < kGroupPoints
+		&& earliest >= group->timestamp
+		&& latest - group->timestamp <= UINT32_MAX;
+
+	size_t evicted = 0;
+	uint64_t stamp_write = 0;
+	PacketStamp entry = stamp;
+	entry.timestamp = extend ? group->timestamp : earliest;
+	if (!extend)
+	{
+		// Claim the stamp slot first. If that pushes out the oldest stamp, the
+		// points it described are evicted with it.
+		size_t stamps_evicted = 0;
+		stamp_write = stamp_index_.beginWrite(1, stamps_evicted);
+		if (stamps_evicted > 0)
+		{
+			const uint64_t oldest = stamp_write + 1 - stamp_index_.capacity();
+			const uint64_t keep_from = oldest < stamp_write ? stamps_[stamp_index_.slot(oldest)].first_point : end;
+			evicted = index_.advanceRead(keep_from);
+		}
+	}
+
+	size_t points_evicted = 0;
+	const uint64_t write = index_.beginWrite(count, points_evicted);
+	copyIn(source.offset(skip), write, count);
+	for (size_t i = 0; i < count; ++i)
+	{
+		const uint64_t offset = stamp.batchTime(source, skip + i) - entry.timestamp;
+		time_offsets_[index_.slot(write + i)] = static_cast<uint32_t>(std::min<uint64_t>(offset, UINT32_MAX));
+	}
+
+	if (!extend)
+	{
+		entry.first_point = write;
+		stamps_[stamp_index_.slot(stamp_write)] = entry;
+		stamp_index_.commitWrite(stamp_write, 1);
+	}
+	index_.commitWrite(write, count);
+	return skip + evicted + points_evicted;
+}
+
+size_t
+PointRing::pop(const PointColumns& destination, size_t max_points)
+{
+	if (max_points == 0)
+	{
+		return 0;
+	}
+
+	for (;;)
+	{
+		size_t available = 0;
+		const uint64_t read = index_.beginRead(available);
+		const size_t count = std::min(max_points, available);
+		if (count == 0)
+		{
+			return 0;
+		}
+
+		copyOut(read, destination, count);
+		if (!fillStampColumns(read, count, count, destination))
+		{
+			continue;
+		}
+		if (index_.commitRead(read, count))
+		{
+			releaseStamps(read + count);
+			return count;
+		}
+	}
+}
+
+size_t
+PointRing::trim(size_t keep)
+{
+	for (;;)
+	{
+		size_t available = 0;
+		const uint64_t read = index_.beginRead(available);
+		if (available <= keep)
+		{
+			return 0;
+		}
+
+		const size_t dropped = available - keep;
+		if (index_.commitRead(read, dropped))
+		{
+			releaseStamps(read + dropped);
+			return dropped;
+		}
+	}
+}
+
+size_t
+PointRing::popDecimated(const PointColumns& destination, size_t max_points, size_t& skipped)
+{
+	skipped = 0;
+	if (max_points == 0)
+	{
+		return 0;
+	}
+
+	for (;;)
+	{
+		size_t available = 0;
+		const uint64_t read = index_.beginRead(available);
+		if (available <= max_points)
+		{
+			return pop(destination, max_points);
+		}
+
+		gatherOut(read, available, destination, max_points);
+		if (!fillStampColumns(read, available, max_points, destination))
+		{
+			continue;
+		}
+		if (index_.commitRead(read, available))
+		{
+			releaseStamps(read + available);
+			skipped = available - max_points;
+			return max_points;
+		}
+	}
+}
+
+void
+PointRing::clear()
+{
+	// The newest stamp stays, since the producer may still be adding to it.
+	index_.clear();
+	size_t stamps_available = 0;
+	const uint64_t stamp_read = stamp_index_.beginRead(stamps_available);
+	if (stamps_available > 1)
+	{
+		// Fails harmlessly if the producer evicted stamps meanwhile.
+		stamp_index_.commitRead(stamp_read, stamps_available - 1);
+	}
+}
+
+size_t
+PointRing::stampCapacityFor(size_t capacity)
+{
+	// Mid-360 packets carry 96 points and smaller batches are grouped into
+	// stamps of at least kGroupPoints, so this leaves ample headroom before
+	// stamp overflow starts evicting points.
+	constexpr size_t kPointsPerStamp = 16;
+	constexpr size_t kMinStamps = 64;
+	return SpscRingIndex::roundCapacity(std::max(capacity / kPointsPerStamp, kMinStamps));
+}
+
+void
+PointRing::allocate(PointColumns& columns, size_t capacity)
+{
+	columns.x = allocateColumn<float>(capacity);
+	columns.y = allocateColumn<float>(capacity);
+	columns.z = allocateColumn<float>(capacity);
+	columns.intensity = allocateColumn<float>(capacity);
+	columns.tag = allocateColumn<float>(capacity);
+}
+
+void
+PointRing::release(PointColumns& columns)
+{
+	releaseColumn(columns.x);
+	releaseColumn(columns.y);
+	releaseColumn(columns.z);
+	releaseColumn(columns.intensity);
+	releaseColumn(columns.tag);
+}
+
+void
+PointRing::copyIn(const PointColumns& source, uint64_t index, size_t count)
+{
+	const size_t capacity = index_.capacity();
+	const size_t slot = index_.slot(index);
+	copyToRing(storage_.x, capacity, slot, source.x, count);
+	copyToRing(storage_.y, capacity, slot, source.y, count);
+	copyToRing(storage_.z, capacity, slot, source.z, count);
+	copyToRing(storage_.intensity, capacity, slot, source.intensity, count);
+	copyToRing(storage_.tag, capacity, slot, source.tag, count);
+}
+
+void
+PointRing::copyOut(uint64_t index, const PointColumns& destination, size_t count) const
+{
+	const size_t capacity = index_.capacity();
+	const size_t slot = index_.slot(index);
+	copyFromRing(storage_.x, capacity, slot, destination.x, count);
+	copyFromRing(storage_.y, capacity, slot, destination.y, count);
+	copyFromRing(storage_.z, capacity, slot, destination.z, count);
+	copyFromRing(storage_.intensity, capacity, slot, destination.intensity, count);
+	copyFromRing(storage_.tag, capacity, slot, destination.tag, count);
+}
+
+void
+PointRing::gatherOut(uint64_t index, size_t span, const PointColumns& destination, size_t count) const
+{
+	const size_t mask = index_.capacity() - 1;
+	gatherFromRing(storage_.x, mask, index, span, destination.x, count);
+	gatherFromRing(storage_.y, mask, index, span, destination.y, count);
+	gatherFromRing(storage_.z, mask, index, span, destination.z, count);
+	gatherFromRing(storage_.intensity, mask, index, span, destination.intensity, count);
+	gatherFromRing(storage_.tag, mask, index, span, destination.tag, count);
+}
+
+bool
+PointRing::fillStampColumns(uint64_t first_point, size_t span, size_t count, const PointColumns& destination) const
+{
+	if (destination.timestamp == nullptr && destination.received == nullptr)
+	{
+		return true;
+	}
+
+	size_t stamps_available = 0;
+	const uint64_t stamp_read = stamp_index_.beginRead(stamps_available);
+	const uint64_t stamp_end = stamp_read + stamps_available;
+
+	// The producer evicts a stamp before the points it covered; until it has
+	// moved past them too, those points have no stamp and the pass is retried.
+	if (stamps_available > 0 && stamps_[stamp_index_.slot(stamp_read)].first_point > first_point)
+	{
+		return false;
+	}
+
+	// Each point belongs to the last stamp starting at or before it.
+	const PacketStamp unstamped;
+	uint64_t s = stamp_read;
+	for (size_t i = 0; i < count; ++i)
+	{
+		const uint64_t point = first_point + (static_cast<uint64_t>(i) * span) / count;
+		while (s + 1 < stamp_end && stamps_[stamp_index_.slot(s + 1)].first_point <= point)
+		{
+			++s;
+		}
+
+		const PacketStamp& stamp = s < stamp_end ? stamps_[stamp_index_.slot(s)] : unstamped;
+		if (destination.timestamp != nullptr)
+		{
+			destination.timestamp[i] = stamp.timestamp + time_offsets_[index_.slot(point)];
+		}
+		if (destination.received != nullptr)
+		{
+			destination.received[i] = stamp.received;
+		}
+	}
+
+	// The producer only overwrites a stamp after evicting it, which moves the
+	// stamp read index; if it did not move, nothing read above was torn.
+	size_t unused = 0;
+	return stamp_index_.beginRead(unused) == stamp_read;
+}
+
+void
+PointRing::releaseStamps(uint64_t read)
+{
+	// Stamp first points increase monotonically, so binary search for the
+	// first stamp starting past read; the one before it covers read and is
+	// kept along with everything after it.
+	size_t stamps_available = 0;
+	const uint64_t stamp_read = stamp_index_.beginRead(stamps_available);
+	uint64_t later = stamp_read;
+	uint64_t stamp_end = stamp_read + stamps_available;
+	while (later < stamp_end)
+	{
+		const uint64_t middle = later + (stamp_end - later) / 2;
+		if (stamps_[stamp_index_.slot(middle)].first_point <= read)
+		{
+			later = middle + 1;
+		}
+		else
+		{
+			stamp_end = middle;
+		}
+	}
+	const uint64_t released = later > stamp_read ? later - 1 : stamp_read;
+	if (released > stamp_read)
+	{
+		// Fails harmlessly if the producer evicted stamps meanwhile.
+		stamp_index_.commitRead(stamp_read, static_cast<size_t>(released - stamp_read));
+	}
+}
@@ -0,0 +1,172 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "SpscRing.h"
+
+// Destination (or source) column pointers for structure-of-arrays point data.
+// Any column left null is skipped, so callers only pay for the fields they use.
+struct PointColumns
+{
+	float* x = nullptr;
+	float* y = nullptr;
+	float* z = nullptr;
+	float* intensity = nullptr;
+	float* tag = nullptr;
+	uint64_t* timestamp = nullptr;
+	uint64_t* received = nullptr;
+	// Sensor slot of each point; filled by LivoxDevice, the buffers ignore it.
+	float* sensor = nullptr;
+
+	// Columns advanced by count points; null columns stay null.
+	PointColumns offset(size_t count) const
+	{
+		PointColumns shifted;
+		shifted.x = x != nullptr ? x + count : nullptr;
+		shifted.y = y != nullptr ? y + count : nullptr;
+		shifted.z = z != nullptr ? z + count : nullptr;
+		shifted.intensity = intensity != nullptr ? intensity + count : nullptr;
+		shifted.tag = tag != nullptr ? tag + count : nullptr;
+		shifted.timestamp = timestamp != nullptr ? timestamp + count : nullptr;
+		shifted.received = received != nullptr ? received + count : nullptr;
+		shifted.sensor = sensor != nullptr ? sensor + count : nullptr;
+		return shifted;
+	}
+};
+
+// Timing shared by every point of one Livox packet. Per-point times are
+// reconstructed from the point's position in the packet and the packet's
+// time_interval (units of 0.1 us spanning dot_num points), unless the points
+// carry their own timestamp column, as the spatial filter's survivors and the
+// voxels do. The host receive time is shared by all points of the packet.
+struct PacketStamp
+{
+	uint64_t first_point = 0;   // buffer index of the first stored point
+	uint64_t timestamp = 0;     // packet timestamp, ns
+	uint64_t received = 0;      // host steady_clock time the packet arrived, ns
+	uint16_t time_interval = 0; // 0.1 us units, as sent by the lidar
+	uint16_t dot_num = 0;       // points in the original packet
+	uint16_t first_dot = 0;     // packet position of the first stored point
+	uint16_t reserved = 0;
+
+	uint64_t pointTime(size_t dot) const
+	{
+		return dot_num == 0 ? timestamp : timestamp + (static_cast<uint64_t>(dot) * time_interval * 100) / dot_num;
+	}
+
+	// Time of point i of a batch stored under this stamp: its own timestamp
+	// when the batch has the column, otherwise its packet position's.
+	uint64_t batchTime(const PointColumns& points, size_t i) const
+	{
+		return points.timestamp != nullptr ? points.timestamp[i] : pointTime(first_dot + i);
+	}
+
+	// Host clock used for received, in ns.
+	static uint64_t hostNow()
+	{
+		return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count());
+	}
+};
+
+// Owning, growable structure-of-arrays scratch block. Used for producer-side
+// staging and for cook-side conversions that cannot write into CHOP channels
+// directly.
+class PointBlock
+{
+public:
+	void resize(size_t count);
+	size_t size() const;
+	PointColumns columns();
+
+private:
+	std::vector<float> x_;
+	std::vector<float> y_;
+	std::vector<float> z_;
+	std::vector<float> intensity_;
+	std::vector<float> tag_;
+	std::vector<uint64_t> timestamp_;
+	std::vector<uint64_t> received_;
+};
+
+// Lock-free single-producer/single-consumer point ring stored as separate
+// cache-line aligned columns. Push and pop are bulk copies per column, split in
+// at most two spans when the range wraps.
+//
+// Each point stores its time as a 32-bit nanosecond offset from its stamp. A
+// companion ring holds the PacketStamps, of which only first_point, timestamp
+// (the base of the offsets) and received are used; a stamp covers its points
+// up to the next stamp's first point. A push starts a new stamp unless the
+// newest one is still small, so the small batches the spatial filter leaves
+// share stamps, with the receive time of their first batch. When the stamp
+// ring overflows, the points of the evicted stamps are evicted as well so
+// every buffered point always has its stamp.
+class PointRing
+{
+public:
+	explicit PointRing(size_t capacity);
+	~PointRing();
+
+	PointRing(const PointRing&) = delete;
+	PointRing& operator=(const PointRing&) = delete;
+
+	// Reallocates the columns for at least capacity points (rounded up to a
+	// power of two) keeping the newest points that still fit, and resets the
+	// limit to the new capacity. Not thread-safe: the producer must be
+	// quiescent while this runs.
+	void resize(size_t capacity);
+
+	size_t capacity() const;
+	size_t size() const;
+	size_t limit() const;
+
+	// Consumer: caps the buffered points at limit (<= capacity), evicting the
+	// excess in O(1). Returns the number of evicted points.
+	size_t setLimit(size_t limit);
+
+	// Producer: appends count points of one packet from the source columns
+	// (x/y/z/intensity/tag must be set). Point times come from the timestamp
+	// column if set, otherwise from the packet timing in stamp. Returns the
+	// number of evicted points.
+	size_t push(const PointColumns& source, size_t count, const PacketStamp& stamp);
+
+	// Consumer: copies up to max_points of the oldest points into the non-null
+	// destination columns and removes them from the ring. Timestamps and
+	// receive times are rebuilt per point from the stamps.
+	size_t pop(const PointColumns& destination, size_t max_points);
+
+	// Consumer: drops the oldest points so that at most keep remain. The read
+	// index moves in O(1); releasing the covered stamps is a binary search.
+	// Returns the number of dropped points.
+	size_t trim(size_t keep);
+
+	// Consumer: drains the whole backlog, copying max_points of it sampled at a
+	// uniform stride (everything if it fits). skipped receives the number of
+	// points stepped over.
+	size_t popDecimated(const PointColumns& destination, size_t max_points, size_t& skipped);
+
+	// Consumer: drops everything currently buffered. The newest stamp is kept
+	// for the points the producer may still add to it.
+	void clear();
+
+private:
+	static size_t stampCapacityFor(size_t capacity);
+
+	void allocate(PointColumns& columns, size_t capacity);
+	void release(PointColumns& columns);
+	void copyIn(const PointColumns& source, uint64_t index, size_t count);
+	void copyOut(uint64_t index, const PointColumns& destination, size_t count) const;
+	void gatherOut(uint64_t index, size_t span, const PointColumns& destination, size_t count) const;
+	// Fills the timestamp and received columns for the points
+	// first_point + i * span / count.
+	bool fillStampColumns(uint64_t first_point, size_t span, size_t count, const PointColumns& destination) const;
+	void releaseStamps(uint64_t read);
+
+	PointColumns storage_;
+	uint32_t* time_offsets_;
+	SpscRingIndex index_;
+	PacketStamp* stamps_;
+	SpscRingIndex stamp_index_;
+};
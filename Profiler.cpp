@@ -0,0 +1,214 @@
+#include "Profiler.h"
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+
+namespace
+{
+	constexpr double kWindowSeconds = 1.0;
+	constexpr double kNanosPerMicro = 1000.0;
+
+	constexpr double kP50 = 0.5;
+	constexpr double kP99 = 0.99;
+
+	constexpr size_t kChannelsPerStage = 4;
+
+	constexpr std::array<const char*, 20> kStageChannelNames = {
+		"ingest_avg_us", "ingest_p50_us", "ingest_p99_us", "ingest_max_us",
+		"cook_lock_avg_us", "cook_lock_p50_us", "cook_lock_p99_us", "cook_lock_max_us",
+		"consume_avg_us", "consume_p50_us", "consume_p99_us", "consume_max_us",
+		"fill_avg_us", "fill_p50_us", "fill_p99_us", "fill_max_us",
+		"execute_avg_us", "execute_p50_us", "execute_p99_us", "execute_max_us"
+	};
+
+	constexpr std::array<const char*, 2> kRateChannelNames = { "packets_per_second", "points_per_second" };
+
+	// Single-writer increment: a load and a store, no locked instruction.
+	void
+	add(std::atomic<uint64_t>& counter, uint64_t value)
+	{
+		counter.store(counter.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+	}
+
+	// A window's share of a running total. Totals only grow, but a reset()
+	// racing a writer's load and store can leave one behind its snapshot.
+	uint64_t
+	since(uint64_t total, uint64_t previous)
+	{
+		return total > previous ? total - previous : 0;
+	}
+}
+
+static_assert(kStageChannelNames.size() == kChannelsPerStage * static_cast<size_t>(Profiler::Stage::Count), "avg/p50/p99/max channels per stage");
+
+Profiler::Profiler()
+	: counters_(new Counters[kCounterSets])
+	, window_histogram_(kHistogramBits)
+{
+	reset();
+}
+
+void
+Profiler::reset()
+{
+	for (size_t i = 0; i < kCounterSets; ++i)
+	{
+		counters_[i].count.store(0);
+		counters_[i].total_ns.store(0);
+		counters_[i].max_ns.store(0);
+		for (std::atomic<uint64_t>& bucket : counters_[i].buckets)
+		{
+			bucket.store(0);
+		}
+	}
+	for (Window& window : windows_)
+	{
+		window = Window();
+	}
+	for (IngestCounters& lane : ingest_)
+	{
+		lane.packets.store(0);
+		lane.points.store(0);
+	}
+	window_start_ = Clock::now();
+	window_packets_ = 0;
+	window_points_ = 0;
+	packet_rate_ = 0.0;
+	point_rate_ = 0.0;
+}
+
+void
+Profiler::record(Stage stage, Clock::duration elapsed, size_t lane)
+{
+	Counters& counters = counters_[counterSet(stage, lane)];
+	const uint64_t ns = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count());
+	add(counters.count, 1);
+	add(counters.total_ns, ns);
+	add(counters.buckets[LatencyHistogram::bucketIndex(ns, kBuckets)], 1);
+	// The cook thread resets max_ns when it closes a window; losing a sample to
+	// that race only understates one window's maximum.
+	if (ns > counters.max_ns.load(std::memory_order_relaxed))
+	{
+		counters.max_ns.store(ns, std::memory_order_relaxed);
+	}
+}
+
+void
+Profiler::countIngest(size_t lane, size_t points)
+{
+	assert(lane < kSensorLanes);
+	add(ingest_[lane].packets, 1);
+	add(ingest_[lane].points, points);
+}
+
+void
+Profiler::update(Clock::time_point now)
+{
+	const double elapsed = std::chrono::duration<double>(now - window_start_).count();
+	if (elapsed < kWindowSeconds)
+	{
+		return;
+	}
+
+	for (size_t i = 0; i < kStages; ++i)
+	{
+		Counters* lanes = &counters_[counterSet(static_cast<Stage>(i), 0)];
+		const size_t lane_count = laneCount(i);
+		Window& window = windows_[i];
+		uint64_t count = 0;
+		uint64_t total_ns = 0;
+		uint64_t max_ns = 0;
+		for (size_t lane = 0; lane < lane_count; ++lane)
+		{
+			count += lanes[lane].count.load(std::memory_order_relaxed);
+			total_ns += lanes[lane].total_ns.load(std::memory_order_relaxed);
+			max_ns = std::max(max_ns, lanes[lane].max_ns.exchange(0, std::memory_order_relaxed));
+		}
+		const uint64_t samples = since(count, window.count);
+		window.average_us = samples == 0 ? 0.0 : static_cast<double>(since(total_ns, window.total_ns)) / static_cast<double>(samples) / kNanosPerMicro;
+		window.max_us = static_cast<double>(max_ns) / kNanosPerMicro;
+		window.count = count;
+		window.total_ns = total_ns;
+
+		// Percentiles come from this window's share of each bucket, recorded at
+		// the bucket's upper edge and capped by the exact maximum.
+		window_histogram_.reset();
+		for (size_t b = 0; b < kBuckets; ++b)
+		{
+			uint64_t total = 0;
+			for (size_t lane = 0; lane < lane_count; ++lane)
+			{
+				total += lanes[lane].buckets[b].load(std::memory_order_relaxed);
+			}
+			window_histogram_.record(LatencyHistogram::bucketValue(b + 1) - 1, since(total, window.buckets[b]));
+			window.buckets[b] = total;
+		}
+		window.p50_us = static_cast<double>(std::min(window_histogram_.percentile(kP50), max_ns)) / kNanosPerMicro;
+		window.p99_us = static_cast<double>(std::min(window_histogram_.percentile(kP99), max_ns)) / kNanosPerMicro;
+	}
+
+	uint64_t packets = 0;
+	uint64_t points = 0;
+	for (const IngestCounters& lane : ingest_)
+	{
+		packets += lane.packets.load(std::memory_order_relaxed);
+		points += lane.points.load(std::memory_order_relaxed);
+	}
+	packet_rate_ = static_cast<double>(since(packets, window_packets_)) / elapsed;
+	point_rate_ = static_cast<double>(since(points, window_points_)) / elapsed;
+	window_packets_ = packets;
+	window_points_ = points;
+	window_start_ = now;
+}
+
+size_t
+Profiler::channelCount() const
+{
+	return enabled() ? kStageChannelNames.size() + kRateChannelNames.size() : 0;
+}
+
+const char*
+Profiler::channelName(size_t index) const
+{
+	if (index < kStageChannelNames.size())
+	{
+		return kStageChannelNames[index];
+	}
+	return kRateChannelNames[(index - kStageChannelNames.size()) % kRateChannelNames.size()];
+}
+
+double
+Profiler::channelValue(size_t index) const
+{
+	if (index < kStageChannelNames.size())
+	{
+		const Window& window = windows_[index / kChannelsPerStage];
+		switch (index % kChannelsPerStage)
+		{
+		case 0:
+			return window.average_us;
+		case 1:
+			return window.p50_us;
+		case 2:
+			return window.p99_us;
+		default:
+			return window.max_us;
+		}
+	}
+	return index == kStageChannelNames.size() ? packet_rate_ : point_rate_;
+}
+
+size_t
+Profiler::counterSet(Stage stage, size_t lane)
+{
+	const size_t index = static_cast<size_t>(stage);
+	assert(lane < laneCount(index));
+	return index < kSourceStages ? index * kSensorLanes + lane : kSourceStages * kSensorLanes + index - kSourceStages;
+}
+
+size_t
+Profiler::laneCount(size_t stage)
+{
+	return stage < kSourceStages ? kSensorLanes : 1;
+}
@@ -0,0 +1,157 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+#include "LatencyHistogram.h"
+
+// Build with LIVOX_INSTRUMENTATION=0 to compile the hot-path timers out.
+#ifndef LIVOX_INSTRUMENTATION
+#define LIVOX_INSTRUMENTATION 1
+#endif
+
+#define LIVOX_PROFILE_CONCAT_INNER(a, b) a##b
+#define LIVOX_PROFILE_CONCAT(a, b) LIVOX_PROFILE_CONCAT_INNER(a, b)
+
+#if LIVOX_INSTRUMENTATION
+#define LIVOX_PROFILE_SCOPE(profiler, stage) \
+	const Profiler::ScopedTimer LIVOX_PROFILE_CONCAT(livox_profile_scope_, __LINE__)((profiler), (stage))
+#define LIVOX_PROFILE_SENSOR_SCOPE(profiler, stage, lane) \
+	const Profiler::ScopedTimer LIVOX_PROFILE_CONCAT(livox_profile_scope_, __LINE__)((profiler), (stage), (lane))
+#define LIVOX_PROFILE_INGEST(profiler, lane, points) (profiler).countIngest((lane), (points))
+#else
+#define LIVOX_PROFILE_SCOPE(profiler, stage) ((void)0)
+#define LIVOX_PROFILE_SENSOR_SCOPE(profiler, stage, lane) ((void)0)
+#define LIVOX_PROFILE_INGEST(profiler, lane, points) ((void)0)
+#endif
+
+// Per-stage timing for the ingest and cook threads. Counters are written with
+// plain relaxed loads and stores rather than read-modify-writes, so each set
+// must have a single writer: the cook-thread stages have one set, and the
+// source-thread stages and ingest rates one per sensor slot (lane), since a
+// source delivers each lidar's point packets from one thread. The cook thread
+// sums the lanes into rolling one-second windows in update() and exposes the
+// window average, median, 99th percentile and maximum as Info CHOP channels.
+class Profiler
+{
+public:
+	using Clock = std::chrono::steady_clock;
+
+	// Lanes of the source-thread stage; LivoxDevice uses its sensor slots.
+	static constexpr size_t kSensorLanes = 8;
+
+	enum class Stage
+	{
+		// Source-thread stage, one lane per sensor slot.
+		Ingest = 0,     // LivoxDevice::onPacket, per packet
+		// Cook-thread stages.
+		CookLock,       // ingest_mutex_ acquisition on the cook thread
+		Consume,        // LivoxDevice::consume
+		Fill,           // LivoxMid360CHOP::fillChannels
+		Execute,        // LivoxMid360CHOP::execute
+		Count
+	};
+
+	class ScopedTimer
+	{
+	public:
+		ScopedTimer(Profiler& profiler, Stage stage, size_t lane = 0)
+			: profiler_(profiler)
+			, stage_(stage)
+			, lane_(lane)
+			, start_(Clock::now())
+		{
+		}
+
+		~ScopedTimer()
+		{
+			profiler_.record(stage_, Clock::now() - start_, lane_);
+		}
+
+		ScopedTimer(const ScopedTimer&) = delete;
+		ScopedTimer& operator=(const ScopedTimer&) = delete;
+
+	private:
+		Profiler& profiler_;
+		Stage stage_;
+		size_t lane_;
+		Clock::time_point start_;
+	};
+
+	Profiler();
+
+	static constexpr bool enabled()
+	{
+		return LIVOX_INSTRUMENTATION != 0;
+	}
+
+	void reset();
+
+	// Writer side; only the lane's own thread may call these. lane is below
+	// kSensorLanes for the source-thread stages and 0 for the others.
+	void record(Stage stage, Clock::duration elapsed, size_t lane = 0);
+	void countIngest(size_t lane, size_t points);
+
+	// Cook thread: closes the current window once it is a second old.
+	void update(Clock::time_point now);
+
+	// Info CHOP view: average, p50, p99 and maximum per stage in
+	// microseconds, then packets/s and points/s.
+	size_t channelCount() const;
+	const char* channelName(size_t index) const;
+	double channelValue(size_t index) const;
+
+private:
+	static constexpr size_t kStages = static_cast<size_t>(Stage::Count);
+	static constexpr size_t kSourceStages = static_cast<size_t>(Stage::CookLock);
+	static constexpr size_t kCounterSets = kSourceStages * kSensorLanes + kStages - kSourceStages;
+
+	// Durations up to about 4 s are resolved; longer ones land in the top bucket.
+	static constexpr int kHistogramBits = 32;
+	static constexpr size_t kBuckets = LatencyHistogram::bucketCount(kHistogramBits);
+
+	struct alignas(64) Counters
+	{
+		std::atomic<uint64_t> count{ 0 };
+		std::atomic<uint64_t> total_ns{ 0 };
+		std::atomic<uint64_t> max_ns{ 0 };
+		std::atomic<uint64_t> buckets[kBuckets];
+	};
+
+	struct Window
+	{
+		uint64_t count = 0;
+		uint64_t total_ns = 0;
+		uint64_t buckets[kBuckets] = {};
+		double average_us = 0.0;
+		double p50_us = 0.0;
+		double p99_us = 0.0;
+		double max_us = 0.0;
+	};
+
+	struct alignas(64) IngestCounters
+	{
+		std::atomic<uint64_t> packets{ 0 };
+		std::atomic<uint64_t> points{ 0 };
+	};
+
+	static size_t counterSet(Stage stage, size_t lane);
+	// Lanes of stage; its sets are consecutive from counterSet(stage, 0).
+	static size_t laneCount(size_t stage);
+
+	// On the heap: every set carries a full histogram.
+	std::unique_ptr<Counters[]> counters_;
+	Window windows_[kStages];
+	LatencyHistogram window_histogram_;
+
+	IngestCounters ingest_[kSensorLanes];
+
+	Clock::time_point window_start_;
+	uint64_t window_packets_;
+	uint64_t window_points_;
+	double packet_rate_;
+	double point_rate_;
+};
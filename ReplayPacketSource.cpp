@@ -0,0 +1,330 @@
+#include "ReplayPacketSource.h"
+#include "PacketCodec.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <sstream>
+#include <unordered_set>
+
+namespace
+{
+	// Waits are split into slices of at most this long so stop() and seek()
+	// are prompt.
+	constexpr auto kMaxSleep = std::chrono::milliseconds(10);
+
+	// Records larger than this are treated as corruption.
+	constexpr uint32_t kMaxRecordSize = 64 * 1024;
+
+	constexpr double kNanosPerSecond = 1e9;
+}
+
+ReplayPacketSource::ReplayPacketSource(const Config& config)
+	: config_(config)
+	, records_end_(0)
+	, first_received_(0)
+	, compressed_(false)
+	, index_(nullptr)
+	, index_count_(0)
+	, running_(false)
+	, seek_ns_(-1)
+	, position_ns_(0)
+	, duration_ns_(0)
+{
+}
+
+ReplayPacketSource::~ReplayPacketSource()
+{
+	stop();
+}
+
+bool
+ReplayPacketSource::start(PacketSink& sink)
+{
+	stop();
+
+	if (!file_.openRead(config_.path))
+	{
+		sink.onStatus("Replay file not found: " + config_.path);
+		return false;
+	}
+
+	PacketFile::FileHeader header{};
+	if (file_.size() < sizeof(header))
+	{
+		file_.close();
+		sink.onStatus("Not a packet recording: " + config_.path);
+		return false;
+	}
+	std::memcpy(&header, file_.data(), sizeof(header));
+	if (std::memcmp(header.magic, PacketFile::kMagic, sizeof(header.magic)) != 0 || header.version < PacketFile::kMinVersion || header.version > PacketFile::kVersion)
+	{
+		file_.close();
+		sink.onStatus("Not a packet recording: " + config_.path);
+		return false;
+	}
+
+	compressed_ = header.version >= 3 && (header.flags & PacketFile::kFlagCompressed) != 0;
+	packet_scratch_.resize(compressed_ ? kMaxRecordSize : 0);
+
+	// A finished recording ends with its index; the records stop where it
+	// begins. Only the footer is read here, the entries are paged in by the
+	// first seek.
+	records_end_ = file_.size();
+	index_ = nullptr;
+	index_count_ = 0;
+	scanned_index_.clear();
+	duration_ns_.store(0);
+	position_ns_.store(0);
+	seek_ns_.store(-1);
+	PacketFile::IndexFooter footer{};
+	if (file_.size() >= sizeof(header) + sizeof(footer))
+	{
+		std::memcpy(&footer, file_.data() + file_.size() - sizeof(footer), sizeof(footer));
+		const bool valid = std::memcmp(footer.magic, PacketFile::kIndexMagic, sizeof(footer.magic)) == 0
+			&& footer.index_offset >= sizeof(header)
+			&& footer.count <= (file_.size() - sizeof(footer) - footer.index_offset) / sizeof(PacketFile::IndexEntry)
+			&& footer.index_offset + footer.count * sizeof(PacketFile::IndexEntry) + sizeof(footer) == file_.size();
+		if (valid)
+		{
+			records_end_ = static_cast<size_t>(footer.index_offset);
+			index_ = reinterpret_cast<const PacketFile::IndexEntry*>(file_.data() + footer.index_offset);
+			index_count_ = static_cast<size_t>(footer.count);
+		}
+	}
+
+	PacketFile::RecordHeader first{};
+	first_received_ = readRecord(sizeof(header), first) ? first.received : 0;
+	if (index_count_ > 0 && footer.last_received >= first_received_)
+	{
+		duration_ns_.store(footer.last_received - first_received_);
+	}
+
+	running_.store(true);
+	sink.onStatus("Replaying " + config_.path);
+	thread_ = std::thread(&ReplayPacketSource::run, this, &sink);
+	return true;
+}
+
+void
+ReplayPacketSource::stop()
+{
+	running_.store(false);
+	if (thread_.joinable())
+	{
+		thread_.join();
+	}
+	index_ = nullptr;
+	index_count_ = 0;
+	file_.close();
+}
+
+void
+ReplayPacketSource::requestDataType(uint32_t, LivoxLidarPointDataType)
+{
+}
+
+std::string
+ReplayPacketSource::description() const
+{
+	std::ostringstream oss;
+	oss << "Replay (" << config_.path << ", ";
+	if (config_.speed > 0.0)
+	{
+		oss << config_.speed << "x";
+	}
+	else
+	{
+		oss << "unpaced";
+	}
+	if (config_.loop)
+	{
+		oss << ", looping";
+	}
+	oss << ")";
+	return oss.str();
+}
+
+void
+ReplayPacketSource::seek(double seconds)
+{
+	seek_ns_.store(static_cast<int64_t>(std::max(seconds, 0.0) * kNanosPerSecond));
+}
+
+double
+ReplayPacketSource::position() const
+{
+	return static_cast<double>(position_ns_.load(std::memory_order_relaxed)) / kNanosPerSecond;
+}
+
+double
+ReplayPacketSource::duration() const
+{
+	return static_cast<double>(duration_ns_.load(std::memory_order_relaxed)) / kNanosPerSecond;
+}
+
+bool
+ReplayPacketSource::readRecord(size_t offset, PacketFile::RecordHeader& record) const
+{
+	if (offset + sizeof(record) > records_end_)
+	{
+		return false;
+	}
+	std::memcpy(&record, file_.data() + offset, sizeof(record));
+	return record.size != 0 && record.size <= kMaxRecordSize && offset + sizeof(record) + record.size <= records_end_;
+}
+
+size_t
+ReplayPacketSource::seekOffset(uint64_t received) const
+{
+	const PacketFile::IndexEntry* begin = index_count_ > 0 ? index_ : scanned_index_.data();
+	const PacketFile::IndexEntry* end = begin + (index_count_ > 0 ? index_count_ : scanned_index_.size());
+
+	// Last entry at or before the target.
+	const PacketFile::IndexEntry* it = std::upper_bound(begin, end, received,
+		[](uint64_t value, const PacketFile::IndexEntry& entry) { return value < entry.received; });
+	if (it == begin)
+	{
+		return sizeof(PacketFile::FileHeader);
+	}
+	return static_cast<size_t>((it - 1)->offset);
+}
+
+void
+ReplayPacketSource::scanIndex()
+{
+	uint64_t next_time = 0;
+	uint64_t last_received = first_received_;
+	PacketFile::RecordHeader record{};
+	for (size_t offset = sizeof(PacketFile::FileHeader); readRecord(offset, record); offset += sizeof(record) + record.size)
+	{
+		if (scanned_index_.empty() || record.received >= next_time)
+		{
+			scanned_index_.push_back({ record.received, offset });
+			next_time = record.received + PacketFile::kIndexIntervalNs;
+		}
+		last_received = record.received;
+	}
+	duration_ns_.store(last_received - first_received_);
+}
+
+void
+ReplayPacketSource::run(PacketSink* sink)
+{
+	using Clock = std::chrono::steady_clock;
+	const uint8_t* const data = file_.data();
+	const bool paced = config_.speed > 0.0;
+	const size_t first_record = sizeof(PacketFile::FileHeader);
+
+	std::unordered_set<uint32_t> announced;
+
+	// A record plays at origin + (timeline + received - first_received_ - base)
+	// / speed. timeline accumulates the recording time of earlier loops; a
+	// seek moves origin to now and base to the target.
+	Clock::time_point origin = Clock::now();
+	uint64_t base = 0;
+	uint64_t timeline = 0;
+	uint64_t previous_received = first_received_;
+	uint64_t last_received = first_received_;
+	uint64_t skip_until = 0;
+	uint64_t packets = 0;
+
+	size_t offset = first_record;
+	while (running_.load(std::memory_order_relaxed))
+	{
+		const int64_t seek = seek_ns_.exchange(-1);
+		if (seek >= 0)
+		{
+			if (index_count_ == 0 && scanned_index_.empty())
+			{
+				scanIndex();
+			}
+			const uint64_t target = std::min(static_cast<uint64_t>(seek), duration_ns_.load(std::memory_order_relaxed));
+			skip_until = first_received_ + target;
+			offset = seekOffset(skip_until);
+			origin = Clock::now();
+			base = timeline + target;
+			position_ns_.store(target, std::memory_order_relaxed);
+		}
+
+		PacketFile::RecordHeader record{};
+		if (!readRecord(offset, record))
+		{
+			const bool corrupt = offset < records_end_;
+			if (corrupt && offset == first_record)
+			{
+				sink->onStatus("Replay stopped: corrupt record in " + config_.path);
+				return;
+			}
+			if (!corrupt)
+			{
+				duration_ns_.store(last_received - first_received_);
+			}
+			if (!config_.loop || packets == 0)
+			{
+				// Stay alive so scrubbing back into the recording resumes it.
+				sink->onStatus(corrupt ? "Replay stopped: corrupt record in " + config_.path : "Replay finished: " + config_.path);
+				while (running_.load(std::memory_order_relaxed) && seek_ns_.load(std::memory_order_relaxed) < 0)
+				{
+					std::this_thread::sleep_for(kMaxSleep);
+				}
+				sink->onStatus("Replaying " + config_.path);
+				continue;
+			}
+			// Continue the timeline across the wrap, leaving the last packet
+			// gap between the last packet and the first one again.
+			timeline += last_received - first_received_ + (last_received - previous_received);
+			skip_until = 0;
+			offset = first_record;
+			continue;
+		}
+
+		previous_received = last_received;
+		last_received = record.received;
+		if (record.received < skip_until)
+		{
+			offset += sizeof(record) + record.size;
+			continue;
+		}
+
+		if (paced)
+		{
+			const uint64_t position = timeline + record.received - first_received_;
+			const uint64_t ahead = position > base ? position - base : 0;
+			const Clock::time_point due = origin + std::chrono::nanoseconds(static_cast<int64_t>(static_cast<double>(ahead) / config_.speed));
+			for (Clock::time_point now = Clock::now(); now < due && running_.load(std::memory_order_relaxed) && seek_ns_.load(std::memory_order_relaxed) < 0; now = Clock::now())
+			{
+				std::this_thread::sleep_for(std::min<Clock::duration>(due - now, kMaxSleep));
+			}
+			if (seek_ns_.load(std::memory_order_relaxed) >= 0)
+			{
+				continue;
+			}
+			if (!running_.load(std::memory_order_relaxed))
+			{
+				break;
+			}
+		}
+
+		if (announced.insert(record.handle).second)
+		{
+			sink->onLidarInfo(record.handle, "REPLAY", "file");
+		}
+
+		const uint8_t* bytes = data + offset + sizeof(record);
+		size_t size = record.size;
+		if (compressed_)
+		{
+			size = PacketCodec::decode(bytes, size, packet_scratch_.data(), packet_scratch_.size());
+			bytes = packet_scratch_.data();
+		}
+		const auto* packet = reinterpret_cast<const LivoxLidarEthernetPacket*>(bytes);
+		if (size >= offsetof(LivoxLidarEthernetPacket, data) && PacketSource::packetSize(packet) <= size)
+		{
+			sink->onPacket(record.handle, packet);
+		}
+		position_ns_.store(record.received - first_received_, std::memory_order_relaxed);
+		offset += sizeof(record) + record.size;
+		++packets;
+	}
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "MappedFile.h"
+#include "PacketFile.h"
+#include "PacketSource.h"
+
+// Plays back a PacketFile recording on its own thread. The file is memory
+// mapped and packets are handed to the sink straight from the mapping, or,
+// for compressed recordings, decoded into one scratch packet first. Pacing
+// follows the recorded receive times scaled by a speed factor, or is switched
+// off to replay as fast as the sink accepts.
+//
+// seek() uses the recording's time index: a binary search picks the last
+// entry at or before the target, and at most one index interval of records is
+// skipped from there. Recordings without an index are scanned once, on the
+// playback thread, the first time they are seeked.
+class ReplayPacketSource : public PacketSource
+{
+public:
+	struct Config
+	{
+		std::string path;
+		// Playback speed relative to the recording; 0 or less is unpaced.
+		double speed = 1.0;
+		bool loop = false;
+	};
+
+	explicit ReplayPacketSource(const Config& config);
+	~ReplayPacketSource() override;
+
+	bool start(PacketSink& sink) override;
+	void stop() override;
+	void requestDataType(uint32_t handle, LivoxLidarPointDataType type) override;
+	std::string description() const override;
+
+	// Any thread; the playback thread applies the latest request before its
+	// next packet.
+	void seek(double seconds) override;
+	double position() const override;
+	// 0 until known: immediately for indexed recordings, otherwise once the
+	// recording has been scanned or played to the end.
+	double duration() const override;
+
+private:
+	void run(PacketSink* sink);
+	bool readRecord(size_t offset, PacketFile::RecordHeader& record) const;
+	size_t seekOffset(uint64_t received) const;
+	void scanIndex();
+
+	Config config_;
+	MappedFile file_;
+	size_t records_end_;
+	uint64_t first_received_;
+	bool compressed_;
+	std::vector<uint8_t> packet_scratch_; // playback thread; decoded packet
+
+	// Index stored in the file, or built by scanIndex() on the playback thread.
+	const PacketFile::IndexEntry* index_;
+	size_t index_count_;
+	std::vector<PacketFile::IndexEntry> scanned_index_;
+
+	std::atomic<bool> running_;
+	std::atomic<int64_t> seek_ns_; // pending seek target, or -1
+	std::atomic<uint64_t> position_ns_;
+	std::atomic<uint64_t> duration_ns_;
+	std::thread thread_;
+};
@@ -0,0 +1,215 @@
+#include "SdkPacketSource.h"
+
+#include <filesystem>
+#include <sstream>
+#include <system_error>
+
+SdkPacketSource::SdkPacketSource(const std::string& config_path)
+	: config_path_(config_path)
+	, sink_(nullptr)
+	, initialized_(false)
+{
+}
+
+SdkPacketSource::~SdkPacketSource()
+{
+	stop();
+}
+
+bool
+SdkPacketSource::start(PacketSink& sink)
+{
+	namespace fs = std::filesystem;
+	std::error_code ec;
+	const fs::path cfg_path(config_path_);
+	if (!fs::exists(cfg_path, ec))
+	{
+		sink.onStatus("Config file not found: " + config_path_);
+		return false;
+	}
+
+	if (!LivoxLidarSdkInit(config_path_.c_str()))
+	{
+		sink.onStatus("LivoxLidarSdkInit failed");
+		return false;
+	}
+
+	sink_ = &sink;
+	initialized_ = true;
+	sink.onStatus("SDK initialized, waiting for Mid-360");
+
+	SetLivoxLidarPointCloudCallBack(PointCloudCallback, this);
+	SetLivoxLidarImuDataCallback(ImuDataCallback, this);
+	SetLivoxLidarInfoCallback(InfoCallback, this);
+	SetLivoxLidarInfoChangeCallback(InfoChangeCallback, this);
+	return true;
+}
+
+void
+SdkPacketSource::stop()
+{
+	if (!initialized_)
+	{
+		return;
+	}
+	initialized_ = false;
+	LivoxLidarSdkUninit();
+	sink_ = nullptr;
+}
+
+void
+SdkPacketSource::requestDataType(uint32_t handle, LivoxLidarPointDataType type)
+{
+	const livox_status status = SetLivoxLidarPclDataType(handle, type, DataTypeCallback, this);
+	if (status != kLivoxLidarStatusSuccess && sink_ != nullptr)
+	{
+		std::ostringstream oss;
+		oss << "Set data type failed (" << status << ")";
+		sink_->onStatus(oss.str());
+	}
+}
+
+std::string
+SdkPacketSource::description() const
+{
+	return "Livox SDK (" + config_path_ + ")";
+}
+
+void
+SdkPacketSource::PointCloudCallback(uint32_t handle, const uint8_t, LivoxLidarEthernetPacket* data, void* client_data)
+{
+	if (client_data == nullptr || data == nullptr)
+	{
+		return;
+	}
+	auto* self = static_cast<SdkPacketSource*>(client_data);
+	if (self->sink_ != nullptr)
+	{
+		self->sink_->onPacket(handle, data);
+	}
+}
+
+void
+SdkPacketSource::ImuDataCallback(uint32_t handle, const uint8_t, LivoxLidarEthernetPacket* data, void* client_data)
+{
+	if (client_data == nullptr || data == nullptr)
+	{
+		return;
+	}
+	auto* self = static_cast<SdkPacketSource*>(client_data);
+	if (self->sink_ != nullptr)
+	{
+		self->sink_->onImuPacket(handle, data);
+	}
+}
+
+void
+SdkPacketSource::InfoCallback(uint32_t, const uint8_t, const char* info, void* client_data)
+{
+	if (client_data == nullptr || info == nullptr)
+	{
+		return;
+	}
+	auto* self = static_cast<SdkPacketSource*>(client_data);
+	if (self->sink_ != nullptr)
+	{
+		self->sink_->onInfoMessage(info);
+	}
+}
+
+void
+SdkPacketSource::InfoChangeCallback(uint32_t handle, const LivoxLidarInfo* info, void* client_data)
+{
+	if (client_data == nullptr || info == nullptr)
+	{
+		return;
+	}
+	auto* self = static_cast<SdkPacketSource*>(client_data);
+	SetLivoxLidarWorkMode(handle, kLivoxLidarNormal, WorkModeCallback, self);
+	EnableLivoxLidarImuData(handle, ImuEnableCallback, self);
+	if (self->sink_ != nullptr)
+	{
+		self->sink_->onLidarInfo(handle, info->sn, info->lidar_ip);
+	}
+}
+
+void
+SdkPacketSource::WorkModeCallback(livox_status status, uint32_t handle, LivoxLidarAsyncControlResponse* response, void* client_data)
+{
+	if (client_data == nullptr)
+	{
+		return;
+	}
+	auto* self = static_cast<SdkPacketSource*>(client_data);
+	std::ostringstream oss;
+	if (status == kLivoxLidarStatusSuccess && response != nullptr && response->ret_code == 0)
+	{
+		oss << "Work mode set OK for handle " << handle;
+	}
+	else
+	{
+		oss << "Work mode failed (" << status << ")";
+		if (response != nullptr)
+		{
+			oss << " ret=" << static_cast<int>(response->ret_code);
+		}
+	}
+	if (self->sink_ != nullptr)
+	{
+		self->sink_->onStatus(oss.str());
+	}
+}
+
+void
+SdkPacketSource::DataTypeCallback(livox_status status, uint32_t handle, LivoxLidarAsyncControlResponse* response, void* client_data)
+{
+	if (client_data == nullptr)
+	{
+		return;
+	}
+	auto* self = static_cast<SdkPacketSource*>(client_data);
+	std::ostringstream oss;
+	if (status == kLivoxLidarStatusSuccess && response != nullptr && response->ret_code == 0)
+	{
+		oss << "Data type updated for handle " << handle;
+	}
+	else
+	{
+		oss << "Data type update failed (" << status << ")";
+		if (response != nullptr)
+		{
+			oss << " ret=" << static_cast<int>(response->ret_code);
+		}
+	}
+	if (self->sink_ != nullptr)
+	{
+		self->sink_->onStatus(oss.str());
+	}
+}
+
+void
+SdkPacketSource::ImuEnableCallback(livox_status status, uint32_t handle, LivoxLidarAsyncControlResponse* response, void* client_data)
+{
+	if (client_data == nullptr)
+	{
+		return;
+	}
+	auto* self = static_cast<SdkPacketSource*>(client_data);
+	std::ostringstream oss;
+	if (status == kLivoxLidarStatusSuccess && response != nullptr && response->ret_code == 0)
+	{
+		oss << "IMU data enabled for handle " << handle;
+	}
+	else
+	{
+		oss << "IMU data enable failed (" << status << ")";
+		if (response != nullptr)
+		{
+			oss << " ret=" << static_cast<int>(response->ret_code);
+		}
+	}
+	if (self->sink_ != nullptr)
+	{
+		self->sink_->onStatus(oss.str());
+	}
+}
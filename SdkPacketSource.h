@@ -0,0 +1,32 @@
+#pragma once
+
+#include <string>
+
+#include "PacketSource.h"
+
+// Packet source backed by the Livox SDK2. The SDK is process-global, so only
+// one instance may be started at a time.
+class SdkPacketSource : public PacketSource
+{
+public:
+	explicit SdkPacketSource(const std::string& config_path);
+	~SdkPacketSource() override;
+
+	bool start(PacketSink& sink) override;
+	void stop() override;
+	void requestDataType(uint32_t handle, LivoxLidarPointDataType type) override;
+	std::string description() const override;
+
+private:
+	static void PointCloudCallback(uint32_t handle, const uint8_t dev_type, LivoxLidarEthernetPacket* data, void* client_data);
+	static void ImuDataCallback(uint32_t handle, const uint8_t dev_type, LivoxLidarEthernetPacket* data, void* client_data);
+	static void InfoCallback(uint32_t handle, const uint8_t dev_type, const char* info, void* client_data);
+	static void InfoChangeCallback(uint32_t handle, const LivoxLidarInfo* info, void* client_data);
+	static void WorkModeCallback(livox_status status, uint32_t handle, LivoxLidarAsyncControlResponse* response, void* client_data);
+	static void DataTypeCallback(livox_status status, uint32_t handle, LivoxLidarAsyncControlResponse* response, void* client_data);
+	static void ImuEnableCallback(livox_status status, uint32_t handle, LivoxLidarAsyncControlResponse* response, void* client_data);
+
+	std::string config_path_;
+	PacketSink* sink_;
+	bool initialized_;
+};
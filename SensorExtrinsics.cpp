@@ -0,0 +1,338 @@
+#include "SensorExtrinsics.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <utility>
+
+namespace
+{
+	constexpr double kMillimetersPerMeter = 1000.0;
+
+	// Nesting deeper than this is rejected rather than recursed into.
+	constexpr int kMaxJsonDepth = 64;
+
+	struct JsonValue
+	{
+		enum class Type
+		{
+			Null,
+			Bool,
+			Number,
+			String,
+			Array,
+			Object
+		};
+
+		Type type = Type::Null;
+		double number = 0.0;
+		std::string text;
+		std::vector<JsonValue> items;
+		std::vector<std::pair<std::string, JsonValue>> members;
+
+		const JsonValue*
+		member(const char* name) const
+		{
+			for (const std::pair<std::string, JsonValue>& entry : members)
+			{
+				if (entry.first == name)
+				{
+					return &entry.second;
+				}
+			}
+			return nullptr;
+		}
+
+		double
+		numberOr(const char* name, double fallback) const
+		{
+			const JsonValue* value = member(name);
+			return value != nullptr && value->type == Type::Number ? value->number : fallback;
+		}
+	};
+
+	// Just enough JSON for configuration files: the whole document is parsed
+	// into a tree, and \u escapes outside ASCII become '?'.
+	class JsonReader
+	{
+	public:
+		JsonReader(const char* begin, const char* end)
+			: pos_(begin)
+			, end_(end)
+		{
+		}
+
+		bool
+		parseDocument(JsonValue& value)
+		{
+			if (!parseValue(value, 0))
+			{
+				return false;
+			}
+			skipSpace();
+			return pos_ == end_;
+		}
+
+	private:
+		void
+		skipSpace()
+		{
+			while (pos_ != end_ && (*pos_ == ' ' || *pos_ == '\t' || *pos_ == '\n' || *pos_ == '\r'))
+			{
+				++pos_;
+			}
+		}
+
+		bool
+		consume(char expected)
+		{
+			skipSpace();
+			if (pos_ == end_ || *pos_ != expected)
+			{
+				return false;
+			}
+			++pos_;
+			return true;
+		}
+
+		bool
+		literal(const char* word)
+		{
+			const size_t length = std::strlen(word);
+			if (static_cast<size_t>(end_ - pos_) < length || std::strncmp(pos_, word, length) != 0)
+			{
+				return false;
+			}
+			pos_ += length;
+			return true;
+		}
+
+		bool
+		parseValue(JsonValue& value, int depth)
+		{
+			if (depth > kMaxJsonDepth)
+			{
+				return false;
+			}
+			skipSpace();
+			if (pos_ == end_)
+			{
+				return false;
+			}
+
+			switch (*pos_)
+			{
+			case '{':
+				return parseObject(value, depth);
+			case '[':
+				return parseArray(value, depth);
+			case '"':
+				value.type = JsonValue::Type::String;
+				return parseString(value.text);
+			case 't':
+				value.type = JsonValue::Type::Bool;
+				value.number = 1.0;
+				return literal("true");
+			case 'f':
+				value.type = JsonValue::Type::Bool;
+				return literal("false");
+			case 'n':
+				return literal("null");
+			default:
+				return parseNumber(value);
+			}
+		}
+
+		bool
+		parseObject(JsonValue& value, int depth)
+		{
+			value.type = JsonValue::Type::Object;
+			++pos_;
+			if (consume('}'))
+			{
+				return true;
+			}
+			do
+			{
+				std::pair<std::string, JsonValue> entry;
+				skipSpace();
+				if (pos_ == end_ || *pos_ != '"' || !parseString(entry.first) || !consume(':') || !parseValue(entry.second, depth + 1))
+				{
+					return false;
+				}
+				value.members.push_back(std::move(entry));
+			} while (consume(','));
+			return consume('}');
+		}
+
+		bool
+		parseArray(JsonValue& value, int depth)
+		{
+			value.type = JsonValue::Type::Array;
+			++pos_;
+			if (consume(']'))
+			{
+				return true;
+			}
+			do
+			{
+				value.items.emplace_back();
+				if (!parseValue(value.items.back(), depth + 1))
+				{
+					return false;
+				}
+			} while (consume(','));
+			return consume(']');
+		}
+
+		bool
+		parseString(std::string& text)
+		{
+			++pos_;
+			while (pos_ != end_)
+			{
+				const char c = *pos_++;
+				if (c == '"')
+				{
+					return true;
+				}
+				if (c != '\\')
+				{
+					text += c;
+					continue;
+				}
+				if (pos_ == end_)
+				{
+					return false;
+				}
+				const char escape = *pos_++;
+				switch (escape)
+				{
+				case 'b':
+					text += '\b';
+					break;
+				case 'f':
+					text += '\f';
+					break;
+				case 'n':
+					text += '\n';
+					break;
+				case 'r':
+					text += '\r';
+					break;
+				case 't':
+					text += '\t';
+					break;
+				case 'u':
+				{
+					if (end_ - pos_ < 4)
+					{
+						return false;
+					}
+					const std::string hex(pos_, pos_ + 4);
+					char* parsed_end = nullptr;
+					const long code = std::strtol(hex.c_str(), &parsed_end, 16);
+					if (parsed_end != hex.c_str() + 4)
+					{
+						return false;
+					}
+					text += code < 0x80 ? static_cast<char>(code) : '?';
+					pos_ += 4;
+					break;
+				}
+				default:
+					text += escape;
+					break;
+				}
+			}
+			return false;
+		}
+
+		bool
+		parseNumber(JsonValue& value)
+		{
+			// strtod needs a terminated buffer; JSON numbers are short.
+			const char* start = pos_;
+			while (pos_ != end_ && std::strchr("+-0123456789.eE", *pos_) != nullptr)
+			{
+				++pos_;
+			}
+			const std::string digits(start, pos_);
+			char* parsed_end = nullptr;
+			value.type = JsonValue::Type::Number;
+			value.number = std::strtod(digits.c_str(), &parsed_end);
+			return !digits.empty() && parsed_end == digits.c_str() + digits.size();
+		}
+
+		const char* pos_;
+		const char* end_;
+	};
+}
+
+bool
+SensorExtrinsic::operator==(const SensorExtrinsic& other) const
+{
+	return key == other.key && transform == other.transform;
+}
+
+bool
+SensorExtrinsics::loadConfig(const std::string& path, std::vector<SensorExtrinsic>& extrinsics, std::string& error)
+{
+	extrinsics.clear();
+	std::ifstream file(path, std::ios::binary);
+	if (!file)
+	{
+		error = "Cannot open " + path;
+		return false;
+	}
+	const std::string text((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+	JsonValue root;
+	JsonReader reader(text.data(), text.data() + text.size());
+	if (!reader.parseDocument(root) || root.type != JsonValue::Type::Object)
+	{
+		error = "Invalid JSON in " + path;
+		return false;
+	}
+
+	const JsonValue* configs = root.member("lidar_configs");
+	if (configs == nullptr || configs->type != JsonValue::Type::Array)
+	{
+		return true;
+	}
+	for (const JsonValue& config : configs->items)
+	{
+		const JsonValue* ip = config.member("ip");
+		const JsonValue* parameter = config.member("extrinsic_parameter");
+		if (ip == nullptr || ip->type != JsonValue::Type::String || parameter == nullptr || parameter->type != JsonValue::Type::Object)
+		{
+			continue;
+		}
+
+		SensorExtrinsic extrinsic;
+		extrinsic.key = ip->text;
+		extrinsic.transform = PointTransform::fromEuler(
+			parameter->numberOr("x", 0.0) / kMillimetersPerMeter,
+			parameter->numberOr("y", 0.0) / kMillimetersPerMeter,
+			parameter->numberOr("z", 0.0) / kMillimetersPerMeter,
+			parameter->numberOr("roll", 0.0),
+			parameter->numberOr("pitch", 0.0),
+			parameter->numberOr("yaw", 0.0));
+		extrinsics.push_back(std::move(extrinsic));
+	}
+	return true;
+}
+
+const PointTransform*
+SensorExtrinsics::find(const std::vector<SensorExtrinsic>& extrinsics, const std::string& serial, const std::string& ip)
+{
+	for (auto it = extrinsics.rbegin(); it != extrinsics.rend(); ++it)
+	{
+		if ((!serial.empty() && it->key == serial) || (!ip.empty() && it->key == ip))
+		{
+			return &it->transform;
+		}
+	}
+	return nullptr;
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "PointDecoder.h"
+
+// Mounting transform for the lidar whose serial number or IP address equals
+// key. Lidars are matched by identity rather than slot, since slots follow
+// the order in which lidars happen to report.
+struct SensorExtrinsic
+{
+	std::string key;
+	PointTransform transform;
+
+	bool operator==(const SensorExtrinsic& other) const;
+};
+
+class SensorExtrinsics
+{
+public:
+	// Reads the lidar_configs section that the Livox ROS driver keeps in the
+	// same JSON as the SDK network settings:
+	//   "lidar_configs": [{ "ip": "192.168.1.12",
+	//     "extrinsic_parameter": { "roll": 0, "pitch": 0, "yaw": 0, "x": 0, "y": 0, "z": 0 } }]
+	// with angles in degrees and x/y/z in millimetres. A file without that
+	// section yields no entries. Returns false with error set if the file
+	// cannot be read or is not valid JSON.
+	static bool loadConfig(const std::string& path, std::vector<SensorExtrinsic>& extrinsics, std::string& error);
+
+	// Transform for the lidar with this serial number or IP, or nullptr.
+	// Later entries win, so table rows appended after the config override it.
+	static const PointTransform* find(const std::vector<SensorExtrinsic>& extrinsics, const std::string& serial, const std::string& ip);
+};
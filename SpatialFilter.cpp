@@ -0,0 +1,350 @@
+#include "SpatialFilter.h"
+#include "PointDecoder.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstring>
+
+#if defined(_M_X64) || defined(__x86_64__)
+	#define LIVOX_HAS_X86_SIMD 1
+	#include <immintrin.h>
+	#if defined(_MSC_VER)
+		#define LIVOX_TARGET_AVX2
+	#else
+		#define LIVOX_TARGET_AVX2 __attribute__((target("avx2")))
+	#endif
+#endif
+
+namespace
+{
+	constexpr double kDegToRad = 3.14159265358979323846 / 180.0;
+
+	// Unit direction of an angle, with the components of the right angles
+	// exactly zero so points on an axis fall on the right side of a limit.
+	void
+	direction(double degrees, float unit[2])
+	{
+		const double radians = degrees * kDegToRad;
+		const double cosine = std::cos(radians);
+		const double sine = std::sin(radians);
+		unit[0] = std::fabs(cosine) < 1e-12 ? 0.0f : static_cast<float>(cosine);
+		unit[1] = std::fabs(sine) < 1e-12 ? 0.0f : static_cast<float>(sine);
+	}
+
+	// The scalar tests. Each is evaluated in the same order as in the vector
+	// kernel, without fused multiply-adds, so both reach the same verdicts.
+	unsigned
+	passes(const SpatialFilter::Limits& limits, float x, float y, float z)
+	{
+		unsigned keep = 1;
+		if (limits.crop)
+		{
+			keep &= static_cast<unsigned>(x >= limits.box_min[0]) & static_cast<unsigned>(x <= limits.box_max[0]);
+			keep &= static_cast<unsigned>(y >= limits.box_min[1]) & static_cast<unsigned>(y <= limits.box_max[1]);
+			keep &= static_cast<unsigned>(z >= limits.box_min[2]) & static_cast<unsigned>(z <= limits.box_max[2]);
+		}
+		if (limits.range)
+		{
+			const float squared = x * x + y * y + z * z;
+			keep &= static_cast<unsigned>(squared >= limits.min_squared) & static_cast<unsigned>(squared <= limits.max_squared);
+		}
+		if (limits.azimuth)
+		{
+			const unsigned from = static_cast<unsigned>(limits.azimuth_from[0] * y - limits.azimuth_from[1] * x >= 0.0f);
+			const unsigned to = static_cast<unsigned>(limits.azimuth_to[1] * x - limits.azimuth_to[0] * y >= 0.0f);
+			keep &= limits.azimuth_wide ? (from | to) : (from & to);
+		}
+		if (limits.elevation)
+		{
+			const float horizontal = std::sqrt(x * x + y * y);
+			keep &= static_cast<unsigned>(z * limits.elevation_from[0] - horizontal * limits.elevation_from[1] >= 0.0f);
+			keep &= static_cast<unsigned>(horizontal * limits.elevation_to[1] - z * limits.elevation_to[0] >= 0.0f);
+		}
+		return keep;
+	}
+
+	// Every point is written to the output slot and the slot only advances
+	// for points that pass; the output never overtakes the input, so the
+	// compaction runs in place.
+	size_t
+	compactScalar(const SpatialFilter::Limits& limits, const PointColumns& points, size_t begin, size_t kept, size_t count, uint32_t* indices)
+	{
+		for (size_t i = begin; i < count; ++i)
+		{
+			const unsigned keep = passes(limits, points.x[i], points.y[i], points.z[i]);
+			points.x[kept] = points.x[i];
+			points.y[kept] = points.y[i];
+			points.z[kept] = points.z[i];
+			points.intensity[kept] = points.intensity[i];
+			points.tag[kept] = points.tag[i];
+			if (indices != nullptr)
+			{
+				indices[kept] = static_cast<uint32_t>(i);
+			}
+			kept += keep;
+		}
+		return kept;
+	}
+
+#if defined(LIVOX_HAS_X86_SIMD)
+	constexpr size_t kLanes = 8;
+
+	// For every 8-bit mask, the lanes that are set, moved to the front, and
+	// how many there are.
+	struct CompactTable
+	{
+		int32_t lanes[256][kLanes];
+		uint8_t counts[256];
+	};
+
+	constexpr CompactTable
+	makeCompactTable()
+	{
+		CompactTable table{};
+		for (int mask = 0; mask < 256; ++mask)
+		{
+			int count = 0;
+			for (int lane = 0; lane < static_cast<int>(kLanes); ++lane)
+			{
+				if ((mask & (1 << lane)) != 0)
+				{
+					table.lanes[mask][count++] = lane;
+				}
+			}
+			table.counts[mask] = static_cast<uint8_t>(count);
+		}
+		return table;
+	}
+
+	constexpr CompactTable kCompactTable = makeCompactTable();
+
+	LIVOX_TARGET_AVX2
+	__m256
+	inside(__m256 value, float low, float high)
+	{
+		return _mm256_and_ps(_mm256_cmp_ps(value, _mm256_set1_ps(low), _CMP_GE_OQ), _mm256_cmp_ps(value, _mm256_set1_ps(high), _CMP_LE_OQ));
+	}
+
+	LIVOX_TARGET_AVX2
+	__m256
+	notNegative(__m256 value)
+	{
+		return _mm256_cmp_ps(value, _mm256_setzero_ps(), _CMP_GE_OQ);
+	}
+
+	LIVOX_TARGET_AVX2
+	__m256
+	passesAvx2(const SpatialFilter::Limits& limits, __m256 x, __m256 y, __m256 z)
+	{
+		__m256 keep = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+		if (limits.crop)
+		{
+			keep = _mm256_and_ps(keep, inside(x, limits.box_min[0], limits.box_max[0]));
+			keep = _mm256_and_ps(keep, inside(y, limits.box_min[1], limits.box_max[1]));
+			keep = _mm256_and_ps(keep, inside(z, limits.box_min[2], limits.box_max[2]));
+		}
+		if (limits.range)
+		{
+			const __m256 squared = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(x, x), _mm256_mul_ps(y, y)), _mm256_mul_ps(z, z));
+			keep = _mm256_and_ps(keep, inside(squared, limits.min_squared, limits.max_squared));
+		}
+		if (limits.azimuth)
+		{
+			const __m256 from = notNegative(_mm256_sub_ps(_mm256_mul_ps(_mm256_set1_ps(limits.azimuth_from[0]), y), _mm256_mul_ps(_mm256_set1_ps(limits.azimuth_from[1]), x)));
+			const __m256 to = notNegative(_mm256_sub_ps(_mm256_mul_ps(_mm256_set1_ps(limits.azimuth_to[1]), x), _mm256_mul_ps(_mm256_set1_ps(limits.azimuth_to[0]), y)));
+			keep = _mm256_and_ps(keep, limits.azimuth_wide ? _mm256_or_ps(from, to) : _mm256_and_ps(from, to));
+		}
+		if (limits.elevation)
+		{
+			const __m256 horizontal = _mm256_sqrt_ps(_mm256_add_ps(_mm256_mul_ps(x, x), _mm256_mul_ps(y, y)));
+			const __m256 from = notNegative(_mm256_sub_ps(_mm256_mul_ps(z, _mm256_set1_ps(limits.elevation_from[0])), _mm256_mul_ps(horizontal, _mm256_set1_ps(limits.elevation_from[1]))));
+			const __m256 to = notNegative(_mm256_sub_ps(_mm256_mul_ps(horizontal, _mm256_set1_ps(limits.elevation_to[1])), _mm256_mul_ps(z, _mm256_set1_ps(limits.elevation_to[0]))));
+			keep = _mm256_and_ps(keep, _mm256_and_ps(from, to));
+		}
+		return keep;
+	}
+
+	LIVOX_TARGET_AVX2
+	void
+	storeCompacted(float* column, size_t kept, size_t i, __m256i permute)
+	{
+		_mm256_storeu_ps(column + kept, _mm256_permutevar8x32_ps(_mm256_loadu_ps(column + i), permute));
+	}
+
+	// Full 8-lane stores at the output slot only overwrite points of the
+	// current block, which are already loaded, or points already output.
+	LIVOX_TARGET_AVX2
+	size_t
+	compactAvx2(const SpatialFilter::Limits& limits, const PointColumns& points, size_t count, uint32_t* indices, size_t& kept)
+	{
+		const __m256i lane_index = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+		size_t i = 0;
+		for (; i + kLanes <= count; i += kLanes)
+		{
+			const __m256 keep = passesAvx2(limits, _mm256_loadu_ps(points.x + i), _mm256_loadu_ps(points.y + i), _mm256_loadu_ps(points.z + i));
+			const int mask = _mm256_movemask_ps(keep);
+			const __m256i permute = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(kCompactTable.lanes[mask]));
+			storeCompacted(points.x, kept, i, permute);
+			storeCompacted(points.y, kept, i, permute);
+			storeCompacted(points.z, kept, i, permute);
+			storeCompacted(points.intensity, kept, i, permute);
+			storeCompacted(points.tag, kept, i, permute);
+			if (indices != nullptr)
+			{
+				const __m256i positions = _mm256_add_epi32(_mm256_set1_epi32(static_cast<int32_t>(i)), lane_index);
+				_mm256_storeu_si256(reinterpret_cast<__m256i*>(indices + kept), _mm256_permutevar8x32_epi32(positions, permute));
+			}
+			kept += kCompactTable.counts[mask];
+		}
+		return i;
+	}
+#endif
+}
+
+bool
+SpatialFilter::Settings::enabled() const
+{
+	return crop || range || sector;
+}
+
+bool
+SpatialFilter::Settings::operator==(const Settings& other) const
+{
+	return crop == other.crop
+		&& std::equal(crop_min, crop_min + 3, other.crop_min)
+		&& std::equal(crop_max, crop_max + 3, other.crop_max)
+		&& range == other.range
+		&& min_range == other.min_range
+		&& max_range == other.max_range
+		&& sector == other.sector
+		&& std::equal(azimuth, azimuth + 2, other.azimuth)
+		&& std::equal(elevation, elevation + 2, other.elevation);
+}
+
+bool
+SpatialFilter::Settings::operator!=(const Settings& other) const
+{
+	return !(*this == other);
+}
+
+SpatialFilter::SpatialFilter()
+	: rejected_points_(0)
+{
+}
+
+void
+SpatialFilter::configure(const Settings& settings)
+{
+	settings_ = settings;
+	limits_ = Limits();
+
+	limits_.crop = settings.crop;
+	for (int axis = 0; axis < 3; ++axis)
+	{
+		limits_.box_min[axis] = std::min(settings.crop_min[axis], settings.crop_max[axis]);
+		limits_.box_max[axis] = std::max(settings.crop_min[axis], settings.crop_max[axis]);
+	}
+
+	limits_.range = settings.range;
+	limits_.min_squared = settings.min_range * settings.min_range;
+	limits_.max_squared = settings.max_range * settings.max_range;
+
+	if (settings.sector)
+	{
+		// A sector of 180 degrees or less is the intersection of the two
+		// half-planes bounding it, a wider one their union.
+		double width = std::fmod(static_cast<double>(settings.azimuth[1]) - settings.azimuth[0], 360.0);
+		if (width <= 0.0)
+		{
+			width += 360.0;
+		}
+		const bool full_circle = settings.azimuth[1] - settings.azimuth[0] >= 360.0f;
+		limits_.azimuth = !full_circle;
+		limits_.azimuth_wide = width > 180.0;
+		direction(settings.azimuth[0], limits_.azimuth_from);
+		direction(settings.azimuth[1], limits_.azimuth_to);
+
+		const float lowest = std::max(std::min(settings.elevation[0], settings.elevation[1]), -90.0f);
+		const float highest = std::min(std::max(settings.elevation[0], settings.elevation[1]), 90.0f);
+		limits_.elevation = lowest > -90.0f || highest < 90.0f;
+		direction(lowest, limits_.elevation_from);
+		direction(highest, limits_.elevation_to);
+	}
+}
+
+const SpatialFilter::Settings&
+SpatialFilter::settings() const
+{
+	return settings_;
+}
+
+bool
+SpatialFilter::enabled() const
+{
+	return settings_.enabled();
+}
+
+size_t
+SpatialFilter::apply(const PointColumns& points, size_t count, uint32_t* indices)
+{
+	if (!enabled())
+	{
+		return count;
+	}
+
+#if !defined(NDEBUG)
+	// Debug builds re-run the scalar kernel on a copy and assert it keeps the
+	// same points.
+	thread_local PointBlock reference;
+	reference.resize(count);
+	const PointColumns expected = reference.columns();
+	std::memcpy(expected.x, points.x, count * sizeof(float));
+	std::memcpy(expected.y, points.y, count * sizeof(float));
+	std::memcpy(expected.z, points.z, count * sizeof(float));
+	std::memcpy(expected.intensity, points.intensity, count * sizeof(float));
+	std::memcpy(expected.tag, points.tag, count * sizeof(float));
+	const size_t expected_count = compactScalar(limits_, expected, 0, 0, count, nullptr);
+#endif
+
+	size_t kept = 0;
+	size_t done = 0;
+#if defined(LIVOX_HAS_X86_SIMD)
+	if (PointDecoder::activeKernel() == PointDecoder::Kernel::Avx2)
+	{
+		done = compactAvx2(limits_, points, count, indices, kept);
+	}
+#endif
+	kept = compactScalar(limits_, points, done, kept, count, indices);
+
+#if !defined(NDEBUG)
+	assert(kept == expected_count);
+	assert(std::memcmp(expected.x, points.x, kept * sizeof(float)) == 0);
+	assert(std::memcmp(expected.y, points.y, kept * sizeof(float)) == 0);
+	assert(std::memcmp(expected.z, points.z, kept * sizeof(float)) == 0);
+#endif
+	return finish(count, kept);
+}
+
+size_t
+SpatialFilter::applyScalar(const PointColumns& points, size_t count, uint32_t* indices)
+{
+	if (!enabled())
+	{
+		return count;
+	}
+	return finish(count, compactScalar(limits_, points, 0, 0, count, indices));
+}
+
+uint64_t
+SpatialFilter::rejectedPoints() const
+{
+	return rejected_points_.load(std::memory_order_relaxed);
+}
+
+size_t
+SpatialFilter::finish(size_t count, size_t kept)
+{
+	rejected_points_.fetch_add(count - kept, std::memory_order_relaxed);
+	return kept;
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+#include "PointRing.h"
+
+// Decode-time spatial filter: drops the points outside a crop box, a distance
+// band and an azimuth/elevation sector before they reach the buffers. The
+// angular limits are turned into plane normals up front, so a point costs a
+// few multiplies and compares and no trigonometry.
+//
+// The AVX2 kernel builds the mask of 8 points at a time and compacts the
+// survivors with a permute looked up from it; the scalar kernel compacts
+// branch-free by writing every point and advancing by its mask bit. Both keep
+// exactly the same points.
+class SpatialFilter
+{
+public:
+	struct Settings
+	{
+		bool crop = false;
+		float crop_min[3] = { -5.0f, -5.0f, -5.0f };
+		float crop_max[3] = { 5.0f, 5.0f, 5.0f };
+
+		// Distance from the origin, in metres.
+		bool range = false;
+		float min_range = 0.1f;
+		float max_range = 70.0f;
+
+		// Degrees, as in the spherical output: azimuth counter-clockwise from
+		// +x, elevation up from the x/y plane. The azimuth interval runs
+		// counter-clockwise from the first value to the second, so it may wrap
+		// through 180.
+		bool sector = false;
+		float azimuth[2] = { -180.0f, 180.0f };
+		float elevation[2] = { -90.0f, 90.0f };
+
+		bool enabled() const;
+		bool operator==(const Settings& other) const;
+		bool operator!=(const Settings& other) const;
+	};
+
+	SpatialFilter();
+
+	// Not thread-safe: the filtering thread must be quiescent.
+	void configure(const Settings& settings);
+	const Settings& settings() const;
+	bool enabled() const;
+
+	// Compacts the x/y/z/intensity/tag columns in place to the points that
+	// pass and returns how many are left. When indices is not null it
+	// receives each survivor's original position. With no test enabled the
+	// points and indices are left untouched.
+	size_t apply(const PointColumns& points, size_t count, uint32_t* indices);
+	size_t applyScalar(const PointColumns& points, size_t count, uint32_t* indices);
+
+	// Points dropped by apply() so far.
+	uint64_t rejectedPoints() const;
+
+	// Plane normals and bounds derived from the settings.
+	struct Limits
+	{
+		bool crop = false;
+		float box_min[3] = {};
+		float box_max[3] = {};
+		bool range = false;
+		float min_squared = 0.0f;
+		float max_squared = 0.0f;
+		bool azimuth = false;
+		bool azimuth_wide = false;
+		float azimuth_from[2] = {};
+		float azimuth_to[2] = {};
+		bool elevation = false;
+		float elevation_from[2] = {};
+		float elevation_to[2] = {};
+	};
+
+private:
+	size_t finish(size_t count, size_t kept);
+
+	Settings settings_;
+	Limits limits_;
+	std::atomic<uint64_t> rejected_points_;
+};
@@ -0,0 +1,373 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <new>
+#include <type_traits>
+
+// Index bookkeeping shared by the lock-free rings used between the Livox SDK
+// callback thread (producer) and the TouchDesigner cook thread (consumer).
+//
+// Indices are monotonically increasing 64-bit counters and the capacity is a
+// power of two, so the slot of index i is i & (capacity - 1). Neither side
+// takes a lock. The ring holds at most limit() items, which may be lower than
+// the allocated capacity; when the producer would exceed it, it evicts the
+// oldest items by advancing the read index with a CAS. The consumer copies
+// first and commits with a CAS afterwards, so a drain that raced with an
+// eviction is detected and retried from the new read position.
+class SpscRingIndex
+{
+public:
+	static constexpr size_t kCacheLine = 64;
+
+	// Smallest power of two that holds capacity items.
+	static size_t roundCapacity(size_t capacity)
+	{
+		size_t rounded = 1;
+		while (rounded < capacity)
+		{
+			rounded <<= 1;
+		}
+		return rounded;
+	}
+
+	size_t capacity() const
+	{
+		return capacity_;
+	}
+
+	size_t limit() const
+	{
+		return limit_.load(std::memory_order_acquire);
+	}
+
+	size_t slot(uint64_t index) const
+	{
+		return static_cast<size_t>(index & mask_);
+	}
+
+	size_t size() const
+	{
+		const uint64_t read = read_.load(std::memory_order_acquire);
+		const uint64_t write = write_.load(std::memory_order_acquire);
+		return write > read ? static_cast<size_t>(write - read) : 0;
+	}
+
+	// Not thread-safe: the producer must be quiescent. capacity must come from
+	// roundCapacity(); the limit is reset to the full capacity. Passing the old
+	// read/write indices keeps absolute indices stable across reallocations.
+	void reset(size_t capacity, uint64_t read = 0, uint64_t write = 0)
+	{
+		capacity_ = capacity;
+		mask_ = capacity - 1;
+		limit_.store(capacity, std::memory_order_relaxed);
+		read_.store(read, std::memory_order_relaxed);
+		write_.store(write, std::memory_order_release);
+	}
+
+	// Either side: moves the read index forward to target (never backwards and
+	// never past the write index). Returns the number of items dropped.
+	size_t advanceRead(uint64_t target)
+	{
+		uint64_t read = read_.load(std::memory_order_acquire);
+		for (;;)
+		{
+			const uint64_t write = write_.load(std::memory_order_acquire);
+			const uint64_t bounded = std::min(target, write);
+			if (bounded <= read)
+			{
+				return 0;
+			}
+			if (read_.compare_exchange_weak(read, bounded, std::memory_order_acq_rel, std::memory_order_acquire))
+			{
+				return static_cast<size_t>(bounded - read);
+			}
+		}
+	}
+
+	// Consumer: lowers or raises the item limit (clamped to the capacity) and
+	// evicts any excess in O(1) by advancing the read index. Returns the number
+	// of evicted items.
+	size_t setLimit(size_t limit)
+	{
+		limit = std::min(std::max<size_t>(limit, 1), capacity_);
+		limit_.store(limit, std::memory_order_release);
+
+		const uint64_t write = write_.load(std::memory_order_acquire);
+		return write > limit ? advanceRead(write - limit) : 0;
+	}
+
+	// Producer: makes room for count items by evicting the oldest ones. Returns
+	// the write index to fill and stores the number of evicted items; if
+	// evicted_end is set, it receives the index just past the last evicted one.
+	uint64_t beginWrite(size_t count, size_t& evicted, uint64_t* evicted_end = nullptr)
+	{
+		const uint64_t write = write_.load(std::memory_order_relaxed);
+		const size_t limit = limit_.load(std::memory_order_acquire);
+		uint64_t read = read_.load(std::memory_order_acquire);
+		evicted = 0;
+		for (;;)
+		{
+			const uint64_t end = write + count;
+			if (end <= read || end - read <= limit)
+			{
+				return write;
+			}
+			const uint64_t target = end - limit;
+			if (read_.compare_exchange_weak(read, target, std::memory_order_acq_rel, std::memory_order_acquire))
+			{
+				evicted = static_cast<size_t>(target - read);
+				if (evicted_end != nullptr)
+				{
+					*evicted_end = target;
+				}
+				return write;
+			}
+		}
+	}
+
+	// Producer: publishes count items starting at the index from beginWrite().
+	void commitWrite(uint64_t write, size_t count)
+	{
+		write_.store(write + count, std::memory_order_release);
+	}
+
+	// Consumer: snapshot of the oldest buffered index and how many follow it.
+	uint64_t beginRead(size_t& available) const
+	{
+		const uint64_t read = read_.load(std::memory_order_acquire);
+		const uint64_t write = write_.load(std::memory_order_acquire);
+		available = write > read ? static_cast<size_t>(write - read) : 0;
+		return read;
+	}
+
+	// Consumer: releases count items after copying them out. Returns false if
+	// the producer evicted part of the range meanwhile and the copy is stale.
+	bool commitRead(uint64_t read, size_t count)
+	{
+		return read_.compare_exchange_strong(read, read + count, std::memory_order_acq_rel, std::memory_order_acquire);
+	}
+
+	// Consumer: drops everything currently buffered.
+	void clear()
+	{
+		uint64_t read = read_.load(std::memory_order_acquire);
+		const uint64_t write = write_.load(std::memory_order_acquire);
+		while (read < write && !read_.compare_exchange_weak(read, write, std::memory_order_acq_rel, std::memory_order_acquire))
+		{
+		}
+	}
+
+private:
+	size_t capacity_ = 0;
+	size_t mask_ = 0;
+	std::atomic<size_t> limit_{ 0 };
+	alignas(kCacheLine) std::atomic<uint64_t> write_{ 0 };
+	alignas(kCacheLine) std::atomic<uint64_t> read_{ 0 };
+};
+
+// Copies count items starting at absolute index first between two rings of
+// (possibly different) power-of-two capacities, splitting at either wrap.
+template <typename T>
+void
+copyRingRange(const T* source, size_t source_capacity, T* destination, size_t destination_capacity, uint64_t first, size_t count)
+{
+	while (count > 0)
+	{
+		const size_t source_slot = static_cast<size_t>(first & (source_capacity - 1));
+		const size_t destination_slot = static_cast<size_t>(first & (destination_capacity - 1));
+		const size_t chunk = std::min({ count, source_capacity - source_slot, destination_capacity - destination_slot });
+		std::memcpy(destination + destination_slot, source + source_slot, chunk * sizeof(T));
+		first += chunk;
+		count -= chunk;
+	}
+}
+
+// Preallocated single-producer/single-consumer ring of trivially copyable items.
+template <typename T>
+class SpscRing
+{
+	static_assert(std::is_trivially_copyable<T>::value, "SpscRing stores trivially copyable items only");
+
+public:
+	static constexpr size_t kCacheLine = SpscRingIndex::kCacheLine;
+
+	SpscRing() = default;
+
+	explicit SpscRing(size_t capacity)
+	{
+		reset(capacity);
+	}
+
+	~SpscRing()
+	{
+		release();
+	}
+
+	SpscRing(const SpscRing&) = delete;
+	SpscRing& operator=(const SpscRing&) = delete;
+
+	// Reallocates the storage for at least capacity items and drops all items.
+	// Not thread-safe: the producer must be quiescent while this runs.
+	void reset(size_t capacity)
+	{
+		release();
+		capacity = SpscRingIndex::roundCapacity(capacity);
+		storage_ = static_cast<T*>(::operator new(capacity * sizeof(T), std::align_val_t(kCacheLine)));
+		index_.reset(capacity);
+	}
+
+	// Reallocates the storage for at least capacity items keeping the newest
+	// items that still fit (at their existing indices), and resets the limit to
+	// the new capacity. Costs O(kept items). Not thread-safe: the producer must
+	// be quiescent.
+	void resize(size_t capacity)
+	{
+		capacity = SpscRingIndex::roundCapacity(capacity);
+		if (capacity == index_.capacity())
+		{
+			return;
+		}
+
+		T* next = static_cast<T*>(::operator new(capacity * sizeof(T), std::align_val_t(kCacheLine)));
+		size_t available = 0;
+		uint64_t read = index_.beginRead(available);
+		const size_t kept = std::min(available, capacity);
+		read += available - kept;
+		if (storage_ != nullptr)
+		{
+			copyRingRange(storage_, index_.capacity(), next, capacity, read, kept);
+		}
+
+		release();
+		storage_ = next;
+		index_.reset(capacity, read, read + kept);
+	}
+
+	size_t capacity() const
+	{
+		return index_.capacity();
+	}
+
+	size_t size() const
+	{
+		return index_.size();
+	}
+
+	size_t limit() const
+	{
+		return index_.limit();
+	}
+
+	// Consumer: O(1) limit change; see SpscRingIndex::setLimit().
+	size_t setLimit(size_t limit)
+	{
+		return index_.setLimit(limit);
+	}
+
+	// Producer: appends count items, evicting the oldest ones if the ring
+	// exceeds its limit. Returns the number of evicted items.
+	size_t push(const T* items, size_t count)
+	{
+		const size_t limit = index_.limit();
+		if (storage_ == nullptr || count == 0)
+		{
+			return 0;
+		}
+
+		if (count > limit)
+		{
+			items += count - limit;
+			count = limit;
+		}
+
+		size_t evicted = 0;
+		const uint64_t write = index_.beginWrite(count, evicted);
+		copyIn(write, items, count);
+		index_.commitWrite(write, count);
+		return evicted;
+	}
+
+	// Consumer: copies up to max_items of the oldest items into destination and
+	// removes them from the ring.
+	size_t pop(T* destination, size_t max_items)
+	{
+		if (storage_ == nullptr || destination == nullptr || max_items == 0)
+		{
+			return 0;
+		}
+
+		for (;;)
+		{
+			size_t available = 0;
+			const uint64_t read = index_.beginRead(available);
+			const size_t count = std::min(max_items, available);
+			if (count == 0)
+			{
+				return 0;
+			}
+
+			copyOut(read, destination, count);
+			if (index_.commitRead(read, count))
+			{
+				return count;
+			}
+		}
+	}
+
+	// Consumer: in-place access for callers that process items before
+	// releasing them. Items read between beginRead() and a successful
+	// commitRead() are valid; a failed commit means they may be torn.
+	uint64_t beginRead(size_t& available) const
+	{
+		return index_.beginRead(available);
+	}
+
+	const T& at(uint64_t index) const
+	{
+		return storage_[index_.slot(index)];
+	}
+
+	bool commitRead(uint64_t read, size_t count)
+	{
+		return index_.commitRead(read, count);
+	}
+
+	// Consumer: drops everything currently buffered.
+	void clear()
+	{
+		index_.clear();
+	}
+
+private:
+	void copyIn(uint64_t index, const T* items, size_t count)
+	{
+		const size_t slot = index_.slot(index);
+		const size_t first = std::min(count, index_.capacity() - slot);
+		std::memcpy(storage_ + slot, items, first * sizeof(T));
+		std::memcpy(storage_, items + first, (count - first) * sizeof(T));
+	}
+
+	void copyOut(uint64_t index, T* destination, size_t count) const
+	{
+		const size_t slot = index_.slot(index);
+		const size_t first = std::min(count, index_.capacity() - slot);
+		std::memcpy(destination, storage_ + slot, first * sizeof(T));
+		std::memcpy(destination + first, storage_, (count - first) * sizeof(T));
+	}
+
+	void release()
+	{
+		if (storage_ != nullptr)
+		{
+			::operator delete(storage_, std::align_val_t(kCacheLine));
+			storage_ = nullptr;
+		}
+	}
+
+	T* storage_ = nullptr;
+	SpscRingIndex index_;
+};
@@ -0,0 +1,262 @@
+#include "SyntheticPacketSource.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstring>
+#include <sstream>
+
+namespace
+{
+	constexpr double kPi = 3.14159265358979323846;
+
+	// One pass of the scan pattern; long enough that consecutive frames differ.
+	constexpr size_t kPatternPoints = 1 << 16;
+
+	// Mid-360 field of view.
+	constexpr double kMinElevation = -7.0 * kPi / 180.0;
+	constexpr double kMaxElevation = 52.0 * kPi / 180.0;
+
+	// The sensor sits inside this box (metres), offset from its centre.
+	constexpr double kRoomMin[3] = { -5.0, -6.0, -1.5 };
+	constexpr double kRoomMax[3] = { 5.0, 4.0, 2.5 };
+
+	constexpr double kMetersToMilli = 1000.0;
+	constexpr int32_t kMilliPerLowUnit = 10;
+	constexpr uint64_t kNanosPerSecond = 1000000000ULL;
+	constexpr uint64_t kTenthMicrosPerSecond = 10000000ULL;
+
+	// Accelerometer reading of a level sensor at rest, in g.
+	constexpr float kGravityAccel[3] = { 0.0f, 0.0f, 1.0f };
+
+	// Paced delivery sleeps this long between bursts.
+	constexpr auto kPaceInterval = std::chrono::milliseconds(1);
+
+	double
+	distanceToRoom(const double direction[3])
+	{
+		double distance = 1e9;
+		for (int axis = 0; axis < 3; ++axis)
+		{
+			if (direction[axis] > 1e-9)
+			{
+				distance = std::min(distance, kRoomMax[axis] / direction[axis]);
+			}
+			else if (direction[axis] < -1e-9)
+			{
+				distance = std::min(distance, kRoomMin[axis] / direction[axis]);
+			}
+		}
+		return distance;
+	}
+}
+
+SyntheticPacketSource::SyntheticPacketSource(const Config& config)
+	: config_(config)
+	, pattern_(kPatternPoints)
+	, pattern_cursor_(0)
+	, packet_count_(0)
+	, packet_period_ns_(0)
+	, imu_count_(0)
+	, imu_period_ns_(0)
+	, data_type_(kLivoxLidarCartesianCoordinateHighData)
+	, running_(false)
+{
+	config_.points_per_second = std::max(config_.points_per_second, 1.0);
+	config_.points_per_packet = std::max<size_t>(config_.points_per_packet, 1);
+	packet_period_ns_ = static_cast<uint64_t>(static_cast<double>(config_.points_per_packet) * kNanosPerSecond / config_.points_per_second);
+	if (config_.imu_rate > 0.0)
+	{
+		imu_period_ns_ = std::max<uint64_t>(static_cast<uint64_t>(kNanosPerSecond / config_.imu_rate), 1);
+	}
+
+	// Azimuth turns quickly while elevation oscillates at an incommensurate
+	// rate, which gives the rosette-like coverage of the real sensor.
+	const double golden = (std::sqrt(5.0) - 1.0) / 2.0;
+	for (size_t i = 0; i < kPatternPoints; ++i)
+	{
+		const double azimuth = 2.0 * kPi * std::fmod(static_cast<double>(i) * golden * 7.0, 1.0);
+		const double phase = std::sin(2.0 * kPi * static_cast<double>(i) / 997.0);
+		const double elevation = kMinElevation + (kMaxElevation - kMinElevation) * (0.5 + 0.5 * phase);
+		const double direction[3] = { std::cos(elevation) * std::cos(azimuth), std::cos(elevation) * std::sin(azimuth), std::sin(elevation) };
+		const double distance = distanceToRoom(direction);
+
+		LivoxLidarCartesianHighRawPoint& point = pattern_[i];
+		point.x = static_cast<int32_t>(std::lround(direction[0] * distance * kMetersToMilli));
+		point.y = static_cast<int32_t>(std::lround(direction[1] * distance * kMetersToMilli));
+		point.z = static_cast<int32_t>(std::lround(direction[2] * distance * kMetersToMilli));
+		point.reflectivity = static_cast<uint8_t>(std::clamp(255.0 - distance * 20.0, 0.0, 255.0));
+		point.tag = 0;
+	}
+
+	packet_.resize(packetSize(kLivoxLidarCartesianCoordinateHighData, config_.points_per_packet));
+	imu_packet_.resize(offsetof(LivoxLidarEthernetPacket, data) + sizeof(LivoxLidarImuRawPoint));
+}
+
+SyntheticPacketSource::~SyntheticPacketSource()
+{
+	stop();
+}
+
+bool
+SyntheticPacketSource::start(PacketSink& sink)
+{
+	stop();
+	pattern_cursor_ = 0;
+	packet_count_ = 0;
+	imu_count_ = 0;
+	running_.store(true);
+	sink.onLidarInfo(kHandle, "SYNTHETIC", "127.0.0.1");
+	thread_ = std::thread(&SyntheticPacketSource::run, this, &sink);
+	return true;
+}
+
+void
+SyntheticPacketSource::stop()
+{
+	running_.store(false);
+	if (thread_.joinable())
+	{
+		thread_.join();
+	}
+}
+
+void
+SyntheticPacketSource::requestDataType(uint32_t, LivoxLidarPointDataType type)
+{
+	if (type == kLivoxLidarCartesianCoordinateHighData || type == kLivoxLidarCartesianCoordinateLowData)
+	{
+		data_type_.store(type);
+	}
+}
+
+std::string
+SyntheticPacketSource::description() const
+{
+	std::ostringstream oss;
+	oss << "Synthetic " << config_.points_per_second << " pts/s";
+	if (config_.rate_scale > 0.0)
+	{
+		oss << " at " << config_.rate_scale << "x";
+	}
+	else
+	{
+		oss << " unpaced";
+	}
+	return oss.str();
+}
+
+void
+SyntheticPacketSource::run(PacketSink* sink)
+{
+	using Clock = std::chrono::steady_clock;
+	const bool paced = config_.rate_scale > 0.0;
+	const double packets_per_second = config_.points_per_second / static_cast<double>(config_.points_per_packet) * config_.rate_scale;
+	const Clock::time_point start = Clock::now();
+	uint64_t sent = 0;
+
+	while (running_.load(std::memory_order_relaxed))
+	{
+		uint64_t due = sent + 1;
+		if (paced)
+		{
+			const double elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+			due = static_cast<uint64_t>(elapsed * packets_per_second);
+		}
+
+		for (; sent < due && running_.load(std::memory_order_relaxed); ++sent)
+		{
+			sink->onPacket(kHandle, buildPacket());
+
+			// Send the IMU samples that fall before the next packet starts.
+			const uint64_t next_packet_time = packet_count_ * packet_period_ns_;
+			while (imu_period_ns_ > 0 && imu_count_ * imu_period_ns_ < next_packet_time)
+			{
+				sink->onImuPacket(kHandle, buildImuPacket());
+			}
+		}
+
+		if (paced)
+		{
+			std::this_thread::sleep_for(kPaceInterval);
+		}
+	}
+}
+
+const LivoxLidarEthernetPacket*
+SyntheticPacketSource::buildPacket()
+{
+	const LivoxLidarPointDataType data_type = data_type_.load(std::memory_order_relaxed);
+	const size_t count = config_.points_per_packet;
+	auto* packet = reinterpret_cast<LivoxLidarEthernetPacket*>(packet_.data());
+
+	packet->version = 0;
+	packet->length = static_cast<uint16_t>(packetSize(data_type, count));
+	packet->time_interval = static_cast<uint16_t>(std::min<uint64_t>(packet_period_ns_ * kTenthMicrosPerSecond / kNanosPerSecond, UINT16_MAX));
+	packet->dot_num = static_cast<uint16_t>(count);
+	packet->udp_cnt = static_cast<uint16_t>(packet_count_);
+	packet->frame_cnt = 0;
+	packet->data_type = static_cast<uint8_t>(data_type);
+	packet->time_type = 0;
+	std::memset(packet->rsvd, 0, sizeof(packet->rsvd));
+	packet->crc32 = 0;
+	const uint64_t timestamp = packet_count_ * packet_period_ns_;
+	std::memcpy(packet->timestamp, &timestamp, sizeof(timestamp));
+
+	if (data_type == kLivoxLidarCartesianCoordinateHighData)
+	{
+		auto* points = reinterpret_cast<LivoxLidarCartesianHighRawPoint*>(packet->data);
+		for (size_t i = 0; i < count; ++i)
+		{
+			points[i] = pattern_[(pattern_cursor_ + i) % kPatternPoints];
+		}
+	}
+	else
+	{
+		auto* points = reinterpret_cast<LivoxLidarCartesianLowRawPoint*>(packet->data);
+		for (size_t i = 0; i < count; ++i)
+		{
+			const LivoxLidarCartesianHighRawPoint& source = pattern_[(pattern_cursor_ + i) % kPatternPoints];
+			points[i].x = static_cast<int16_t>(source.x / kMilliPerLowUnit);
+			points[i].y = static_cast<int16_t>(source.y / kMilliPerLowUnit);
+			points[i].z = static_cast<int16_t>(source.z / kMilliPerLowUnit);
+			points[i].reflectivity = source.reflectivity;
+			points[i].tag = source.tag;
+		}
+	}
+
+	pattern_cursor_ = (pattern_cursor_ + count) % kPatternPoints;
+	++packet_count_;
+	return packet;
+}
+
+const LivoxLidarEthernetPacket*
+SyntheticPacketSource::buildImuPacket()
+{
+	auto* packet = reinterpret_cast<LivoxLidarEthernetPacket*>(imu_packet_.data());
+	packet->version = 0;
+	packet->length = static_cast<uint16_t>(imu_packet_.size());
+	packet->time_interval = 0;
+	packet->dot_num = 1;
+	packet->udp_cnt = static_cast<uint16_t>(imu_count_);
+	packet->frame_cnt = 0;
+	packet->data_type = kLivoxLidarImuData;
+	packet->time_type = 0;
+	std::memset(packet->rsvd, 0, sizeof(packet->rsvd));
+	packet->crc32 = 0;
+	const uint64_t timestamp = imu_count_ * imu_period_ns_;
+	std::memcpy(packet->timestamp, &timestamp, sizeof(timestamp));
+
+	LivoxLidarImuRawPoint sample;
+	sample.gyro_x = 0.0f;
+	sample.gyro_y = 0.0f;
+	sample.gyro_z = 0.0f;
+	sample.acc_x = kGravityAccel[0];
+	sample.acc_y = kGravityAccel[1];
+	sample.acc_z = kGravityAccel[2];
+	std::memcpy(packet->data, &sample, sizeof(sample));
+
+	++imu_count_;
+	return packet;
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "PacketSource.h"
+
+// Generates Mid-360-shaped point packets on its own thread: a non-repeating
+// scan of a box-shaped room at a fixed nominal point rate, so buffering,
+// decode and output can be exercised without a sensor. IMU packets of a
+// sensor standing still are interleaved on the same timeline.
+class SyntheticPacketSource : public PacketSource
+{
+public:
+	struct Config
+	{
+		double points_per_second = 200000.0;
+		// Delivery speed relative to real time; 0 or less sends as fast as the
+		// sink accepts. Packet timestamps always follow the nominal rate.
+		double rate_scale = 1.0;
+		size_t points_per_packet = 96;
+		// IMU samples per second; 0 sends none.
+		double imu_rate = 200.0;
+	};
+
+	explicit SyntheticPacketSource(const Config& config);
+	~SyntheticPacketSource() override;
+
+	bool start(PacketSink& sink) override;
+	void stop() override;
+	void requestDataType(uint32_t handle, LivoxLidarPointDataType type) override;
+	std::string description() const override;
+
+	static constexpr uint32_t kHandle = 1;
+
+private:
+	void run(PacketSink* sink);
+	const LivoxLidarEthernetPacket* buildPacket();
+	const LivoxLidarEthernetPacket* buildImuPacket();
+
+	Config config_;
+	std::vector<LivoxLidarCartesianHighRawPoint> pattern_;
+	std::vector<uint8_t> packet_;
+	size_t pattern_cursor_;
+	uint64_t packet_count_;
+	uint64_t packet_period_ns_;
+	std::vector<uint8_t> imu_packet_;
+	uint64_t imu_count_;
+	uint64_t imu_period_ns_;
+
+	std::atomic<LivoxLidarPointDataType> data_type_;
+	std::atomic<bool> running_;
+	std::thread thread_;
+};
@@ -0,0 +1,237 @@
+#include "VoxelGrid.h"
+#include "PointDecoder.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <vector>
+
+#if defined(_M_X64) || defined(__x86_64__)
+	#define LIVOX_HAS_X86_SIMD 1
+	#include <immintrin.h>
+	#if defined(_MSC_VER)
+		#define LIVOX_TARGET_AVX2
+	#else
+		#define LIVOX_TARGET_AVX2 __attribute__((target("avx2")))
+	#endif
+#endif
+
+namespace
+{
+	// Voxel coordinates are packed 21 bits per axis into the key; at a 1 cm
+	// leaf that spans +-10 km, and anything further is clamped to the edge.
+	constexpr int kCellBits = 21;
+	constexpr float kCellBias = static_cast<float>(1 << (kCellBits - 1));
+
+	constexpr size_t kMinSlots = 1024;
+
+	// Fibonacci hashing: the top bits of key * 2^64 / phi index the table.
+	constexpr uint64_t kHashMultiplier = 0x9E3779B97F4A7C15ull;
+
+	// Cell index of one coordinate, biased to be non-negative. The value is
+	// clamped before rounding, so truncating and stepping down below it gives
+	// floor() without a libm call, and the same cell as the vector kernel.
+	uint64_t
+	cellOf(float value, float inverse_leaf)
+	{
+		const float clamped = std::min(std::max(value * inverse_leaf, -kCellBias), kCellBias - 1.0f);
+		int32_t cell = static_cast<int32_t>(clamped);
+		cell -= static_cast<float>(cell) > clamped ? 1 : 0;
+		return static_cast<uint64_t>(static_cast<uint32_t>(cell + static_cast<int32_t>(kCellBias)));
+	}
+
+	void
+	keysScalar(const PointColumns& points, size_t begin, size_t count, float inverse_leaf, uint64_t* keys)
+	{
+		for (size_t i = begin; i < count; ++i)
+		{
+			keys[i] = (cellOf(points.x[i], inverse_leaf) << (2 * kCellBits)) | (cellOf(points.y[i], inverse_leaf) << kCellBits) | cellOf(points.z[i], inverse_leaf);
+		}
+	}
+
+#if defined(LIVOX_HAS_X86_SIMD)
+	constexpr size_t kLanes = 8;
+
+	LIVOX_TARGET_AVX2
+	__m256i
+	cellsAvx2(const float* values, __m256 inverse_leaf)
+	{
+		const __m256 low = _mm256_set1_ps(-kCellBias);
+		const __m256 high = _mm256_set1_ps(kCellBias - 1.0f);
+		const __m256 clamped = _mm256_min_ps(_mm256_max_ps(_mm256_mul_ps(_mm256_loadu_ps(values), inverse_leaf), low), high);
+		const __m256i cells = _mm256_cvttps_epi32(_mm256_floor_ps(clamped));
+		return _mm256_add_epi32(cells, _mm256_set1_epi32(static_cast<int32_t>(kCellBias)));
+	}
+
+	// Packs the three cell indices of 4 points, widened to 64 bits.
+	LIVOX_TARGET_AVX2
+	__m256i
+	packAvx2(__m128i x, __m128i y, __m128i z)
+	{
+		const __m256i wide_x = _mm256_slli_epi64(_mm256_cvtepu32_epi64(x), 2 * kCellBits);
+		const __m256i wide_y = _mm256_slli_epi64(_mm256_cvtepu32_epi64(y), kCellBits);
+		return _mm256_or_si256(_mm256_or_si256(wide_x, wide_y), _mm256_cvtepu32_epi64(z));
+	}
+
+	LIVOX_TARGET_AVX2
+	size_t
+	keysAvx2(const PointColumns& points, size_t count, float inverse_leaf, uint64_t* keys)
+	{
+		const __m256 inverse = _mm256_set1_ps(inverse_leaf);
+		size_t i = 0;
+		for (; i + kLanes <= count; i += kLanes)
+		{
+			const __m256i x = cellsAvx2(points.x + i, inverse);
+			const __m256i y = cellsAvx2(points.y + i, inverse);
+			const __m256i z = cellsAvx2(points.z + i, inverse);
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(keys + i), packAvx2(_mm256_castsi256_si128(x), _mm256_castsi256_si128(y), _mm256_castsi256_si128(z)));
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(keys + i + 4), packAvx2(_mm256_extracti128_si256(x, 1), _mm256_extracti128_si256(y, 1), _mm256_extracti128_si256(z, 1)));
+		}
+		return i;
+	}
+#endif
+}
+
+VoxelGrid::VoxelGrid()
+	: leaf_size_(0.0f)
+	, inverse_leaf_(0.0f)
+	, shift_(64)
+	, generation_(0)
+	, removed_points_(0)
+{
+}
+
+void
+VoxelGrid::setLeafSize(float meters)
+{
+	leaf_size_ = meters > 0.0f ? meters : 0.0f;
+	inverse_leaf_ = leaf_size_ > 0.0f ? 1.0f / leaf_size_ : 0.0f;
+}
+
+float
+VoxelGrid::leafSize() const
+{
+	return leaf_size_;
+}
+
+size_t
+VoxelGrid::filter(const PointColumns& points, size_t count)
+{
+	if (leaf_size_ <= 0.0f || count == 0)
+	{
+		return count;
+	}
+	reserve(count);
+
+	if (++generation_ == 0)
+	{
+		for (Slot& slot : slots_)
+		{
+			slot.generation = 0;
+		}
+		generation_ = 1;
+	}
+
+	// Keys go first, 8 points at a time where AVX2 is available; the probing
+	// below is inherently one point at a time.
+	size_t keyed = 0;
+#if defined(LIVOX_HAS_X86_SIMD)
+	if (PointDecoder::activeKernel() == PointDecoder::Kernel::Avx2)
+	{
+		keyed = keysAvx2(points, count, inverse_leaf_, keys_.data());
+	}
+#endif
+	keysScalar(points, keyed, count, inverse_leaf_, keys_.data());
+#if !defined(NDEBUG)
+	// Debug builds recompute every key with the scalar kernel.
+	thread_local std::vector<uint64_t> expected;
+	expected.resize(count);
+	keysScalar(points, 0, count, inverse_leaf_, expected.data());
+	assert(std::memcmp(expected.data(), keys_.data(), count * sizeof(uint64_t)) == 0);
+#endif
+
+	const size_t mask = slots_.size() - 1;
+	size_t voxels = 0;
+	for (size_t i = 0; i < count; ++i)
+	{
+		const uint64_t key = keys_[i];
+		for (size_t index = static_cast<size_t>((key * kHashMultiplier) >> shift_);; index = (index + 1) & mask)
+		{
+			Slot& slot = slots_[index];
+			if (slot.generation != generation_)
+			{
+				slot.key = key;
+				slot.voxel = static_cast<uint32_t>(voxels);
+				slot.generation = generation_;
+				voxels_[voxels++] = { 0.0f, 0.0f, 0.0f, points.intensity[i], 1, static_cast<uint32_t>(i) };
+				break;
+			}
+			if (slot.key == key)
+			{
+				Voxel& voxel = voxels_[slot.voxel];
+				voxel.dx += points.x[i] - points.x[voxel.first];
+				voxel.dy += points.y[i] - points.y[voxel.first];
+				voxel.dz += points.z[i] - points.z[voxel.first];
+				voxel.intensity += points.intensity[i];
+				++voxel.count;
+				break;
+			}
+		}
+	}
+
+	// A voxel's first point is never ahead of its output slot, and later
+	// voxels only read points past it, so the compaction can run in place.
+	for (size_t v = 0; v < voxels; ++v)
+	{
+		const Voxel& voxel = voxels_[v];
+		const size_t first = voxel.first;
+		const float scale = 1.0f / static_cast<float>(voxel.count);
+		points.x[v] = points.x[first] + voxel.dx * scale;
+		points.y[v] = points.y[first] + voxel.dy * scale;
+		points.z[v] = points.z[first] + voxel.dz * scale;
+		points.intensity[v] = voxel.intensity * scale;
+		points.tag[v] = points.tag[first];
+		if (points.timestamp != nullptr)
+		{
+			points.timestamp[v] = points.timestamp[first];
+		}
+		if (points.received != nullptr)
+		{
+			points.received[v] = points.received[first];
+		}
+	}
+
+	removed_points_.fetch_add(count - voxels, std::memory_order_relaxed);
+	return voxels;
+}
+
+uint64_t
+VoxelGrid::removedPoints() const
+{
+	return removed_points_.load(std::memory_order_relaxed);
+}
+
+void
+VoxelGrid::reserve(size_t count)
+{
+	if (voxels_.size() < count)
+	{
+		voxels_.resize(count);
+		keys_.resize(count);
+	}
+
+	// At most half full, so probe runs stay short.
+	size_t slots = kMinSlots;
+	int bits = 10;
+	while (slots < 2 * count)
+	{
+		slots *= 2;
+		++bits;
+	}
+	if (slots > slots_.size())
+	{
+		slots_.assign(slots, Slot());
+		shift_ = 64 - bits;
+		generation_ = 0;
+	}
+}
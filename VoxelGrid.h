@@ -0,0 +1,71 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "PointRing.h"
+
+// Voxel-grid downsampling. Every occupied cube of side leafSize() is replaced
+// by the centroid of its points, carrying their mean intensity and the tag and
+// times of the first point that fell into it.
+//
+// Voxels are found through an open-addressing hash table with linear probing
+// that is kept from call to call. It only grows, to twice the largest input
+// seen, and a generation stamp per slot empties it in O(1), so steady-state
+// filtering allocates nothing. Voxel keys are computed up front, 8 points at
+// a time with AVX2; both kernels give the same keys.
+//
+// Everything but the counter belongs to the thread that filters.
+class VoxelGrid
+{
+public:
+	VoxelGrid();
+
+	// Side of a voxel in meters; 0 turns filtering off.
+	void setLeafSize(float meters);
+	float leafSize() const;
+
+	// Reduces the count points in place to one per occupied voxel and returns
+	// how many are left. Voxels are ordered by their first point, so
+	// time-ordered input stays time-ordered. x/y/z/intensity/tag must be set;
+	// the timestamp and received columns are carried along when not null.
+	size_t filter(const PointColumns& points, size_t count);
+
+	// Points merged away by filter() so far.
+	uint64_t removedPoints() const;
+
+private:
+	struct Slot
+	{
+		uint64_t key = 0;
+		uint32_t voxel = 0;
+		uint32_t generation = 0;
+	};
+
+	// Sums are kept relative to the voxel's first point, which keeps float
+	// precision at long range.
+	struct Voxel
+	{
+		float dx;
+		float dy;
+		float dz;
+		float intensity;
+		uint32_t count;
+		uint32_t first;
+	};
+
+	void reserve(size_t count);
+
+	float leaf_size_;
+	float inverse_leaf_;
+
+	std::vector<Slot> slots_;
+	int shift_;
+	uint32_t generation_;
+	std::vector<Voxel> voxels_;
+	std::vector<uint64_t> keys_;
+
+	std::atomic<uint64_t> removed_points_;
+};
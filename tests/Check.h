@@ -0,0 +1,36 @@
+#pragma once
+
+#include <cstdio>
+#include <cstdlib>
+
+// Minimal checks for the headless tests. A failed CHECK prints where it
+// failed and the test carries on, so one run reports every failure;
+// checkResult() is the test's exit code.
+inline int&
+checkFailures()
+{
+	static int failures = 0;
+	return failures;
+}
+
+inline int
+checkResult()
+{
+	if (checkFailures() == 0)
+	{
+		std::printf("All checks passed\n");
+		return EXIT_SUCCESS;
+	}
+	std::printf("%d checks failed\n", checkFailures());
+	return EXIT_FAILURE;
+}
+
+#define CHECK(condition) \
+	do \
+	{ \
+		if (!(condition)) \
+		{ \
+			std::printf("%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #condition); \
+			++checkFailures(); \
+		} \
+	} while (false)
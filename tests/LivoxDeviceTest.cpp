@@ -0,0 +1,199 @@
+// LivoxDevice fed by hand through a packet source that hands its sink to the
+// test: the spatial filter's survivors must come out of either storage with
+// the exact times of their packet positions, and fill the Buffer Limit even
+// though each packet leaves only a few of them.
+
+#include "Check.h"
+#include "TestPackets.h"
+
+#include "LivoxDevice.h"
+
+#include <cstring>
+#include <memory>
+#include <random>
+#include <vector>
+
+namespace
+{
+	constexpr LivoxLidarPointDataType kHigh = kLivoxLidarCartesianCoordinateHighData;
+	constexpr uint32_t kHandle = 7;
+	constexpr size_t kDots = 96;
+	// One point in kKeepEvery lies inside the crop box.
+	constexpr size_t kKeepEvery = 20;
+	constexpr size_t kKeepPhase = 3;
+	constexpr uint64_t kFirstTimestamp = 1000000000ull;
+	constexpr uint64_t kPacketNs = 500000;
+
+	// Delivers nothing by itself; the test calls the sink directly.
+	class ManualSource : public PacketSource
+	{
+	public:
+		explicit ManualSource(PacketSink*& sink)
+			: sink_(sink)
+		{
+		}
+
+		bool start(PacketSink& sink) override
+		{
+			sink_ = &sink;
+			return true;
+		}
+
+		void stop() override
+		{
+		}
+
+		void requestDataType(uint32_t, LivoxLidarPointDataType) override
+		{
+		}
+
+		std::string description() const override
+		{
+			return "manual";
+		}
+
+	private:
+		PacketSink*& sink_;
+	};
+
+	bool
+	kept(size_t dot)
+	{
+		return dot % kKeepEvery == kKeepPhase;
+	}
+
+	// A High packet whose kept() points lie 1 m out on x and the rest 100 m.
+	std::vector<uint8_t>
+	filteredPacket(uint64_t timestamp, std::mt19937& rng)
+	{
+		std::vector<uint8_t> bytes = makePacket(kHigh, kDots, timestamp, rng);
+		auto* packet = reinterpret_cast<LivoxLidarEthernetPacket*>(bytes.data());
+		for (size_t i = 0; i < kDots; ++i)
+		{
+			LivoxLidarCartesianHighRawPoint point = {};
+			point.x = kept(i) ? 1000 : 100000;
+			std::memcpy(packet->data + i * sizeof(point), &point, sizeof(point));
+		}
+		return bytes;
+	}
+
+	uint64_t
+	dotTime(uint64_t timestamp, size_t dot)
+	{
+		return timestamp + dot * kPacketNs / kDots;
+	}
+
+	void
+	deliver(PacketSink& sink, uint64_t timestamp, std::mt19937& rng)
+	{
+		const std::vector<uint8_t> packet = filteredPacket(timestamp, rng);
+		sink.onPacket(kHandle, reinterpret_cast<const LivoxLidarEthernetPacket*>(packet.data()));
+	}
+
+	SpatialFilter::Settings
+	cropSettings()
+	{
+		SpatialFilter::Settings settings;
+		settings.crop = true;
+		return settings;
+	}
+
+	void
+	testSurvivorTimes(LivoxDevice::BufferStorage storage)
+	{
+		constexpr size_t kPackets = 30;
+		std::mt19937 rng(11);
+		LivoxDevice device;
+		device.setBufferStorage(storage);
+		device.setSpatialFilter(cropSettings());
+		PacketSink* sink = nullptr;
+		CHECK(device.start(std::make_unique<ManualSource>(sink)));
+		CHECK(sink != nullptr);
+		if (sink == nullptr)
+		{
+			return;
+		}
+
+		std::vector<uint64_t> expected;
+		for (size_t k = 0; k < kPackets; ++k)
+		{
+			const uint64_t timestamp = kFirstTimestamp + k * kPacketNs;
+			deliver(*sink, timestamp, rng);
+			for (size_t i = 0; i < kDots; ++i)
+			{
+				if (kept(i))
+				{
+					expected.push_back(dotTime(timestamp, i));
+				}
+			}
+		}
+
+		PointBlock block;
+		block.resize(expected.size() + 1);
+		const PointColumns output = block.columns();
+		CHECK(device.consume(output, block.size()) == expected.size());
+		for (size_t i = 0; i < expected.size(); ++i)
+		{
+			CHECK(output.timestamp[i] == expected[i]);
+			CHECK(output.x[i] == 1.0f);
+		}
+		device.stop();
+	}
+
+	// About 5% of each packet survives; the buffer must still fill to the
+	// limit, exactly for decoded points and within one slot for raw packets,
+	// with every other survivor counted as evicted.
+	void
+	testBufferLimit(LivoxDevice::BufferStorage storage)
+	{
+		constexpr size_t kLimit = 20000;
+		constexpr size_t kKeptPerPacket = (kDots + kKeepEvery - 1 - kKeepPhase) / kKeepEvery;
+		const size_t tolerance = storage == LivoxDevice::BufferStorage::RawPackets ? PacketSlab::kPointsPerSlot : 0;
+		std::mt19937 rng(12);
+		LivoxDevice device;
+		device.setBufferStorage(storage);
+		device.setBufferLimit(kLimit);
+		device.setSpatialFilter(cropSettings());
+		PacketSink* sink = nullptr;
+		CHECK(device.start(std::make_unique<ManualSource>(sink)));
+		if (sink == nullptr)
+		{
+			return;
+		}
+
+		// Fill past the limit, drain part of it and fill again, so the merged
+		// stamps and slots are also extended after a consume.
+		size_t packets = 0;
+		const auto fill = [&](size_t count) {
+			for (size_t k = 0; k < count; ++k, ++packets)
+			{
+				deliver(*sink, kFirstTimestamp + packets * kPacketNs, rng);
+			}
+		};
+		PointBlock block;
+		block.resize(kLimit);
+		fill(2 * kLimit / kKeptPerPacket);
+		CHECK(device.bufferedSamples() + tolerance >= kLimit);
+		CHECK(device.bufferedSamples() <= kLimit + tolerance);
+		CHECK(device.evictedPoints() + device.bufferedSamples() == packets * kKeptPerPacket);
+
+		const size_t consumed = device.consume(block.columns(), kLimit / 2);
+		CHECK(consumed == kLimit / 2);
+		fill(kLimit / kKeptPerPacket);
+		CHECK(device.bufferedSamples() + tolerance >= kLimit);
+		CHECK(device.bufferedSamples() <= kLimit + tolerance);
+		CHECK(consumed + device.evictedPoints() + device.bufferedSamples() == packets * kKeptPerPacket);
+		device.stop();
+	}
+}
+
+int
+main()
+{
+	for (LivoxDevice::BufferStorage storage : { LivoxDevice::BufferStorage::Decoded, LivoxDevice::BufferStorage::RawPackets })
+	{
+		testSurvivorTimes(storage);
+		testBufferLimit(storage);
+	}
+	return checkResult();
+}
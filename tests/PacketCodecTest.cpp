@@ -0,0 +1,101 @@
+// PacketCodec round trips: every packet must come back byte for byte,
+// scan-like packets must shrink, and malformed input must be rejected.
+
+#include "Check.h"
+#include "TestPackets.h"
+
+#include "PacketCodec.h"
+
+#include <array>
+#include <cstring>
+#include <random>
+#include <vector>
+
+namespace
+{
+	constexpr std::array<size_t, 8> kCounts = { 0, 1, 31, 32, 33, 95, 96, 200 };
+
+	// Encodes and decodes packet; returns the encoded size, 0 on a mismatch.
+	size_t
+	roundTrip(const std::vector<uint8_t>& packet)
+	{
+		std::vector<uint8_t> encoded(PacketCodec::maxEncodedSize(packet.size()));
+		const size_t encoded_size = PacketCodec::encode(reinterpret_cast<const LivoxLidarEthernetPacket*>(packet.data()), packet.size(), encoded.data());
+		CHECK(encoded_size > 0 && encoded_size <= encoded.size());
+
+		std::vector<uint8_t> decoded(packet.size());
+		const size_t decoded_size = PacketCodec::decode(encoded.data(), encoded_size, decoded.data(), decoded.size());
+		CHECK(decoded_size == packet.size());
+		const bool same = decoded_size == packet.size() && std::memcmp(decoded.data(), packet.data(), packet.size()) == 0;
+		CHECK(same);
+		return same ? encoded_size : 0;
+	}
+
+	void
+	testRoundTrips()
+	{
+		std::mt19937 rng(1);
+		for (LivoxLidarPointDataType data_type : { kLivoxLidarCartesianCoordinateHighData, kLivoxLidarCartesianCoordinateLowData })
+		{
+			for (size_t count : kCounts)
+			{
+				for (bool smooth : { false, true })
+				{
+					const std::vector<uint8_t> packet = makePacket(data_type, count, 1000 * count, rng, smooth);
+					const size_t encoded = roundTrip(packet);
+					// Incompressible packets are stored with a one-byte marker.
+					CHECK(encoded <= packet.size() + 1);
+					if (smooth && count >= 32)
+					{
+						CHECK(encoded < packet.size());
+					}
+				}
+			}
+		}
+	}
+
+	void
+	testStoredPackets()
+	{
+		std::mt19937 rng(2);
+
+		// Non-Cartesian data is kept verbatim.
+		std::vector<uint8_t> imu = makePacket(kLivoxLidarCartesianCoordinateHighData, 2, 0, rng);
+		reinterpret_cast<LivoxLidarEthernetPacket*>(imu.data())->data_type = kLivoxLidarImuData;
+		CHECK(roundTrip(imu) == imu.size() + 1);
+
+		// So is a packet whose size disagrees with its dot_num.
+		std::vector<uint8_t> padded = makePacket(kLivoxLidarCartesianCoordinateHighData, 96, 0, rng, true);
+		padded.push_back(0xAB);
+		CHECK(roundTrip(padded) == padded.size() + 1);
+	}
+
+	void
+	testMalformedInput()
+	{
+		std::mt19937 rng(3);
+		const std::vector<uint8_t> packet = makePacket(kLivoxLidarCartesianCoordinateLowData, 96, 0, rng, true);
+		std::vector<uint8_t> encoded(PacketCodec::maxEncodedSize(packet.size()) + 1);
+		const size_t size = PacketCodec::encode(reinterpret_cast<const LivoxLidarEthernetPacket*>(packet.data()), packet.size(), encoded.data());
+		CHECK(size < packet.size());
+
+		std::vector<uint8_t> decoded(packet.size());
+		CHECK(PacketCodec::decode(encoded.data(), 0, decoded.data(), decoded.size()) == 0);
+		CHECK(PacketCodec::decode(encoded.data(), size - 1, decoded.data(), decoded.size()) == 0);
+		CHECK(PacketCodec::decode(encoded.data(), size + 1, decoded.data(), decoded.size()) == 0);
+		CHECK(PacketCodec::decode(encoded.data(), size, decoded.data(), decoded.size() - 1) == 0);
+
+		std::vector<uint8_t> unknown(encoded.begin(), encoded.begin() + size);
+		unknown[0] = 0xFF;
+		CHECK(PacketCodec::decode(unknown.data(), unknown.size(), decoded.data(), decoded.size()) == 0);
+	}
+}
+
+int
+main()
+{
+	testRoundTrips();
+	testStoredPackets();
+	testMalformedInput();
+	return checkResult();
+}
@@ -0,0 +1,278 @@
+// PacketSlab against a per-packet reference decode: whole, split and short
+// packets of either format in either slot layout must come back point for
+// point through consume, trim, a relayout and decimation, and a timed slab
+// must keep the per-record times it was given.
+
+#include "Check.h"
+
+#include "PacketSlab.h"
+#include "PointDecoder.h"
+
+#include <random>
+#include <vector>
+
+namespace
+{
+	constexpr LivoxLidarPointDataType kHigh = kLivoxLidarCartesianCoordinateHighData;
+	constexpr LivoxLidarPointDataType kLow = kLivoxLidarCartesianCoordinateLowData;
+	constexpr size_t kPackets = 20;
+	constexpr size_t kCapacity = 100000;
+	constexpr size_t kConsumeStep = 77;
+
+	size_t
+	recordSize(LivoxLidarPointDataType type)
+	{
+		return type == kHigh ? sizeof(LivoxLidarCartesianHighRawPoint) : sizeof(LivoxLidarCartesianLowRawPoint);
+	}
+
+	enum class Mode
+	{
+		Consume,
+		Trim,
+		Relayout,
+		Decimate
+	};
+
+	struct Output
+	{
+		explicit Output(size_t count)
+		{
+			block.resize(count);
+			columns = block.columns();
+		}
+
+		PointBlock block;
+		PointColumns columns;
+	};
+
+	// The pushed packets, decoded one point at a time.
+	struct Reference
+	{
+		bool point(uint64_t index, float& x, uint64_t& timestamp) const
+		{
+			for (size_t k = 0; k < records.size(); ++k)
+			{
+				if (index < first[k] || index >= first[k] + stamps[k].dot_num)
+				{
+					continue;
+				}
+				const size_t dot = static_cast<size_t>(index - first[k]);
+				Output output(1);
+				if (types[k] == kHigh)
+				{
+					PointDecoder::decodeHighScalar(reinterpret_cast<const LivoxLidarCartesianHighRawPoint*>(records[k].data()) + dot, 1, output.columns);
+				}
+				else
+				{
+					PointDecoder::decodeLowScalar(reinterpret_cast<const LivoxLidarCartesianLowRawPoint*>(records[k].data()) + dot, 1, output.columns);
+				}
+				x = output.columns.x[0];
+				timestamp = stamps[k].pointTime(dot);
+				return true;
+			}
+			return false;
+		}
+
+		std::vector<std::vector<uint8_t>> records;
+		std::vector<PacketStamp> stamps;
+		std::vector<LivoxLidarPointDataType> types;
+		std::vector<uint64_t> first;
+	};
+
+	bool
+	matches(const Reference& reference, uint64_t index, const PointColumns& output, size_t position)
+	{
+		float x = 0.0f;
+		uint64_t timestamp = 0;
+		return reference.point(index, x, timestamp) && output.x[position] == x && output.timestamp[position] == timestamp;
+	}
+
+	void
+	testMode(LivoxLidarPointDataType layout, LivoxLidarPointDataType type, Mode mode, std::mt19937& rng)
+	{
+		const size_t point_size = recordSize(type);
+		PacketSlab slab(kCapacity, layout);
+		CHECK(slab.slotBytes() == (layout == kHigh ? 1384u : 808u));
+
+		// Oversized packets split across slots, full ones and short ones.
+		Reference reference;
+		uint64_t pushed = 0;
+		for (size_t k = 0; k < kPackets; ++k)
+		{
+			const size_t count = k % 3 == 0 ? 200 : (k % 3 == 1 ? 96 : 1 + rng() % 95);
+			std::vector<uint8_t> records(count * point_size);
+			for (uint8_t& byte : records)
+			{
+				byte = static_cast<uint8_t>(rng());
+			}
+			PacketStamp stamp;
+			stamp.timestamp = 1000000ull * k;
+			stamp.time_interval = 6000;
+			stamp.dot_num = static_cast<uint16_t>(count);
+			stamp.received = k;
+			slab.push(records.data(), count, type, stamp);
+			reference.records.push_back(records);
+			reference.stamps.push_back(stamp);
+			reference.types.push_back(type);
+			reference.first.push_back(pushed);
+			pushed += count;
+		}
+		CHECK(slab.size() == pushed);
+
+		Output output(static_cast<size_t>(pushed));
+		uint64_t base = 0;
+		if (mode == Mode::Trim)
+		{
+			CHECK(slab.trim(250) == pushed - 250);
+			CHECK(slab.size() == 250);
+			base = pushed - 250;
+		}
+		else if (mode == Mode::Relayout)
+		{
+			// Leaves the read position inside a packet.
+			CHECK(slab.consume(output.columns, 137) == 137);
+			slab.setDataType(layout == kHigh ? kLow : kHigh);
+			CHECK(slab.size() == pushed - 137);
+			base = 137;
+		}
+		else if (mode == Mode::Decimate)
+		{
+			constexpr size_t kKept = 100;
+			size_t skipped = 0;
+			CHECK(slab.consumeDecimated(output.columns, kKept, skipped) == kKept);
+			CHECK(skipped == pushed - kKept);
+			CHECK(slab.size() == 0);
+			for (size_t i = 0; i < kKept; ++i)
+			{
+				CHECK(matches(reference, i * pushed / kKept, output.columns, i));
+			}
+			return;
+		}
+
+		size_t total = 0;
+		for (size_t got; (got = slab.consume(output.columns.offset(total), kConsumeStep)) > 0;)
+		{
+			total += got;
+		}
+		CHECK(total == pushed - base);
+		for (size_t i = 0; i < total; ++i)
+		{
+			CHECK(matches(reference, base + i, output.columns, i));
+		}
+	}
+
+	// A limit counts the points of split packets exactly, and every point
+	// pushed is either still buffered, consumed or reported evicted once.
+	void
+	testLimit(LivoxLidarPointDataType layout, LivoxLidarPointDataType type, std::mt19937& rng)
+	{
+		const size_t point_size = recordSize(type);
+		std::vector<uint8_t> records(200 * point_size);
+		for (uint8_t& byte : records)
+		{
+			byte = static_cast<uint8_t>(rng());
+		}
+		PacketStamp stamp;
+		stamp.dot_num = 200;
+		stamp.time_interval = 100;
+
+		PacketSlab slab(96 * 4, layout);
+		size_t evicted = 0;
+		for (int k = 0; k < 10; ++k)
+		{
+			evicted += slab.push(records.data(), 200, type, stamp);
+		}
+		CHECK(slab.size() > 0 && slab.size() <= 2000);
+		CHECK(evicted + slab.size() == 2000);
+
+		// Leave the read position inside a slot that the next pushes evict.
+		Output output(200);
+		const size_t consumed = slab.consume(output.columns, 50);
+		for (int k = 0; k < 3; ++k)
+		{
+			evicted += slab.push(records.data(), 200, type, stamp);
+		}
+		CHECK(consumed + evicted + slab.size() == 2600);
+		slab.trim(10);
+		CHECK(slab.size() == 10);
+	}
+
+	// A timed slab returns the times it was given, not the packet timing,
+	// through consume, a relayout and decimation.
+	void
+	testTimed(LivoxLidarPointDataType layout, LivoxLidarPointDataType type, std::mt19937& rng)
+	{
+		const size_t point_size = recordSize(type);
+		constexpr size_t kCount = 150;
+		std::vector<uint8_t> records(kCount * point_size);
+		for (uint8_t& byte : records)
+		{
+			byte = static_cast<uint8_t>(rng());
+		}
+		std::vector<uint64_t> times(kCount);
+		uint64_t time = 5000000000ull;
+		for (uint64_t& value : times)
+		{
+			time += 1 + rng() % 20000;
+			value = time;
+		}
+		PacketStamp stamp;
+		stamp.timestamp = 1;
+		stamp.time_interval = 100;
+		stamp.dot_num = 1;
+
+		PacketSlab slab(kCapacity, layout);
+		slab.setTimed(true);
+		CHECK(slab.timed());
+		CHECK(slab.slotBytes() == (layout == kHigh ? 1768u : 1192u));
+		slab.push(records.data(), kCount, type, stamp, times.data());
+
+		Output output(kCount);
+		CHECK(slab.consume(output.columns, 40) == 40);
+		slab.setDataType(layout == kHigh ? kLow : kHigh);
+		size_t total = 40;
+		for (size_t got; (got = slab.consume(output.columns.offset(total), kConsumeStep)) > 0;)
+		{
+			total += got;
+		}
+		CHECK(total == kCount);
+		for (size_t i = 0; i < total; ++i)
+		{
+			CHECK(output.columns.timestamp[i] == times[i]);
+		}
+
+		slab.push(records.data(), kCount, type, stamp, times.data());
+		size_t skipped = 0;
+		CHECK(slab.consumeDecimated(output.columns, 10, skipped) == 10);
+		for (size_t i = 0; i < 10; ++i)
+		{
+			CHECK(output.columns.timestamp[i] == times[i * kCount / 10]);
+		}
+
+		// Switching the layout drops the buffered points; the slots are still
+		// those of the other data type.
+		slab.push(records.data(), kCount, type, stamp, times.data());
+		slab.setTimed(false);
+		CHECK(slab.size() == 0);
+		CHECK(slab.slotBytes() == (layout == kHigh ? 808u : 1384u));
+	}
+}
+
+int
+main()
+{
+	std::mt19937 rng(5);
+	for (LivoxLidarPointDataType layout : { kHigh, kLow })
+	{
+		for (LivoxLidarPointDataType type : { kHigh, kLow })
+		{
+			for (Mode mode : { Mode::Consume, Mode::Trim, Mode::Relayout, Mode::Decimate })
+			{
+				testMode(layout, type, mode, rng);
+			}
+			testLimit(layout, type, rng);
+			testTimed(layout, type, rng);
+		}
+	}
+	return checkResult();
+}
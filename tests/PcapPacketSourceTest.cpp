@@ -0,0 +1,370 @@
+// PcapPacketSource on hand-made captures: the Livox packets in pcap and
+// pcapng files must be delivered byte for byte under handles derived from the
+// sender's address, whatever the framing and byte order, and every other
+// frame must be skipped.
+
+#include "Check.h"
+#include "TestPackets.h"
+
+#include "PcapPacketSource.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace
+{
+	constexpr uint16_t kPointPort = 56301;
+	constexpr uint32_t kLinkEthernet = 1;
+	constexpr uint32_t kLinkLinuxSll = 113;
+	constexpr uint32_t kLinkIpv4 = 228;
+	constexpr auto kTimeout = std::chrono::seconds(5);
+
+	struct Sender
+	{
+		uint8_t address[4];
+		const char* ip;
+		uint32_t handle;
+	};
+
+	// The handle is the IPv4 address read as a little-endian word, as the
+	// Livox SDK derives it.
+	const Sender kFirst = { { 192, 168, 1, 10 }, "192.168.1.10", 0x0A01A8C0 };
+	const Sender kSecond = { { 192, 168, 1, 11 }, "192.168.1.11", 0x0B01A8C0 };
+
+	class Bytes
+	{
+	public:
+		void u8(uint8_t value)
+		{
+			data.push_back(value);
+		}
+
+		void u16(uint16_t value, bool big_endian)
+		{
+			for (int i = 0; i < 2; ++i)
+			{
+				u8(static_cast<uint8_t>(value >> (big_endian ? 8 * (1 - i) : 8 * i)));
+			}
+		}
+
+		void u32(uint32_t value, bool big_endian)
+		{
+			for (int i = 0; i < 4; ++i)
+			{
+				u8(static_cast<uint8_t>(value >> (big_endian ? 8 * (3 - i) : 8 * i)));
+			}
+		}
+
+		void append(const std::vector<uint8_t>& bytes)
+		{
+			data.insert(data.end(), bytes.begin(), bytes.end());
+		}
+
+		void pad4()
+		{
+			while (data.size() % 4 != 0)
+			{
+				u8(0);
+			}
+		}
+
+		std::vector<uint8_t> data;
+	};
+
+	std::vector<uint8_t>
+	ipv4Udp(const Sender& sender, uint16_t port, const std::vector<uint8_t>& payload, uint8_t protocol = 17, bool fragment = false)
+	{
+		Bytes ip;
+		ip.u8(0x45);
+		ip.u8(0);
+		ip.u16(static_cast<uint16_t>(20 + 8 + payload.size()), true);
+		ip.u16(0x1234, true);
+		ip.u16(fragment ? 0x2000 : 0x4000, true); // MF, or DF only
+		ip.u8(64);
+		ip.u8(protocol);
+		ip.u16(0, true);
+		for (uint8_t octet : sender.address)
+		{
+			ip.u8(octet);
+		}
+		for (uint8_t octet : { 192, 168, 1, 50 })
+		{
+			ip.u8(octet);
+		}
+		ip.u16(56000, true);
+		ip.u16(port, true);
+		ip.u16(static_cast<uint16_t>(8 + payload.size()), true);
+		ip.u16(0, true);
+		ip.append(payload);
+		return ip.data;
+	}
+
+	std::vector<uint8_t>
+	ethernet(const std::vector<uint8_t>& ip, bool vlan)
+	{
+		Bytes frame;
+		for (int i = 0; i < 12; ++i)
+		{
+			frame.u8(static_cast<uint8_t>(i));
+		}
+		if (vlan)
+		{
+			frame.u16(0x8100, true);
+			frame.u16(7, true);
+		}
+		frame.u16(0x0800, true);
+		frame.append(ip);
+		return frame.data;
+	}
+
+	std::vector<uint8_t>
+	linuxSll(const std::vector<uint8_t>& ip)
+	{
+		Bytes frame;
+		frame.u16(0, true);     // packet type
+		frame.u16(1, true);     // ARPHRD_ETHER
+		frame.u16(6, true);     // address length
+		for (int i = 0; i < 8; ++i)
+		{
+			frame.u8(static_cast<uint8_t>(i));
+		}
+		frame.u16(0x0800, true);
+		frame.append(ip);
+		return frame.data;
+	}
+
+	std::vector<uint8_t>
+	pcap(const std::vector<std::vector<uint8_t>>& frames, uint32_t link_type, bool big_endian, bool nanos)
+	{
+		Bytes file;
+		file.u32(nanos ? 0xa1b23c4d : 0xa1b2c3d4, big_endian);
+		file.u16(2, big_endian);
+		file.u16(4, big_endian);
+		file.u32(0, big_endian);
+		file.u32(0, big_endian);
+		file.u32(65535, big_endian);
+		file.u32(link_type, big_endian);
+		uint32_t fraction = 0;
+		for (const std::vector<uint8_t>& frame : frames)
+		{
+			file.u32(1700000000, big_endian);
+			file.u32(fraction, big_endian);
+			file.u32(static_cast<uint32_t>(frame.size()), big_endian);
+			file.u32(static_cast<uint32_t>(frame.size()), big_endian);
+			file.append(frame);
+			fraction += nanos ? 100000 : 100;
+		}
+		return file.data;
+	}
+
+	// One section with a nanosecond raw-IPv4 interface. Frames alternate
+	// between enhanced and simple packet blocks.
+	std::vector<uint8_t>
+	pcapng(const std::vector<std::vector<uint8_t>>& frames)
+	{
+		Bytes file;
+		file.u32(0x0a0d0d0a, false);
+		file.u32(28, false);
+		file.u32(0x1a2b3c4d, false);
+		file.u16(1, false);
+		file.u16(0, false);
+		file.u32(0xffffffff, false);
+		file.u32(0xffffffff, false);
+		file.u32(28, false);
+
+		file.u32(1, false);
+		file.u32(32, false);
+		file.u16(static_cast<uint16_t>(kLinkIpv4), false);
+		file.u16(0, false);
+		file.u32(65535, false);
+		file.u16(9, false); // if_tsresol
+		file.u16(1, false);
+		file.u8(9);
+		file.pad4();
+		file.u16(0, false); // opt_endofopt
+		file.u16(0, false);
+		file.u32(32, false);
+
+		uint64_t stamp = 1700000000ull * 1000000000ull;
+		for (size_t i = 0; i < frames.size(); ++i)
+		{
+			const std::vector<uint8_t>& frame = frames[i];
+			const uint32_t padded = static_cast<uint32_t>((frame.size() + 3) & ~size_t(3));
+			if (i % 2 == 0)
+			{
+				file.u32(6, false);
+				file.u32(32 + padded, false);
+				file.u32(0, false);
+				file.u32(static_cast<uint32_t>(stamp >> 32), false);
+				file.u32(static_cast<uint32_t>(stamp), false);
+				file.u32(static_cast<uint32_t>(frame.size()), false);
+				file.u32(static_cast<uint32_t>(frame.size()), false);
+				file.append(frame);
+				file.pad4();
+				file.u32(32 + padded, false);
+			}
+			else
+			{
+				file.u32(3, false);
+				file.u32(16 + padded, false);
+				file.u32(static_cast<uint32_t>(frame.size()), false);
+				file.append(frame);
+				file.pad4();
+				file.u32(16 + padded, false);
+			}
+			stamp += 100000;
+		}
+		return file.data;
+	}
+
+	class CollectingSink : public PacketSink
+	{
+	public:
+		void onPacket(uint32_t handle, const LivoxLidarEthernetPacket* packet) override
+		{
+			const std::lock_guard<std::mutex> lock(mutex_);
+			const auto* bytes = reinterpret_cast<const uint8_t*>(packet);
+			handles.push_back(handle);
+			packets.emplace_back(bytes, bytes + PacketSource::packetSize(packet));
+		}
+
+		void onImuPacket(uint32_t, const LivoxLidarEthernetPacket*) override {}
+
+		void onLidarInfo(uint32_t handle, const std::string&, const std::string& ip) override
+		{
+			const std::lock_guard<std::mutex> lock(mutex_);
+			lidars.emplace_back(handle, ip);
+		}
+
+		void onInfoMessage(const std::string&) override {}
+
+		void onStatus(const std::string& text) override
+		{
+			const std::lock_guard<std::mutex> lock(mutex_);
+			status = text;
+			if (text.compare(0, 16, "Capture finished") == 0)
+			{
+				finished.store(true);
+			}
+		}
+
+		std::mutex mutex_;
+		std::vector<uint32_t> handles;
+		std::vector<std::vector<uint8_t>> packets;
+		std::vector<std::pair<uint32_t, std::string>> lidars;
+		std::string status;
+		std::atomic<bool> finished{ false };
+	};
+
+	std::string
+	writeCapture(const char* name, const std::vector<uint8_t>& bytes)
+	{
+		std::ofstream file(name, std::ios::binary);
+		file.write(reinterpret_cast<const char*>(bytes.data()), static_cast<std::streamsize>(bytes.size()));
+		return name;
+	}
+
+	// Plays the capture unpaced to the end and checks what arrived.
+	void
+	play(const char* name, const std::vector<uint8_t>& capture, const std::vector<std::vector<uint8_t>>& expected, const std::vector<uint32_t>& handles, size_t other_frames)
+	{
+		PcapPacketSource::Config config;
+		config.path = writeCapture(name, capture);
+		config.speed = 0.0;
+		PcapPacketSource source(config);
+		CollectingSink sink;
+		CHECK(source.start(sink));
+		const auto deadline = std::chrono::steady_clock::now() + kTimeout;
+		while (!sink.finished.load() && std::chrono::steady_clock::now() < deadline)
+		{
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		}
+		source.stop();
+		std::remove(name);
+
+		CHECK(sink.finished.load());
+		CHECK(sink.packets == expected);
+		CHECK(sink.handles == handles);
+		const std::string counts = "(" + std::to_string(expected.size()) + " point packets, " + std::to_string(other_frames) + " other frames)";
+		CHECK(sink.status.size() >= counts.size() && sink.status.compare(sink.status.size() - counts.size(), counts.size(), counts) == 0);
+
+		// Each sender is announced once, before its first packet.
+		std::vector<std::pair<uint32_t, std::string>> lidars;
+		for (uint32_t handle : handles)
+		{
+			const Sender& sender = handle == kFirst.handle ? kFirst : kSecond;
+			const std::pair<uint32_t, std::string> lidar(sender.handle, sender.ip);
+			if (std::find(lidars.begin(), lidars.end(), lidar) == lidars.end())
+			{
+				lidars.push_back(lidar);
+			}
+		}
+		CHECK(sink.lidars == lidars);
+	}
+
+	void
+	testCaptures()
+	{
+		std::mt19937 rng(4);
+		const std::vector<uint8_t> a = makePacket(kLivoxLidarCartesianCoordinateHighData, 96, 1000, rng);
+		const std::vector<uint8_t> b = makePacket(kLivoxLidarCartesianCoordinateLowData, 96, 2000, rng);
+		const std::vector<uint8_t> c = makePacket(kLivoxLidarCartesianCoordinateHighData, 5, 3000, rng);
+		const std::vector<uint8_t> imu_port_packet = makePacket(kLivoxLidarCartesianCoordinateHighData, 1, 0, rng);
+		const std::vector<std::vector<uint8_t>> expected = { a, b, c };
+		const std::vector<uint32_t> handles = { kFirst.handle, kSecond.handle, kFirst.handle };
+
+		// Three point packets among a datagram to another port, a TCP segment
+		// and a fragment, none of which may come through.
+		const std::vector<std::vector<uint8_t>> ip = {
+			ipv4Udp(kFirst, kPointPort, a),
+			ipv4Udp(kFirst, 56401, imu_port_packet),
+			ipv4Udp(kSecond, kPointPort, b),
+			ipv4Udp(kSecond, kPointPort, b, 6),
+			ipv4Udp(kFirst, kPointPort, c, 17, true),
+			ipv4Udp(kFirst, kPointPort, c)
+		};
+
+		std::vector<std::vector<uint8_t>> ethernet_frames;
+		std::vector<std::vector<uint8_t>> sll_frames;
+		for (size_t i = 0; i < ip.size(); ++i)
+		{
+			ethernet_frames.push_back(ethernet(ip[i], i == 2));
+			sll_frames.push_back(linuxSll(ip[i]));
+		}
+
+		play("test_ethernet.pcap", pcap(ethernet_frames, kLinkEthernet, false, false), expected, handles, 3);
+		play("test_sll_swapped.pcap", pcap(sll_frames, kLinkLinuxSll, true, true), expected, handles, 3);
+		play("test_raw.pcapng", pcapng(ip), expected, handles, 3);
+	}
+
+	void
+	testRejectedFiles()
+	{
+		CollectingSink sink;
+		PcapPacketSource::Config config;
+		config.path = "test_missing.pcap";
+		CHECK(!PcapPacketSource(config).start(sink));
+
+		config.path = writeCapture("test_not_a_capture.pcap", std::vector<uint8_t>(64, 0x55));
+		CHECK(!PcapPacketSource(config).start(sink));
+		CHECK(sink.status.compare(0, 24, "Not a pcap or pcapng cap") == 0);
+		std::remove(config.path.c_str());
+	}
+}
+
+int
+main()
+{
+	testCaptures();
+	testRejectedFiles();
+	return checkResult();
+}
@@ -0,0 +1,111 @@
+// PointDecoder: both formats decode to metres with intensity and tag carried
+// over, a transform lands where the matrix says, and the active kernel agrees
+// bit for bit with the scalar one (Benchmark::verifyDecoders).
+
+#include "Check.h"
+
+#include "Benchmark.h"
+#include "PointDecoder.h"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+namespace
+{
+	constexpr float kTolerance = 1e-5f;
+
+	bool
+	near(float value, float expected)
+	{
+		return std::fabs(value - expected) <= kTolerance * std::max(1.0f, std::fabs(expected));
+	}
+
+	struct Output
+	{
+		explicit Output(size_t count)
+		{
+			block.resize(count);
+			columns = block.columns();
+		}
+
+		PointBlock block;
+		PointColumns columns;
+	};
+
+	void
+	testKnownValues()
+	{
+		// More than one AVX2 batch, so both kernels take part.
+		constexpr size_t kCount = 19;
+		std::vector<LivoxLidarCartesianHighRawPoint> high(kCount);
+		std::vector<LivoxLidarCartesianLowRawPoint> low(kCount);
+		for (size_t i = 0; i < kCount; ++i)
+		{
+			const int32_t sign = i % 2 == 0 ? 1 : -1;
+			high[i] = { sign * static_cast<int32_t>(1234 + i), static_cast<int32_t>(-5000 * i), 70000, static_cast<uint8_t>(i * 10), static_cast<uint8_t>(i) };
+			low[i] = { static_cast<int16_t>(sign * static_cast<int32_t>(123 + i)), static_cast<int16_t>(-50 * static_cast<int32_t>(i)), 7000, static_cast<uint8_t>(i * 10), static_cast<uint8_t>(i) };
+		}
+
+		Output decoded_high(kCount);
+		Output decoded_low(kCount);
+		PointDecoder::decodeHigh(high.data(), kCount, decoded_high.columns);
+		PointDecoder::decodeLow(low.data(), kCount, decoded_low.columns);
+		for (size_t i = 0; i < kCount; ++i)
+		{
+			const float sign = i % 2 == 0 ? 1.0f : -1.0f;
+			// Millimetres for High, centimetres for Low.
+			CHECK(near(decoded_high.columns.x[i], sign * (1.234f + 0.001f * i)));
+			CHECK(near(decoded_high.columns.y[i], -5.0f * i));
+			CHECK(near(decoded_high.columns.z[i], 70.0f));
+			CHECK(near(decoded_low.columns.x[i], sign * (1.23f + 0.01f * i)));
+			CHECK(near(decoded_low.columns.y[i], -0.5f * i));
+			CHECK(near(decoded_low.columns.z[i], 70.0f));
+			for (const Output* output : { &decoded_high, &decoded_low })
+			{
+				CHECK(output->columns.intensity[i] == static_cast<float>(i * 10));
+				CHECK(output->columns.tag[i] == static_cast<float>(i));
+			}
+		}
+	}
+
+	void
+	testTransform()
+	{
+		// Yaw 90 degrees maps +x onto +y, then the translation is added.
+		const PointTransform transform = PointTransform::fromEuler(1.0, 2.0, 3.0, 0.0, 0.0, 90.0);
+		CHECK(!transform.isIdentity());
+		CHECK(PointTransform().isIdentity());
+
+		constexpr size_t kCount = 11;
+		std::vector<LivoxLidarCartesianHighRawPoint> high(kCount, LivoxLidarCartesianHighRawPoint{ 1000, 0, 500, 7, 1 });
+		Output output(kCount);
+		PointDecoder::decodeHigh(high.data(), kCount, output.columns, &transform);
+		for (size_t i = 0; i < kCount; ++i)
+		{
+			CHECK(near(output.columns.x[i], 1.0f));
+			CHECK(near(output.columns.y[i], 3.0f));
+			CHECK(near(output.columns.z[i], 3.5f));
+			CHECK(output.columns.intensity[i] == 7.0f);
+		}
+	}
+
+	void
+	testKernelsAgree()
+	{
+		for (const Benchmark::Result& result : Benchmark::verifyDecoders())
+		{
+			CHECK(result.points > 0);
+			CHECK(result.mismatches == 0);
+		}
+	}
+}
+
+int
+main()
+{
+	testKnownValues();
+	testTransform();
+	testKernelsAgree();
+	return checkResult();
+}
@@ -0,0 +1,191 @@
+// SpatialFilter against a straightforward trigonometric reference: random
+// settings and points through both kernels must keep exactly the points the
+// reference keeps, in order and with their indices. Points within rounding
+// distance of a limit are not judged.
+
+#include "Check.h"
+
+#include "SpatialFilter.h"
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <vector>
+
+namespace
+{
+	using Settings = SpatialFilter::Settings;
+
+	constexpr size_t kPoints = 10007;
+	constexpr int kRounds = 400;
+	constexpr double kDistanceSlack = 1e-4;
+	constexpr double kAngleSlack = 0.01;
+	constexpr double kRadToDeg = 180.0 / 3.14159265358979323846;
+
+	enum class Verdict
+	{
+		Rejected,
+		Kept,
+		Borderline
+	};
+
+	Verdict
+	reference(const Settings& settings, float x, float y, float z)
+	{
+		bool borderline = false;
+		const auto within = [&borderline](double value, double low, double high, double slack) {
+			borderline = borderline || std::fabs(value - low) < slack || std::fabs(value - high) < slack;
+			return value >= low && value <= high;
+		};
+
+		bool kept = true;
+		if (settings.crop)
+		{
+			kept = within(x, settings.crop_min[0], settings.crop_max[0], kDistanceSlack) && kept;
+			kept = within(y, settings.crop_min[1], settings.crop_max[1], kDistanceSlack) && kept;
+			kept = within(z, settings.crop_min[2], settings.crop_max[2], kDistanceSlack) && kept;
+		}
+		const double range = std::sqrt(double(x) * x + double(y) * y + double(z) * z);
+		if (settings.range)
+		{
+			kept = within(range, settings.min_range, settings.max_range, kDistanceSlack) && kept;
+		}
+		if (settings.sector && range > 1e-6)
+		{
+			const double azimuth = std::atan2(y, x) * kRadToDeg;
+			const double elevation = std::atan2(z, std::hypot(x, y)) * kRadToDeg;
+			const double span = settings.azimuth[1] - settings.azimuth[0];
+			if (span < 360.0)
+			{
+				// Counter-clockwise offsets from the first azimuth.
+				const double width = std::fmod(std::fmod(span, 360.0) + 360.0, 360.0);
+				const double offset = std::fmod(std::fmod(azimuth - settings.azimuth[0], 360.0) + 360.0, 360.0);
+				borderline = borderline || offset < kAngleSlack || offset > 360.0 - kAngleSlack || std::fabs(offset - width) < kAngleSlack;
+				kept = offset <= width && kept;
+			}
+			const double low = std::max(-90.0, double(std::min(settings.elevation[0], settings.elevation[1])));
+			const double high = std::min(90.0, double(std::max(settings.elevation[0], settings.elevation[1])));
+			kept = within(elevation, low, high, kAngleSlack) && kept;
+		}
+		return borderline ? Verdict::Borderline : (kept ? Verdict::Kept : Verdict::Rejected);
+	}
+
+	Settings
+	randomSettings(int round, std::mt19937& rng)
+	{
+		std::uniform_real_distribution<float> coordinate(-30.0f, 30.0f);
+		std::uniform_real_distribution<float> azimuth(-180.0f, 180.0f);
+		std::uniform_real_distribution<float> elevation(-90.0f, 90.0f);
+
+		Settings settings;
+		settings.crop = round % 2 != 0;
+		settings.range = (round / 2) % 2 != 0;
+		settings.sector = (round / 4) % 2 != 0 || round > 8;
+		for (int axis = 0; axis < 3; ++axis)
+		{
+			const float a = coordinate(rng);
+			const float b = coordinate(rng);
+			settings.crop_min[axis] = std::min(a, b);
+			settings.crop_max[axis] = std::max(a, b);
+		}
+		settings.min_range = std::fabs(coordinate(rng)) / 3.0f;
+		settings.max_range = settings.min_range + std::fabs(coordinate(rng));
+		// Every third sector wraps through 180 degrees.
+		settings.azimuth[0] = azimuth(rng);
+		settings.azimuth[1] = azimuth(rng) + (round % 3 == 0 ? 180.0f : 0.0f);
+		settings.elevation[0] = elevation(rng);
+		settings.elevation[1] = elevation(rng);
+		if (round % 7 == 0)
+		{
+			settings.azimuth[0] = -180.0f;
+			settings.azimuth[1] = 180.0f;
+		}
+		if (round % 11 == 0)
+		{
+			settings.elevation[0] = -90.0f;
+			settings.elevation[1] = 90.0f;
+		}
+		return settings;
+	}
+
+	void
+	testAgainstReference()
+	{
+		std::mt19937 rng(3);
+		std::uniform_real_distribution<float> coordinate(-30.0f, 30.0f);
+		PointBlock block;
+		block.resize(kPoints);
+		const PointColumns columns = block.columns();
+		std::vector<float> x(kPoints);
+		std::vector<float> y(kPoints);
+		std::vector<float> z(kPoints);
+		std::vector<uint32_t> indices(kPoints);
+
+		for (int round = 0; round < kRounds; ++round)
+		{
+			const Settings settings = randomSettings(round, rng);
+			SpatialFilter filter;
+			filter.configure(settings);
+
+			// Every fifth round is flat, and the first point is the origin.
+			const float flatten = round % 5 == 0 ? 0.0f : 1.0f;
+			for (size_t i = 0; i < kPoints; ++i)
+			{
+				x[i] = columns.x[i] = i == 0 ? 0.0f : coordinate(rng);
+				y[i] = columns.y[i] = i == 0 ? 0.0f : coordinate(rng);
+				z[i] = columns.z[i] = i == 0 ? 0.0f : coordinate(rng) * flatten;
+				columns.intensity[i] = static_cast<float>(i);
+				columns.tag[i] = static_cast<float>(i % 5);
+				indices[i] = static_cast<uint32_t>(i);
+			}
+
+			const size_t kept = round % 2 != 0 ? filter.applyScalar(columns, kPoints, indices.data()) : filter.apply(columns, kPoints, indices.data());
+			CHECK(filter.rejectedPoints() == kPoints - kept);
+
+			size_t next = 0;
+			for (size_t i = 0; i < kPoints; ++i)
+			{
+				const bool survived = next < kept && indices[next] == i;
+				if (survived)
+				{
+					CHECK(columns.x[next] == x[i] && columns.y[next] == y[i] && columns.z[next] == z[i]);
+					CHECK(columns.intensity[next] == static_cast<float>(i) && columns.tag[next] == static_cast<float>(i % 5));
+					++next;
+				}
+				const Verdict verdict = reference(settings, x[i], y[i], z[i]);
+				CHECK(verdict == Verdict::Borderline || (verdict == Verdict::Kept) == survived);
+			}
+			CHECK(next == kept);
+		}
+	}
+
+	void
+	testDisabled()
+	{
+		SpatialFilter filter;
+		filter.configure(Settings());
+		CHECK(!filter.enabled());
+
+		PointBlock block;
+		block.resize(4);
+		const PointColumns columns = block.columns();
+		for (size_t i = 0; i < 4; ++i)
+		{
+			columns.x[i] = 100.0f * i;
+			columns.y[i] = columns.z[i] = columns.intensity[i] = columns.tag[i] = 0.0f;
+		}
+		uint32_t indices[4] = { 9, 9, 9, 9 };
+		CHECK(filter.apply(columns, 4, indices) == 4);
+		CHECK(columns.x[3] == 300.0f);
+		CHECK(indices[0] == 9);
+		CHECK(filter.rejectedPoints() == 0);
+	}
+}
+
+int
+main()
+{
+	testAgainstReference();
+	testDisabled();
+	return checkResult();
+}
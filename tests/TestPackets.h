@@ -0,0 +1,67 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <random>
+#include <vector>
+
+#include "livox_lidar_api.h"
+#include "PacketSource.h"
+
+// A Livox point packet of dot_num records in the given format. Records are
+// random over the full coordinate range unless smooth is set, in which case
+// they follow a slowly varying scan line the way real returns do.
+inline std::vector<uint8_t>
+makePacket(LivoxLidarPointDataType data_type, size_t dot_num, uint64_t timestamp, std::mt19937& rng, bool smooth = false)
+{
+	std::vector<uint8_t> bytes(PacketSource::packetSize(static_cast<uint8_t>(data_type), dot_num));
+	auto* packet = reinterpret_cast<LivoxLidarEthernetPacket*>(bytes.data());
+	packet->version = 0;
+	packet->length = static_cast<uint16_t>(bytes.size());
+	packet->time_interval = 5000;
+	packet->dot_num = static_cast<uint16_t>(dot_num);
+	packet->udp_cnt = static_cast<uint16_t>(rng());
+	packet->frame_cnt = 0;
+	packet->data_type = static_cast<uint8_t>(data_type);
+	packet->time_type = 0;
+	std::memcpy(packet->timestamp, &timestamp, sizeof(timestamp));
+
+	std::uniform_int_distribution<int32_t> any(INT32_MIN, INT32_MAX);
+	std::uniform_int_distribution<int32_t> step(-40, 40);
+	int32_t x = 5000;
+	int32_t y = -2000;
+	int32_t z = 800;
+	for (size_t i = 0; i < dot_num; ++i)
+	{
+		if (smooth)
+		{
+			x += step(rng);
+			y += step(rng);
+			z += step(rng);
+		}
+		const uint8_t reflectivity = smooth ? static_cast<uint8_t>(100 + i % 3) : static_cast<uint8_t>(rng());
+		const uint8_t tag = smooth ? 0 : static_cast<uint8_t>(rng());
+		if (data_type == kLivoxLidarCartesianCoordinateHighData)
+		{
+			LivoxLidarCartesianHighRawPoint point;
+			point.x = smooth ? x : any(rng);
+			point.y = smooth ? y : any(rng);
+			point.z = smooth ? z : any(rng);
+			point.reflectivity = reflectivity;
+			point.tag = tag;
+			std::memcpy(packet->data + i * sizeof(point), &point, sizeof(point));
+		}
+		else
+		{
+			LivoxLidarCartesianLowRawPoint point;
+			point.x = static_cast<int16_t>(smooth ? x / 10 : any(rng));
+			point.y = static_cast<int16_t>(smooth ? y / 10 : any(rng));
+			point.z = static_cast<int16_t>(smooth ? z / 10 : any(rng));
+			point.reflectivity = reflectivity;
+			point.tag = tag;
+			std::memcpy(packet->data + i * sizeof(point), &point, sizeof(point));
+		}
+	}
+	return bytes;
+}
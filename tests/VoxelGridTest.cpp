@@ -0,0 +1,135 @@
+// VoxelGrid against a map of cells: every occupied voxel must come out once,
+// in order of its first point, at the centroid of its points with their mean
+// intensity and the first point's tag and times.
+
+#include "Check.h"
+
+#include "VoxelGrid.h"
+
+#include <algorithm>
+#include <cmath>
+#include <map>
+#include <random>
+#include <tuple>
+#include <vector>
+
+namespace
+{
+	constexpr size_t kPoints = 20000;
+	constexpr float kLeaf = 0.25f;
+	constexpr int kCells = 12;
+	constexpr float kTolerance = 1e-4f;
+
+	using Cell = std::tuple<int, int, int>;
+
+	struct Expected
+	{
+		size_t first = 0;
+		size_t count = 0;
+		double x = 0.0;
+		double y = 0.0;
+		double z = 0.0;
+		double intensity = 0.0;
+	};
+
+	bool
+	near(float value, double expected)
+	{
+		return std::fabs(value - expected) <= kTolerance * std::max(1.0, std::fabs(expected));
+	}
+
+	void
+	testCentroids(float offset, uint32_t seed)
+	{
+		std::mt19937 rng(seed);
+		std::uniform_int_distribution<int> cell(-kCells, kCells);
+		// Points stay clear of the cell faces, so float rounding cannot move
+		// one into a neighbouring voxel.
+		std::uniform_real_distribution<float> inside(0.1f, 0.9f);
+		std::uniform_real_distribution<float> intensity(0.0f, 255.0f);
+
+		PointBlock block;
+		block.resize(kPoints);
+		const PointColumns points = block.columns();
+		std::map<Cell, Expected> cells;
+		for (size_t i = 0; i < kPoints; ++i)
+		{
+			const Cell key(cell(rng), cell(rng), cell(rng) / 4);
+			points.x[i] = (offset + std::get<0>(key) + inside(rng)) * kLeaf;
+			points.y[i] = (std::get<1>(key) + inside(rng)) * kLeaf;
+			points.z[i] = (std::get<2>(key) + inside(rng)) * kLeaf;
+			points.intensity[i] = intensity(rng);
+			points.tag[i] = static_cast<float>(i % 7);
+			points.timestamp[i] = 1000 + i;
+			points.received[i] = 5000 + i;
+
+			Expected& expected = cells[key];
+			if (expected.count == 0)
+			{
+				expected.first = i;
+			}
+			++expected.count;
+			expected.x += points.x[i];
+			expected.y += points.y[i];
+			expected.z += points.z[i];
+			expected.intensity += points.intensity[i];
+		}
+
+		VoxelGrid grid;
+		grid.setLeafSize(kLeaf);
+		const size_t kept = grid.filter(points, kPoints);
+		CHECK(kept == cells.size());
+		CHECK(grid.removedPoints() == kPoints - kept);
+
+		std::vector<const Expected*> ordered(kPoints, nullptr);
+		for (const auto& entry : cells)
+		{
+			ordered[entry.second.first] = &entry.second;
+		}
+		size_t v = 0;
+		for (const Expected* expected : ordered)
+		{
+			if (expected == nullptr || v >= kept)
+			{
+				continue;
+			}
+			const double count = static_cast<double>(expected->count);
+			CHECK(near(points.x[v], expected->x / count));
+			CHECK(near(points.y[v], expected->y / count));
+			CHECK(near(points.z[v], expected->z / count));
+			CHECK(near(points.intensity[v], expected->intensity / count));
+			CHECK(points.tag[v] == static_cast<float>(expected->first % 7));
+			CHECK(points.timestamp[v] == 1000 + expected->first);
+			CHECK(points.received[v] == 5000 + expected->first);
+			++v;
+		}
+	}
+
+	void
+	testLeafOff()
+	{
+		PointBlock block;
+		block.resize(3);
+		const PointColumns points = block.columns();
+		for (size_t i = 0; i < 3; ++i)
+		{
+			points.x[i] = points.y[i] = points.z[i] = 0.01f * i;
+			points.intensity[i] = points.tag[i] = 0.0f;
+		}
+		VoxelGrid grid;
+		grid.setLeafSize(0.0f);
+		CHECK(grid.filter(points, 3) == 3);
+		CHECK(points.x[2] == 0.02f);
+		CHECK(grid.removedPoints() == 0);
+	}
+}
+
+int
+main()
+{
+	testCentroids(0.0f, 11);
+	// Far from the origin, where the sums rely on being relative.
+	testCentroids(400.0f, 12);
+	testLeafOff();
+	return checkResult();
+}
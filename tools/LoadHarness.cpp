@@ -0,0 +1,320 @@
+// Headless load test of the ingest and drain path. Drives a LivoxDevice from
+// the synthetic source at several multiples of the Mid-360 point rate while a
+// fixed-rate loop stands in for TouchDesigner's cook, and prints one CSV row
+// per load level: sustained rates, dropped points, receive-to-output latency,
+// cook time and per-packet handler time.
+//
+// Usage: LoadHarness [--seconds N] [--cook-hz N] [--points-per-cook N]
+//                    [--buffer-limit N] [--storage decoded|raw] [--scales 1,5,20]
+
+#include "LatencyHistogram.h"
+#include "LivoxDevice.h"
+#include "PointRing.h"
+#include "Profiler.h"
+#include "SyntheticPacketSource.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace
+{
+	using Clock = std::chrono::steady_clock;
+
+	constexpr double kNanosPerMicro = 1000.0;
+	constexpr double kMicrosPerMilli = 1000.0;
+	constexpr double kP50 = 0.5;
+	constexpr double kP99 = 0.99;
+
+	// Each level first runs this long unmeasured, so start-up and the sensor's
+	// registration are not counted. It also lets the profiler close its first
+	// window, which starts when the device is created.
+	constexpr auto kWarmup = std::chrono::seconds(1);
+	constexpr auto kProfileWindow = std::chrono::seconds(1);
+
+	struct Options
+	{
+		double seconds = 5.0;
+		double cook_hz = 60.0;
+		// The CHOP's Points Per Cook maximum and Buffer Limit default.
+		size_t points_per_cook = 65536;
+		size_t buffer_limit = 200000;
+		LivoxDevice::BufferStorage storage = LivoxDevice::BufferStorage::Decoded;
+		std::vector<double> scales = { 1.0, 5.0, 20.0 };
+	};
+
+	struct LevelResult
+	{
+		double scale = 0.0;
+		double offered_rate = 0.0;
+		double ingested_rate = 0.0;
+		double output_rate = 0.0;
+		uint64_t evicted = 0;
+		uint64_t skipped = 0;
+		uint64_t cooks = 0;
+		uint64_t late_cooks = 0;
+		LatencyHistogram latency_us;
+		LatencyHistogram cook_ns;
+		// Over the profiler's one-second windows: mean of the medians, worst
+		// 99th percentile and worst maximum.
+		double ingest_p50_us = 0.0;
+		double ingest_p99_us = 0.0;
+		double ingest_max_us = 0.0;
+	};
+
+	void
+	printUsage()
+	{
+		std::cerr << "Usage: LoadHarness [--seconds N] [--cook-hz N] [--points-per-cook N]\n"
+			"                   [--buffer-limit N] [--storage decoded|raw] [--scales 1,5,20]\n";
+	}
+
+	bool
+	parseScales(const std::string& text, std::vector<double>& scales)
+	{
+		scales.clear();
+		std::stringstream stream(text);
+		std::string item;
+		while (std::getline(stream, item, ','))
+		{
+			const double scale = std::atof(item.c_str());
+			if (scale <= 0.0)
+			{
+				return false;
+			}
+			scales.push_back(scale);
+		}
+		return !scales.empty();
+	}
+
+	bool
+	parseOptions(int argc, char** argv, Options& options)
+	{
+		for (int i = 1; i < argc; ++i)
+		{
+			const char* name = argv[i];
+			if (i + 1 >= argc)
+			{
+				return false;
+			}
+			const char* value = argv[++i];
+			if (std::strcmp(name, "--seconds") == 0)
+			{
+				options.seconds = std::atof(value);
+			}
+			else if (std::strcmp(name, "--cook-hz") == 0)
+			{
+				options.cook_hz = std::atof(value);
+			}
+			else if (std::strcmp(name, "--points-per-cook") == 0)
+			{
+				options.points_per_cook = static_cast<size_t>(std::strtoull(value, nullptr, 10));
+			}
+			else if (std::strcmp(name, "--buffer-limit") == 0)
+			{
+				options.buffer_limit = static_cast<size_t>(std::strtoull(value, nullptr, 10));
+			}
+			else if (std::strcmp(name, "--storage") == 0 && std::strcmp(value, "decoded") == 0)
+			{
+				options.storage = LivoxDevice::BufferStorage::Decoded;
+			}
+			else if (std::strcmp(name, "--storage") == 0 && std::strcmp(value, "raw") == 0)
+			{
+				options.storage = LivoxDevice::BufferStorage::RawPackets;
+			}
+			else if (std::strcmp(name, "--scales") == 0)
+			{
+				if (!parseScales(value, options.scales))
+				{
+					return false;
+				}
+			}
+			else
+			{
+				return false;
+			}
+		}
+		return options.seconds > 0.0 && options.cook_hz > 0.0 && options.points_per_cook > 0 && options.buffer_limit > 0;
+	}
+
+	double
+	profileValue(const Profiler& profiler, const char* name)
+	{
+		for (size_t i = 0; i < profiler.channelCount(); ++i)
+		{
+			if (std::strcmp(profiler.channelName(i), name) == 0)
+			{
+				return profiler.channelValue(i);
+			}
+		}
+		return 0.0;
+	}
+
+	// Ages of the drained points at the end of the cook, as the CHOP's
+	// latency channels measure them.
+	void
+	recordLatency(const uint64_t* received, size_t count, LatencyHistogram& histogram)
+	{
+		const uint64_t now = PacketStamp::hostNow();
+		for (size_t i = 0; i < count;)
+		{
+			size_t run = 1;
+			while (i + run < count && received[i + run] == received[i])
+			{
+				++run;
+			}
+			const uint64_t age = now > received[i] ? (now - received[i]) / static_cast<uint64_t>(kNanosPerMicro) : 0;
+			histogram.record(age, run);
+			i += run;
+		}
+	}
+
+	LevelResult
+	runLevel(const Options& options, double scale)
+	{
+		LevelResult result;
+		result.scale = scale;
+
+		SyntheticPacketSource::Config config;
+		config.rate_scale = scale;
+		result.offered_rate = config.points_per_second * scale;
+
+		LivoxDevice device;
+		device.setBufferStorage(options.storage);
+		device.setBufferLimit(options.buffer_limit);
+		device.start(std::make_unique<SyntheticPacketSource>(config));
+
+		PointBlock block;
+		block.resize(options.points_per_cook);
+		std::vector<float> sensor(options.points_per_cook);
+		PointColumns destination = block.columns();
+		destination.tag = nullptr;
+		destination.timestamp = nullptr;
+		destination.sensor = sensor.data();
+
+		const Clock::duration period = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / options.cook_hz));
+		const Clock::time_point start = Clock::now();
+		const Clock::time_point measure_start = start + kWarmup;
+		const Clock::time_point end = measure_start + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(options.seconds));
+		Clock::time_point next_cook = start;
+		Clock::time_point next_window = measure_start;
+		bool measuring = false;
+		uint64_t first_total = 0;
+		uint64_t first_evicted = 0;
+		uint64_t first_skipped = 0;
+		uint64_t consumed = 0;
+		size_t windows = 0;
+		double p50_sum = 0.0;
+
+		for (;;)
+		{
+			std::this_thread::sleep_until(next_cook);
+			// Runs past the end if need be until one profiler window has closed.
+			const Clock::time_point cook_start = Clock::now();
+			if (cook_start >= end && windows > 0)
+			{
+				break;
+			}
+			if (!measuring && cook_start >= measure_start)
+			{
+				measuring = true;
+				first_total = device.totalPoints();
+				first_evicted = device.evictedPoints();
+				first_skipped = device.skippedPoints();
+				// Closes the warm-up window.
+				device.profiler().update(cook_start);
+				next_window = cook_start + kProfileWindow;
+			}
+
+			const size_t drained = device.consume(destination, options.points_per_cook);
+			const Clock::time_point cook_end = Clock::now();
+			if (measuring)
+			{
+				recordLatency(destination.received, drained, result.latency_us);
+				result.cook_ns.record(static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(cook_end - cook_start).count()));
+				consumed += drained;
+				++result.cooks;
+				if (cook_end >= next_window)
+				{
+					device.profiler().update(cook_end);
+					p50_sum += profileValue(device.profiler(), "ingest_p50_us");
+					result.ingest_p99_us = std::max(result.ingest_p99_us, profileValue(device.profiler(), "ingest_p99_us"));
+					result.ingest_max_us = std::max(result.ingest_max_us, profileValue(device.profiler(), "ingest_max_us"));
+					++windows;
+					next_window = cook_end + kProfileWindow;
+				}
+			}
+
+			// A cook that overruns its slot starts the next one at once rather
+			// than bursting to catch up.
+			next_cook += period;
+			if (next_cook < cook_end)
+			{
+				next_cook = cook_end;
+				result.late_cooks += measuring ? 1 : 0;
+			}
+		}
+
+		const double elapsed = std::chrono::duration<double>(Clock::now() - measure_start).count();
+		result.ingested_rate = static_cast<double>(device.totalPoints() - first_total) / elapsed;
+		result.output_rate = static_cast<double>(consumed) / elapsed;
+		result.evicted = device.evictedPoints() - first_evicted;
+		result.skipped = device.skippedPoints() - first_skipped;
+		result.ingest_p50_us = windows == 0 ? 0.0 : p50_sum / static_cast<double>(windows);
+		device.stop();
+		return result;
+	}
+
+	void
+	writeHeader(std::ostream& stream)
+	{
+		stream << "load,offered_points_per_s,ingested_points_per_s,output_points_per_s,evicted_points,skipped_points,"
+			"cooks,late_cooks,latency_p50_ms,latency_p99_ms,latency_max_ms,cook_p50_us,cook_p99_us,cook_max_us,"
+			"ingest_p50_us,ingest_p99_us,ingest_max_us\n";
+	}
+
+	void
+	writeRow(std::ostream& stream, const LevelResult& result)
+	{
+		stream << std::fixed << std::setprecision(3)
+			<< result.scale << ',' << result.offered_rate << ',' << result.ingested_rate << ',' << result.output_rate << ','
+			<< result.evicted << ',' << result.skipped << ',' << result.cooks << ',' << result.late_cooks << ','
+			<< result.latency_us.percentile(kP50) / kMicrosPerMilli << ','
+			<< result.latency_us.percentile(kP99) / kMicrosPerMilli << ','
+			<< result.latency_us.max() / kMicrosPerMilli << ','
+			<< result.cook_ns.percentile(kP50) / kNanosPerMicro << ','
+			<< result.cook_ns.percentile(kP99) / kNanosPerMicro << ','
+			<< result.cook_ns.max() / kNanosPerMicro << ','
+			<< result.ingest_p50_us << ',' << result.ingest_p99_us << ',' << result.ingest_max_us << '\n';
+	}
+}
+
+int
+main(int argc, char** argv)
+{
+	Options options;
+	if (!parseOptions(argc, argv, options))
+	{
+		printUsage();
+		return EXIT_FAILURE;
+	}
+
+	std::cerr << "Cooking at " << options.cook_hz << " Hz, up to " << options.points_per_cook << " points per cook, "
+		<< options.buffer_limit << " point buffer limit, "
+		<< (options.storage == LivoxDevice::BufferStorage::RawPackets ? "raw packet" : "decoded") << " storage, "
+		<< options.seconds << " s per load level\n";
+	writeHeader(std::cout);
+	for (double scale : options.scales)
+	{
+		writeRow(std::cout, runLevel(options, scale));
+	}
+	return EXIT_SUCCESS;
+}